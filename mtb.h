@@ -82,9 +82,37 @@ save it in a `mtb.natvis` file somewhere reachable by your debugger.
 #define MTB_USE_STB_SPRINTF 0
 #endif
 
+// #Option Use AVX2 kernels, e.g. for the small sorting networks. Defaults to whether the compiler targets AVX2.
+#if !defined(MTB_USE_AVX2)
+#if defined(__AVX2__)
+#define MTB_USE_AVX2 1
+#else
+#define MTB_USE_AVX2 0
+#endif
+#endif
+
+// #Option Use SSE2 kernels, e.g. for probing tMap slot groups. Defaults to whether the compiler targets SSE2.
+#if !defined(MTB_USE_SSE2)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MTB_USE_SSE2 1
+#else
+#define MTB_USE_SSE2 0
+#endif
+#endif
+
+// #Option Use SSSE3 kernels, e.g. for compacting 32-bit items with pshufb. Defaults to whether the compiler targets SSSE3.
+#if !defined(MTB_USE_SSSE3)
+#if defined(__SSSE3__) || defined(__AVX__)
+#define MTB_USE_SSSE3 1
+#else
+#define MTB_USE_SSSE3 0
+#endif
+#endif
+
 #define MTB_NODISCARD [[nodiscard]]
 
 #include <float.h>   // FLT_MAX, DBL_MAX, LDBL_MAX
+#include <math.h>    // HUGE_VAL, HUGE_VALF
 #include <new>       // Placement-new
 #include <stdarg.h>  // va_list, va_start, va_end
 #include <stdint.h>  // uint8_t, uint16_t, ..., uintptr_t
@@ -95,6 +123,18 @@ save it in a `mtb.natvis` file somewhere reachable by your debugger.
 #include <string.h>  // memcpy, memmove
 #endif               // MTB_USE_LIBC
 
+#if MTB_USE_AVX2
+#include <immintrin.h>  // __m256i, _mm256_*
+#endif
+
+#if MTB_USE_SSE2
+#include <emmintrin.h>  // __m128i, _mm_*
+#endif
+
+#if MTB_USE_SSSE3
+#include <tmmintrin.h>  // _mm_shuffle_epi8
+#endif
+
 // #Option
 #if !defined(MTB_memcpy)
 #define MTB_memcpy ::mtb::CopyBytes
@@ -248,6 +288,56 @@ namespace mtb {
     }
 }  // namespace mtb
 
+// --------------------------------------------------
+// -- #Section Bit Operations -----------------------
+// --------------------------------------------------
+#if MTB_COMPILER_MSVC
+#include <intrin.h>  // _BitScanReverse64, _Interlocked*
+#endif
+
+namespace mtb {
+    MTB_NODISCARD constexpr bool IsPowerOfTwo(uint64_t value) {
+        return value && (value & (value - 1)) == 0;
+    }
+
+    /// Index of the most significant set bit. \a value may not be zero.
+    MTB_NODISCARD inline int Log2Floor(uint64_t value) {
+        MTB_ASSERT(value != 0);
+#if MTB_COMPILER_MSVC && !MTB_COMPILER_CLANG
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return (int)index;
+#else
+        return 63 - __builtin_clzll(value);
+#endif
+    }
+
+    /// Smallest n such that (1 << n) >= value. Log2Ceil(0) == Log2Ceil(1) == 0.
+    MTB_NODISCARD inline int Log2Ceil(uint64_t value) {
+        return value > 1 ? Log2Floor(value - 1) + 1 : 0;
+    }
+
+    MTB_NODISCARD inline int CountSetBits(uint64_t value) {
+#if MTB_COMPILER_MSVC && !MTB_COMPILER_CLANG
+        return (int)__popcnt64(value);
+#else
+        return __builtin_popcountll(value);
+#endif
+    }
+
+    /// Index of the least significant set bit. \a value may not be zero.
+    MTB_NODISCARD inline int CountTrailingZeros(uint64_t value) {
+        MTB_ASSERT(value != 0);
+#if MTB_COMPILER_MSVC && !MTB_COMPILER_CLANG
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return (int)index;
+#else
+        return __builtin_ctzll(value);
+#endif
+    }
+}  // namespace mtb
+
 #if MTB_TESTS
 namespace mtb_test_dump {
     struct tCountSizeThing {
@@ -263,6 +353,25 @@ namespace mtb_test_dump {
     static_assert(MTB_ARRAY_COUNT(tCountSizeThing::bar) == 128);
     static_assert(sizeof(tCountSizeThing::bar) == 128);
 }  // namespace mtb_test_dump
+
+/// Helpers shared between test suites. Each DOCTEST_TEST_SUITE is a namespace of its own.
+namespace mtb_test {
+    /// Small LCG so the tests don't depend on mtb_rng.h. Returns the upper 31 bits of the new state.
+    inline uint32_t NextRandom(uint64_t& state) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (uint32_t)(state >> 33);
+    }
+
+    /// tMapHashFunc for int keys.
+    inline uint64_t HashInt(void const* key, size_t) {
+        return (uint64_t)*(int const*)key * 0x9E3779B97F4A7C15ULL >> 7;
+    }
+
+    /// tMapCompareFunc for int keys.
+    inline int CompareInt(void const* a, void const* b, size_t) {
+        return *(int const*)a - *(int const*)b;
+    }
+}  // namespace mtb_test
 #endif
 
 // --------------------------------------------------
@@ -287,8 +396,23 @@ namespace mtb {
     template<>           struct tIsPOD<void const volatile> { static const bool value = true; };
 
     // clang-format on
+
+    /// Types that can be moved to another address with a plain memmove, without running any constructor or
+    /// destructor. PODs are detected automatically. Other types opt in with MTB_DECLARE_TRIVIALLY_RELOCATABLE, or by
+    /// specializing this template for class templates.
+    template<typename T>
+    struct tIsTriviallyRelocatable {
+        static constexpr bool value = MTB_IS_POD(T);
+    };
 }  // namespace mtb
 
+#define MTB_IS_TRIVIALLY_RELOCATABLE(...) (::mtb::tIsTriviallyRelocatable<__VA_ARGS__>::value)
+
+/// Use at global scope, e.g. `MTB_DECLARE_TRIVIALLY_RELOCATABLE(tMyString);`
+#define MTB_DECLARE_TRIVIALLY_RELOCATABLE(...) \
+    template<>                                 \
+    struct mtb::tIsTriviallyRelocatable<__VA_ARGS__> { static constexpr bool value = true; }
+
 namespace mtb {
     namespace impl {
         // clang-format off
@@ -357,12 +481,38 @@ namespace mtb {
             static constexpr bool value = true;
         };
 
+        template<typename A, typename B>
+        struct tIsSame {
+            static constexpr bool value = false;
+        };
+
+        template<typename T>
+        struct tIsSame<T, T> {
+            static constexpr bool value = true;
+        };
+
         // clang-format off
     }
     namespace traits {
         template<typename T> static constexpr bool is_pointer = impl::tIsPointer<tDecay<T>>::value;
     }
 
+    namespace impl {
+        // clang-format off
+        template<size_t... Is> struct tIndexSequence {};
+        template<size_t N, size_t... Is> struct tMakeIndexSequence : tMakeIndexSequence<N - 1, N - 1, Is...> {};
+        template<size_t... Is>           struct tMakeIndexSequence<0, Is...> { using tType = tIndexSequence<Is...>; };
+
+        template<size_t I, typename T, typename... Ts> struct tTypeAt                { using tType = typename tTypeAt<I - 1, Ts...>::tType; };
+        template<typename T, typename... Ts>           struct tTypeAt<0, T, Ts...>   { using tType = T; };
+        // clang-format on
+    }  // namespace impl
+
+    // clang-format off
+    template<size_t N>                  using tMakeIndexSequence = typename impl::tMakeIndexSequence<N>::tType;
+    template<size_t I, typename... Ts>  using tTypeAt = typename impl::tTypeAt<I, Ts...>::tType;
+    // clang-format on
+
 } // namespace mtb
 
 namespace mtb
@@ -536,11 +686,24 @@ namespace mtb {
             }
         }
 
+        /// Move-construct each item at its destination and destruct the source. The ranges may overlap, in which case
+        /// items are moved in the order that never overwrites a source item before it was moved.
         template<typename T, typename U>
-        static void Relocate(T* dest, U* src, size_t src_len) {
-            for(size_t index = 0; index < src_len; ++index) {
-                new(dest + index) T(src[index]);  // #TODO Do we need MoveCast(src[index]) here?
-                src[index].~U();
+        static void Relocate(T* dest, size_t dest_len, U* src, size_t src_len) {
+            MTB_ASSERT(dest_len >= src_len);
+            if((void*)dest == (void*)src) {
+                return;
+            }
+            if((uintptr_t)dest < (uintptr_t)src) {
+                for(size_t index = 0; index < src_len; ++index) {
+                    new(dest + index) T(MoveCast(src[index]));
+                    src[index].~U();
+                }
+            } else {
+                for(size_t index = src_len; index > 0; --index) {
+                    new(dest + index - 1) T(MoveCast(src[index - 1]));
+                    src[index - 1].~U();
+                }
             }
         }
     };
@@ -575,9 +738,10 @@ namespace mtb {
         tItemOps<MTB_IS_POD(T)>::Destruct(items, len);
     }
 
+    /// Move \a src to \a dest, leaving \a src as raw memory. Trivially relocatable types are moved with one memmove.
     template<typename T, typename U>
     void RelocateItems(T* dest, size_t dest_len, U* src, size_t src_len) {
-        tItemOps<MTB_IS_POD(T)>::Relocate(dest, dest_len, src, src_len);
+        tItemOps<MTB_IS_TRIVIALLY_RELOCATABLE(T)>::Relocate(dest, dest_len, src, src_len);
     }
 }  // namespace mtb
 
@@ -825,6 +989,12 @@ namespace mtb {
         MTB_memcpy(dest.ptr, src.ptr, SliceSize(src));
     }
 
+    /// Move all items of \a src to the front of \a dest. The two slices may overlap.
+    template<typename T, typename U>
+    void SliceRelocateItems(tSlice<T> dest, tSlice<U> src) {
+        RelocateItems(dest.ptr, (size_t)dest.len, src.ptr, (size_t)src.len);
+    }
+
     template<typename T>
     MTB_NODISCARD bool SliceIsZero(tSlice<T> slice) {
         tSlice<uint8_t const> bytes = PtrSlice((uint8_t const*)slice.ptr, SliceSize(slice));
@@ -1235,6 +1405,43 @@ namespace mtb {
         }
     };
 
+    // Trivially relocatable items can be moved by the allocator itself.
+    template<bool TriviallyRelocatable = true>
+    struct tResizeOps {
+        template<typename T>
+        static tSlice<T> Resize(tAllocator allocator, tSlice<T> allocation, ptrdiff_t len, ptrdiff_t new_cap) {
+            (void)len;
+            return allocator.ResizeArray(allocation, new_cap, kNoInit);
+        }
+    };
+
+    // Everything else is relocated item by item into a fresh allocation.
+    template<>
+    struct tResizeOps<false> {
+        template<typename T>
+        static tSlice<T> Resize(tAllocator allocator, tSlice<T> allocation, ptrdiff_t len, ptrdiff_t new_cap) {
+            MTB_ASSERT(len <= new_cap);
+            tSlice<T> result{};
+            if(new_cap > 0) {
+                result = allocator.template AllocArray<T>(new_cap, kNoInit);
+                if(!result) {
+                    return result;
+                }
+                RelocateItems(result.ptr, (size_t)result.len, allocation.ptr, (size_t)len);
+            }
+            if(allocation) {
+                allocator.FreeArray(allocation);
+            }
+            return result;
+        }
+    };
+
+    /// Change the size of an allocation of which the first \a len items are in use. Those items are moved along.
+    template<typename T>
+    MTB_NODISCARD tSlice<T> ResizeItems(tAllocator allocator, tSlice<T> allocation, ptrdiff_t len, ptrdiff_t new_cap) {
+        return tResizeOps<MTB_IS_TRIVIALLY_RELOCATABLE(T)>::Resize(allocator, allocation, len, new_cap);
+    }
+
 #if MTB_USE_LIBC
     MTB_NODISCARD tAllocator GetLibcAllocator();
 #endif
@@ -1271,6 +1478,202 @@ namespace mtb {
 // --------------------------------------------------
 // -- #Section Array --------------------------------
 // --------------------------------------------------
+
+// #Option Minimum alignment of each column of a tSoA. Must be supported by the allocators in use.
+#if !defined(MTB_SOA_COLUMN_ALIGNMENT)
+#define MTB_SOA_COLUMN_ALIGNMENT MTB_ALLOCATOR_DEFAULT_ALIGNMENT
+#endif
+
+// #Option Number of items in the first bucket of a tBucketArray. Must be a power of two.
+#if !defined(MTB_BUCKET_ARRAY_DEFAULT_FIRST_BUCKET_LEN)
+#define MTB_BUCKET_ARRAY_DEFAULT_FIRST_BUCKET_LEN 16
+#endif
+
+namespace mtb::impl {
+    /// Open a gap of \a insert_count items at \a insert_index by moving the tail of the first \a len items back.
+    /// The allocation must have room for len + insert_count items.
+    template<typename T>
+    tSlice<T> ArrayInsertGap(tSlice<T> allocation, ptrdiff_t len, ptrdiff_t insert_index, ptrdiff_t insert_count, eInit init) {
+        MTB_ASSERT(insert_index >= 0 && insert_index <= len);
+        MTB_ASSERT(len + insert_count <= allocation.len);
+        tSlice<T> result = SliceRange(allocation, insert_index, insert_count);
+        if(insert_index < len) {
+            SliceRelocateItems(SliceRange(allocation, insert_index + insert_count, len - insert_index), SliceRange(allocation, insert_index, len - insert_index));
+        }
+        switch(init) {
+            case kClearToZero: SliceSetZero(SliceCast<void>(result)); break;
+            case kNoInit: break;
+        }
+        return result;
+    }
+
+    // Compacts whole blocks of items and returns the number of kept items. \a read_index is advanced past the last
+    // block; the rest is left to the caller. Without a kernel for T, no blocks are processed.
+    template<bool Lanes32>
+    struct tCompactBlocks {
+        template<typename T, typename P>
+        static ptrdiff_t RemoveAll(tSlice<T>, P&, ptrdiff_t&) {
+            return 0;
+        }
+    };
+
+#if MTB_USE_SSSE3
+    struct tCompressTable {
+        uint8_t bytes[16][16];
+    };
+
+    /// pshufb masks that move the 32-bit lanes selected by a 4-bit mask to the front.
+    constexpr tCompressTable MakeCompressTable() {
+        tCompressTable result{};
+        for(int mask = 0; mask < 16; ++mask) {
+            int out = 0;
+            for(int lane = 0; lane < 4; ++lane) {
+                if((mask >> lane) & 1) {
+                    for(int byte = 0; byte < 4; ++byte) {
+                        result.bytes[mask][out * 4 + byte] = (uint8_t)(lane * 4 + byte);
+                    }
+                    ++out;
+                }
+            }
+            for(int byte = out * 4; byte < 16; ++byte) {
+                result.bytes[mask][byte] = 0x80;
+            }
+        }
+        return result;
+    }
+
+    inline constexpr tCompressTable compress_table = MakeCompressTable();
+
+    // 32-bit items, 4 at a time: the predicate builds a 4-bit keep mask and one pshufb moves the kept items to the
+    // write cursor. The 16-byte store never passes the end of the block that was just read.
+    template<>
+    struct tCompactBlocks<true> {
+        template<typename T, typename P>
+        static ptrdiff_t RemoveAll(tSlice<T> items, P& predicate, ptrdiff_t& read_index) {
+            ptrdiff_t write_index = 0;
+            for(; read_index + 4 <= items.len; read_index += 4) {
+                T const* block = items.ptr + read_index;
+                int keep = !predicate(block[0]);
+                keep |= !predicate(block[1]) << 1;
+                keep |= !predicate(block[2]) << 2;
+                keep |= !predicate(block[3]) << 3;
+                __m128i lanes = _mm_loadu_si128((__m128i const*)block);
+                __m128i shuffle = _mm_loadu_si128((__m128i const*)compress_table.bytes[keep]);
+                _mm_storeu_si128((__m128i*)(items.ptr + write_index), _mm_shuffle_epi8(lanes, shuffle));
+                write_index += CountSetBits((uint64_t)keep);
+            }
+            return write_index;
+        }
+    };
+#endif  // MTB_USE_SSSE3
+
+    // Stable compaction for PODs. With MTB_USE_SSSE3, 32-bit items go through the pshufb kernel above. Everything else,
+    // and the tail, copies every item unconditionally and only advances the write cursor for kept items, so there is
+    // no branch on the predicate.
+    template<bool Pod = true>
+    struct tCompactOps {
+        template<typename T, typename P>
+        static ptrdiff_t RemoveAll(tSlice<T> items, P& predicate) {
+            ptrdiff_t read_index = 0;
+            ptrdiff_t write_index = tCompactBlocks<sizeof(T) == 4>::RemoveAll(items, predicate, read_index);
+            for(; read_index < items.len; ++read_index) {
+                T item = items.ptr[read_index];
+                items.ptr[write_index] = item;
+                write_index += !predicate(item);
+            }
+            return write_index;
+        }
+    };
+
+    template<>
+    struct tCompactOps<false> {
+        template<typename T, typename P>
+        static ptrdiff_t RemoveAll(tSlice<T> items, P& predicate) {
+            ptrdiff_t write_index = 0;
+            for(ptrdiff_t read_index = 0; read_index < items.len; ++read_index) {
+                if(predicate(items.ptr[read_index])) {
+                    DestructItems(items.ptr + read_index, 1);
+                } else {
+                    if(write_index != read_index) {
+                        RelocateItems(items.ptr + write_index, 1, items.ptr + read_index, 1);
+                    }
+                    ++write_index;
+                }
+            }
+            return write_index;
+        }
+    };
+
+    /// Stable single-pass compaction. Returns the number of remaining items, which are at the front of \a items.
+    template<typename T, typename P>
+    ptrdiff_t SliceRemoveAll(tSlice<T> items, P& predicate) {
+        return tCompactOps<MTB_IS_POD(T)>::RemoveAll(items, predicate);
+    }
+
+    /// Unstable compaction that fills each hole with the current last item. Moves at most as many items as it removes.
+    template<typename T, typename P>
+    ptrdiff_t SliceRemoveAllSwap(tSlice<T> items, P& predicate) {
+        ptrdiff_t len = items.len;
+        ptrdiff_t index = 0;
+        while(index < len) {
+            if(predicate(items.ptr[index])) {
+                DestructItems(items.ptr + index, 1);
+                --len;
+                if(index != len) {
+                    RelocateItems(items.ptr + index, 1, items.ptr + len, 1);
+                }
+            } else {
+                ++index;
+            }
+        }
+        return len;
+    }
+
+    /// Remove the items at the strictly ascending \a sorted_indices, moving each run of kept items only once.
+    /// Returns the number of remaining items.
+    template<typename T>
+    ptrdiff_t SliceRemoveIndices(tSlice<T> items, tSlice<ptrdiff_t const> sorted_indices) {
+        if(!sorted_indices) {
+            return items.len;
+        }
+
+        ptrdiff_t write_index = sorted_indices[0];
+        for(ptrdiff_t index_index = 0; index_index < sorted_indices.len; ++index_index) {
+            ptrdiff_t remove_index = sorted_indices[index_index];
+            MTB_ASSERT(IsValidIndex(items, remove_index));
+            MTB_ASSERT(index_index == 0 || sorted_indices[index_index - 1] < remove_index);
+            DestructItems(items.ptr + remove_index, 1);
+
+            ptrdiff_t run_begin = remove_index + 1;
+            ptrdiff_t run_end = index_index + 1 < sorted_indices.len ? sorted_indices[index_index + 1] : items.len;
+            if(run_end > run_begin) {
+                SliceRelocateItems(SliceRange(items, write_index, run_end - run_begin), SliceRange(items, run_begin, run_end - run_begin));
+                write_index += run_end - run_begin;
+            }
+        }
+        return write_index;
+    }
+
+    /// Close the gap of \a remove_count items at \a remove_index, either by moving the tail forward or by moving
+    /// the last items into the gap (\a swap).
+    template<typename T>
+    void ArrayRemoveRange(tSlice<T> items, ptrdiff_t remove_index, ptrdiff_t remove_count, bool swap) {
+        MTB_ASSERT(remove_count > 0);
+        MTB_ASSERT(IsValidIndex(items, remove_index));
+        MTB_ASSERT(remove_index + remove_count <= items.len);
+        ptrdiff_t tail_index = remove_index + remove_count;
+        ptrdiff_t tail_count = items.len - tail_index;
+        DestructItems(items.ptr + remove_index, (size_t)remove_count);
+        if(swap) {
+            // Only the last items that are not removed themselves need to move.
+            ptrdiff_t move_count = remove_count < tail_count ? remove_count : tail_count;
+            SliceRelocateItems(SliceRange(items, remove_index, move_count), SliceRange(items, items.len - move_count, move_count));
+        } else if(tail_count > 0) {
+            SliceRelocateItems(SliceRange(items, remove_index, tail_count), SliceRange(items, tail_index, tail_count));
+        }
+    }
+}  // namespace mtb::impl
+
 namespace mtb {
     template<typename T>
     struct tArray {
@@ -1313,6 +1716,11 @@ namespace mtb {
         MTB_NODISCARD tSlice<T> Items() const { return {ptr, len}; }
     };
 
+    template<typename T>
+    struct tIsTriviallyRelocatable<tArray<T>> {
+        static constexpr bool value = true;
+    };
+
     template<typename T>
     bool Reserve(tArray<T>& array, ptrdiff_t min_requested_capacity) {
         if(array.cap >= min_requested_capacity) {
@@ -1331,7 +1739,7 @@ namespace mtb {
                 new_alloc_len = (new_alloc_len * 3) / 2;
             }
         }
-        tSlice<T> new_alloc = array.allocator.ResizeArray(PtrSlice(array.ptr, array.cap), new_alloc_len, kNoInit);
+        tSlice<T> new_alloc = ResizeItems(array.allocator, PtrSlice(array.ptr, array.cap), array.len, new_alloc_len);
         if(new_alloc) {
             array.ptr = new_alloc.ptr;
             array.cap = new_alloc.len;
@@ -1341,7 +1749,7 @@ namespace mtb {
 
     template<typename T>
     tSlice<T> ShrinkAllocation(tArray<T>& array) {
-        tSlice<T> new_alloc = array.allocator.ResizeArray(PtrSlice(array.ptr, array.cap), array.len, kNoInit);
+        tSlice<T> new_alloc = ResizeItems(array.allocator, PtrSlice(array.ptr, array.cap), array.len, array.len);
         array.ptr = new_alloc.ptr;
         array.cap = new_alloc.len;
         return array.items;
@@ -1402,14 +1810,7 @@ namespace mtb {
         MTB_ASSERT(insert_count > 0);
         tSlice<T> result{};
         if(Reserve(array, array.len + insert_count)) {
-            MTB_ASSERT(IsValidIndex(array, insert_index) || insert_index == array.len);
-            tSlice<T> Allocation = PtrSlice(array.ptr, array.cap);
-            result = SliceRange(Allocation, insert_index, insert_count);
-            SliceRelocateItems(SliceOffset(Allocation, insert_index + insert_count), result);
-            switch(init) {
-                case kClearToZero: SliceSetZero(SliceCast<void>(result)); break;
-                case kNoInit: break;
-            }
+            result = impl::ArrayInsertGap(PtrSlice(array.ptr, array.cap), array.len, insert_index, insert_count, init);
             array.len += insert_count;
         }
         return result;
@@ -1500,2317 +1901,8805 @@ namespace mtb {
 
     template<typename T>
     void RemoveAt(tArray<T>& array, ptrdiff_t remove_index, ptrdiff_t remove_count = 1, bool swap = false) {
-        MTB_ASSERT(remove_count > 0);
-        MTB_ASSERT(IsValidIndex(array.items, remove_index));
-        MTB_ASSERT(IsValidIndex(array.items, remove_index + remove_count));
-        if(swap) {
-            SliceRelocateItems(SliceRange(array.items, remove_index, remove_count), SliceRange(array.items, array.len - remove_count, remove_count));
-        } else {
-            SliceRelocateItems(SliceOffset(array.items, remove_index), SliceOffset(array.items, remove_index + remove_count));
-        }
+        impl::ArrayRemoveRange(array.items, remove_index, remove_count, swap);
         array.len -= remove_count;
     }
 
+    /// Remove all items for which \a predicate returns true in a single pass. Without \a swap, the order of the
+    /// remaining items is preserved. Returns the number of removed items.
     template<typename T, typename P>
-    void RemoveAll(tArray<T>& array, P Predicate, bool swap = false) {
-        // #TODO
-        MTB_ASSERT(false);
+    ptrdiff_t RemoveAll(tArray<T>& array, P predicate, bool swap = false) {
+        ptrdiff_t new_len = swap ? impl::SliceRemoveAllSwap(array.items, predicate) : impl::SliceRemoveAll(array.items, predicate);
+        ptrdiff_t result = array.len - new_len;
+        array.len = new_len;
+        return result;
     }
 
+    /// Remove the first item for which \a predicate returns true. Returns false if there is none.
     template<typename T, typename P>
-    void RemoveFirst(tArray<T>& array, P Predicate, bool swap = false) {
-        // #TODO
-        MTB_ASSERT(false);
+    bool RemoveFirst(tArray<T>& array, P predicate, bool swap = false) {
+        for(ptrdiff_t index = 0; index < array.len; ++index) {
+            if(predicate(array.ptr[index])) {
+                RemoveAt(array, index, 1, swap);
+                return true;
+            }
+        }
+        return false;
     }
 
+    /// Remove the last item for which \a predicate returns true. Returns false if there is none.
     template<typename T, typename P>
-    void RemoveLast(tArray<T>& array, P Predicate, bool swap = false) {
-        // #TODO
-        MTB_ASSERT(false);
+    bool RemoveLast(tArray<T>& array, P predicate, bool swap = false) {
+        for(ptrdiff_t index = array.len - 1; index >= 0; --index) {
+            if(predicate(array.ptr[index])) {
+                RemoveAt(array, index, 1, swap);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Remove the items at the given indices in a single pass, preserving the order of the remaining items.
+    /// \a sorted_indices must be strictly ascending.
+    template<typename T>
+    void RemoveIndices(tArray<T>& array, tSlice<ptrdiff_t const> sorted_indices) {
+        array.len = impl::SliceRemoveIndices(array.items, sorted_indices);
     }
 
     MTB_NODISCARD tSlice<char> ToString(tArray<char>& array, bool null_terminate = true);
 
-}  // namespace mtb
+    /// Array that stores up to N items inline and only asks its allocator for memory beyond that.
+    ///
+    /// While the items are inline, ptr is null. The array never points into itself, so it can be moved with memcpy
+    /// like any POD, as long as T can.
+    template<typename T, ptrdiff_t N>
+    struct tInlineArray {
+        static_assert(N > 0, "Use tArray instead.");
 
-// --------------------------------------------------
-// -- #Section Map ----------------------------------
-// --------------------------------------------------
-namespace mtb {
-    template<typename K, typename V>
-    struct tMap;
+        /// May be null as long as the array never grows beyond N items.
+        tAllocator allocator;
 
-    struct tMapSlot {
-        enum eState : uint8_t {
-            kFree,
-            kOccupied,
-            kDead,
-        };
+        /// Heap allocation, or null while the items are stored inline.
+        T* ptr;
+        /// Number of elements currently in use.
+        ptrdiff_t len;
+        /// Number of allocated elements. Only meaningful if ptr is set.
+        ptrdiff_t cap;
 
-        eState State;
-    };
+        alignas(T) uint8_t inline_storage[N * MTB_sizeof(T)];
 
-    static_assert(sizeof(tMapSlot) == sizeof(uint8_t));
+        // --------------------------------------------------
+        // --------------------------------------------------
+        // --------------------------------------------------
 
-    template<typename T>
-    struct tMapIterator_KeyOrValue {
-        ptrdiff_t cap;
-        tMapSlot* Slots;
-        T* Items;
-        ptrdiff_t index;
+        MTB_NODISCARD T* Data() const { return ptr ? ptr : (T*)inline_storage; }
 
-        MTB_NODISCARD bool operator!=(tMapIterator_KeyOrValue const& Other) const {
-            return index != Other.index;
+        MTB_NODISCARD ptrdiff_t Capacity() const { return ptr ? cap : N; }
+
+        MTB_NODISCARD bool IsInline() const { return !ptr; }
+
+        MTB_NODISCARD T& operator[](ptrdiff_t index) { return Items()[index]; }
+
+        MTB_NODISCARD constexpr explicit operator bool() const { return len > (ptrdiff_t)0; }
+
+        MTB_NODISCARD T* begin() const { return Data(); }
+
+        MTB_NODISCARD T* end() const { return Data() + len; }
+
+        MTB_NODISCARD tSlice<T> Items() const { return {Data(), len}; }
+    };
+
+    template<typename T, ptrdiff_t N>
+    struct tIsTriviallyRelocatable<tInlineArray<T, N>> {
+        static constexpr bool value = MTB_IS_TRIVIALLY_RELOCATABLE(T);
+    };
+
+    template<typename T, ptrdiff_t N>
+    bool Reserve(tInlineArray<T, N>& array, ptrdiff_t min_requested_capacity) {
+        if(array.Capacity() >= min_requested_capacity) {
+            return true;
         }
 
-        MTB_NODISCARD T& operator*() const {
-            MTB_ASSERT(index < cap);
-            return Items[index];
+        ptrdiff_t new_alloc_len = array.Capacity() > 16 ? array.Capacity() : 16;
+        while(new_alloc_len < min_requested_capacity) {
+            new_alloc_len = (new_alloc_len * 3) / 2;
         }
 
-        MTB_NODISCARD tMapIterator_KeyOrValue& operator++() {
-            while(++index < cap) {
-                if(Slots[index].State == tMapSlot::kOccupied) {
-                    break;
-                }
+        tSlice<T> new_alloc;
+        if(array.ptr) {
+            new_alloc = ResizeItems(array.allocator, PtrSlice(array.ptr, array.cap), array.len, new_alloc_len);
+        } else {
+            MTB_ASSERT(array.allocator && "Inline capacity exceeded but there is no allocator.");
+            new_alloc = array.allocator.template AllocArray<T>(new_alloc_len, kNoInit);
+            if(new_alloc) {
+                SliceRelocateItems(new_alloc, array.Items());
             }
-            return *this;
         }
-
-        MTB_NODISCARD tMapIterator_KeyOrValue begin() {
-            tMapIterator_KeyOrValue result = *this;
-            result.index = -1;
-            return ++result;
+        if(new_alloc) {
+            array.ptr = new_alloc.ptr;
+            array.cap = new_alloc.len;
         }
+        return !!new_alloc;
+    }
 
-        MTB_NODISCARD tMapIterator_KeyOrValue end() {
-            tMapIterator_KeyOrValue result = *this;
-            result.index = cap;
-            return result;
+    /// Move the items back inline if they fit, otherwise shrink the heap allocation to the number of items.
+    template<typename T, ptrdiff_t N>
+    tSlice<T> ShrinkAllocation(tInlineArray<T, N>& array) {
+        if(array.ptr) {
+            if(array.len <= N) {
+                tSlice<T> old_alloc = PtrSlice(array.ptr, array.cap);
+                SliceRelocateItems(PtrSlice((T*)array.inline_storage, N), SliceRange(old_alloc, 0, array.len));
+                array.allocator.FreeArray(old_alloc);
+                array.ptr = nullptr;
+                array.cap = 0;
+            } else {
+                tSlice<T> new_alloc = ResizeItems(array.allocator, PtrSlice(array.ptr, array.cap), array.len, array.len);
+                array.ptr = new_alloc.ptr;
+                array.cap = new_alloc.len;
+            }
         }
-    };
+        return array.Items();
+    }
 
-    // #TODO Return size_t instead? May be easier to leave it up to the user to take care of bitness.
-    using tMapHashFunc = uint64_t (*)(void const* Key, size_t KeySize);
-    using tMapCompareFunc = int (*)(void const* KeyA, void const* KeyB, size_t KeySize);
+    template<typename T, ptrdiff_t N>
+    void Clear(tInlineArray<T, N>& array) {
+        array.len = 0;
+    }
 
-    template<typename K, typename V>
-    struct tMap {
-        /// May not be null.
-        tAllocator allocator;
-
-        /// May not be null.
-        tMapHashFunc HashFunc;
+    template<typename T, ptrdiff_t N>
+    void ClearAllocation(tInlineArray<T, N>& array) {
+        Clear(array);
+        ShrinkAllocation(array);
+    }
 
-        /// May be null. Fallback is memcpy-style comparison.
-        tMapCompareFunc CompareFunc;
+    template<typename T, ptrdiff_t N>
+    bool SetLength(tInlineArray<T, N>& array, ptrdiff_t new_count, eInit init = kClearToZero) {
+        if(array.len < new_count) {
+            if(Reserve(array, new_count)) {
+                tSlice<T> fresh = SliceBetween(PtrSlice(array.Data(), array.Capacity()), array.len, new_count);
+                switch(init) {
+                    case kClearToZero: SliceSetZero(SliceCast<void>(fresh)); break;
+                    case kNoInit: break;
+                }
+                array.len = new_count;
+            }
+        } else {
+            array.len = new_count;
+        }
+        return array.len == new_count;
+    }
 
-        /// Number of elements in the map.
-        ptrdiff_t count;
+    template<typename T, ptrdiff_t N>
+    MTB_NODISCARD T* GetLast(tInlineArray<T, N> const& array) {
+        return array ? array.Data() + array.len - 1 : nullptr;
+    }
 
-        /// Number of elements the map could theoretically store. The map is resized before this value is reached.
-        ptrdiff_t cap;
+    template<typename T, ptrdiff_t N>
+    MTB_NODISCARD tSlice<T> GetSlack(tInlineArray<T, N> const& array) {
+        return SliceOffset(PtrSlice(array.Data(), array.Capacity()), array.len);
+    }
 
-        /// Internal. array(N=cap) of slots in this map.
-        tMapSlot* Slots;
+    template<typename T, ptrdiff_t N>
+    MTB_NODISCARD size_t ArraySize(tInlineArray<T, N> const& array) {
+        return SliceSize(array.Items());
+    }
 
-        /// Internal. array(N=cap) of keys in this map.
-        // #TODO Compute this based on Slots instead of storing it?
-        K* Keys;
+    /// Create \a insert_count new items at the given index and return them as a slice.
+    template<typename T, ptrdiff_t N>
+    MTB_NODISCARD tSlice<T> InsertN(tInlineArray<T, N>& array, ptrdiff_t insert_index, ptrdiff_t insert_count, eInit init = kClearToZero) {
+        MTB_ASSERT(insert_count > 0);
+        tSlice<T> result{};
+        if(Reserve(array, array.len + insert_count)) {
+            result = impl::ArrayInsertGap(PtrSlice(array.Data(), array.Capacity()), array.len, insert_index, insert_count, init);
+            array.len += insert_count;
+        }
+        return result;
+    }
 
-        /// Internal. array(N=cap) of values in this map.
-        // #TODO Compute this based on Slots instead of storing it?
-        V* Values;
-    };
-}  // namespace mtb
+    /// Create enough room for slice items to be copied to at the specified index.
+    template<typename T, ptrdiff_t N, typename U>
+    tSlice<T> InsertMany(tInlineArray<T, N>& array, ptrdiff_t insert_index, tSlice<U> slice) {
+        tSlice<T> result = InsertN(array, insert_index, slice.len, kNoInit);
+        SliceCopyBytes(result, slice);
+        return result;
+    }
 
-namespace mtb {
-    template<typename K, typename V>
-    MTB_NODISCARD tMapIterator_KeyOrValue<K> IterKeys(tMap<K, V>& map);
+    /// Create a new item in the array and return a pointer to it.
+    template<typename T, ptrdiff_t N>
+    T& InsertOne(tInlineArray<T, N>& array, ptrdiff_t insert_index, eInit init = kClearToZero) {
+        return *InsertN(array, insert_index, 1, init).ptr;
+    }
 
-    template<typename K, typename V>
-    MTB_NODISCARD tMapIterator_KeyOrValue<V> IterValues(tMap<K, V>& map);
+    /// Create a new item in the array and copy \a item there.
+    template<typename T, ptrdiff_t N, typename TItem>
+    T& Insert(tInlineArray<T, N>& array, ptrdiff_t insert_index, TItem item) {
+        return *new(&InsertOne(array, insert_index, kNoInit)) T(item);
+    }
 
-    template<typename K, typename V>
-    MTB_NODISCARD tMap<K, V> CreateMap(tAllocator allocator, tMapHashFunc hash_func, tMapCompareFunc cmp_func);
+    /// Create \a repeat_count items in the array, initializing them all to the value of \a item.
+    template<typename T, ptrdiff_t N, typename TItem>
+    tSlice<T> InsertRepeat(tInlineArray<T, N>& array, ptrdiff_t insert_index, TItem item, ptrdiff_t repeat_count) {
+        tSlice<T> result = InsertN(array, insert_index, repeat_count, kNoInit);
+        for(ptrdiff_t index = 0; index < result.len; ++index) {
+            result[index] = item;
+        }
+        return result;
+    }
 
-    template<typename K, typename V>
-    void Put(tMap<K, V>& map, K const& Key, V const& value);
+    /// Create \a push_count new items at the end and return them as a slice.
+    template<typename T, ptrdiff_t N>
+    MTB_NODISCARD tSlice<T> PushN(tInlineArray<T, N>& array, ptrdiff_t push_count, eInit init = kClearToZero) {
+        tSlice<T> result{};
+        if(Reserve(array, array.len + push_count)) {
+            result = SliceRange(PtrSlice(array.Data(), array.Capacity()), array.len, push_count);
+            switch(init) {
+                case kClearToZero: SliceSetZero(SliceCast<void>(result)); break;
+                case kNoInit: break;
+            }
+            array.len += push_count;
+        }
+        return result;
+    }
 
-    template<typename K, typename V>
-    MTB_NODISCARD V* Find(tMap<K, V>& map, K const& Key);
+    /// Create enough room for slice items to be copied to.
+    template<typename T, ptrdiff_t N, typename U>
+    tSlice<T> PushMany(tInlineArray<T, N>& array, tSlice<U> slice) {
+        tSlice<T> result = PushN(array, slice.len, kNoInit);
+        SliceCopyBytes(result, slice);
+        return result;
+    }
 
-    template<typename K, typename V>
-    MTB_NODISCARD V& FindChecked(tMap<K, V>& map, K const& Key);
+    /// Create a new item in the array and return a pointer to it.
+    template<typename T, ptrdiff_t N>
+    MTB_NODISCARD T& PushOne(tInlineArray<T, N>& array, eInit init = kClearToZero) {
+        T* result = PushN(array, 1, init).ptr;
+        MTB_ASSERT(!!result);
+        return *result;
+    }
 
-    template<typename K, typename V>
-    bool Remove(tMap<K, V>& map, K const& Key);
-}  // namespace mtb
+    /// Create a new item in the array and copy \a item there.
+    template<typename T, ptrdiff_t N, typename TItem>
+    T& Push(tInlineArray<T, N>& array, TItem item) {
+        return *new(&PushOne(array, kNoInit)) T(item);
+    }
 
-namespace mtb {
-    template<typename K, typename V>
-    void InternalMapPut(tMap<K, V>& map, K const& Key, V const& value);
+    /// Create \a repeat_count items in the array, initializing them all to the value of \a item.
+    template<typename T, ptrdiff_t N, typename TItem>
+    tSlice<T> PushRepeat(tInlineArray<T, N>& array, TItem item, ptrdiff_t repeat_count) {
+        tSlice<T> result = PushN(array, repeat_count, kNoInit);
+        for(ptrdiff_t index = 0; index < result.len; ++index) {
+            result[index] = item;
+        }
+        return result;
+    }
 
-    template<typename K, typename V>
-    void InternalEnsureAdditionalCapacity(tMap<K, V>& map, ptrdiff_t additional_len);
-}  // namespace mtb
+    template<typename T, ptrdiff_t N>
+    void RemoveAt(tInlineArray<T, N>& array, ptrdiff_t remove_index, ptrdiff_t remove_count = 1, bool swap = false) {
+        impl::ArrayRemoveRange(array.Items(), remove_index, remove_count, swap);
+        array.len -= remove_count;
+    }
 
-template<typename K, typename V>
-void mtb::InternalMapPut(tMap<K, V>& map, K const& Key, V const& value) {
-    MTB_ASSERT(map.cap > 0);
+    template<typename T, ptrdiff_t N, typename P>
+    ptrdiff_t RemoveAll(tInlineArray<T, N>& array, P predicate, bool swap = false) {
+        ptrdiff_t new_len = swap ? impl::SliceRemoveAllSwap(array.Items(), predicate) : impl::SliceRemoveAll(array.Items(), predicate);
+        ptrdiff_t result = array.len - new_len;
+        array.len = new_len;
+        return result;
+    }
 
-    tMapSlot* Slots = map.Slots;
-    K* Keys = map.Keys;
-    V* Values = map.Values;
-    ptrdiff_t start_index = (uint64_t)(map.HashFunc(&Key, sizeof(K)) % map.cap);
-    ptrdiff_t index = start_index;
-    bool bFound = false;
-    while(true) {
-        tMapSlot& Slot = Slots[index];
-        if(Slot.State == tMapSlot::kFree || Slot.State == tMapSlot::kDead) {
-            Slot.State = tMapSlot::kOccupied;
-            tItemOps<MTB_IS_POD(K)>::CopyConstruct(Keys + index, 1, &Key, 1);
-            tItemOps<MTB_IS_POD(K)>::CopyConstruct(Values + index, 1, &value, 1);
-            ++map.count;
-            bFound = true;
-            break;
-        }
+    template<typename T, ptrdiff_t N>
+    void RemoveIndices(tInlineArray<T, N>& array, tSlice<ptrdiff_t const> sorted_indices) {
+        array.len = impl::SliceRemoveIndices(array.Items(), sorted_indices);
+    }
 
-        if(map.CompareFunc(Keys + index, &Key, sizeof(K)) == 0) {
-            tItemOps<MTB_IS_POD(K)>::CopyConstruct(Values + index, 1, &value, 1);
-            bFound = true;
-            break;
-        }
+    /// Location of an item in a tBucketArray.
+    struct tBucketArrayIndex {
+        ptrdiff_t bucket;
+        ptrdiff_t offset;
+    };
 
-        if(++index == map.cap) {
-            index = 0;
-        }
-        if(index == start_index) {
-            break;
-        }
+    /// Bucket k of a tBucketArray holds first_bucket_len << k items, so bucket k starts at index
+    /// first_bucket_len * (2^k - 1). Both must be powers of two.
+    MTB_NODISCARD inline tBucketArrayIndex BucketArrayLocate(ptrdiff_t first_bucket_len, ptrdiff_t index) {
+        MTB_ASSERT(IsPowerOfTwo((uint64_t)first_bucket_len) && index >= 0);
+        uint64_t shifted = (uint64_t)index + (uint64_t)first_bucket_len;
+        int bucket = Log2Floor(shifted) - Log2Floor((uint64_t)first_bucket_len);
+        tBucketArrayIndex result;
+        result.bucket = bucket;
+        result.offset = (ptrdiff_t)(shifted - ((uint64_t)first_bucket_len << bucket));
+        return result;
     }
 
-    MTB_ASSERT(bFound);
-}
+    /// Array made of power-of-two sized buckets that are never moved, so pointers to items stay valid while the array
+    /// grows. Indexing is O(1) via BucketArrayLocate.
+    ///
+    /// Use GetBucketItems to process buckets independently, e.g. one per thread.
+    template<typename T>
+    struct tBucketArray {
+        static constexpr ptrdiff_t max_bucket_count = 48;
 
-template<typename K, typename V>
-void mtb::InternalEnsureAdditionalCapacity(tMap<K, V>& map, ptrdiff_t additional_len) {
-    MTB_ASSERT(map.allocator);
+        /// May not be null. Use MakeAllocator to allocate from a tArena.
+        tAllocator allocator;
 
-    ptrdiff_t threshold = (ptrdiff_t)(0.7f * map.cap);
-    if(map.count + additional_len < threshold) {
-        // We got enough space.
-        return;
-    }
+        /// Number of items in the first bucket. Must be a power of two. Zero means
+        /// MTB_BUCKET_ARRAY_DEFAULT_FIRST_BUCKET_LEN. Can not be changed once the array has buckets.
+        ptrdiff_t first_bucket_len;
 
-    ptrdiff_t NewCapacity = map.cap == 0 ? 64 : map.cap << 1;
-    size_t const alignment = MTB_alignof(V) > MTB_alignof(K) ? MTB_alignof(V) : MTB_alignof(K);
-    size_t const PayloadSize = sizeof(tMapSlot) + sizeof(K) + sizeof(V);
-    tSlice<void> new_alloc = map.allocator.AllocRaw(NewCapacity * PayloadSize, alignment, kClearToZero);
+        /// Number of elements currently in use.
+        ptrdiff_t len;
 
-    tMap<K, V> new_map{};
-    new_map.allocator = map.allocator;
-    new_map.HashFunc = map.HashFunc;
-    new_map.CompareFunc = map.CompareFunc;
-    new_map.count = 0;
-    new_map.cap = NewCapacity;
-    new_map.Slots = (tMapSlot*)new_alloc.ptr;
-    new_map.Keys = (K*)(new_map.Slots + NewCapacity);
-    new_map.Values = (V*)(new_map.Keys + NewCapacity);
+        /// Number of allocated buckets.
+        ptrdiff_t bucket_count;
 
-    for(ptrdiff_t index = 0; index < map.cap; ++index) {
-        if(map.Slots[index].State == tMapSlot::kOccupied) {
-            InternalMapPut(new_map, map.Keys[index], map.Values[index]);
-        }
-    }
+        T* buckets[max_bucket_count];
 
-    tSlice<void> OldAllocation = PtrSlice((void*)map.Slots, map.cap * PayloadSize);
-    map.allocator.FreeRaw(OldAllocation, alignment);
+        // --------------------------------------------------
+        // --------------------------------------------------
+        // --------------------------------------------------
 
-    map = new_map;
-}
+        MTB_NODISCARD ptrdiff_t FirstBucketLen() const { return first_bucket_len ? first_bucket_len : MTB_BUCKET_ARRAY_DEFAULT_FIRST_BUCKET_LEN; }
 
-template<typename K, typename V>
-mtb::tMapIterator_KeyOrValue<K> mtb::IterKeys(tMap<K, V>& map) {
-    tMapIterator_KeyOrValue<K> result;
-    result.cap = map.cap;
-    result.Slots = map.Slots;
-    result.Items = map.Keys;
-    return result;
-}
+        MTB_NODISCARD T& operator[](ptrdiff_t index) const {
+            MTB_ASSERT(0 <= index && index < len);
+            tBucketArrayIndex location = BucketArrayLocate(FirstBucketLen(), index);
+            return buckets[location.bucket][location.offset];
+        }
 
-template<typename K, typename V>
-mtb::tMapIterator_KeyOrValue<V> mtb::IterValues(tMap<K, V>& map) {
-    tMapIterator_KeyOrValue<V> result;
-    result.cap = map.cap;
-    result.Slots = map.Slots;
-    result.Items = map.Values;
-    return result;
-}
+        MTB_NODISCARD constexpr explicit operator bool() const { return len > (ptrdiff_t)0; }
+    };
 
-template<typename K, typename V>
-mtb::tMap<K, V> mtb::CreateMap(tAllocator allocator, tMapHashFunc hash_func, tMapCompareFunc cmp_func) {
-    MTB_ASSERT(allocator);
-    MTB_ASSERT(hash_func);
-    MTB_ASSERT(cmp_func);
-    tMap<K, V> result{allocator, hash_func, cmp_func};
-    return result;
-}
+    /// Number of items bucket \a bucket_index can hold.
+    template<typename T>
+    MTB_NODISCARD ptrdiff_t BucketCapacity(tBucketArray<T> const& array, ptrdiff_t bucket_index) {
+        return array.FirstBucketLen() << bucket_index;
+    }
 
-template<typename K, typename V>
-void mtb::Put(tMap<K, V>& map, K const& Key, V const& value) {
-    InternalEnsureAdditionalCapacity(map, 1);
-    InternalMapPut(map, Key, value);
-}
+    /// Total number of items the allocated buckets can hold.
+    template<typename T>
+    MTB_NODISCARD ptrdiff_t Capacity(tBucketArray<T> const& array) {
+        return array.FirstBucketLen() * (((ptrdiff_t)1 << array.bucket_count) - 1);
+    }
 
-template<typename K, typename V>
-V* mtb::Find(tMap<K, V>& map, K const& Key) {
-    V* result = nullptr;
-    if(map.count) {
-        ptrdiff_t start_index = (uint64_t)(map.HashFunc(&Key, sizeof(K)) % map.cap);
-        ptrdiff_t index = start_index;
-        while(map.Slots[index].State != tMapSlot::kFree) {
-            tMapSlot& Slot = map.Slots[index];
-            if(Slot.State == tMapSlot::kFree) {
-                break;
-            }
+    /// Number of buckets that contain items.
+    template<typename T>
+    MTB_NODISCARD ptrdiff_t UsedBucketCount(tBucketArray<T> const& array) {
+        return array.len ? BucketArrayLocate(array.FirstBucketLen(), array.len - 1).bucket + 1 : 0;
+    }
 
-            if(Slot.State == tMapSlot::kOccupied && map.CompareFunc(map.Keys + index, &Key, sizeof(K)) == 0) {
-                result = map.Values + index;
-                break;
-            }
+    /// The items in use in the given bucket.
+    template<typename T>
+    MTB_NODISCARD tSlice<T> GetBucketItems(tBucketArray<T> const& array, ptrdiff_t bucket_index) {
+        MTB_ASSERT(0 <= bucket_index && bucket_index < array.bucket_count);
+        ptrdiff_t first_index = array.FirstBucketLen() * (((ptrdiff_t)1 << bucket_index) - 1);
+        ptrdiff_t used = array.len - first_index;
+        if(used < 0) {
+            used = 0;
+        }
+        if(used > BucketCapacity(array, bucket_index)) {
+            used = BucketCapacity(array, bucket_index);
+        }
+        return PtrSlice(array.buckets[bucket_index], used);
+    }
 
-            if(++index == map.cap) {
-                index = 0;
-            }
-            if(index == start_index) {
-                break;
+    template<typename T>
+    bool Reserve(tBucketArray<T>& array, ptrdiff_t min_requested_capacity) {
+        while(Capacity(array) < min_requested_capacity) {
+            MTB_ASSERT(array.bucket_count < tBucketArray<T>::max_bucket_count);
+            ptrdiff_t bucket_len = BucketCapacity(array, array.bucket_count);
+            tSlice<T> bucket = array.allocator.template AllocArray<T>(bucket_len, kNoInit);
+            if(!bucket) {
+                return false;
             }
+            array.buckets[array.bucket_count++] = bucket.ptr;
         }
+        return true;
     }
 
-    return result;
-}
+    template<typename T>
+    void Clear(tBucketArray<T>& array) {
+        array.len = 0;
+    }
 
-template<typename K, typename V>
-V& mtb::FindChecked(tMap<K, V>& map, K const& Key) {
-    V* value = Find(map, Key);
-    MTB_ASSERT(value);
-    return *value;
-}
+    template<typename T>
+    void ClearAllocation(tBucketArray<T>& array) {
+        Clear(array);
+        while(array.bucket_count > 0) {
+            --array.bucket_count;
+            array.allocator.FreeArray(PtrSlice(array.buckets[array.bucket_count], BucketCapacity(array, array.bucket_count)));
+            array.buckets[array.bucket_count] = nullptr;
+        }
+    }
 
-template<typename K, typename V>
-bool mtb::Remove(tMap<K, V>& map, K const& Key) {
-    bool result = false;
-    if(map.count) {
-        ptrdiff_t start_index = (uint64_t)(map.HashFunc(&Key, sizeof(K)) % map.cap);
-        ptrdiff_t index = start_index;
-        while(true) {
-            tMapSlot& Slot = map.Slots[index];
-            if(Slot.State == tMapSlot::kFree) {
-                break;
-            }
+    template<typename T>
+    MTB_NODISCARD T* GetLast(tBucketArray<T> const& array) {
+        return array ? &array[array.len - 1] : nullptr;
+    }
 
-            if(map.Slots[index].State == tMapSlot::kOccupied && map.CompareFunc(map.Keys + index, &Key, sizeof(K)) == 0) {
-                map.Slots[index].State = tMapSlot::kDead;
-                tItemOps<MTB_IS_POD(K)>::Destruct(map.Keys + index, 1);
-                tItemOps<MTB_IS_POD(K)>::Destruct(map.Values + index, 1);
-                result = true;
-                break;
-            }
+    /// Create a new item at the end and return a reference to it. Existing items never move.
+    template<typename T>
+    MTB_NODISCARD T& PushOne(tBucketArray<T>& array, eInit init = kClearToZero) {
+        bool reserved = Reserve(array, array.len + 1);
+        MTB_ASSERT(reserved);
+        (void)reserved;
+        ++array.len;
+        T* result = &array[array.len - 1];
+        if(init == kClearToZero) {
+            ItemSetZero(*result);
+        }
+        return *result;
+    }
 
-            if(++index == map.cap) {
-                index = 0;
-            }
-            if(index == start_index) {
-                break;
+    /// Create a new item at the end and copy \a item there.
+    template<typename T, typename TItem>
+    T& Push(tBucketArray<T>& array, TItem item) {
+        return *new(&PushOne(array, kNoInit)) T(item);
+    }
+
+    /// Copy all items of \a slice to the end, one bucket-sized chunk at a time.
+    template<typename T, typename U>
+    void PushMany(tBucketArray<T>& array, tSlice<U> slice) {
+        if(!Reserve(array, array.len + slice.len)) {
+            return;
+        }
+        while(slice.len > 0) {
+            tBucketArrayIndex location = BucketArrayLocate(array.FirstBucketLen(), array.len);
+            ptrdiff_t chunk_len = BucketCapacity(array, location.bucket) - location.offset;
+            if(chunk_len > slice.len) {
+                chunk_len = slice.len;
             }
+            SliceCopyBytes(PtrSlice(array.buckets[location.bucket] + location.offset, chunk_len), SliceRange(slice, 0, chunk_len));
+            array.len += chunk_len;
+            slice = SliceOffset(slice, chunk_len);
         }
     }
 
-    return result;
-}
+    /// Remove the last item. Pointers to all other items stay valid.
+    template<typename T>
+    void Pop(tBucketArray<T>& array) {
+        MTB_ASSERT(array.len > 0);
+        --array.len;
+    }
 
-// --------------------------------------------------
-// -- #Section Delegate -----------------------------
-// --------------------------------------------------
+    /// Array of variable-length rows, stored compressed-sparse-row style: all values back to back in one allocation and
+    /// one offset per row into it. Row r is values[offsets[r] .. offsets[r + 1]].
+    ///
+    /// Create one with CreateJaggedArray when the row lengths are known up front (rows can then be filled
+    /// independently, e.g. in parallel), or with a tJaggedArrayBuilder from items arriving in any order.
+    template<typename T>
+    struct tJaggedArray {
+        tAllocator allocator;
 
-// #NOTE: Disabled for now because I'm not 100% sure what kind of behavior
-//  this particular implementation exhibits and I don't have proper use/test
-//  cases at hand.
-#if 0
-namespace mtb {
-    template<typename>
-    struct tDelegate;
+        /// row_count + 1 entries. Empty while there are no rows.
+        tSlice<ptrdiff_t> offsets;
 
-    template<typename R, typename... tArgs>
-    struct tDelegate<R(tArgs...)> {
-        using tDispatchSignature = R(void*, tArgs&&...);
-        using tDelegateSignature = R(tArgs&&...);
+        tSlice<T> values;
 
-        void* DispatchTarget{};
-        tDispatchSignature* DispatchProc{};
+        // --------------------------------------------------
+        // --------------------------------------------------
+        // --------------------------------------------------
 
-        template<typename tTargetSignature>
-        static R Dispatcher(void* DispatchTarget, tArgs&&... args) {
-            return (*(tTargetSignature*)DispatchTarget)(ForwardCast<tArgs>(args)...);
+        MTB_NODISCARD ptrdiff_t RowCount() const { return offsets ? offsets.len - 1 : 0; }
+
+        MTB_NODISCARD tSlice<T> operator[](ptrdiff_t row) const {
+            MTB_ASSERT(0 <= row && row < RowCount());
+            return SliceBetween(values, offsets[row], offsets[row + 1]);
         }
 
-        tDelegate() = default;
-        tDelegate(tDelegate const&) = default;
-        tDelegate(tDelegate&&) = default;
-        tDelegate& operator=(tDelegate const&) = default;
-        tDelegate& operator=(tDelegate&&) = default;
-        ~tDelegate() = default;
+        MTB_NODISCARD constexpr explicit operator bool() const { return offsets.len > 1; }
+    };
 
-        explicit tDelegate(tDelegateSignature* PlainProcPtr)
-            : DispatchTarget{PlainProcPtr}
-            , DispatchProc{Dispatcher<tDelegateSignature>} {
-            MTB_ASSERT(PlainProcPtr);
-        }
+    template<typename T>
+    struct tIsTriviallyRelocatable<tJaggedArray<T>> {
+        static constexpr bool value = true;
+    };
 
-        template<typename T>
-        explicit tDelegate(T&& CallableTarget)
-            : DispatchTarget{&CallableTarget}
-            , DispatchProc{Dispatcher<tDecay<T>>} {
-        }
+    /// Allocate a jagged array with the given row lengths. The values are initialized according to \a init.
+    template<typename T>
+    MTB_NODISCARD tJaggedArray<T> CreateJaggedArray(tAllocator allocator, tSlice<ptrdiff_t const> row_lengths, eInit init = kClearToZero) {
+        MTB_ASSERT(allocator);
+        tJaggedArray<T> result{};
+        result.allocator = allocator;
+        result.offsets = allocator.template AllocArray<ptrdiff_t>(row_lengths.len + 1, kNoInit);
+        MTB_ASSERT(result.offsets);
 
-        R operator()(tArgs&&... args) {
-            MTB_ASSERT(DispatchProc && DispatchTarget);
-            return DispatchProc(DispatchTarget, ForwardCast<tArgs>(args)...);
+        ptrdiff_t offset = 0;
+        for(ptrdiff_t row = 0; row < row_lengths.len; ++row) {
+            MTB_ASSERT(row_lengths[row] >= 0);
+            result.offsets[row] = offset;
+            offset += row_lengths[row];
         }
+        result.offsets[row_lengths.len] = offset;
 
-        MTB_NODISCARD constexpr explicit operator bool() const {
-            return !!DispatchTarget && !!DispatchProc;
+        if(offset > 0) {
+            result.values = allocator.template AllocArray<T>(offset, init);
+            MTB_ASSERT(result.values);
         }
-    };
-}  // namespace mtb
-#endif
+        return result;
+    }
 
-// --------------------------------------------------
-// -- #Section Sorting ------------------------------
-// --------------------------------------------------
-namespace mtb {
-    // Quick sort sorting algorithm. This procedure does not require to know the actual data. It relies on the fact that
-    // less_proc and swap_proc are able to produce the desired information/effect required for effectively sorting
-    // something. This implementation works on all data structures that work using indices. In other words, you can sort
-    // data in linked lists if you can index each node, or sort a discontiguous (chunked) array.
-    //
-    // \remark This sort is not stable.
-    //
-    // \param user_ptr will be passed through to \a less_proc and \a swap_proc as-is. Can be null.
-    // \param count The number of items to sort. In other words, this is the first invalid index into whatever is being sorted.
-    // \param less_proc Whether element at the first index is considered less than the element at the second index.
-    // \param threshold Partitions with a count equal to or less than this value will be sorted with insertion sort.
-    void QuickSort(void* user_ptr, ptrdiff_t count, bool (*less_proc)(void*, ptrdiff_t, ptrdiff_t), void (*swap_proc)(void*, ptrdiff_t, ptrdiff_t), ptrdiff_t threshold);
+    template<typename T>
+    void ClearAllocation(tJaggedArray<T>& array) {
+        if(array.values) {
+            DestructItems(array.values.ptr, (size_t)array.values.len);
+            array.allocator.FreeArray(array.values);
+        }
+        if(array.offsets) {
+            array.allocator.FreeArray(array.offsets);
+        }
+        array.offsets = {};
+        array.values = {};
+    }
 
-    template<typename T, typename tLessProc, typename tSwapProc>
-    void QuickSortSlice(tSlice<T> slice, tLessProc less_proc, tSwapProc swap_proc, ptrdiff_t threshold = 16) {
-        struct tContext {
-            T* ptr;
-            tLessProc Less;
-            tSwapProc Swap;
-        } Context{slice.ptr, less_proc, swap_proc};
+    /// Collects (row, item) pairs in any order and turns them into a tJaggedArray. Items of the same row keep the
+    /// order in which they were added.
+    template<typename T>
+    struct tJaggedArrayBuilder {
+        struct tEntry {
+            ptrdiff_t row;
+            T item;
+        };
 
-        QuickSort(
-            &Context,
-            slice.len,
-            [](void* C, ptrdiff_t I, ptrdiff_t J) {
-                tContext* Context = (tContext*)C;
-                return Context->Less(Context->ptr[I], Context->ptr[J]);
-            },
-            [](void* C, ptrdiff_t I, ptrdiff_t J) {
-                tContext* Context = (tContext*)C;
-                Context->Swap(Context->ptr[I], Context->ptr[J]);
-            },
-            threshold
-        );
-    }
+        tArray<tEntry> entries;
 
-    template<typename T, typename tLessProc>
-    void QuickSortSlice(tSlice<T> slice, tLessProc less_proc, ptrdiff_t threshold = 16) {
-        struct tContext {
-            T* ptr;
-            tLessProc Less;
-        } Context{slice.ptr, less_proc};
+        /// One more than the largest row seen so far.
+        ptrdiff_t row_count;
+    };
 
-        QuickSort(
-            &Context,
-            slice.len,
-            [](void* C, ptrdiff_t I, ptrdiff_t J) {
-                tContext* Context = (tContext*)C;
-                return Context->Less(Context->ptr[I], Context->ptr[J]);
-            },
-            [](void* C, ptrdiff_t I, ptrdiff_t J) {
-                tContext* Context = (tContext*)C;
-                ::mtb::Swap(Context->ptr[I], Context->ptr[J]);
-            },
-            threshold
-        );
+    template<typename T>
+    MTB_NODISCARD tJaggedArrayBuilder<T> CreateJaggedArrayBuilder(tAllocator allocator) {
+        tJaggedArrayBuilder<T> result{};
+        result.entries.allocator = allocator;
+        return result;
     }
 
-    template<typename T>
-    void QuickSortSlice(tSlice<T> slice, ptrdiff_t threshold = 16) {
-        QuickSort(
-            slice.ptr,
-            slice.len,
-            [](void* ptr, ptrdiff_t i, ptrdiff_t j) { return ((T*)ptr)[i] < ((T*)ptr)[j]; },
-            [](void* ptr, ptrdiff_t i, ptrdiff_t j) { ::mtb::Swap(((T*)ptr)[i], ((T*)ptr)[j]); },
-            threshold
-        );
+    template<typename T, typename TItem>
+    void AddItem(tJaggedArrayBuilder<T>& builder, ptrdiff_t row, TItem item) {
+        MTB_ASSERT(row >= 0);
+        auto& entry = PushOne(builder.entries, kNoInit);
+        entry.row = row;
+        new(&entry.item) T(item);
+        if(builder.row_count <= row) {
+            builder.row_count = row + 1;
+        }
     }
-}  // namespace mtb
 
-// #Note I tried using tOption. In general, I would like something like that
-// very much. However, it's so hard to correctly implement in C++ that I don't
-// think it's worth the effort. one would have to verify on all compilers that
-// it actually behaves as expected with regards to implicit casting and move
-// semantics, and that it doesn't allow implicit casts from T to
-// tOption<T> etc. There's too much uncertainty on little details that could
-// go wrong. So I just disable this here. Maybe at some point in the future
-// (C++20 and beyond?) it might be easier to achieve this kind of thing.
-#if 1
-// --------------------------------------------------
-// -- #Section Option -------------------------------
-// --------------------------------------------------
-#define MTB_OPTION_MOVE_SEMANTICS 0
+    template<typename T, typename U>
+    void AddRow(tJaggedArrayBuilder<T>& builder, ptrdiff_t row, tSlice<U> items) {
+        Reserve(builder.entries, builder.entries.len + items.len);
+        for(U& item : items) {
+            AddItem(builder, row, item);
+        }
+    }
 
-namespace mtb {
+    /// Counting sort of all entries by row into a new jagged array with at least \a min_row_count rows.
+    /// The builder is empty afterwards but keeps its memory.
     template<typename T>
-    struct tOption {
-        bool has_value;
-
-        union {
-            T value;
-        };
+    MTB_NODISCARD tJaggedArray<T> FinishJaggedArray(tJaggedArrayBuilder<T>& builder, tAllocator allocator, ptrdiff_t min_row_count = 0) {
+        ptrdiff_t row_count = builder.row_count > min_row_count ? builder.row_count : min_row_count;
 
-        // ReSharper disable once CppPossiblyUninitializedMember
-        tOption()
-            : has_value{false} {
+        // Count.
+        tSlice<ptrdiff_t> cursors = allocator.template AllocArray<ptrdiff_t>(row_count, kClearToZero);
+        for(auto& entry : builder.entries) {
+            ++cursors[entry.row];
         }
 
-        tOption(T in_value)
-            : has_value{true} {
-            new(&value) T(MoveCast(in_value));
+        // Fill. Reuse the counts as write cursors.
+        tJaggedArray<T> result = CreateJaggedArray<T>(allocator, cursors, kNoInit);
+        SliceCopyBytes(cursors, SliceRange(result.offsets, 0, row_count));
+        for(auto& entry : builder.entries) {
+            RelocateItems(result.values.ptr + cursors[entry.row]++, 1, &entry.item, 1);
         }
 
-#if MTB_OPTION_MOVE_SEMANTICS
-        tOption(T&& in_value)
-            : has_value{true} {
-            new(&value) T(MoveCast(in_value));
+        if(cursors) {
+            allocator.FreeArray(cursors);
         }
-#endif
+        Clear(builder.entries);
+        builder.row_count = 0;
+        return result;
+    }
 
-        tOption(tOption const& to_copy)
-            : has_value{to_copy.has_value} {
-            if(to_copy.has_value) {
-                new(&value) T(to_copy.value);
-            }
+    /// Struct-of-arrays container. Each of Ts is stored in its own column, and all columns live in one allocation.
+    /// Item \a index is the tuple of Column<0>(soa)[index], Column<1>(soa)[index], ...
+    template<typename... Ts>
+    struct tSoA {
+        static_assert(sizeof...(Ts) > 0, "A tSoA needs at least one column.");
+        static constexpr size_t column_count = sizeof...(Ts);
+
+        /// May not be null.
+        tAllocator allocator;
+
+        /// Number of items currently in use.
+        ptrdiff_t len;
+
+        /// Number of items each column has room for.
+        ptrdiff_t cap;
+
+        /// Internal. Start of each column within the allocation. The first column is the start of the allocation.
+        void* columns[sizeof...(Ts)];
+
+        MTB_NODISCARD constexpr explicit operator bool() const { return len > (ptrdiff_t)0; }
+    };
+
+    template<typename... Ts>
+    struct tIsTriviallyRelocatable<tSoA<Ts...>> {
+        static constexpr bool value = true;
+    };
+
+    /// The used part of column \a I.
+    template<size_t I, typename... Ts>
+    MTB_NODISCARD tSlice<tTypeAt<I, Ts...>> Column(tSoA<Ts...> const& soa) {
+        return PtrSlice((tTypeAt<I, Ts...>*)soa.columns[I], soa.len);
+    }
+}  // namespace mtb
+
+namespace mtb::impl {
+    constexpr size_t SoAColumnAlignment(size_t item_alignment) {
+        return item_alignment > MTB_SOA_COLUMN_ALIGNMENT ? item_alignment : MTB_SOA_COLUMN_ALIGNMENT;
+    }
+
+    /// Byte size of an allocation for \a cap items of each column. Writes the byte offset of each column.
+    template<typename... Ts>
+    size_t SoALayout(ptrdiff_t cap, size_t (&out_offsets)[sizeof...(Ts)]) {
+        size_t const sizes[]{MTB_sizeof(Ts)...};
+        size_t const alignments[]{SoAColumnAlignment(MTB_alignof(Ts))...};
+        size_t total = 0;
+        for(size_t column = 0; column < sizeof...(Ts); ++column) {
+            total = (total + alignments[column] - 1) & ~(alignments[column] - 1);
+            out_offsets[column] = total;
+            total += sizes[column] * (size_t)cap;
         }
+        return total;
+    }
 
-#if MTB_OPTION_MOVE_SEMANTICS
-        tOption(tOption&& to_move)
-            : has_value{to_move.has_value} {
-            if(to_move.has_value) {
-                new(&value) T(MoveCast(to_move.value));
-            }
+    template<typename... Ts>
+    constexpr size_t SoAAllocationAlignment() {
+        size_t const alignments[]{SoAColumnAlignment(MTB_alignof(Ts))...};
+        size_t result = 1;
+        for(size_t alignment : alignments) {
+            result = alignment > result ? alignment : result;
         }
-#endif
+        return result;
+    }
 
-        ~tOption() {
-            if(has_value) {
-                value.~T();
-            }
+    template<typename... Ts, size_t... Is>
+    void SoARelocateColumns(tSoA<Ts...>& soa, void* (&new_columns)[sizeof...(Ts)], ptrdiff_t new_cap, tIndexSequence<Is...>) {
+        (RelocateItems((Ts*)new_columns[Is], (size_t)new_cap, (Ts*)soa.columns[Is], (size_t)soa.len), ...);
+    }
+
+    template<typename... Ts, size_t... Is>
+    void SoADestructColumns(tSoA<Ts...>& soa, ptrdiff_t index, ptrdiff_t count, tIndexSequence<Is...>) {
+        (DestructItems((Ts*)soa.columns[Is] + index, (size_t)count), ...);
+    }
+
+    template<typename... Ts, size_t... Is, typename... TItems>
+    void SoAConstructAt(tSoA<Ts...>& soa, ptrdiff_t index, tIndexSequence<Is...>, TItems&&... items) {
+        (new((Ts*)soa.columns[Is] + index) Ts(ForwardCast<TItems>(items)), ...);
+    }
+
+    template<typename... Ts, size_t... Is>
+    void SoAClearAt(tSoA<Ts...>& soa, ptrdiff_t index, ptrdiff_t count, tIndexSequence<Is...>) {
+        (SliceSetZero(SliceCast<void>(PtrSlice((Ts*)soa.columns[Is] + index, count))), ...);
+    }
+
+    template<typename S, typename T>
+    void SoACopyColumnToStructs(T const* column, tSlice<S> out_structs, T S::*member) {
+        for(ptrdiff_t index = 0; index < out_structs.len; ++index) {
+            out_structs[index].*member = column[index];
         }
+    }
 
-        tOption& operator=(tOption const& to_copy) {
-            if(&to_copy != this) {
-                if(!has_value && !to_copy.has_value) {
-                    // value stays untouched.
-                } else if(has_value && to_copy.has_value) {
-                    // we had a value, so copy directly.
-                    value = to_copy.value;
-                } else if(!has_value && to_copy.has_value) {
-                    // we didn't have a value before, so construct.
-                    new(&value) T(to_copy.value);
-                    has_value = true;
-                } else if(has_value && !to_copy.has_value) {
-                    // we had a value, so destroy.
-                    value.~T();
-                    has_value = false;
-                }
-            }
+    template<typename... Ts, size_t... Is>
+    void SoARemoveRange(tSoA<Ts...>& soa, ptrdiff_t remove_index, ptrdiff_t remove_count, bool swap, tIndexSequence<Is...>) {
+        (ArrayRemoveRange(PtrSlice((Ts*)soa.columns[Is], soa.len), remove_index, remove_count, swap), ...);
+    }
+}  // namespace mtb::impl
 
-            return *this;
+namespace mtb {
+    template<typename... Ts>
+    bool Reserve(tSoA<Ts...>& soa, ptrdiff_t min_requested_capacity) {
+        if(soa.cap >= min_requested_capacity) {
+            return true;
         }
 
-#if MTB_OPTION_MOVE_SEMANTICS
-        tOption& operator=(tOption&& to_move) {
-            if(&to_move != this) {
-                if(!has_value && !to_move.has_value) {
-                    // value stays untouched.
-                } else if(has_value && to_move.has_value) {
-                    // we had a value, so copy directly.
-                    value = (T &&) to_move.value;
-                } else if(!has_value && to_move.has_value) {
-                    // we didn't have a value before, so construct.
-                    new(&value) T((T &&) to_move.value);
-                    has_value = true;
-                } else if(has_value && !to_move.has_value) {
-                    // we had a value, so destroy.
-                    value.~T();
-                    has_value = false;
-                }
-            }
+        ptrdiff_t new_cap = soa.cap > 0 ? soa.cap : 16;
+        while(new_cap < min_requested_capacity) {
+            new_cap = (new_cap * 3) / 2;
+        }
 
-            return *this;
+        size_t offsets[sizeof...(Ts)];
+        size_t const alignment = impl::SoAAllocationAlignment<Ts...>();
+        tSlice<void> new_alloc = soa.allocator.AllocRaw(impl::SoALayout<Ts...>(new_cap, offsets), alignment, kNoInit);
+        if(!new_alloc) {
+            return false;
         }
-#endif
 
-        constexpr operator bool() const { return has_value; }
+        void* new_columns[sizeof...(Ts)];
+        for(size_t column = 0; column < sizeof...(Ts); ++column) {
+            new_columns[column] = PtrOffset(new_alloc.ptr, (ptrdiff_t)offsets[column]);
+        }
 
-        MTB_NODISCARD T& Unwrap() {
-            MTB_ASSERT(has_value);
-            return value;
+        if(soa.cap > 0) {
+            impl::SoARelocateColumns(soa, new_columns, new_cap, tMakeIndexSequence<sizeof...(Ts)>{});
+            soa.allocator.FreeRaw(PtrSlice(soa.columns[0], impl::SoALayout<Ts...>(soa.cap, offsets)), alignment);
         }
-    };
 
-    template<typename T>
-    MTB_NODISCARD constexpr bool operator==(tOption<T> const& a, tOption<T> const& b) {
-        return (!a.has_value && !b.has_value) || (a.has_value && b.has_value && a.value == b.value);
+        for(size_t column = 0; column < sizeof...(Ts); ++column) {
+            soa.columns[column] = new_columns[column];
+        }
+        soa.cap = new_cap;
+        return true;
     }
 
-    template<typename T>
-    MTB_NODISCARD constexpr bool operator!=(tOption<T> const& a, tOption<T> const& b) {
-        return !(a == b);
+    template<typename... Ts>
+    void Clear(tSoA<Ts...>& soa) {
+        impl::SoADestructColumns(soa, 0, soa.len, tMakeIndexSequence<sizeof...(Ts)>{});
+        soa.len = 0;
+    }
+
+    template<typename... Ts>
+    void ClearAllocation(tSoA<Ts...>& soa) {
+        Clear(soa);
+        if(soa.cap > 0) {
+            size_t offsets[sizeof...(Ts)];
+            soa.allocator.FreeRaw(PtrSlice(soa.columns[0], impl::SoALayout<Ts...>(soa.cap, offsets)), impl::SoAAllocationAlignment<Ts...>());
+        }
+        soa.cap = 0;
+        for(void*& column : soa.columns) {
+            column = nullptr;
+        }
+    }
+
+    /// Append \a push_count items and return the index of the first one.
+    template<typename... Ts>
+    ptrdiff_t PushN(tSoA<Ts...>& soa, ptrdiff_t push_count, eInit init = kClearToZero) {
+        bool reserved = Reserve(soa, soa.len + push_count);
+        MTB_ASSERT(reserved);
+        (void)reserved;
+        ptrdiff_t result = soa.len;
+        if(init == kClearToZero) {
+            impl::SoAClearAt(soa, result, push_count, tMakeIndexSequence<sizeof...(Ts)>{});
+        }
+        soa.len += push_count;
+        return result;
+    }
+
+    /// Append one item, given as one value per column. Returns its index.
+    template<typename... Ts, typename... TItems>
+    ptrdiff_t Push(tSoA<Ts...>& soa, TItems&&... items) {
+        static_assert(sizeof...(TItems) == sizeof...(Ts), "Need exactly one value per column.");
+        ptrdiff_t result = PushN(soa, 1, kNoInit);
+        impl::SoAConstructAt(soa, result, tMakeIndexSequence<sizeof...(Ts)>{}, ForwardCast<TItems>(items)...);
+        return result;
+    }
+
+    template<typename... Ts>
+    void RemoveAt(tSoA<Ts...>& soa, ptrdiff_t remove_index, ptrdiff_t remove_count = 1, bool swap = false) {
+        impl::SoARemoveRange(soa, remove_index, remove_count, swap, tMakeIndexSequence<sizeof...(Ts)>{});
+        soa.len -= remove_count;
     }
+
+    /// AoS to SoA: append one item per struct, reading one member per column.
+    /// e.g. `PushFromStructs(soa, particles, &tParticle::position, &tParticle::velocity);`
+    template<typename S, typename... Ts>
+    void PushFromStructs(tSoA<Ts...>& soa, tSlice<S> structs, Ts tRemoveConst<S>::*... members) {
+        ptrdiff_t first = PushN(soa, structs.len, kNoInit);
+        for(ptrdiff_t index = 0; index < structs.len; ++index) {
+            impl::SoAConstructAt(soa, first + index, tMakeIndexSequence<sizeof...(Ts)>{}, structs[index].*members...);
+        }
+    }
+
+    /// SoA to AoS: assign items [first, first + out_structs.len) to the given members of \a out_structs.
+    template<typename S, typename... Ts>
+    void CopyToStructs(tSoA<Ts...> const& soa, ptrdiff_t first, tSlice<S> out_structs, Ts S::*... members) {
+        MTB_ASSERT(0 <= first && first + out_structs.len <= soa.len);
+        // Column by column, so each column is read sequentially.
+        size_t column = 0;
+        (impl::SoACopyColumnToStructs((Ts const*)soa.columns[column++] + first, out_structs, members), ...);
+    }
+
 }  // namespace mtb
-#endif
 
 // --------------------------------------------------
-// -- #Section Arena --------------------------------
+// -- #Section Map ----------------------------------
 // --------------------------------------------------
+namespace mtb {
+    template<typename K, typename V>
+    struct tMap;
 
-// #Option
-#if !defined(MTB_ARENA_DEFAULT_BUCKET_SIZE)
-#define MTB_ARENA_DEFAULT_BUCKET_SIZE 4096
-#endif
+    /// Control byte of a map slot. Occupied slots have the high bit set and store 7 bits of the key's hash in the
+    /// others, so probing only compares keys whose fingerprint matches.
+    struct tMapSlot {
+        enum eState : uint8_t {
+            kFree = 0x00,
+            kDead = 0x01,
+            kOccupied = 0x80,
+        };
 
-namespace mtb {
-    struct tArenaBucket {
-        tArenaBucket* next;
-        tArenaBucket* prev;
-        size_t used_size;
-        size_t total_size;
-        uint8_t data[1];  // trailing data
+        uint8_t State;
+
+        MTB_NODISCARD constexpr bool IsOccupied() const { return (State & kOccupied) != 0; }
     };
 
-    struct tArenaMarker {
-        tArenaBucket* bucket;
-        size_t offset;
+    static_assert(sizeof(tMapSlot) == sizeof(uint8_t));
 
-        MTB_NODISCARD constexpr uint8_t* ptr() const {
-            return bucket ? bucket->data + offset : nullptr;
+    template<typename T>
+    struct tMapIterator_KeyOrValue {
+        ptrdiff_t cap;
+        tMapSlot* Slots;
+        T* Items;
+        ptrdiff_t index;
+
+        MTB_NODISCARD bool operator!=(tMapIterator_KeyOrValue const& Other) const {
+            return index != Other.index;
         }
-    };
 
-    // #TODO struct tArenaStats { size_t largest_bucket_size; size_t NumBucketAllocations; size_t NumBucketFrees; };
+        MTB_NODISCARD T& operator*() const {
+            MTB_ASSERT(index < cap);
+            return Items[index];
+        }
 
-    struct tArena {
-        tAllocator child_allocator;
-        size_t min_bucket_size;
-        tArenaBucket* current_bucket;
-        tArenaBucket* first_free_bucket;
+        tMapIterator_KeyOrValue& operator++() {
+            while(++index < cap) {
+                if(Slots[index].IsOccupied()) {
+                    break;
+                }
+            }
+            return *this;
+        }
 
-        size_t largest_bucket_size;
+        MTB_NODISCARD tMapIterator_KeyOrValue begin() {
+            tMapIterator_KeyOrValue result = *this;
+            result.index = -1;
+            return ++result;
+        }
+
+        MTB_NODISCARD tMapIterator_KeyOrValue end() {
+            tMapIterator_KeyOrValue result = *this;
+            result.index = cap;
+            return result;
+        }
     };
 
-    MTB_NODISCARD size_t BucketTotalSize(tArenaBucket const* bucket);
+    // #TODO Return size_t instead? May be easier to leave it up to the user to take care of bitness.
+    using tMapHashFunc = uint64_t (*)(void const* Key, size_t KeySize);
+    using tMapCompareFunc = int (*)(void const* KeyA, void const* KeyB, size_t KeySize);
 
-    MTB_NODISCARD size_t BucketUsedSize(tArenaBucket const* bucket);
+    template<typename K, typename V>
+    struct tMap {
+        /// May not be null.
+        tAllocator allocator;
 
-    void Reserve(tArena& arena, size_t total_size);
+        /// May not be null.
+        tMapHashFunc HashFunc;
 
-    void Grow(tArena& arena, size_t required_size);
+        /// May be null. Fallback is memcpy-style comparison.
+        tMapCompareFunc CompareFunc;
 
-    void Clear(tArena& arena, bool release_memory = true);
+        /// Number of elements in the map.
+        ptrdiff_t count;
 
-    void* ReallocRaw(tArena& arena, void* old_ptr, size_t old_size, size_t old_alignment, size_t new_size, size_t new_alignment, eInit init);
+        /// Number of dead slots, left behind by Remove. They count towards the load until the next rehash.
+        ptrdiff_t dead_count;
 
-    MTB_NODISCARD void* PushRaw(tArena& arena, size_t size, size_t alignment, eInit init);
+        /// Number of elements the map could theoretically store. The map is resized before this value is reached.
+        /// Zero or a power of two that is at least the probing group size.
+        ptrdiff_t cap;
 
-    tSlice<void> ReallocRawArray(tArena& arena, tSlice<void> old_array, size_t old_alignment, size_t new_size, size_t new_alignment, eInit init);
+        /// Internal. array(N=cap) of control bytes in this map.
+        tMapSlot* Slots;
 
-    MTB_NODISCARD tSlice<void> PushRawArray(tArena& arena, size_t size, size_t alignment, eInit init);
+        /// Internal. array(N=cap) of keys in this map.
+        // #TODO Compute this based on Slots instead of storing it?
+        K* Keys;
 
-    template<typename T>
-    tSlice<T> ReallocArray(tArena& arena, tSlice<T> old_array, size_t new_count, eInit init = kClearToZero) {
-        size_t new_size = MTB_sizeof(T) * new_count;
-        size_t alignment = MTB_alignof(T);
-        void* ptr = ReallocRaw(arena, old_array.ptr, SliceSize(old_array), alignment, new_size, alignment, init);
-        tSlice<T> result = PtrSlice((T*)ptr, new_count);
-        if(init == kClearToZero) {
-            SliceSetZero(SliceOffset(result, old_array.len));
-        }
-        return result;
-    }
+        /// Internal. array(N=cap) of values in this map.
+        // #TODO Compute this based on Slots instead of storing it?
+        V* Values;
+    };
 
-    template<typename T>
-    MTB_NODISCARD tSlice<T> PushArray(tArena& arena, size_t count, eInit init = kClearToZero) {
-        return ReallocArray<T>(arena, {}, count, init);
-    }
+    template<typename K, typename V>
+    struct tIsTriviallyRelocatable<tMap<K, V>> {
+        static constexpr bool value = true;
+    };
 
-    template<typename T, typename U = tRemoveConst<T>>
-    MTB_NODISCARD tSlice<U> PushCopyArray(tArena& arena, tSlice<T> to_copy) {
-        tSlice<U> Copy = PushArray<U>(arena, to_copy.len, kNoInit);
-        SliceCopyBytes(Copy, to_copy);
-        return Copy;
-    }
+    /// Whether keys of type K are integers or pointers, which map hash functions can treat as a single value.
+    // clang-format off
+    template<typename K> struct tMapKeyIsInteger                     { static constexpr bool value = false; };
+    template<typename K> struct tMapKeyIsInteger<K*>                 { static constexpr bool value = true; };
+    template<> struct tMapKeyIsInteger<bool>                         { static constexpr bool value = true; };
+    template<> struct tMapKeyIsInteger<char>                         { static constexpr bool value = true; };
+    template<> struct tMapKeyIsInteger<signed char>                  { static constexpr bool value = true; };
+    template<> struct tMapKeyIsInteger<unsigned char>                { static constexpr bool value = true; };
+    template<> struct tMapKeyIsInteger<wchar_t>                      { static constexpr bool value = true; };
+    template<> struct tMapKeyIsInteger<char16_t>                     { static constexpr bool value = true; };
+    template<> struct tMapKeyIsInteger<char32_t>                     { static constexpr bool value = true; };
+    template<> struct tMapKeyIsInteger<short>                        { static constexpr bool value = true; };
+    template<> struct tMapKeyIsInteger<unsigned short>               { static constexpr bool value = true; };
+    template<> struct tMapKeyIsInteger<int>                          { static constexpr bool value = true; };
+    template<> struct tMapKeyIsInteger<unsigned int>                 { static constexpr bool value = true; };
+    template<> struct tMapKeyIsInteger<long>                         { static constexpr bool value = true; };
+    template<> struct tMapKeyIsInteger<unsigned long>                { static constexpr bool value = true; };
+    template<> struct tMapKeyIsInteger<long long>                    { static constexpr bool value = true; };
+    template<> struct tMapKeyIsInteger<unsigned long long>           { static constexpr bool value = true; };
+    // clang-format on
 
-    // The same as PushCopyArray with one additional zero-element at the end.
-    template<typename T, typename U = tRemoveConst<T>>
-    MTB_NODISCARD tSlice<U> PushCopyString(tArena& arena, tSlice<T> to_copy) {
-        tSlice<U> ZeroTerminatedCopy = PushArray<U>(arena, to_copy.len + 1, kNoInit);
-        tSlice<U> result = SliceRange(ZeroTerminatedCopy, 0, ZeroTerminatedCopy.len - 1);
-        SliceCopyBytes(result, to_copy);
-        // set terminator element.
-        new(PtrOffset(ZeroTerminatedCopy.ptr, ZeroTerminatedCopy.len - 1)) U{};
-        return result;
-    }
+    /// Default hash policy of tPolicyMap. See below.
+    template<typename K>
+    struct tMapHash;
 
-    template<typename T>
-    MTB_NODISCARD T& PushOne(tArena& arena, eInit init = kClearToZero) {
-        T* result = PushArray<T>(arena, 1, init).ptr;
-        MTB_ASSERT(!!result);
-        return *result;
-    }
+    /// Default equality policy of tPolicyMap. See below.
+    template<typename K>
+    struct tMapEqual;
 
-    template<typename T>
-    MTB_NODISCARD T& PushCopy(tArena& arena, T const& item) {
-        T& result = PushOne<T>(arena, kNoInit);
-        SliceCopyBytes(PtrSlice(&result, 1), PtrSlice(&item, 1));
-        return result;
-    }
+    /// A tMap that hashes and compares keys with `tHash::Hash(K const&) -> uint64_t` and
+    /// `tEqual::Equal(K const&, K const&) -> bool` instead of function pointers, so both can be inlined into the
+    /// probing loop. Memory is managed exactly like for tMap.
+    template<typename K, typename V, typename tHash = tMapHash<K>, typename tEqual = tMapEqual<K>>
+    struct tPolicyMap {
+        /// May not be null.
+        tAllocator allocator;
 
-    /* #TODO
-     - NumBuckets?
-     - accumulated total_size across all buckets?
-     - accumulated used_size across all buckets?
-    */
+        /// Number of elements in the map.
+        ptrdiff_t count;
 
-    /// \remark Only valid before free was called.
-    MTB_NODISCARD tArenaMarker GetMarker(tArena const& arena);
+        /// Number of dead slots, left behind by Remove. They count towards the load until the next rehash.
+        ptrdiff_t dead_count;
 
-    void ResetToMarker(tArena& arena, tArenaMarker marker, bool release_memory = true);
+        /// Number of elements the map could theoretically store. The map is resized before this value is reached.
+        /// Zero or a power of two that is at least the probing group size.
+        ptrdiff_t cap;
 
-    /// Ensure the memory in the given range is contiguous.
-    /// Returns the marker to the beginning of the linearized section.
-    MTB_NODISCARD tSlice<void> Linearize(tArena& arena, tArenaMarker begin, tArenaMarker end);
+        /// Internal. array(N=cap) of control bytes in this map.
+        tMapSlot* Slots;
 
-    MTB_NODISCARD tAllocator MakeAllocator(tArena& arena);
+        /// Internal. array(N=cap) of keys in this map.
+        K* Keys;
 
-#if MTB_USE_STB_SPRINTF
-    /// \brief Produce several fragments of formatted strings within the given arena. Use `*printf_Arena` or `Linearize` to produce an actual string.
-    void vprintf_ArenaRaw(tArena& arena, char const* format, va_list vargs);
+        /// Internal. array(N=cap) of values in this map.
+        V* Values;
+    };
 
-    // Append a string with the given format inside the given arena.
-    inline void printf_ArenaRaw(tArena& arena, char const* format, ...) {
-        va_list args;
-        va_start(args, format);
-        vprintf_ArenaRaw(arena, format, args);
-        va_end(args);
-    }
+    template<typename K, typename V, typename tHash, typename tEqual>
+    struct tIsTriviallyRelocatable<tPolicyMap<K, V, tHash, tEqual>> {
+        static constexpr bool value = true;
+    };
+}  // namespace mtb
 
-    /// \brief Append a string with the given format inside the given arena. Produces a null-terminated string.
-    /// \return The formatted string EXCLUDING the null-terminator.
-    tSlice<char> vprintf_Arena(tArena& arena, char const* format, va_list vargs);
+namespace mtb {
+    template<typename K, typename V>
+    MTB_NODISCARD tMapIterator_KeyOrValue<K> IterKeys(tMap<K, V>& map);
 
-    // Append a string with the given format inside the given arena.
-    inline tSlice<char> printf_Arena(tArena& arena, char const* format, ...) {
-        va_list args;
-        va_start(args, format);
-        tSlice<char> result = vprintf_Arena(arena, format, args);
-        va_end(args);
+    template<typename K, typename V>
+    MTB_NODISCARD tMapIterator_KeyOrValue<V> IterValues(tMap<K, V>& map);
 
-        return result;
-    }
+    template<typename K, typename V>
+    MTB_NODISCARD tMap<K, V> CreateMap(tAllocator allocator, tMapHashFunc hash_func, tMapCompareFunc cmp_func);
 
-#endif  // MTB_USE_STB_SPRINTF
+    template<typename K, typename V>
+    void Put(tMap<K, V>& map, K const& Key, V const& value);
 
-}  // namespace mtb
+    template<typename K, typename V>
+    MTB_NODISCARD V* Find(tMap<K, V>& map, K const& Key);
 
-// --------------------------------------------------
-// -- #Section Strings ------------------------------
-// --------------------------------------------------
-namespace mtb {
-    namespace literals {
-        /// Create an mtb::tSlice<char const> from a string literal.
-        static tSlice<char const> operator""_s(char const* str, size_t len) {
-            return {.ptr = str, .len = (ptrdiff_t)len};
-        }
-    }  // namespace literals
+    template<typename K, typename V>
+    MTB_NODISCARD V& FindChecked(tMap<K, V>& map, K const& Key);
 
-    //
-    // Types
-    //
-    enum eStringComparison {
-        kCaseSensitive,
-        kIgnoreCase,
-    };
+    template<typename K, typename V>
+    bool Remove(tMap<K, V>& map, K const& Key);
 
-    using tTrimPredicate = bool (*)(char);
-    using tWTrimPredicate = bool (*)(wchar_t);
+    /// Destruct all keys and values and free the map's memory.
+    template<typename K, typename V>
+    void ClearAllocation(tMap<K, V>& map);
 
-    MTB_NODISCARD size_t StringLengthZ(char const* str_z);
-    MTB_NODISCARD size_t StringLengthZ(wchar_t const* str_z);
+    template<typename K, typename V, typename tHash, typename tEqual>
+    MTB_NODISCARD tMapIterator_KeyOrValue<K> IterKeys(tPolicyMap<K, V, tHash, tEqual>& map);
 
-    MTB_NODISCARD inline tSlice<char> WrapZ(char* str_z) { return PtrSlice(str_z, StringLengthZ(str_z)); }
-    MTB_NODISCARD inline tSlice<wchar_t> WrapZ(wchar_t* str_z) { return PtrSlice(str_z, StringLengthZ(str_z)); }
+    template<typename K, typename V, typename tHash, typename tEqual>
+    MTB_NODISCARD tMapIterator_KeyOrValue<V> IterValues(tPolicyMap<K, V, tHash, tEqual>& map);
 
-    MTB_NODISCARD inline tSlice<char const> ConstZ(char const* str_z) { return PtrSlice(str_z, StringLengthZ(str_z)); }
-    MTB_NODISCARD inline tSlice<wchar_t const> ConstZ(wchar_t const* str_z) { return PtrSlice(str_z, StringLengthZ(str_z)); }
+    template<typename K, typename V, typename tHash = tMapHash<K>, typename tEqual = tMapEqual<K>>
+    MTB_NODISCARD tPolicyMap<K, V, tHash, tEqual> CreatePolicyMap(tAllocator allocator);
 
-    //
-    // Character conversion
-    //
+    template<typename K, typename V, typename tHash, typename tEqual>
+    void Put(tPolicyMap<K, V, tHash, tEqual>& map, K const& Key, V const& value);
 
-    MTB_NODISCARD char ToLowerChar(char c);
-    MTB_NODISCARD char ToUpperChar(char c);
+    template<typename K, typename V, typename tHash, typename tEqual>
+    MTB_NODISCARD V* Find(tPolicyMap<K, V, tHash, tEqual>& map, K const& Key);
 
-    MTB_NODISCARD wchar_t ToLowerChar(wchar_t c);
-    MTB_NODISCARD wchar_t ToUpperChar(wchar_t c);
+    template<typename K, typename V, typename tHash, typename tEqual>
+    MTB_NODISCARD V& FindChecked(tPolicyMap<K, V, tHash, tEqual>& map, K const& Key);
 
-    //
-    // Character properties
-    //
+    template<typename K, typename V, typename tHash, typename tEqual>
+    bool Remove(tPolicyMap<K, V, tHash, tEqual>& map, K const& Key);
 
-    MTB_NODISCARD bool IsDigitChar(char c);
-    MTB_NODISCARD bool IsWhiteChar(char c);
+    /// Destruct all keys and values and free the map's memory.
+    template<typename K, typename V, typename tHash, typename tEqual>
+    void ClearAllocation(tPolicyMap<K, V, tHash, tEqual>& map);
+}  // namespace mtb
 
-    MTB_NODISCARD bool IsDigitChar(wchar_t c);
-    MTB_NODISCARD bool IsWhiteChar(wchar_t c);
+// The internals work on both tMap and tPolicyMap. They only differ in impl::MapHashKey and impl::MapKeysEqual.
+namespace mtb {
+    template<typename tMapType, typename K, typename V>
+    void InternalMapPut(tMapType& map, K const& Key, V const& value);
 
-    // String comparison
+    template<typename tMapType>
+    void InternalEnsureAdditionalCapacity(tMapType& map, ptrdiff_t additional_len);
 
-    MTB_NODISCARD int32_t StringCompare(tSlice<char const> str_a, tSlice<char const> str_b, eStringComparison cmp = kCaseSensitive);
-    MTB_NODISCARD int32_t StringCompare(tSlice<wchar_t const> str_a, tSlice<wchar_t const> str_b, eStringComparison cmp = kCaseSensitive);
+    /// Turn all dead slots into free ones without reallocating, by moving every key to the first free slot of its
+    /// probe sequence.
+    template<typename tMapType>
+    void InternalMapDropDeadSlots(tMapType& map);
 
-    MTB_NODISCARD bool StringsAreEqual(tSlice<char const> str_a, tSlice<char const> str_b, eStringComparison cmp = kCaseSensitive);
-    MTB_NODISCARD bool StringsAreEqual(tSlice<wchar_t const> str_a, tSlice<wchar_t const> str_b, eStringComparison cmp = kCaseSensitive);
+    template<typename K, typename V>
+    constexpr size_t InternalMapAlignment();
 
-    MTB_NODISCARD bool StringStartsWith(tSlice<char const> str, tSlice<char const> prefix, eStringComparison cmp = kCaseSensitive);
-    MTB_NODISCARD bool StringStartsWith(tSlice<wchar_t const> str, tSlice<wchar_t const> prefix, eStringComparison cmp = kCaseSensitive);
+    namespace impl {
+        /// Slots are probed in aligned groups of this many. The capacity of a map is always a multiple of it.
+        constexpr ptrdiff_t map_group_len = 16;
 
-    MTB_NODISCARD bool StringEndsWith(tSlice<char const> str, tSlice<char const> prefix, eStringComparison cmp = kCaseSensitive);
-    MTB_NODISCARD bool StringEndsWith(tSlice<wchar_t const> str, tSlice<wchar_t const> prefix, eStringComparison cmp = kCaseSensitive);
+        /// Control byte of an occupied slot for a key with the given hash.
+        MTB_NODISCARD constexpr uint8_t MapSlotState(uint64_t hash) {
+            return (uint8_t)(tMapSlot::kOccupied | (hash & 0x7F));
+        }
 
-    //
-    // Trim Start
-    //
+        /// Applied to the result of every HashFunc call. Slots are picked by masking, which only looks at some of the
+        /// bits, so this folds the high bits into the low ones and spreads them out again. Hash functions that only
+        /// vary in a few bits, like the identity on integers, would otherwise pile up in a handful of groups.
+        MTB_NODISCARD constexpr uint64_t MapMixHash(uint64_t hash) {
+            hash = (hash ^ (hash >> 32)) * 0x9E3779B97F4A7C15ULL;
+            return hash ^ (hash >> 32);
+        }
 
-    MTB_NODISCARD tSlice<char const> StringTrimStartPredicate(tSlice<char const> str, tTrimPredicate Predicate);
-    MTB_NODISCARD inline tSlice<char> StringTrimStartPredicate(tSlice<char> str, tTrimPredicate Predicate) { return SliceRemoveConst(StringTrimStartPredicate((tSlice<char const>)str, Predicate)); }
-    MTB_NODISCARD tSlice<wchar_t const> StringTrimStartPredicate(tSlice<wchar_t const> str, tWTrimPredicate Predicate);
-    MTB_NODISCARD inline tSlice<wchar_t> StringTrimStartPredicate(tSlice<wchar_t> str, tWTrimPredicate Predicate) { return SliceRemoveConst(StringTrimStartPredicate((tSlice<wchar_t const>)str, Predicate)); }
+        template<typename K, typename V>
+        MTB_NODISCARD uint64_t MapHashKey(tMap<K, V> const& map, K const& key) {
+            return MapMixHash(map.HashFunc(&key, sizeof(K)));
+        }
 
-    MTB_NODISCARD tSlice<char const> StringTrimStart(tSlice<char const> str);
-    MTB_NODISCARD inline tSlice<char> StringTrimStart(tSlice<char> str) { return SliceRemoveConst(StringTrimStart((tSlice<char const>)str)); }
-    MTB_NODISCARD tSlice<wchar_t const> StringTrimStart(tSlice<wchar_t const> str);
-    MTB_NODISCARD inline tSlice<wchar_t> StringTrimStart(tSlice<wchar_t> str) { return SliceRemoveConst(StringTrimStart((tSlice<wchar_t const>)str)); }
+        template<typename K, typename V, typename tHash, typename tEqual>
+        MTB_NODISCARD uint64_t MapHashKey(tPolicyMap<K, V, tHash, tEqual> const&, K const& key) {
+            return MapMixHash(tHash::Hash(key));
+        }
 
-    //
-    // Trim End
-    //
+        template<typename K, typename V>
+        MTB_NODISCARD bool MapKeysEqual(tMap<K, V> const& map, K const& a, K const& b) {
+            return map.CompareFunc(&a, &b, sizeof(K)) == 0;
+        }
 
-    MTB_NODISCARD tSlice<char const> StringTrimEndPredicate(tSlice<char const> str, tTrimPredicate Predicate);
-    MTB_NODISCARD inline tSlice<char> StringTrimEndPredicate(tSlice<char> str, tTrimPredicate Predicate) { return SliceRemoveConst(StringTrimEndPredicate((tSlice<char const>)str, Predicate)); }
-    MTB_NODISCARD tSlice<wchar_t const> StringTrimEndPredicate(tSlice<wchar_t const> str, tWTrimPredicate Predicate);
-    MTB_NODISCARD inline tSlice<wchar_t> StringTrimEndPredicate(tSlice<wchar_t> str, tWTrimPredicate Predicate) { return SliceRemoveConst(StringTrimEndPredicate((tSlice<wchar_t const>)str, Predicate)); }
+        template<typename K, typename V, typename tHash, typename tEqual>
+        MTB_NODISCARD bool MapKeysEqual(tPolicyMap<K, V, tHash, tEqual> const&, K const& a, K const& b) {
+            return tEqual::Equal(a, b);
+        }
 
-    MTB_NODISCARD tSlice<char const> StringTrimEnd(tSlice<char const> str);
-    MTB_NODISCARD inline tSlice<char> StringTrimEnd(tSlice<char> str) { return SliceRemoveConst(StringTrimEnd((tSlice<char const>)str)); }
-    MTB_NODISCARD tSlice<wchar_t const> StringTrimEnd(tSlice<wchar_t const> str);
-    MTB_NODISCARD inline tSlice<wchar_t> StringTrimEnd(tSlice<wchar_t> str) { return SliceRemoveConst(StringTrimEnd((tSlice<wchar_t const>)str)); }
+        /// Hash of a key's bytes, for keys without padding. Keys of up to 8 bytes are returned as they are, since
+        /// MapMixHash takes care of them.
+        MTB_NODISCARD inline uint64_t MapHashKeyBytes(void const* key, size_t key_size) {
+            uint8_t const* ptr = (uint8_t const*)key;
+            uint64_t word = 0;
+            if(key_size <= sizeof(word)) {
+                MTB_memcpy(&word, ptr, key_size);
+                return word;
+            }
 
-    //
-    // Trim (both ends)
-    //
+            uint64_t result = key_size;
+            for(; key_size > sizeof(word); key_size -= sizeof(word), ptr += sizeof(word)) {
+                MTB_memcpy(&word, ptr, sizeof(word));
+                result = MapMixHash(result ^ word);
+            }
+            word = 0;
+            MTB_memcpy(&word, ptr, key_size);
+            return result ^ word;
+        }
 
-    MTB_NODISCARD tSlice<char const> StringTrimPredicate(tSlice<char const> str, tTrimPredicate Predicate);
-    MTB_NODISCARD inline tSlice<char> StringTrimPredicate(tSlice<char> str, tTrimPredicate Predicate) { return SliceRemoveConst(StringTrimPredicate((tSlice<char const>)str, Predicate)); }
-    MTB_NODISCARD tSlice<wchar_t const> StringTrimPredicate(tSlice<wchar_t const> str, tWTrimPredicate Predicate);
-    MTB_NODISCARD inline tSlice<wchar_t> StringTrimPredicate(tSlice<wchar_t> str, tWTrimPredicate Predicate) { return SliceRemoveConst(StringTrimPredicate((tSlice<wchar_t const>)str, Predicate)); }
+        /// Integers and pointers hash to their value and are compared with ==. Everything else goes byte-wise.
+        template<bool tIsInteger>
+        struct tMapKeyOps {
+            template<typename K>
+            MTB_NODISCARD static uint64_t Hash(K const& key) {
+                return MapHashKeyBytes(&key, sizeof(K));
+            }
 
-    MTB_NODISCARD tSlice<char const> StringTrim(tSlice<char const> str);
-    MTB_NODISCARD inline tSlice<char> StringTrim(tSlice<char> str) { return SliceRemoveConst(StringTrim((tSlice<char const>)str)); }
-    MTB_NODISCARD tSlice<wchar_t const> StringTrim(tSlice<wchar_t const> str);
-    MTB_NODISCARD inline tSlice<wchar_t> StringTrim(tSlice<wchar_t> str) { return SliceRemoveConst(StringTrim((tSlice<wchar_t const>)str)); }
+            template<typename K>
+            MTB_NODISCARD static bool Equal(K const& a, K const& b) {
+                return MTB_memcmp(&a, &b, sizeof(K)) == 0;
+            }
+        };
 
-    //
-    // String Allocation
-    //
+        template<>
+        struct tMapKeyOps<true> {
+            template<typename K>
+            MTB_NODISCARD static uint64_t Hash(K key) {
+                return (uint64_t)key;
+            }
 
-    MTB_NODISCARD tSlice<char> AllocString(tAllocator a, size_t char_count);
-    MTB_NODISCARD tSlice<wchar_t> AllocWString(tAllocator a, size_t char_count);
+            template<typename K>
+            MTB_NODISCARD static bool Equal(K a, K b) {
+                return a == b;
+            }
+        };
+    }  // namespace impl
 
-    MTB_NODISCARD tSlice<char> DupeString(tAllocator a, tSlice<char const> str);
-    MTB_NODISCARD tSlice<wchar_t> DupeString(tAllocator a, tSlice<wchar_t const> str);
+    /// Integer and pointer keys hash to their own value, which the map mixes before use. Other keys are hashed
+    /// byte-wise, so they must not contain padding bytes or pointers to their actual data.
+    template<typename K>
+    struct tMapHash {
+        MTB_NODISCARD static uint64_t Hash(K const& key) {
+            return impl::tMapKeyOps<tMapKeyIsInteger<K>::value>::Hash(key);
+        }
+    };
 
-    void FreeString(tAllocator a, tSlice<char> str);
-    void FreeString(tAllocator a, tSlice<wchar_t> str);
-}  // namespace mtb::string
+    /// Integer and pointer keys are compared with ==, other keys byte-wise.
+    template<typename K>
+    struct tMapEqual {
+        MTB_NODISCARD static bool Equal(K const& a, K const& b) {
+            return impl::tMapKeyOps<tMapKeyIsInteger<K>::value>::Equal(a, b);
+        }
+    };
 
-// --------------------------------------------------
-// -- #Section Units --------------------------------
-// --------------------------------------------------
-namespace mtb {
-    const uint64_t kibibytes_to_bytes = 1024ULL;
-    const uint64_t mebibytes_to_bytes = 1024ULL * kibibytes_to_bytes;
-    const uint64_t gibibytes_to_bytes = 1024ULL * mebibytes_to_bytes;
-    const uint64_t tebibytes_to_bytes = 1024ULL * gibibytes_to_bytes;
-    const uint64_t pebibytes_to_bytes = 1024ULL * tebibytes_to_bytes;
-    const uint64_t exbibytes_to_bytes = 1024ULL * pebibytes_to_bytes;
+    /// Slice keys, e.g. strings, are hashed and compared by the bytes they point to. The map does not copy them.
+    template<typename T>
+    struct tMapHash<tSlice<T>> {
+        MTB_NODISCARD static uint64_t Hash(tSlice<T> const& key) {
+            return impl::MapHashKeyBytes(key.ptr, key.len * sizeof(T));
+        }
+    };
 
-    const uint64_t kilobytes_to_bytes = 1000ULL;
-    const uint64_t megabytes_to_bytes = 1000ULL * kilobytes_to_bytes;
-    const uint64_t gigabytes_to_bytes = 1000ULL * megabytes_to_bytes;
-    const uint64_t terabytes_to_bytes = 1000ULL * gigabytes_to_bytes;
-    const uint64_t petabytes_to_bytes = 1000ULL * terabytes_to_bytes;
-    const uint64_t exabytes_to_bytes = 1000ULL * petabytes_to_bytes;
+    template<typename T>
+    struct tMapEqual<tSlice<T>> {
+        MTB_NODISCARD static bool Equal(tSlice<T> const& a, tSlice<T> const& b) {
+            return SliceBytesAreEqual(a, b);
+        }
+    };
 
-    // clang-format off
-    const uint64_t microseconds_to_nanoseconds = 1000ULL;
-    const uint64_t milliseconds_to_nanoseconds = 1000ULL * microseconds_to_nanoseconds;
-    const uint64_t seconds_to_nanoseconds      = 1000ULL * milliseconds_to_nanoseconds;
-    const uint64_t minutes_to_nanoseconds      =   60ULL * seconds_to_nanoseconds;
-    const uint64_t hours_to_nanoseconds        =   60ULL * minutes_to_nanoseconds;
-    const uint64_t days_to_nanoseconds         =   24ULL * hours_to_nanoseconds;
-    // clang-format on
+    namespace impl {
+        /// One less than the number of groups. The capacity is a power of two, so this masks a hash to a group index.
+        MTB_NODISCARD constexpr size_t MapGroupMask(ptrdiff_t cap) {
+            return (size_t)cap / map_group_len - 1;
+        }
 
-    /// Break a value into whole unit components.
-    /// \example
-    ///    uint64_t byte_value = (1337 * mebibytes_to_bytes) + (666 * kibibytes_to_bytes) + 42;
-    ///    uint64_t units[]{mebibytes_to_bytes, kibibytes_to_bytes, 1}; uint32_t results[3];
-    ///    BreakIntoUnits(byte_value, ArraySlice(units), ArraySlice(results));
-    ///    // results[0] == 1337; results[1] == 666; results[0] == 42;
-    void BreakIntoUnits(uint64_t value, tSlice<uint64_t const> units_table, tSlice<uint32_t> out_results);
-}  // namespace mtb
+        /// Index of the group where probing for a key with the given hash starts.
+        MTB_NODISCARD constexpr size_t MapFirstGroup(uint64_t hash, ptrdiff_t cap) {
+            return (size_t)(hash >> 7) & MapGroupMask(cap);
+        }
 
-// --------------------------------------------------
-// -- #Section Timespan ClockTime -------------------
-// --------------------------------------------------
+        /// Bit i is set if slot i of the group has the given state.
+        MTB_NODISCARD inline uint32_t MapGroupMatch(tMapSlot const* group, uint8_t state) {
+#if MTB_USE_SSE2
+            __m128i control = _mm_loadu_si128((__m128i const*)group);
+            return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8((char)state)));
+#else
+            uint32_t result = 0;
+            for(ptrdiff_t index = 0; index < map_group_len; ++index) {
+                result |= (uint32_t)(group[index].State == state) << index;
+            }
+            return result;
+#endif
+        }
 
-namespace mtb::time {
-    struct tTimespan {
-        int64_t nanoseconds;
+        /// Bit i is set if slot i of the group is free or dead.
+        MTB_NODISCARD inline uint32_t MapGroupMatchAvailable(tMapSlot const* group) {
+#if MTB_USE_SSE2
+            // The high bit of each control byte is the occupied flag.
+            return ~(uint32_t)_mm_movemask_epi8(_mm_loadu_si128((__m128i const*)group)) & 0xFFFF;
+#else
+            uint32_t result = 0;
+            for(ptrdiff_t index = 0; index < map_group_len; ++index) {
+                result |= (uint32_t)!group[index].IsOccupied() << index;
+            }
+            return result;
+#endif
+        }
 
-        constexpr operator bool() const { return (bool)nanoseconds; }
+        /// Index of the slot holding \a key, or -1. Only slots whose fingerprint matches are compared with the key.
+        /// Probing ends at the first group with a free slot: Put fills the first group with room, and Remove leaves
+        /// dead slots behind, so a key is never behind such a group.
+        template<typename tMapType, typename K>
+        ptrdiff_t MapFindIndex(tMapType const& map, K const& key, uint64_t hash) {
+            uint8_t state = MapSlotState(hash);
+            size_t group_mask = MapGroupMask(map.cap);
+            size_t group = MapFirstGroup(hash, map.cap);
+            for(size_t probe = 0; probe <= group_mask; ++probe) {
+                tMapSlot const* slots = map.Slots + group * map_group_len;
+                for(uint32_t match = MapGroupMatch(slots, state); match; match &= match - 1) {
+                    ptrdiff_t index = (ptrdiff_t)group * map_group_len + CountTrailingZeros(match);
+                    if(MapKeysEqual(map, map.Keys[index], key)) {
+                        return index;
+                    }
+                }
+                if(MapGroupMatch(slots, tMapSlot::kFree)) {
+                    break;
+                }
+                group = (group + 1) & group_mask;
+            }
+            return -1;
+        }
 
-        // clang-format off
-        MTB_NODISCARD constexpr int64_t Nanoseconds() const { return nanoseconds; }
-        MTB_NODISCARD constexpr double Microseconds() const { return (double)nanoseconds / (double)microseconds_to_nanoseconds; }
-        MTB_NODISCARD constexpr double Milliseconds() const { return (double)nanoseconds / (double)milliseconds_to_nanoseconds; }
-        MTB_NODISCARD constexpr double Seconds()      const { return (double)nanoseconds / (double)seconds_to_nanoseconds; }
-        MTB_NODISCARD constexpr double Minutes()      const { return (double)nanoseconds / (double)minutes_to_nanoseconds; }
-        MTB_NODISCARD constexpr double Hours()        const { return (double)nanoseconds / (double)hours_to_nanoseconds; }
-        MTB_NODISCARD constexpr double Days()         const { return (double)nanoseconds / (double)days_to_nanoseconds; }
-        // clang-format on
+        /// Index of the first free or dead slot in the probe sequence of \a hash.
+        template<typename tMapType>
+        ptrdiff_t MapFindAvailableIndex(tMapType const& map, uint64_t hash) {
+            size_t group_mask = MapGroupMask(map.cap);
+            size_t group = MapFirstGroup(hash, map.cap);
+            for(size_t probe = 0; probe <= group_mask; ++probe) {
+                uint32_t available = MapGroupMatchAvailable(map.Slots + group * map_group_len);
+                if(available) {
+                    return (ptrdiff_t)group * map_group_len + CountTrailingZeros(available);
+                }
+                group = (group + 1) & group_mask;
+            }
+            return -1;
+        }
 
-        // clang-format off
-        MTB_NODISCARD static constexpr tTimespan FromNanoseconds(int64_t in_nanoseconds)  { return { in_nanoseconds }; }
-        MTB_NODISCARD static constexpr tTimespan FromMicroseconds(double in_microseconds) { return { (int64_t)(in_microseconds * (double)microseconds_to_nanoseconds) }; }
-        MTB_NODISCARD static constexpr tTimespan FromMilliseconds(double in_milliseconds) { return { (int64_t)(in_milliseconds * (double)milliseconds_to_nanoseconds) }; }
-        MTB_NODISCARD static constexpr tTimespan FromSeconds     (double in_seconds)      { return { (int64_t)(in_seconds      * (double)seconds_to_nanoseconds) }; }
-        MTB_NODISCARD static constexpr tTimespan FromMinutes     (double in_minutes)      { return { (int64_t)(in_minutes      * (double)minutes_to_nanoseconds) }; }
-        MTB_NODISCARD static constexpr tTimespan FromHours       (double in_hours)        { return { (int64_t)(in_hours        * (double)hours_to_nanoseconds) }; }
-        MTB_NODISCARD static constexpr tTimespan FromDays        (double in_days)         { return { (int64_t)(in_days         * (double)days_to_nanoseconds) }; }
-        // clang-format on
-    };
+        template<typename tMapType, typename K>
+        auto MapFind(tMapType& map, K const& key) -> decltype(map.Values) {
+            decltype(map.Values) result = nullptr;
+            if(map.count) {
+                ptrdiff_t index = MapFindIndex(map, key, MapHashKey(map, key));
+                if(index >= 0) {
+                    result = map.Values + index;
+                }
+            }
 
-    constexpr tTimespan timespan_zero{0};
-    constexpr tTimespan timespan_min{tIntProperties<int64_t>::min_value};
-    constexpr tTimespan timespan_max{tIntProperties<int64_t>::max_value};
+            return result;
+        }
 
-    //
-    // timespan + timespan
-    //
-    MTB_NODISCARD constexpr tTimespan operator+(tTimespan a, tTimespan b) {
-        return {a.nanoseconds + b.nanoseconds};
-    }
+        template<typename tMapType, typename K>
+        bool MapRemove(tMapType& map, K const& key) {
+            bool result = false;
+            if(map.count) {
+                ptrdiff_t index = MapFindIndex(map, key, MapHashKey(map, key));
+                if(index >= 0) {
+                    // A group with a free slot ends every probe sequence that reaches it, so no key can be stored
+                    // behind it and this slot can become free right away. Otherwise it has to stay in the way as a
+                    // dead slot.
+                    tMapSlot const* group = map.Slots + index / map_group_len * map_group_len;
+                    if(MapGroupMatch(group, tMapSlot::kFree)) {
+                        map.Slots[index].State = tMapSlot::kFree;
+                    } else {
+                        map.Slots[index].State = tMapSlot::kDead;
+                        ++map.dead_count;
+                    }
+                    DestructItems(map.Keys + index, 1);
+                    DestructItems(map.Values + index, 1);
+                    --map.count;
+                    result = true;
+                }
+            }
 
-    MTB_NODISCARD constexpr tTimespan& operator+=(tTimespan& a, tTimespan b) {
-        a.nanoseconds += b.nanoseconds;
-        return a;
-    }
+            return result;
+        }
 
-    //
-    // (timespan) - timespan
-    //
-    MTB_NODISCARD constexpr tTimespan operator-(tTimespan a) {
-        return {-a.nanoseconds};
-    }
+        template<typename tMapType>
+        void MapClearAllocation(tMapType& map) {
+            using K = ::mtb::tDecay<decltype(*map.Keys)>;
+            using V = ::mtb::tDecay<decltype(*map.Values)>;
+            for(ptrdiff_t index = 0; index < map.cap; ++index) {
+                if(map.Slots[index].IsOccupied()) {
+                    DestructItems(map.Keys + index, 1);
+                    DestructItems(map.Values + index, 1);
+                }
+            }
 
-    MTB_NODISCARD constexpr tTimespan operator-(tTimespan a, tTimespan b) {
-        return {a.nanoseconds - b.nanoseconds};
-    }
+            if(map.Slots) {
+                size_t const PayloadSize = sizeof(tMapSlot) + sizeof(K) + sizeof(V);
+                map.allocator.FreeRaw(PtrSlice((void*)map.Slots, map.cap * PayloadSize), InternalMapAlignment<K, V>());
+            }
 
-    MTB_NODISCARD constexpr tTimespan& operator-=(tTimespan& a, tTimespan b) {
-        a.nanoseconds -= b.nanoseconds;
-        return a;
-    }
+            map.count = 0;
+            map.dead_count = 0;
+            map.cap = 0;
+            map.Slots = nullptr;
+            map.Keys = nullptr;
+            map.Values = nullptr;
+        }
+    }  // namespace impl
+}  // namespace mtb
 
-    //
-    // timespan comparison
-    //
-    MTB_NODISCARD constexpr bool operator==(tTimespan a, tTimespan b) {
-        return a.nanoseconds == b.nanoseconds;
-    }
+template<typename tMapType, typename K, typename V>
+void mtb::InternalMapPut(tMapType& map, K const& Key, V const& value) {
+    MTB_ASSERT(map.cap > 0);
 
-    MTB_NODISCARD constexpr bool operator!=(tTimespan a, tTimespan b) {
-        return a.nanoseconds != b.nanoseconds;
+    uint64_t hash = impl::MapHashKey(map, Key);
+    ptrdiff_t index = impl::MapFindIndex(map, Key, hash);
+    if(index >= 0) {
+        CopyAssignItems(map.Values + index, 1, &value, 1);
+        return;
     }
 
-    MTB_NODISCARD constexpr bool operator<(tTimespan a, tTimespan b) {
-        return a.nanoseconds < b.nanoseconds;
-    }
+    index = impl::MapFindAvailableIndex(map, hash);
+    MTB_ASSERT(index >= 0);
+    map.Slots[index].State = impl::MapSlotState(hash);
+    CopyConstructItems(map.Keys + index, 1, &Key, 1);
+    CopyConstructItems(map.Values + index, 1, &value, 1);
+    ++map.count;
+}
 
-    MTB_NODISCARD constexpr bool operator<=(tTimespan a, tTimespan b) {
-        return a.nanoseconds <= b.nanoseconds;
+template<typename K, typename V>
+constexpr size_t mtb::InternalMapAlignment() {
+    return MTB_alignof(V) > MTB_alignof(K) ? MTB_alignof(V) : MTB_alignof(K);
+}
+
+template<typename tMapType>
+void mtb::InternalEnsureAdditionalCapacity(tMapType& map, ptrdiff_t additional_len) {
+    using K = ::mtb::tDecay<decltype(*map.Keys)>;
+    using V = ::mtb::tDecay<decltype(*map.Values)>;
+    MTB_ASSERT(map.allocator);
+
+    // Group probing stays short up to a load of 7/8. Dead slots lengthen probe sequences just like live ones.
+    ptrdiff_t threshold = map.cap - map.cap / 8;
+    if(map.count + map.dead_count + additional_len <= threshold) {
+        // We got enough space.
+        return;
     }
 
-    MTB_NODISCARD constexpr bool operator>(tTimespan a, tTimespan b) {
-        return a.nanoseconds > b.nanoseconds;
+    if(map.count + additional_len <= threshold / 2) {
+        // Mostly dead slots. Clean them up instead of growing.
+        InternalMapDropDeadSlots(map);
+        return;
     }
 
-    MTB_NODISCARD constexpr bool operator>=(tTimespan a, tTimespan b) {
-        return a.nanoseconds >= b.nanoseconds;
+    ptrdiff_t NewCapacity = map.cap == 0 ? 64 : map.cap << 1;
+    size_t const alignment = InternalMapAlignment<K, V>();
+    size_t const PayloadSize = sizeof(tMapSlot) + sizeof(K) + sizeof(V);
+    tSlice<void> new_alloc = map.allocator.AllocRaw(NewCapacity * PayloadSize, alignment, kClearToZero);
+
+    // Copies the allocator and, for tMap, the hash and compare functions.
+    tMapType new_map = map;
+    new_map.count = 0;
+    new_map.dead_count = 0;
+    new_map.cap = NewCapacity;
+    new_map.Slots = (tMapSlot*)new_alloc.ptr;
+    new_map.Keys = (K*)(new_map.Slots + NewCapacity);
+    new_map.Values = (V*)(new_map.Keys + NewCapacity);
+
+    // Keys are unique, so each one goes to the first free slot of its probe sequence and is moved, not copied.
+    for(ptrdiff_t index = 0; index < map.cap; ++index) {
+        if(map.Slots[index].IsOccupied()) {
+            uint64_t hash = impl::MapHashKey(new_map, map.Keys[index]);
+            ptrdiff_t new_index = impl::MapFindAvailableIndex(new_map, hash);
+            new_map.Slots[new_index].State = impl::MapSlotState(hash);
+            RelocateItems(new_map.Keys + new_index, 1, map.Keys + index, 1);
+            RelocateItems(new_map.Values + new_index, 1, map.Values + index, 1);
+            ++new_map.count;
+        }
     }
 
-    struct tClockTime {
-        bool negative;
-        uint32_t days;
-        uint32_t hours;
-        uint32_t minutes;
-        uint32_t seconds;
-        uint32_t milliseconds;
-        uint32_t microseconds;
-        uint32_t nanoseconds;
-    };
-
-    MTB_NODISCARD tClockTime ClockTimeFromTimespan(tTimespan span);
-}  // namespace mtb::time
-
-#endif  // !defined(MTB_INCLUDED)
+    tSlice<void> OldAllocation = PtrSlice((void*)map.Slots, map.cap * PayloadSize);
+    map.allocator.FreeRaw(OldAllocation, alignment);
 
-// --------------------------------------------------
-// -- #Section Implementation -----------------------
-// --------------------------------------------------
-#if defined(MTB_IMPLEMENTATION)
+    map = new_map;
+}
 
-void mtb::CopyBytes(void* dest, void const* src, size_t size) {
-#if MTB_USE_LIBC
-    ::memcpy(dest, src, size);
-#else
-    uint8_t* dst = (uint8_t*)dest;
-    uint8_t const* src = (uint8_t const*)src;
-    for(size_t index = 0; index < size; ++index) {
-        dst[index] = src[index];
+template<typename tMapType>
+void mtb::InternalMapDropDeadSlots(tMapType& map) {
+    // Mark the keys that still need to be placed as dead and everything else as free.
+    for(ptrdiff_t index = 0; index < map.cap; ++index) {
+        map.Slots[index].State = map.Slots[index].IsOccupied() ? tMapSlot::kDead : tMapSlot::kFree;
     }
-#endif  // MTB_USE_LIBC
-}
 
-void mtb::MoveBytes(void* dest, void const* src, size_t size) {
-#if MTB_USE_LIBC
-    ::memmove(dest, src, size);
-#else
-    uint8_t* dst = (uint8_t*)dest;
-    uint8_t const* src = (uint8_t const*)src;
-    if(dst < src) {
-        // copy forward
-        for(size_t index = 0; index < size; ++index) {
-            dst[index] = src[index];
+    for(ptrdiff_t index = 0; index < map.cap; ++index) {
+        if(map.Slots[index].State != tMapSlot::kDead) {
+            continue;
         }
-    } else {
-        // copy reverse
-        for(size_t rIndex = size; rIndex > 0; --rIndex) {
-            size_t index = rIndex - 1;
-            dst[index] = src[index];
+
+        // All groups before the target are full of placed keys.
+        uint64_t hash = impl::MapHashKey(map, map.Keys[index]);
+        ptrdiff_t target = impl::MapFindAvailableIndex(map, hash);
+        if(target / impl::map_group_len == index / impl::map_group_len) {
+            // Already in the right group.
+            map.Slots[index].State = impl::MapSlotState(hash);
+        } else if(map.Slots[target].State == tMapSlot::kFree) {
+            RelocateItems(map.Keys + target, 1, map.Keys + index, 1);
+            RelocateItems(map.Values + target, 1, map.Values + index, 1);
+            map.Slots[target].State = impl::MapSlotState(hash);
+            map.Slots[index].State = tMapSlot::kFree;
+        } else {
+            // The target holds a key that was not placed yet. Swap and place that one next.
+            Swap(map.Keys[index], map.Keys[target]);
+            Swap(map.Values[index], map.Values[target]);
+            map.Slots[target].State = impl::MapSlotState(hash);
+            --index;
         }
     }
-#endif  // MTB_USE_LIBC
+
+    map.dead_count = 0;
 }
 
-void mtb::SetBytes(void* dest, int byte_value, size_t size) {
-#if MTB_USE_LIBC
-    ::memset(dest, byte_value, size);
-#else
-    uint8_t* dst = (uint8_t*)dest;
-    uint8_t byte_value_u8 = (uint8_t)byte_value;
-    for(size_t index = 0; index < size; index++) {
-        dst[index] = byte_value_u8;
-    }
-#endif
+template<typename K, typename V>
+mtb::tMapIterator_KeyOrValue<K> mtb::IterKeys(tMap<K, V>& map) {
+    tMapIterator_KeyOrValue<K> result;
+    result.cap = map.cap;
+    result.Slots = map.Slots;
+    result.Items = map.Keys;
+    return result;
 }
 
-int mtb::CompareBytes(void const* a, void const* b, size_t size) {
-#if MTB_USE_LIBC
-    return ::memcmp(a, b, size);
-#else
-    uint8_t* byte_a = (uint8_t*)a;
-    uint8_t* byte_b = (uint8_t*)b;
-    for(size_t index = 0; index < size; ++index) {
-        if(byte_a[index] != byte_b[index]) {
-            return byte_a[index] - byte_b[index];
-        }
-    }
-    return 0;
-#endif
+template<typename K, typename V>
+mtb::tMapIterator_KeyOrValue<V> mtb::IterValues(tMap<K, V>& map) {
+    tMapIterator_KeyOrValue<V> result;
+    result.cap = map.cap;
+    result.Slots = map.Slots;
+    result.Items = map.Values;
+    return result;
 }
 
-int mtb::SliceCompareBytes(tSlice<void const> a, tSlice<void const> b) {
-    int result = (int)(a.len - b.len);
-    if(result == 0) {
-        result = MTB_memcmp(a.ptr, b.ptr, a.len);
-    }
+template<typename K, typename V>
+mtb::tMap<K, V> mtb::CreateMap(tAllocator allocator, tMapHashFunc hash_func, tMapCompareFunc cmp_func) {
+    MTB_ASSERT(allocator);
+    MTB_ASSERT(hash_func);
+    MTB_ASSERT(cmp_func);
+    tMap<K, V> result{allocator, hash_func, cmp_func};
     return result;
 }
 
-bool mtb::SliceBytesAreEqual(tSlice<void const> a, tSlice<void const> b) {
-    return SliceCompareBytes(a, b) == 0;
+template<typename K, typename V>
+void mtb::Put(tMap<K, V>& map, K const& Key, V const& value) {
+    InternalEnsureAdditionalCapacity(map, 1);
+    InternalMapPut(map, Key, value);
 }
 
-void mtb::AlignAllocation(void** inout_ptr, size_t* inout_size, size_t alignment) {
-    MTB_ASSERT(inout_ptr != nullptr);
-    MTB_ASSERT(*inout_ptr != nullptr);
-    MTB_ASSERT(alignment > 0);
+template<typename K, typename V>
+V* mtb::Find(tMap<K, V>& map, K const& Key) {
+    return impl::MapFind(map, Key);
+}
 
-    auto unaligned = (uintptr_t)*inout_ptr;
+template<typename K, typename V>
+V& mtb::FindChecked(tMap<K, V>& map, K const& Key) {
+    V* value = Find(map, Key);
+    MTB_ASSERT(value);
+    return *value;
+}
 
-    /* Example
-        unaligned =      0b1010'1010 // input pointer
-        alignment = 16 = 0b0001'0000
+template<typename K, typename V>
+bool mtb::Remove(tMap<K, V>& map, K const& Key) {
+    return impl::MapRemove(map, Key);
+}
 
-        a = 0b0000'1111
-        ~a = 0b1111'0000
+template<typename K, typename V>
+void mtb::ClearAllocation(tMap<K, V>& map) {
+    impl::MapClearAllocation(map);
+}
 
-        unaligned + a = 0b1011'1001
-        (unaligned + a) & ~a = 0b1011'0000 // i.e. the last four bits are cleared.
-    */
-    size_t a = alignment - 1;
-    uintptr_t aligned = (unaligned + a) & ~a;
-    uintptr_t delta = aligned - unaligned;
-    *(uint8_t**)inout_ptr += delta;
-    if(inout_size) {
-        *inout_size += delta;
-    }
+template<typename K, typename V, typename tHash, typename tEqual>
+mtb::tMapIterator_KeyOrValue<K> mtb::IterKeys(tPolicyMap<K, V, tHash, tEqual>& map) {
+    tMapIterator_KeyOrValue<K> result;
+    result.cap = map.cap;
+    result.Slots = map.Slots;
+    result.Items = map.Keys;
+    return result;
 }
 
-// IMPL
-namespace mtb::impl {
-    size_t ChooseAlignment(size_t alignment) {
-        return alignment ? alignment : MTB_ALLOCATOR_DEFAULT_ALIGNMENT;
-    }
-}  // namespace mtb::impl
+template<typename K, typename V, typename tHash, typename tEqual>
+mtb::tMapIterator_KeyOrValue<V> mtb::IterValues(tPolicyMap<K, V, tHash, tEqual>& map) {
+    tMapIterator_KeyOrValue<V> result;
+    result.cap = map.cap;
+    result.Slots = map.Slots;
+    result.Items = map.Values;
+    return result;
+}
 
-mtb::tSlice<void> mtb::tAllocator::AllocRaw(size_t size, size_t alignment, eInit init) const {
-    MTB_ASSERT(IsValid());
-    size_t chosen_alignment = impl::ChooseAlignment(alignment);
-    tSlice<void> result = realloc_proc(user, {}, chosen_alignment, size, chosen_alignment, init);
+template<typename K, typename V, typename tHash, typename tEqual>
+mtb::tPolicyMap<K, V, tHash, tEqual> mtb::CreatePolicyMap(tAllocator allocator) {
+    MTB_ASSERT(allocator);
+    tPolicyMap<K, V, tHash, tEqual> result{allocator};
     return result;
 }
 
-mtb::tSlice<void> mtb::tAllocator::ReallocRaw(tSlice<void> old_mem, size_t old_alignment, size_t new_size, size_t new_alignment, eInit init) const {
-    MTB_ASSERT(IsValid());
-    return realloc_proc(user, old_mem, impl::ChooseAlignment(old_alignment), new_size, impl::ChooseAlignment(new_alignment), init);
+template<typename K, typename V, typename tHash, typename tEqual>
+void mtb::Put(tPolicyMap<K, V, tHash, tEqual>& map, K const& Key, V const& value) {
+    InternalEnsureAdditionalCapacity(map, 1);
+    InternalMapPut(map, Key, value);
 }
 
-mtb::tSlice<void> mtb::tAllocator::DupeRaw(tSlice<void> mem, size_t alignment) const {
-    MTB_ASSERT(IsValid());
-    size_t chosen_alignment = impl::ChooseAlignment(alignment);
-    tSlice<void> result = realloc_proc(user, mem, chosen_alignment, mem.len, chosen_alignment, kNoInit);
-    MTB_ASSERT(result.len == mem.len);
-    MTB_memcpy(result.ptr, mem.ptr, mem.len);
-    return result;
+template<typename K, typename V, typename tHash, typename tEqual>
+V* mtb::Find(tPolicyMap<K, V, tHash, tEqual>& map, K const& Key) {
+    return impl::MapFind(map, Key);
 }
 
-void mtb::tAllocator::FreeRaw(tSlice<void> mem, size_t alignment) const {
-    MTB_ASSERT(IsValid());
-    size_t chosen_alignment = impl::ChooseAlignment(alignment);
-    realloc_proc(user, mem, chosen_alignment, 0, chosen_alignment, kNoInit);
+template<typename K, typename V, typename tHash, typename tEqual>
+V& mtb::FindChecked(tPolicyMap<K, V, tHash, tEqual>& map, K const& Key) {
+    V* value = Find(map, Key);
+    MTB_ASSERT(value);
+    return *value;
 }
 
-#if MTB_USE_LIBC
-namespace mtb::impl {
-    // ReSharper disable once CppParameterMayBeConstPtrOrRef
-    tSlice<void> LibcReallocProc(void* user, tSlice<void> old_mem, size_t old_alignment, size_t new_size, size_t new_alignment, eInit init) {
-        (void)user;
-        MTB_ASSERT((!old_mem || old_alignment >= new_alignment) && "Changing alignment is not supported on realloc (yet?)");
+template<typename K, typename V, typename tHash, typename tEqual>
+bool mtb::Remove(tPolicyMap<K, V, tHash, tEqual>& map, K const& Key) {
+    return impl::MapRemove(map, Key);
+}
 
-        tSlice<void> result{};
-        if(old_mem || new_size) {
-            void* new_ptr = ::realloc(old_mem.ptr, new_size);
-            if(new_ptr) {
-                result = PtrSlice(new_ptr, new_size);
-                void* AlignedPtr = result.ptr;
-                size_t AlignedSize = result.len;
-                AlignAllocation(&AlignedPtr, &AlignedSize, new_alignment);
-                MTB_ASSERT(AlignedSize == new_size && "Unsupported alignment");
+template<typename K, typename V, typename tHash, typename tEqual>
+void mtb::ClearAllocation(tPolicyMap<K, V, tHash, tEqual>& map) {
+    impl::MapClearAllocation(map);
+}
+// --------------------------------------------------
+// -- #Section Delegate -----------------------------
+// --------------------------------------------------
 
-                if(init == kClearToZero && old_mem.len < result.len) {
-                    SliceSetZero(SliceOffset(result, old_mem.len));
-                }
-            } else {
-                MTB_ASSERT((old_mem.ptr == nullptr || new_size == 0) && "realloc failed to resize an existing allocation?!");
-            }
+// #NOTE: Disabled for now because I'm not 100% sure what kind of behavior
+//  this particular implementation exhibits and I don't have proper use/test
+//  cases at hand.
+#if 0
+namespace mtb {
+    template<typename>
+    struct tDelegate;
+
+    template<typename R, typename... tArgs>
+    struct tDelegate<R(tArgs...)> {
+        using tDispatchSignature = R(void*, tArgs&&...);
+        using tDelegateSignature = R(tArgs&&...);
+
+        void* DispatchTarget{};
+        tDispatchSignature* DispatchProc{};
+
+        template<typename tTargetSignature>
+        static R Dispatcher(void* DispatchTarget, tArgs&&... args) {
+            return (*(tTargetSignature*)DispatchTarget)(ForwardCast<tArgs>(args)...);
         }
 
-        return result;
-    }
-}  // namespace mtb::impl
+        tDelegate() = default;
+        tDelegate(tDelegate const&) = default;
+        tDelegate(tDelegate&&) = default;
+        tDelegate& operator=(tDelegate const&) = default;
+        tDelegate& operator=(tDelegate&&) = default;
+        ~tDelegate() = default;
 
-mtb::tAllocator mtb::GetLibcAllocator() {
-    tAllocator result{};
-    result.realloc_proc = impl::LibcReallocProc;
-    return result;
-}
-#endif
+        explicit tDelegate(tDelegateSignature* PlainProcPtr)
+            : DispatchTarget{PlainProcPtr}
+            , DispatchProc{Dispatcher<tDelegateSignature>} {
+            MTB_ASSERT(PlainProcPtr);
+        }
 
-namespace mtb::impl {
-    tSlice<void> BufferAllocatorReallocProc(
-        void* user,
-        tSlice<void> old_mem,
-        size_t old_alignment,
-        size_t new_size,
-        size_t new_alignment,
-        eInit init
-    ) {
-        (void)old_alignment;
-        tSlice<void> result{};
-        if(old_mem || new_size) {
-            MTB_ASSERT(user);
-            tBufferAllocator& allocator = *(tBufferAllocator*)user;
-            if(old_mem && old_mem.ptr == PtrOffset(allocator.buf.ptr, allocator.fill - old_mem.len)) {
-                // Resize is requested and old_mem is the most recent allocation.
-                void* aligned_ptr = old_mem.ptr;
-                size_t required_usize = new_size;
-                AlignAllocation(&aligned_ptr, &required_usize, new_alignment);
-                auto required_size = IntCast<ptrdiff_t>(required_usize);
-                if(required_size > old_mem.len) {
-                    // Grow existing allocation if possible
-                    ptrdiff_t delta = required_size - old_mem.len;
-                    if(allocator.fill + delta <= allocator.buf.len) {
-                        result = PtrSlice(aligned_ptr, new_size);
-                        allocator.fill += delta;
-                        if(init == kClearToZero) {
-                            SliceSetZero(SliceOffset(result, old_mem.len));
-                        }
-                    }
-                } else {
-                    // Shrink existing allocation
-                    result = PtrSlice(aligned_ptr, new_size);
-                    allocator.fill -= old_mem.len - required_size;
-                }
-            } else {
-                // Try to allocate a new slice.
-                void* aligned_ptr = PtrOffset(allocator.buf.ptr, allocator.fill);
-                size_t required_usize = new_size;
-                AlignAllocation(&aligned_ptr, &required_usize, new_alignment);
-                auto required_size = IntCast<ptrdiff_t>(required_usize);
-                if(allocator.fill + required_size <= allocator.buf.len) {
-                    result = PtrSlice(aligned_ptr, new_size);
-                    allocator.fill += required_size;
-                    if(init == kClearToZero) {
-                        SliceSetZero(result);
-                    }
-                }
-            }
+        template<typename T>
+        explicit tDelegate(T&& CallableTarget)
+            : DispatchTarget{&CallableTarget}
+            , DispatchProc{Dispatcher<tDecay<T>>} {
         }
-        return result;
-    }
-}  // namespace mtb::impl
 
-mtb::tAllocator mtb::tBufferAllocator::Allocator() {
-    tAllocator result;
-    result.user = this;
-    result.realloc_proc = mtb::impl::BufferAllocatorReallocProc;
-    return result;
-}
+        R operator()(tArgs&&... args) {
+            MTB_ASSERT(DispatchProc && DispatchTarget);
+            return DispatchProc(DispatchTarget, ForwardCast<tArgs>(args)...);
+        }
 
-#if MTB_USE_STB_SPRINTF
-namespace mtb::impl {
-    char* InternalPrintfCallback(char const* buf, void* user, int len) {
-        PushMany(*(tArray<char>*)user, PtrSlice(buf, len));
-        return const_cast<char*>(buf);
+        MTB_NODISCARD constexpr explicit operator bool() const {
+            return !!DispatchTarget && !!DispatchProc;
+        }
+    };
+}  // namespace mtb
+#endif
+
+// --------------------------------------------------
+// -- #Section Sorting ------------------------------
+// --------------------------------------------------
+
+// #Option Slices with fewer items than this are sorted sequentially by ParallelSortSlice.
+#if !defined(MTB_PARALLEL_SORT_GRAIN_SIZE)
+#define MTB_PARALLEL_SORT_GRAIN_SIZE 16384
+#endif
+
+namespace mtb {
+    // Quick sort sorting algorithm. This procedure does not require to know the actual data. It relies on the fact that
+    // less_proc and swap_proc are able to produce the desired information/effect required for effectively sorting
+    // something. This implementation works on all data structures that work using indices. In other words, you can sort
+    // data in linked lists if you can index each node, or sort a discontiguous (chunked) array.
+    //
+    // \remark This sort is not stable.
+    //
+    // \param user_ptr will be passed through to \a less_proc and \a swap_proc as-is. Can be null.
+    // \param count The number of items to sort. In other words, this is the first invalid index into whatever is being sorted.
+    // \param less_proc Whether element at the first index is considered less than the element at the second index.
+    // \param threshold Partitions with a count equal to or less than this value will be sorted with insertion sort.
+    void QuickSort(void* user_ptr, ptrdiff_t count, bool (*less_proc)(void*, ptrdiff_t, ptrdiff_t), void (*swap_proc)(void*, ptrdiff_t, ptrdiff_t), ptrdiff_t threshold);
+
+    template<typename T, typename tLessProc, typename tSwapProc>
+    void QuickSortSlice(tSlice<T> slice, tLessProc less_proc, tSwapProc swap_proc, ptrdiff_t threshold = 16) {
+        struct tContext {
+            T* ptr;
+            tLessProc Less;
+            tSwapProc Swap;
+        } Context{slice.ptr, less_proc, swap_proc};
+
+        QuickSort(
+            &Context,
+            slice.len,
+            [](void* C, ptrdiff_t I, ptrdiff_t J) {
+                tContext* Context = (tContext*)C;
+                return Context->Less(Context->ptr[I], Context->ptr[J]);
+            },
+            [](void* C, ptrdiff_t I, ptrdiff_t J) {
+                tContext* Context = (tContext*)C;
+                Context->Swap(Context->ptr[I], Context->ptr[J]);
+            },
+            threshold
+        );
     }
-}  // namespace mtb::impl
 
-mtb::tSlice<char> mtb::vprintfAlloc(tAllocator a, char const* format, va_list vargs) {
-    tArray<char> buffer{
-        .allocator = a,
+    /// Default comparison for the templated sorting procedures.
+    struct tLess {
+        template<typename T, typename U>
+        MTB_NODISCARD constexpr bool operator()(T const& a, U const& b) const {
+            return a < b;
+        }
     };
-    char temp_buffer[STB_SPRINTF_MIN];
-    stbsp_vsprintfcb(impl::InternalPrintfCallback, &buffer, temp_buffer, format, vargs);
-    PushOne<char>(buffer, kNoInit) = 0;
-    tSlice<char> result = ShrinkAllocation(buffer);
-    if(result.len > 0) {
-        result.len -= 1;
+
+    /// Sort the slice in place with pattern-defeating quicksort: introsort with a heapsort fallback for bad pivots,
+    /// branchless block partitioning for PODs, and early exits for already sorted or reversed input.
+    /// The comparison is fully inlined.
+    ///
+    /// \remark This sort is not stable.
+    template<typename T, typename tLessProc = tLess>
+    void SortSlice(tSlice<T> slice, tLessProc less = {});
+
+    /// Sort up to 64 keys with an AVX2 bitonic sorting network, padded to the next power of two. Supports int32_t,
+    /// uint32_t, float, int64_t, uint64_t and double with MTB_USE_AVX2. Without it, and for other key types, short
+    /// slices are insertion sorted; slices longer than 64 are sorted with SortSlice. SortSlice uses the networks as
+    /// its leaf case when sorting integer keys with tLess.
+    ///
+    /// \remark NaN keys are moved to the end in unspecified order.
+    template<typename K>
+    void SortSmall(tSlice<K> keys);
+
+    /// \deprecated Use SortSlice. \a threshold is ignored.
+    template<typename T, typename tLessProc>
+    void QuickSortSlice(tSlice<T> slice, tLessProc less_proc, ptrdiff_t threshold = 16) {
+        (void)threshold;
+        SortSlice(slice, less_proc);
     }
-    return result;
-}
 
-mtb::tSlice<char> mtb::PushFormat(tArray<char>& array, char const* format, ...) {
-    va_list vargs;
-    va_start(vargs, format);
-    tSlice<char> result = PushFormatV(array, format, vargs);
-    va_end(vargs);
-    return result;
-}
+    /// \deprecated Use SortSlice. \a threshold is ignored.
+    template<typename T>
+    void QuickSortSlice(tSlice<T> slice, ptrdiff_t threshold = 16) {
+        (void)threshold;
+        SortSlice(slice);
+    }
 
-mtb::tSlice<char> mtb::PushFormatV(tArray<char>& array, char const* format, va_list vargs) {
-    ptrdiff_t offset = array.len;
-    char temp_buffer[STB_SPRINTF_MIN];
-    stbsp_vsprintfcb(impl::InternalPrintfCallback, &array, temp_buffer, format, vargs);
-    return SliceOffset(array.items, offset);
-}
-#endif  // MTB_USE_STB_SPRINTF
+    /// Sort integer or floating point keys in ascending order with an LSD radix sort, one pass per byte of the key.
+    /// Passes in which all keys share the same byte are skipped. Scratch memory for one copy of \a keys is taken from
+    /// \a allocator, use MakeAllocator to take it from a tArena. Returns false if that allocation failed, in which
+    /// case \a keys is left unchanged.
+    ///
+    /// \remark Floats are ordered by their bits: -0 comes before +0, NaNs end up at either end depending on their sign.
+    template<typename K>
+    bool RadixSort(tSlice<K> keys, tAllocator allocator);
 
-mtb::tSlice<char> mtb::ToString(tArray<char>& array, bool null_terminate /*= true*/) {
-    ptrdiff_t end_offset = 0;
-    if(null_terminate) {
-        Push(array, '\0');
-        end_offset = 1;
+    /// Sort \a keys like RadixSort and apply the same permutation to \a values. Both slices must have the same length.
+    template<typename K, typename V>
+    bool RadixSortPairs(tSlice<K> keys, tSlice<V> values, tAllocator allocator);
+
+    /// Stable radix sort of \a items by the integer or floating point key returned by key_proc(item), which is called
+    /// once per item and pass. T must be trivially relocatable.
+    template<typename T, typename tKeyProc>
+    bool RadixSortByKey(tSlice<T> items, tAllocator allocator, tKeyProc key_proc);
+
+    /// Stable adaptive merge sort in the style of timsort: natural runs are detected (descending ones are reversed),
+    /// short runs are extended with binary insertion sort, and merges switch to galloping when one side keeps winning.
+    /// Scratch memory for up to half of \a slice is taken from \a allocator. If that allocation fails, or T is not
+    /// trivially relocatable, this falls back to StableSortSliceInPlace.
+    template<typename T, typename tLessProc = tLess>
+    void StableSortSlice(tSlice<T> slice, tAllocator allocator, tLessProc less = {});
+
+    /// Stable merge sort that needs no extra memory, at the cost of O(n log^2 n) moves. Merges are done with rotations
+    /// (SymMerge), and skipped for neighboring blocks that are already in order.
+    template<typename T, typename tLessProc = tLess>
+    void StableSortSliceInPlace(tSlice<T> slice, tLessProc less = {});
+
+    /// Reorder the slice so that slice[nth] is the item that would be there if the slice was sorted, no item before it
+    /// is greater, and no item after it is less. Introselect: quickselect with median-of-3 or ninther pivots that
+    /// falls back to heap selection after too many unbalanced partitions, so this is O(n) on average and
+    /// O(n log n) at worst.
+    template<typename T, typename tLessProc = tLess>
+    void SliceNthElement(tSlice<T> slice, ptrdiff_t nth, tLessProc less = {});
+
+    /// Sort the \a count smallest items into the front of the slice. The order of the remaining items is unspecified.
+    template<typename T, typename tLessProc = tLess>
+    void SlicePartialSort(tSlice<T> slice, ptrdiff_t count, tLessProc less = {});
+
+    /// Index of the first item in the sorted \a slice that is not less than \a key, or slice.len if there is none.
+    /// The search is branchless and prefetches both candidates of the next step.
+    template<typename T, typename K, typename tLessProc = tLess>
+    MTB_NODISCARD ptrdiff_t SliceLowerBound(tSlice<T> slice, K const& key, tLessProc less = {});
+
+    /// Index of the first item in the sorted \a slice that is greater than \a key, or slice.len if there is none.
+    template<typename T, typename K, typename tLessProc = tLess>
+    MTB_NODISCARD ptrdiff_t SliceUpperBound(tSlice<T> slice, K const& key, tLessProc less = {});
+
+    /// All items in the sorted \a slice that are equal to \a key. Empty, pointing to where \a key would go, if none are.
+    template<typename T, typename K, typename tLessProc = tLess>
+    MTB_NODISCARD tSlice<T> SliceEqualRange(tSlice<T> slice, K const& key, tLessProc less = {});
+
+    //
+    // Set operations on sorted slices without duplicates. Results are appended to \a out and returned.
+    // Lists that differ a lot in size are processed by galloping through the longer one. With MTB_USE_SSSE3,
+    // intersection and difference of 32-bit integer keys compare blocks of four items per side with SSE.
+    //
+
+    template<typename T, typename A, typename B, typename tLessProc = tLess>
+    tSlice<T> SliceIntersectSorted(tArray<T>& out, tSlice<A> a, tSlice<B> b, tLessProc less = {});
+
+    template<typename T, typename A, typename B, typename tLessProc = tLess>
+    tSlice<T> SliceUnionSorted(tArray<T>& out, tSlice<A> a, tSlice<B> b, tLessProc less = {});
+
+    /// Items of \a a that are not in \a b.
+    template<typename T, typename A, typename B, typename tLessProc = tLess>
+    tSlice<T> SliceDifferenceSorted(tArray<T>& out, tSlice<A> a, tSlice<B> b, tLessProc less = {});
+
+    /// Items that are in all \a lists, which is a slice of slices. Starts with the shortest list and narrows the result
+    /// down with the others in ascending order of length.
+    template<typename T, typename L, typename tLessProc = tLess>
+    tSlice<T> SliceIntersectSortedMany(tArray<T>& out, tSlice<L> lists, tLessProc less = {});
+
+    /// Items that are in any of \a lists, which is a slice of slices. K-way merge with a heap of list cursors.
+    template<typename T, typename L, typename tLessProc = tLess>
+    tSlice<T> SliceUnionSortedMany(tArray<T>& out, tSlice<L> lists, tLessProc less = {});
+
+    /// Remove duplicates from \a slice, keeping the first occurrence of every item in its original order. Seen items
+    /// are tracked in an open-addressing table of indices allocated from \a scratch, with hashing and comparison done
+    /// like for tMap keys. Returns the unique prefix of \a slice. The items after it are left moved-from. If the table
+    /// cannot be allocated, \a slice is returned unmodified.
+    template<typename T>
+    MTB_NODISCARD tSlice<T> SliceUnique(tSlice<T> slice, tAllocator scratch, tMapHashFunc hash_func, tMapCompareFunc compare_func);
+
+    /// Remove duplicates by sorting \a slice and compacting runs of equal items. Needs neither memory nor a hash
+    /// function, but the result is sorted instead of in original order.
+    template<typename T, typename tLessProc = tLess>
+    MTB_NODISCARD tSlice<T> SliceSortUnique(tSlice<T> slice, tLessProc less = {});
+
+    /// Hook to run work on the caller's worker pool. mtb does not create threads itself.
+    struct tTaskRunner {
+        void* user;
+
+        /// Must call task_proc(task_context, index) exactly once for every index in [0, task_count), in any order and
+        /// on any thread, and return only after all calls have finished.
+        void (*run_proc)(void* user, ptrdiff_t task_count, void (*task_proc)(void* task_context, ptrdiff_t index), void* task_context);
+
+        /// Number of threads run_proc distributes tasks to. Used to decide how to split the work.
+        ptrdiff_t worker_count;
+
+        MTB_NODISCARD constexpr explicit operator bool() const { return !!run_proc; }
+    };
+
+    /// Run all tasks with \a runner. Without a runner, the tasks are run in order on the calling thread.
+    void RunTasks(tTaskRunner runner, ptrdiff_t task_count, void (*task_proc)(void* task_context, ptrdiff_t index), void* task_context);
+
+    /// Sort the slice with a parallel sample sort: splitters are picked from a sorted sample, the items are
+    /// distributed to buckets in parallel blocks, and each bucket is sorted with SortSlice as a separate task.
+    /// Falls back to SortSlice for slices below MTB_PARALLEL_SORT_GRAIN_SIZE or without a multi-threaded \a runner.
+    ///
+    /// Scratch memory for one copy of \a slice is taken from \a allocator. Returns false if that allocation failed, in
+    /// which case \a slice is left unchanged. T must be trivially relocatable.
+    ///
+    /// \remark This sort is not stable.
+    template<typename T, typename tLessProc = tLess>
+    bool ParallelSortSlice(tSlice<T> slice, tTaskRunner runner, tAllocator allocator, tLessProc less = {});
+}  // namespace mtb
+
+namespace mtb::impl {
+    constexpr ptrdiff_t sort_network_max_len = 64;
+
+    // clang-format off
+    template<typename K> struct tSortNetworkKey           { static constexpr bool supported = false; static constexpr bool leaf = false; };
+    // clang-format on
+
+#if MTB_USE_AVX2
+    // Floating point keys stay out of the SortSlice leaf: min/max lanes don't order NaNs the way tLess does.
+    // clang-format off
+    template<>           struct tSortNetworkKey<int32_t>  { static constexpr bool supported = true; static constexpr bool leaf = true; static constexpr int32_t pad = INT32_MAX; };
+    template<>           struct tSortNetworkKey<uint32_t> { static constexpr bool supported = true; static constexpr bool leaf = true; static constexpr uint32_t pad = UINT32_MAX; };
+    template<>           struct tSortNetworkKey<int64_t>  { static constexpr bool supported = true; static constexpr bool leaf = true; static constexpr int64_t pad = INT64_MAX; };
+    template<>           struct tSortNetworkKey<uint64_t> { static constexpr bool supported = true; static constexpr bool leaf = true; static constexpr uint64_t pad = UINT64_MAX; };
+    template<>           struct tSortNetworkKey<float>    { static constexpr bool supported = true; static constexpr bool leaf = false; static constexpr float pad = HUGE_VALF; };
+    template<>           struct tSortNetworkKey<double>   { static constexpr bool supported = true; static constexpr bool leaf = false; static constexpr double pad = HUGE_VAL; };
+    // clang-format on
+
+    // Lane i of the result is lane (i ^ xor_mask) of the input. Only called with constants, so the switches fold.
+    MTB_NODISCARD inline __m256i Avx2PermuteIndices32(int xor_mask) {
+        return _mm256_xor_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(xor_mask));
     }
-    ShrinkAllocation(array);
-    return SliceRange(array.items, 0, array.len - end_offset);
-}
 
-void mtb::QuickSort(void* user_ptr, ptrdiff_t count, bool (*less_proc)(void*, ptrdiff_t, ptrdiff_t), void (*swap_proc)(void*, ptrdiff_t, ptrdiff_t), ptrdiff_t threshold) {
-    // Based on https://github.com/svpv/qsort
-    if(count <= 1) {
-        return;
+    // Takes hi in lanes where (i & bit) is set, lo elsewhere.
+    MTB_NODISCARD inline __m256i Avx2Blend32(__m256i lo, __m256i hi, int bit) {
+        switch(bit) {
+            case 1: return _mm256_blend_epi32(lo, hi, 0xAA);
+            case 2: return _mm256_blend_epi32(lo, hi, 0xCC);
+            default: return _mm256_blend_epi32(lo, hi, 0xF0);
+        }
     }
 
-    ptrdiff_t left = 0;
-    ptrdiff_t right = count - 1;
-    ptrdiff_t stack_pointer = 0;  // the number of frames pushed to the stack
+    MTB_NODISCARD inline __m256i Avx2Permute64(__m256i reg, int xor_mask) {
+        switch(xor_mask) {
+            case 1: return _mm256_permute4x64_epi64(reg, 0xB1);
+            case 2: return _mm256_permute4x64_epi64(reg, 0x4E);
+            default: return _mm256_permute4x64_epi64(reg, 0x1B);
+        }
+    }
 
-    struct
-    {
-        ptrdiff_t left, right;
-    } stack[sizeof(count) > 4 ? 48 : 32];
+    MTB_NODISCARD inline __m256i Avx2Blend64(__m256i lo, __m256i hi, int bit) {
+        switch(bit) {
+            case 1: return _mm256_blend_epi32(lo, hi, 0xCC);
+            default: return _mm256_blend_epi32(lo, hi, 0xF0);
+        }
+    }
 
-    while(true) {
-        if(right - left + 1 >= threshold) {
-            // Partition
-            ptrdiff_t Middle = left + ((right - left) >> 1);
+    template<typename K, bool Is64 = sizeof(K) == 8>
+    struct tAvx2IntLanes {
+        using tReg = __m256i;
+        static constexpr ptrdiff_t lane_count = 8;
 
-            // Sort 3 elements
-            if(less_proc(user_ptr, Middle, left + 1)) {
-                if(less_proc(user_ptr, right, Middle)) {
-                    swap_proc(user_ptr, left + 1, right);
-                } else {
-                    swap_proc(user_ptr, left + 1, Middle);
-                    if(less_proc(user_ptr, right, Middle)) {
-                        swap_proc(user_ptr, Middle, right);
+        MTB_NODISCARD static tReg Load(K const* ptr) { return _mm256_loadu_si256((__m256i const*)ptr); }
+        static void Store(K* ptr, tReg reg) { _mm256_storeu_si256((__m256i*)ptr, reg); }
+        MTB_NODISCARD static tReg Permute(tReg reg, int xor_mask) { return _mm256_permutevar8x32_epi32(reg, Avx2PermuteIndices32(xor_mask)); }
+        MTB_NODISCARD static tReg Blend(tReg lo, tReg hi, int bit) { return Avx2Blend32(lo, hi, bit); }
+        MTB_NODISCARD static tReg Reverse(tReg reg) { return Permute(reg, 7); }
+    };
+
+    struct tAvx2Int32Lanes : tAvx2IntLanes<int32_t> {
+        MTB_NODISCARD static tReg Min(tReg a, tReg b) { return _mm256_min_epi32(a, b); }
+        MTB_NODISCARD static tReg Max(tReg a, tReg b) { return _mm256_max_epi32(a, b); }
+    };
+
+    struct tAvx2Uint32Lanes : tAvx2IntLanes<uint32_t> {
+        MTB_NODISCARD static tReg Min(tReg a, tReg b) { return _mm256_min_epu32(a, b); }
+        MTB_NODISCARD static tReg Max(tReg a, tReg b) { return _mm256_max_epu32(a, b); }
+    };
+
+    template<typename K>
+    struct tAvx2IntLanes<K, true> {
+        using tReg = __m256i;
+        static constexpr ptrdiff_t lane_count = 4;
+
+        MTB_NODISCARD static tReg Load(K const* ptr) { return _mm256_loadu_si256((__m256i const*)ptr); }
+        static void Store(K* ptr, tReg reg) { _mm256_storeu_si256((__m256i*)ptr, reg); }
+        MTB_NODISCARD static tReg Permute(tReg reg, int xor_mask) { return Avx2Permute64(reg, xor_mask); }
+        MTB_NODISCARD static tReg Blend(tReg lo, tReg hi, int bit) { return Avx2Blend64(lo, hi, bit); }
+        MTB_NODISCARD static tReg Reverse(tReg reg) { return Avx2Permute64(reg, 3); }
+    };
+
+    // AVX2 has no 64-bit min/max, so compare and blend. Unsigned keys get their sign bit flipped for the compare.
+    template<typename K>
+    struct tAvx2Int64Lanes : tAvx2IntLanes<K> {
+        using tReg = __m256i;
+        MTB_NODISCARD static tReg Greater(tReg a, tReg b) {
+            if((K)-1 < (K)0) {
+                return _mm256_cmpgt_epi64(a, b);
+            }
+            __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+            return _mm256_cmpgt_epi64(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+        }
+        MTB_NODISCARD static tReg Min(tReg a, tReg b) { return _mm256_blendv_epi8(a, b, Greater(a, b)); }
+        MTB_NODISCARD static tReg Max(tReg a, tReg b) { return _mm256_blendv_epi8(b, a, Greater(a, b)); }
+    };
+
+    struct tAvx2FloatLanes {
+        using tReg = __m256;
+        static constexpr ptrdiff_t lane_count = 8;
+
+        MTB_NODISCARD static tReg Load(float const* ptr) { return _mm256_loadu_ps(ptr); }
+        static void Store(float* ptr, tReg reg) { _mm256_storeu_ps(ptr, reg); }
+        MTB_NODISCARD static tReg Min(tReg a, tReg b) { return _mm256_min_ps(a, b); }
+        MTB_NODISCARD static tReg Max(tReg a, tReg b) { return _mm256_max_ps(a, b); }
+        MTB_NODISCARD static tReg Permute(tReg reg, int xor_mask) { return _mm256_permutevar8x32_ps(reg, Avx2PermuteIndices32(xor_mask)); }
+        MTB_NODISCARD static tReg Blend(tReg lo, tReg hi, int bit) { return _mm256_castsi256_ps(Avx2Blend32(_mm256_castps_si256(lo), _mm256_castps_si256(hi), bit)); }
+        MTB_NODISCARD static tReg Reverse(tReg reg) { return Permute(reg, 7); }
+    };
+
+    struct tAvx2DoubleLanes {
+        using tReg = __m256d;
+        static constexpr ptrdiff_t lane_count = 4;
+
+        MTB_NODISCARD static tReg Load(double const* ptr) { return _mm256_loadu_pd(ptr); }
+        static void Store(double* ptr, tReg reg) { _mm256_storeu_pd(ptr, reg); }
+        MTB_NODISCARD static tReg Min(tReg a, tReg b) { return _mm256_min_pd(a, b); }
+        MTB_NODISCARD static tReg Max(tReg a, tReg b) { return _mm256_max_pd(a, b); }
+        MTB_NODISCARD static tReg Permute(tReg reg, int xor_mask) { return _mm256_castsi256_pd(Avx2Permute64(_mm256_castpd_si256(reg), xor_mask)); }
+        MTB_NODISCARD static tReg Blend(tReg lo, tReg hi, int bit) { return _mm256_castsi256_pd(Avx2Blend64(_mm256_castpd_si256(lo), _mm256_castpd_si256(hi), bit)); }
+        MTB_NODISCARD static tReg Reverse(tReg reg) { return Permute(reg, 3); }
+    };
+
+    // clang-format off
+    template<typename K> struct tSortNetworkLanes;
+    template<>           struct tSortNetworkLanes<int32_t>  { using tType = tAvx2Int32Lanes; };
+    template<>           struct tSortNetworkLanes<uint32_t> { using tType = tAvx2Uint32Lanes; };
+    template<>           struct tSortNetworkLanes<int64_t>  { using tType = tAvx2Int64Lanes<int64_t>; };
+    template<>           struct tSortNetworkLanes<uint64_t> { using tType = tAvx2Int64Lanes<uint64_t>; };
+    template<>           struct tSortNetworkLanes<float>    { using tType = tAvx2FloatLanes; };
+    template<>           struct tSortNetworkLanes<double>   { using tType = tAvx2DoubleLanes; };
+    // clang-format on
+
+    /// Bitonic sort of RegCount * lane_count keys, all ascending: every merge stage starts by comparing each item of
+    /// a block with its mirror image in the other half (flip), followed by half-cleaners of decreasing distance.
+    template<typename tLanes, ptrdiff_t RegCount, typename K>
+    void BitonicSortNetwork(K* keys) {
+        using tReg = typename tLanes::tReg;
+        constexpr ptrdiff_t lane_count = tLanes::lane_count;
+        constexpr ptrdiff_t len = RegCount * lane_count;
+
+        tReg regs[RegCount];
+        for(ptrdiff_t index = 0; index < RegCount; ++index) {
+            regs[index] = tLanes::Load(keys + index * lane_count);
+        }
+
+        for(ptrdiff_t block = 2; block <= len; block *= 2) {
+            if(block <= lane_count) {
+                for(tReg& reg : regs) {
+                    tReg other = tLanes::Permute(reg, (int)(block - 1));
+                    reg = tLanes::Blend(tLanes::Min(reg, other), tLanes::Max(reg, other), (int)(block / 2));
+                }
+            } else {
+                ptrdiff_t reg_mask = block / lane_count - 1;
+                for(ptrdiff_t index = 0; index < RegCount; ++index) {
+                    ptrdiff_t other = index ^ reg_mask;
+                    if(other > index) {
+                        tReg reversed = tLanes::Reverse(regs[other]);
+                        tReg lo = tLanes::Min(regs[index], reversed);
+                        regs[other] = tLanes::Reverse(tLanes::Max(regs[index], reversed));
+                        regs[index] = lo;
                     }
                 }
-            } else if(less_proc(user_ptr, right, Middle)) {
-                swap_proc(user_ptr, Middle, right);
-                if(less_proc(user_ptr, Middle, left + 1)) {
-                    swap_proc(user_ptr, left + 1, Middle);
+            }
+
+            for(ptrdiff_t distance = block / 4; distance > 0; distance /= 2) {
+                if(distance >= lane_count) {
+                    ptrdiff_t reg_distance = distance / lane_count;
+                    for(ptrdiff_t index = 0; index < RegCount; ++index) {
+                        ptrdiff_t other = index ^ reg_distance;
+                        if(other > index) {
+                            tReg lo = tLanes::Min(regs[index], regs[other]);
+                            regs[other] = tLanes::Max(regs[index], regs[other]);
+                            regs[index] = lo;
+                        }
+                    }
+                } else {
+                    for(tReg& reg : regs) {
+                        tReg other = tLanes::Permute(reg, (int)distance);
+                        reg = tLanes::Blend(tLanes::Min(reg, other), tLanes::Max(reg, other), (int)distance);
+                    }
                 }
             }
+        }
+
+        for(ptrdiff_t index = 0; index < RegCount; ++index) {
+            tLanes::Store(keys + index * lane_count, regs[index]);
+        }
+    }
+
+    template<typename K>
+    void SortNetwork(K* keys, ptrdiff_t len) {
+        using tLanes = typename tSortNetworkLanes<K>::tType;
+        constexpr ptrdiff_t lane_count = tLanes::lane_count;
+        K buffer[sort_network_max_len];
+
+        ptrdiff_t padded_len = lane_count;
+        while(padded_len < len) {
+            padded_len *= 2;
+        }
+        MTB_memcpy(buffer, keys, len * sizeof(K));
+        for(ptrdiff_t index = len; index < padded_len; ++index) {
+            buffer[index] = tSortNetworkKey<K>::pad;
+        }
+
+        switch(padded_len / lane_count) {
+            case 1: BitonicSortNetwork<tLanes, 1>(buffer); break;
+            case 2: BitonicSortNetwork<tLanes, 2>(buffer); break;
+            case 4: BitonicSortNetwork<tLanes, 4>(buffer); break;
+            case 8: BitonicSortNetwork<tLanes, 8>(buffer); break;
+            case 16: BitonicSortNetwork<tLanes, 16>(buffer); break;
+            case 32: BitonicSortNetwork<tLanes, 32>(buffer); break;
+            case 64: BitonicSortNetwork<tLanes, 64>(buffer); break;
+        }
+
+        MTB_memcpy(keys, buffer, len * sizeof(K));
+    }
+#endif
+
+    constexpr ptrdiff_t sort_insertion_threshold = 24;
+    constexpr ptrdiff_t sort_ninther_threshold = 128;
+    constexpr ptrdiff_t sort_partial_insertion_limit = 8;
+    constexpr ptrdiff_t sort_block_size = 64;
+
+    template<typename T>
+    void SwapItems(T* a, T* b) {
+        T temp(MoveCast(*a));
+        *a = MoveCast(*b);
+        *b = MoveCast(temp);
+    }
+
+    template<typename T, typename tLessProc>
+    void Sort2(T* a, T* b, tLessProc& less) {
+        if(less(*b, *a)) {
+            SwapItems(a, b);
+        }
+    }
+
+    template<typename T, typename tLessProc>
+    void Sort3(T* a, T* b, T* c, tLessProc& less) {
+        Sort2(a, b, less);
+        Sort2(b, c, less);
+        Sort2(a, b, less);
+    }
+
+    template<typename T, typename tLessProc>
+    void InsertionSort(T* begin, T* end, tLessProc& less) {
+        if(begin == end) {
+            return;
+        }
+        for(T* cur = begin + 1; cur != end; ++cur) {
+            T* sift = cur;
+            T* sift_1 = cur - 1;
+            if(less(*sift, *sift_1)) {
+                T temp(MoveCast(*sift));
+                do {
+                    *sift-- = MoveCast(*sift_1);
+                } while(sift != begin && less(temp, *--sift_1));
+                *sift = MoveCast(temp);
+            }
+        }
+    }
+
+    /// Like InsertionSort, but requires the item before \a begin to be less than or equal to all items in the range.
+    template<typename T, typename tLessProc>
+    void UnguardedInsertionSort(T* begin, T* end, tLessProc& less) {
+        if(begin == end) {
+            return;
+        }
+        for(T* cur = begin + 1; cur != end; ++cur) {
+            T* sift = cur;
+            T* sift_1 = cur - 1;
+            if(less(*sift, *sift_1)) {
+                T temp(MoveCast(*sift));
+                do {
+                    *sift-- = MoveCast(*sift_1);
+                } while(less(temp, *--sift_1));
+                *sift = MoveCast(temp);
+            }
+        }
+    }
+
+    /// Insertion sort that gives up after moving sort_partial_insertion_limit items. Returns true if the range is sorted.
+    template<typename T, typename tLessProc>
+    bool PartialInsertionSort(T* begin, T* end, tLessProc& less) {
+        if(begin == end) {
+            return true;
+        }
+        ptrdiff_t limit = 0;
+        for(T* cur = begin + 1; cur != end; ++cur) {
+            T* sift = cur;
+            T* sift_1 = cur - 1;
+            if(less(*sift, *sift_1)) {
+                T temp(MoveCast(*sift));
+                do {
+                    *sift-- = MoveCast(*sift_1);
+                } while(sift != begin && less(temp, *--sift_1));
+                *sift = MoveCast(temp);
+                limit += cur - sift;
+            }
+            if(limit > sort_partial_insertion_limit) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template<typename T, typename tLessProc>
+    void SiftDown(T* items, ptrdiff_t index, ptrdiff_t len, tLessProc& less) {
+        T temp(MoveCast(items[index]));
+        while(true) {
+            ptrdiff_t child = 2 * index + 1;
+            if(child >= len) {
+                break;
+            }
+            if(child + 1 < len && less(items[child], items[child + 1])) {
+                ++child;
+            }
+            if(!less(temp, items[child])) {
+                break;
+            }
+            items[index] = MoveCast(items[child]);
+            index = child;
+        }
+        items[index] = MoveCast(temp);
+    }
+
+    template<typename T, typename tLessProc>
+    void HeapSort(T* begin, T* end, tLessProc& less) {
+        ptrdiff_t len = end - begin;
+        for(ptrdiff_t index = len / 2; index > 0; --index) {
+            SiftDown(begin, index - 1, len, less);
+        }
+        for(ptrdiff_t last = len - 1; last > 0; --last) {
+            SwapItems(begin, begin + last);
+            SiftDown(begin, 0, last, less);
+        }
+    }
+
+    template<typename T>
+    struct tPartitionResult {
+        T* pivot;
+        bool already_partitioned;
+    };
+
+    // Used by the branchless partition. Moves items at the given offsets from the left block to the right block and
+    // vice versa. With use_swaps, pairs are swapped, otherwise they are rotated in one cycle, which needs fewer moves.
+    template<typename T>
+    void SwapOffsets(T* first, T* last, uint8_t const* offsets_l, uint8_t const* offsets_r, ptrdiff_t num, bool use_swaps) {
+        if(use_swaps) {
+            for(ptrdiff_t index = 0; index < num; ++index) {
+                SwapItems(first + offsets_l[index], last - offsets_r[index]);
+            }
+        } else if(num > 0) {
+            T* l = first + offsets_l[0];
+            T* r = last - offsets_r[0];
+            T temp(MoveCast(*l));
+            *l = MoveCast(*r);
+            for(ptrdiff_t index = 1; index < num; ++index) {
+                l = first + offsets_l[index];
+                *r = MoveCast(*l);
+                r = last - offsets_r[index];
+                *l = MoveCast(*r);
+            }
+            *r = MoveCast(temp);
+        }
+    }
+
+    // Partition [begin, end) around *begin. Items equal to the pivot go to the right.
+    template<bool Branchless, typename T, typename tLessProc>
+    tPartitionResult<T> PartitionRight(T* begin, T* end, tLessProc& less) {
+        T pivot(MoveCast(*begin));
+        T* first = begin;
+        T* last = end;
+
+        // Find the first item >= pivot. There is one, because the pivot was picked as a median.
+        while(less(*++first, pivot)) {
+        }
+
+        // Find the first item < pivot from the right. Guard only if there was no item < pivot on the left.
+        if(first - 1 == begin) {
+            while(first < last && !less(*--last, pivot)) {
+            }
+        } else {
+            while(!less(*--last, pivot)) {
+            }
+        }
+
+        bool already_partitioned = first >= last;
+        if(!already_partitioned) {
+            if(Branchless) {
+                SwapItems(first, last);
+                ++first;
+
+                // BlockQuicksort: record the offsets of misplaced items for a whole block without branching on the
+                // comparison, then swap them in bulk.
+                uint8_t offsets_l[sort_block_size];
+                uint8_t offsets_r[sort_block_size];
+
+                T* offsets_l_base = first;
+                T* offsets_r_base = last;
+                ptrdiff_t num_l = 0;
+                ptrdiff_t num_r = 0;
+                ptrdiff_t start_l = 0;
+                ptrdiff_t start_r = 0;
+
+                while(first < last) {
+                    // Fill the offset blocks that are empty. Split the remaining items if both are.
+                    ptrdiff_t num_unknown = last - first;
+                    ptrdiff_t left_split = num_l == 0 ? (num_r == 0 ? num_unknown / 2 : num_unknown) : 0;
+                    ptrdiff_t right_split = num_r == 0 ? (num_unknown - left_split) : 0;
+
+                    if(left_split > sort_block_size) {
+                        left_split = sort_block_size;
+                    }
+                    for(ptrdiff_t index = 0; index < left_split;) {
+                        offsets_l[num_l] = (uint8_t)index++;
+                        num_l += !less(*first, pivot);
+                        ++first;
+                    }
+
+                    if(right_split > sort_block_size) {
+                        right_split = sort_block_size;
+                    }
+                    for(ptrdiff_t index = 0; index < right_split;) {
+                        offsets_r[num_r] = (uint8_t)++index;
+                        num_r += less(*--last, pivot);
+                    }
+
+                    ptrdiff_t num = num_l < num_r ? num_l : num_r;
+                    SwapOffsets(offsets_l_base, offsets_r_base, offsets_l + start_l, offsets_r + start_r, num, num_l == num_r);
+                    num_l -= num;
+                    num_r -= num;
+                    start_l += num;
+                    start_r += num;
+
+                    if(num_l == 0) {
+                        start_l = 0;
+                        offsets_l_base = first;
+                    }
+                    if(num_r == 0) {
+                        start_r = 0;
+                        offsets_r_base = last;
+                    }
+                }
+
+                // At most one block has leftover offsets. Move those items to the other side.
+                if(num_l) {
+                    uint8_t const* offsets = offsets_l + start_l;
+                    while(num_l--) {
+                        SwapItems(offsets_l_base + offsets[num_l], --last);
+                    }
+                    first = last;
+                }
+                if(num_r) {
+                    uint8_t const* offsets = offsets_r + start_r;
+                    while(num_r--) {
+                        SwapItems(offsets_r_base - offsets[num_r], first);
+                        ++first;
+                    }
+                    last = first;
+                }
+            } else {
+                while(first < last) {
+                    SwapItems(first, last);
+                    while(less(*++first, pivot)) {
+                    }
+                    while(!less(*--last, pivot)) {
+                    }
+                }
+            }
+        }
+
+        T* pivot_pos = first - 1;
+        *begin = MoveCast(*pivot_pos);
+        *pivot_pos = MoveCast(pivot);
+        return {pivot_pos, already_partitioned};
+    }
+
+    // Partition [begin, end) around *begin. Items equal to the pivot go to the left. Used when the pivot equals the
+    // item before the range, so all of them can be skipped at once.
+    template<typename T, typename tLessProc>
+    T* PartitionLeft(T* begin, T* end, tLessProc& less) {
+        T pivot(MoveCast(*begin));
+        T* first = begin;
+        T* last = end;
+
+        while(less(pivot, *--last)) {
+        }
+
+        if(last + 1 == end) {
+            while(first < last && !less(pivot, *++first)) {
+            }
+        } else {
+            while(!less(pivot, *++first)) {
+            }
+        }
+
+        while(first < last) {
+            SwapItems(first, last);
+            while(less(pivot, *--last)) {
+            }
+            while(!less(pivot, *++first)) {
+            }
+        }
+
+        T* pivot_pos = last;
+        *begin = MoveCast(*pivot_pos);
+        *pivot_pos = MoveCast(pivot);
+        return pivot_pos;
+    }
+
+    template<bool UseNetwork>
+    struct tLeafSortOps;
+
+    template<>
+    struct tLeafSortOps<false> {
+        template<typename T, typename tLessProc>
+        static void Sort(T* begin, T* end, tLessProc& less, bool leftmost) {
+            if(leftmost) {
+                InsertionSort(begin, end, less);
+            } else {
+                UnguardedInsertionSort(begin, end, less);
+            }
+        }
+    };
+
+#if MTB_USE_AVX2
+    template<>
+    struct tLeafSortOps<true> {
+        template<typename T, typename tLessProc>
+        static void Sort(T* begin, T* end, tLessProc&, bool) {
+            if(end - begin > 1) {
+                SortNetwork(begin, end - begin);
+            }
+        }
+    };
+#endif
+
+    template<bool Branchless, typename T, typename tLessProc>
+    void PdqSortLoop(T* begin, T* end, tLessProc& less, int bad_allowed, bool leftmost) {
+        while(true) {
+            ptrdiff_t size = end - begin;
+            if(size < sort_insertion_threshold) {
+                tLeafSortOps<tSortNetworkKey<T>::leaf && tIsSame<tLessProc, tLess>::value>::Sort(begin, end, less, leftmost);
+                return;
+            }
+
+            // Pivot is the median of 3, or the pseudomedian of 9 for larger ranges. It ends up in *begin.
+            ptrdiff_t s2 = size / 2;
+            if(size > sort_ninther_threshold) {
+                Sort3(begin, begin + s2, end - 1, less);
+                Sort3(begin + 1, begin + (s2 - 1), end - 2, less);
+                Sort3(begin + 2, begin + (s2 + 1), end - 3, less);
+                Sort3(begin + (s2 - 1), begin + s2, begin + (s2 + 1), less);
+                SwapItems(begin, begin + s2);
+            } else {
+                Sort3(begin + s2, begin, end - 1, less);
+            }
+
+            // If the item before this range is not less than the pivot, many items equal the pivot. Put them all to
+            // the left where they are done.
+            if(!leftmost && !less(*(begin - 1), *begin)) {
+                begin = PartitionLeft(begin, end, less) + 1;
+                continue;
+            }
+
+            tPartitionResult<T> part = PartitionRight<Branchless>(begin, end, less);
+            T* pivot_pos = part.pivot;
+
+            ptrdiff_t l_size = pivot_pos - begin;
+            ptrdiff_t r_size = end - (pivot_pos + 1);
+            bool highly_unbalanced = l_size < size / 8 || r_size < size / 8;
+
+            if(highly_unbalanced) {
+                // Too many bad pivots. Guarantee O(n log n).
+                if(--bad_allowed == 0) {
+                    HeapSort(begin, end, less);
+                    return;
+                }
+
+                // Shuffle some items to break patterns.
+                if(l_size >= sort_insertion_threshold) {
+                    SwapItems(begin, begin + l_size / 4);
+                    SwapItems(pivot_pos - 1, pivot_pos - l_size / 4);
+                    if(l_size > sort_ninther_threshold) {
+                        SwapItems(begin + 1, begin + (l_size / 4 + 1));
+                        SwapItems(begin + 2, begin + (l_size / 4 + 2));
+                        SwapItems(pivot_pos - 2, pivot_pos - (l_size / 4 + 1));
+                        SwapItems(pivot_pos - 3, pivot_pos - (l_size / 4 + 2));
+                    }
+                }
+                if(r_size >= sort_insertion_threshold) {
+                    SwapItems(pivot_pos + 1, pivot_pos + (1 + r_size / 4));
+                    SwapItems(end - 1, end - r_size / 4);
+                    if(r_size > sort_ninther_threshold) {
+                        SwapItems(pivot_pos + 2, pivot_pos + (2 + r_size / 4));
+                        SwapItems(pivot_pos + 3, pivot_pos + (3 + r_size / 4));
+                        SwapItems(end - 2, end - (1 + r_size / 4));
+                        SwapItems(end - 3, end - (2 + r_size / 4));
+                    }
+                }
+            } else if(part.already_partitioned && PartialInsertionSort(begin, pivot_pos, less) && PartialInsertionSort(pivot_pos + 1, end, less)) {
+                // The partition did not move anything and both sides turned out to be (nearly) sorted.
+                return;
+            }
+
+            // Recurse into the left side, loop on the right side.
+            PdqSortLoop<Branchless>(begin, pivot_pos, less, bad_allowed, leftmost);
+            begin = pivot_pos + 1;
+            leftmost = false;
+        }
+    }
+
+    /// Handles input that is entirely sorted or entirely in descending order in O(n). Returns true if \a slice is
+    /// sorted afterwards.
+    template<typename T, typename tLessProc>
+    bool SortTrivialRuns(tSlice<T> slice, tLessProc& less) {
+        if(slice.len < 2) {
+            return true;
+        }
+
+        T* ptr = slice.ptr;
+        ptrdiff_t index = 1;
+        if(less(ptr[1], ptr[0])) {
+            // Strictly descending, so reversing it cannot reorder equal items.
+            while(index < slice.len && less(ptr[index], ptr[index - 1])) {
+                ++index;
+            }
+            if(index == slice.len) {
+                for(ptrdiff_t left = 0, right = slice.len - 1; left < right; ++left, --right) {
+                    SwapItems(ptr + left, ptr + right);
+                }
+                return true;
+            }
+        } else {
+            while(index < slice.len && !less(ptr[index], ptr[index - 1])) {
+                ++index;
+            }
+            if(index == slice.len) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns the number of keys before the NaNs.
+    template<typename K>
+    ptrdiff_t MoveNaNsToEnd(K*, ptrdiff_t len) {
+        return len;
+    }
+
+    template<typename K>
+    ptrdiff_t MoveFloatNaNsToEnd(K* keys, ptrdiff_t len) {
+        ptrdiff_t write_index = 0;
+        for(ptrdiff_t read_index = 0; read_index < len; ++read_index) {
+            if(keys[read_index] == keys[read_index]) {
+                SwapItems(keys + write_index, keys + read_index);
+                ++write_index;
+            }
+        }
+        return write_index;
+    }
+
+    inline ptrdiff_t MoveNaNsToEnd(float* keys, ptrdiff_t len) { return MoveFloatNaNsToEnd(keys, len); }
+    inline ptrdiff_t MoveNaNsToEnd(double* keys, ptrdiff_t len) { return MoveFloatNaNsToEnd(keys, len); }
+}  // namespace mtb::impl
+
+template<typename K>
+void mtb::SortSmall(tSlice<K> keys) {
+    keys.len = impl::MoveNaNsToEnd(keys.ptr, keys.len);
+    if(keys.len <= impl::sort_network_max_len) {
+        tLess less;
+        impl::tLeafSortOps<impl::tSortNetworkKey<K>::supported>::Sort(keys.ptr, keys.ptr + keys.len, less, true);
+    } else {
+        SortSlice(keys);
+    }
+}
+
+template<typename T, typename tLessProc>
+void mtb::SortSlice(tSlice<T> slice, tLessProc less) {
+    if(impl::SortTrivialRuns(slice, less)) {
+        return;
+    }
+    int bad_allowed = Log2Floor((uint64_t)slice.len);
+    impl::PdqSortLoop<MTB_IS_POD(T)>(slice.ptr, slice.ptr + slice.len, less, bad_allowed, true);
+}
+
+namespace mtb::impl {
+    // clang-format off
+    template<size_t Size> struct tRadixBits;
+    template<>            struct tRadixBits<1> { using tType = uint8_t; };
+    template<>            struct tRadixBits<2> { using tType = uint16_t; };
+    template<>            struct tRadixBits<4> { using tType = uint32_t; };
+    template<>            struct tRadixBits<8> { using tType = uint64_t; };
+    // clang-format on
+
+    /// Maps a key to an unsigned integer with the same order.
+    template<typename K>
+    struct tRadixKey {
+        using tBits = typename tRadixBits<sizeof(K)>::tType;
+        static constexpr bool is_signed = (K)-1 < (K)0;
+
+        MTB_NODISCARD static tBits Encode(K key) {
+            tBits bits = (tBits)key;
+            if(is_signed) {
+                bits ^= (tBits)((tBits)1 << (sizeof(K) * 8 - 1));
+            }
+            return bits;
+        }
+    };
+
+    template<typename K, typename tBits>
+    struct tRadixFloatKey {
+        MTB_NODISCARD static tBits Encode(K key) {
+            constexpr tBits sign_bit = (tBits)1 << (sizeof(K) * 8 - 1);
+            tBits bits;
+            MTB_memcpy(&bits, &key, sizeof(bits));
+            // Flip all bits of negative numbers to reverse their order, only the sign bit of positive ones.
+            tBits mask = (tBits)(0 - (bits >> (sizeof(K) * 8 - 1))) | sign_bit;
+            return bits ^ mask;
+        }
+    };
+
+    template<>
+    struct tRadixKey<float> : tRadixFloatKey<float, uint32_t> {
+        using tBits = uint32_t;
+    };
+
+    template<>
+    struct tRadixKey<double> : tRadixFloatKey<double, uint64_t> {
+        using tBits = uint64_t;
+    };
+
+    constexpr int radix_digit_bits = 8;
+    constexpr ptrdiff_t radix_digit_count = (ptrdiff_t)1 << radix_digit_bits;
+
+    /// LSD radix sort of \a items by key_proc(item). If \a values is not null, it is permuted along with \a items.
+    template<typename T, typename V, typename tKeyProc>
+    bool RadixSortImpl(tSlice<T> items, V* values, tAllocator allocator, tKeyProc& key_proc) {
+        static_assert(MTB_IS_TRIVIALLY_RELOCATABLE(T), "Radix sort moves items with memcpy.");
+        static_assert(MTB_IS_TRIVIALLY_RELOCATABLE(V), "Radix sort moves values with memcpy.");
+
+        using tKey = tRadixKey<::mtb::tDecay<decltype(key_proc(*items.ptr))>>;
+        using tBits = typename tKey::tBits;
+        constexpr int pass_count = (int)(sizeof(tBits) * 8 / radix_digit_bits);
+
+        if(items.len < 2) {
+            return true;
+        }
+
+        // Histograms for all passes are built in a single read.
+        ptrdiff_t counts[pass_count][radix_digit_count] = {};
+        for(T const& item : items) {
+            tBits bits = tKey::Encode(key_proc(item));
+            for(int pass = 0; pass < pass_count; ++pass) {
+                ++counts[pass][(bits >> (pass * radix_digit_bits)) & (radix_digit_count - 1)];
+            }
+        }
+
+        tSlice<T> scratch = allocator.template AllocArray<T>(items.len, kNoInit);
+        if(!scratch) {
+            return false;
+        }
+        tSlice<V> values_scratch{};
+        if(values) {
+            values_scratch = allocator.template AllocArray<V>(items.len, kNoInit);
+            if(!values_scratch) {
+                allocator.FreeArray(scratch);
+                return false;
+            }
+        }
+
+        T* src = items.ptr;
+        T* dest = scratch.ptr;
+        V* values_src = values;
+        V* values_dest = values_scratch.ptr;
+        tBits first_bits = tKey::Encode(key_proc(items.ptr[0]));
+        for(int pass = 0; pass < pass_count; ++pass) {
+            int shift = pass * radix_digit_bits;
+            ptrdiff_t* offsets = counts[pass];
+
+            // All items share this digit, so the pass would not move anything.
+            if(offsets[(first_bits >> shift) & (radix_digit_count - 1)] == items.len) {
+                continue;
+            }
+
+            ptrdiff_t offset = 0;
+            for(ptrdiff_t digit = 0; digit < radix_digit_count; ++digit) {
+                ptrdiff_t count = offsets[digit];
+                offsets[digit] = offset;
+                offset += count;
+            }
+
+            if(values) {
+                for(ptrdiff_t index = 0; index < items.len; ++index) {
+                    tBits bits = tKey::Encode(key_proc(src[index]));
+                    ptrdiff_t target = offsets[(bits >> shift) & (radix_digit_count - 1)]++;
+                    MTB_memcpy((void*)(dest + target), (void const*)(src + index), sizeof(T));
+                    MTB_memcpy((void*)(values_dest + target), (void const*)(values_src + index), sizeof(V));
+                }
+                Swap(values_src, values_dest);
+            } else {
+                for(ptrdiff_t index = 0; index < items.len; ++index) {
+                    tBits bits = tKey::Encode(key_proc(src[index]));
+                    ptrdiff_t target = offsets[(bits >> shift) & (radix_digit_count - 1)]++;
+                    MTB_memcpy((void*)(dest + target), (void const*)(src + index), sizeof(T));
+                }
+            }
+            Swap(src, dest);
+        }
+
+        if(src != items.ptr) {
+            MTB_memcpy((void*)items.ptr, (void const*)src, items.len * sizeof(T));
+            if(values) {
+                MTB_memcpy((void*)values, (void const*)values_src, items.len * sizeof(V));
+            }
+        }
+
+        if(values) {
+            allocator.FreeArray(values_scratch);
+        }
+        allocator.FreeArray(scratch);
+        return true;
+    }
+
+    template<typename K>
+    struct tRadixIdentityKey {
+        MTB_NODISCARD K operator()(K key) const { return key; }
+    };
+}  // namespace mtb::impl
+
+template<typename K>
+bool mtb::RadixSort(tSlice<K> keys, tAllocator allocator) {
+    impl::tRadixIdentityKey<K> key_proc{};
+    return impl::RadixSortImpl(keys, (uint8_t*)nullptr, allocator, key_proc);
+}
+
+template<typename K, typename V>
+bool mtb::RadixSortPairs(tSlice<K> keys, tSlice<V> values, tAllocator allocator) {
+    MTB_ASSERT(keys.len == values.len);
+    impl::tRadixIdentityKey<K> key_proc{};
+    return impl::RadixSortImpl(keys, values.ptr, allocator, key_proc);
+}
+
+template<typename T, typename tKeyProc>
+bool mtb::RadixSortByKey(tSlice<T> items, tAllocator allocator, tKeyProc key_proc) {
+    return impl::RadixSortImpl(items, (uint8_t*)nullptr, allocator, key_proc);
+}
+
+namespace mtb::impl {
+    constexpr ptrdiff_t stable_sort_min_gallop = 7;
+    constexpr ptrdiff_t stable_sort_in_place_block_len = 20;
+
+    template<typename T>
+    void InPlaceRotate(T* first, T* middle, T* last) {
+        // Swap blocks of equal size until the rotation is done.
+        ptrdiff_t i = middle - first;
+        ptrdiff_t j = last - middle;
+        auto swap_range = [](T* a, T* b, ptrdiff_t n) {
+            for(ptrdiff_t index = 0; index < n; ++index) {
+                SwapItems(a + index, b + index);
+            }
+        };
+        while(i != j) {
+            if(i > j) {
+                swap_range(middle - i, middle, j);
+                i -= j;
+            } else {
+                swap_range(middle - i, middle + j - i, i);
+                j -= i;
+            }
+        }
+        swap_range(middle - i, middle, i);
+    }
+
+    /// Merge the sorted ranges [first, middle) and [middle, last) without extra memory. See "Stable Minimum Storage
+    /// Merging by Symmetric Comparisons" by Pok-Son Kim and Arne Kutzner.
+    template<typename T, typename tLessProc>
+    void SymMerge(T* first, T* middle, T* last, tLessProc& less) {
+        if(middle - first == 1) {
+            // Insert the single item on the left into the right side.
+            T* lower = middle;
+            T* upper = last;
+            while(lower < upper) {
+                T* half = lower + (upper - lower) / 2;
+                if(less(*half, *first)) {
+                    lower = half + 1;
+                } else {
+                    upper = half;
+                }
+            }
+            for(T* cursor = first; cursor < lower - 1; ++cursor) {
+                SwapItems(cursor, cursor + 1);
+            }
+            return;
+        }
+        if(last - middle == 1) {
+            // Insert the single item on the right into the left side.
+            T* lower = first;
+            T* upper = middle;
+            while(lower < upper) {
+                T* half = lower + (upper - lower) / 2;
+                if(!less(*middle, *half)) {
+                    lower = half + 1;
+                } else {
+                    upper = half;
+                }
+            }
+            for(T* cursor = middle; cursor > lower; --cursor) {
+                SwapItems(cursor, cursor - 1);
+            }
+            return;
+        }
+
+        ptrdiff_t a = 0;
+        ptrdiff_t m = middle - first;
+        ptrdiff_t b = last - first;
+        ptrdiff_t mid = b / 2;
+        ptrdiff_t n = mid + m;
+        ptrdiff_t start;
+        ptrdiff_t r;
+        if(m > mid) {
+            start = n - b;
+            r = mid;
+        } else {
+            start = a;
+            r = m;
+        }
+        ptrdiff_t p = n - 1;
+        while(start < r) {
+            ptrdiff_t c = start + (r - start) / 2;
+            if(!less(first[p - c], first[c])) {
+                start = c + 1;
+            } else {
+                r = c;
+            }
+        }
+        ptrdiff_t end = n - start;
+        if(start < m && m < end) {
+            InPlaceRotate(first + start, first + m, first + end);
+        }
+        if(a < start && start < mid) {
+            SymMerge(first, first + start, first + mid, less);
+        }
+        if(mid < end && end < b) {
+            SymMerge(first + mid, first + end, last, less);
+        }
+    }
+
+    /// Position of the first item in \a items that is not less than \a key, searching outwards from \a hint.
+    template<typename T, typename tLessProc>
+    ptrdiff_t GallopLeft(T const& key, T const* items, ptrdiff_t len, ptrdiff_t hint, tLessProc& less) {
+        T const* base = items + hint;
+        ptrdiff_t last_ofs = 0;
+        ptrdiff_t ofs = 1;
+        if(less(*base, key)) {
+            // items[hint] < key: gallop right until items[hint + last_ofs] < key <= items[hint + ofs].
+            ptrdiff_t max_ofs = len - hint;
+            while(ofs < max_ofs && less(base[ofs], key)) {
+                last_ofs = ofs;
+                ofs = (ofs << 1) + 1;
+            }
+            if(ofs > max_ofs) {
+                ofs = max_ofs;
+            }
+            last_ofs += hint;
+            ofs += hint;
+        } else {
+            // key <= items[hint]: gallop left until items[hint - ofs] < key <= items[hint - last_ofs].
+            ptrdiff_t max_ofs = hint + 1;
+            while(ofs < max_ofs && !less(base[-ofs], key)) {
+                last_ofs = ofs;
+                ofs = (ofs << 1) + 1;
+            }
+            if(ofs > max_ofs) {
+                ofs = max_ofs;
+            }
+            ptrdiff_t temp = last_ofs;
+            last_ofs = hint - ofs;
+            ofs = hint - temp;
+        }
+
+        // items[last_ofs] < key <= items[ofs], binary search in between.
+        ++last_ofs;
+        while(last_ofs < ofs) {
+            ptrdiff_t m = last_ofs + ((ofs - last_ofs) >> 1);
+            if(less(items[m], key)) {
+                last_ofs = m + 1;
+            } else {
+                ofs = m;
+            }
+        }
+        return ofs;
+    }
+
+    /// Position after the last item in \a items that is not greater than \a key, searching outwards from \a hint.
+    template<typename T, typename tLessProc>
+    ptrdiff_t GallopRight(T const& key, T const* items, ptrdiff_t len, ptrdiff_t hint, tLessProc& less) {
+        T const* base = items + hint;
+        ptrdiff_t last_ofs = 0;
+        ptrdiff_t ofs = 1;
+        if(less(key, *base)) {
+            ptrdiff_t max_ofs = hint + 1;
+            while(ofs < max_ofs && less(key, base[-ofs])) {
+                last_ofs = ofs;
+                ofs = (ofs << 1) + 1;
+            }
+            if(ofs > max_ofs) {
+                ofs = max_ofs;
+            }
+            ptrdiff_t temp = last_ofs;
+            last_ofs = hint - ofs;
+            ofs = hint - temp;
+        } else {
+            ptrdiff_t max_ofs = len - hint;
+            while(ofs < max_ofs && !less(key, base[ofs])) {
+                last_ofs = ofs;
+                ofs = (ofs << 1) + 1;
+            }
+            if(ofs > max_ofs) {
+                ofs = max_ofs;
+            }
+            last_ofs += hint;
+            ofs += hint;
+        }
+
+        ++last_ofs;
+        while(last_ofs < ofs) {
+            ptrdiff_t m = last_ofs + ((ofs - last_ofs) >> 1);
+            if(less(key, items[m])) {
+                ofs = m;
+            } else {
+                last_ofs = m + 1;
+            }
+        }
+        return ofs;
+    }
+
+    template<typename T>
+    void RelocateBytes(T* dest, T const* src, ptrdiff_t count) {
+        MTB_memmove((void*)dest, (void const*)src, count * sizeof(T));
+    }
+
+    template<typename T, typename tLessProc>
+    struct tMergeState {
+        struct tRun {
+            T* base;
+            ptrdiff_t len;
+        };
+
+        tLessProc* less;
+        T* scratch;
+        ptrdiff_t min_gallop;
+
+        /// The run lengths grow at least as fast as the Fibonacci numbers, so this is enough for any slice.
+        tRun runs[96];
+        ptrdiff_t run_count;
+    };
+
+    /// Merge two adjacent runs where \a len_a <= \a len_b. The first item of B is smaller than all items in A, and the
+    /// last item of A is greater than all items in B.
+    template<typename T, typename tLessProc>
+    void MergeLow(tMergeState<T, tLessProc>& state, T* base_a, ptrdiff_t len_a, T* base_b, ptrdiff_t len_b) {
+        tLessProc& less = *state.less;
+        RelocateBytes(state.scratch, base_a, len_a);
+        T* a = state.scratch;
+        T* b = base_b;
+        T* dest = base_a;
+
+        RelocateBytes(dest++, b++, 1);
+        --len_b;
+        if(len_b == 0) {
+            RelocateBytes(dest, a, len_a);
+            return;
+        }
+        if(len_a == 1) {
+            RelocateBytes(dest, b, len_b);
+            RelocateBytes(dest + len_b, a, 1);
+            return;
+        }
+
+        ptrdiff_t min_gallop = state.min_gallop;
+        while(true) {
+            ptrdiff_t count_a = 0;
+            ptrdiff_t count_b = 0;
+
+            // One item at a time until one side wins consistently.
+            while(true) {
+                if(less(*b, *a)) {
+                    RelocateBytes(dest++, b++, 1);
+                    ++count_b;
+                    count_a = 0;
+                    if(--len_b == 0) {
+                        goto succeed;
+                    }
+                    if(count_b >= min_gallop) {
+                        break;
+                    }
+                } else {
+                    RelocateBytes(dest++, a++, 1);
+                    ++count_a;
+                    count_b = 0;
+                    if(--len_a == 1) {
+                        goto copy_b;
+                    }
+                    if(count_a >= min_gallop) {
+                        break;
+                    }
+                }
+            }
+
+            // Galloping: move whole stretches at once as long as that pays off.
+            ++min_gallop;
+            do {
+                min_gallop -= min_gallop > 1;
+
+                count_a = GallopRight(*b, a, len_a, 0, less);
+                if(count_a) {
+                    RelocateBytes(dest, a, count_a);
+                    dest += count_a;
+                    a += count_a;
+                    len_a -= count_a;
+                    if(len_a == 1) {
+                        goto copy_b;
+                    }
+                    if(len_a == 0) {
+                        goto succeed;
+                    }
+                }
+                RelocateBytes(dest++, b++, 1);
+                if(--len_b == 0) {
+                    goto succeed;
+                }
+
+                count_b = GallopLeft(*a, (T const*)b, len_b, 0, less);
+                if(count_b) {
+                    RelocateBytes(dest, b, count_b);
+                    dest += count_b;
+                    b += count_b;
+                    len_b -= count_b;
+                    if(len_b == 0) {
+                        goto succeed;
+                    }
+                }
+                RelocateBytes(dest++, a++, 1);
+                if(--len_a == 1) {
+                    goto copy_b;
+                }
+            } while(count_a >= stable_sort_min_gallop || count_b >= stable_sort_min_gallop);
+            ++min_gallop;
+        }
+
+    succeed:
+        state.min_gallop = min_gallop < 1 ? 1 : min_gallop;
+        if(len_a) {
+            RelocateBytes(dest, a, len_a);
+        }
+        return;
+
+    copy_b:
+        state.min_gallop = min_gallop < 1 ? 1 : min_gallop;
+        // The last item of A is greater than all remaining items of B.
+        RelocateBytes(dest, b, len_b);
+        RelocateBytes(dest + len_b, a, 1);
+    }
+
+    /// Mirror image of MergeLow for \a len_a > \a len_b, merging from the back.
+    template<typename T, typename tLessProc>
+    void MergeHigh(tMergeState<T, tLessProc>& state, T* base_a, ptrdiff_t len_a, T* base_b, ptrdiff_t len_b) {
+        tLessProc& less = *state.less;
+        RelocateBytes(state.scratch, base_b, len_b);
+        T* scratch = state.scratch;
+        T* dest = base_b + len_b - 1;
+        T* a = base_a + len_a - 1;
+        T* b = scratch + len_b - 1;
+
+        RelocateBytes(dest--, a--, 1);
+        --len_a;
+        if(len_a == 0) {
+            RelocateBytes(dest - (len_b - 1), scratch, len_b);
+            return;
+        }
+        if(len_b == 1) {
+            dest -= len_a;
+            a -= len_a;
+            RelocateBytes(dest + 1, a + 1, len_a);
+            RelocateBytes(dest, b, 1);
+            return;
+        }
+
+        ptrdiff_t min_gallop = state.min_gallop;
+        while(true) {
+            ptrdiff_t count_a = 0;
+            ptrdiff_t count_b = 0;
+
+            while(true) {
+                if(less(*b, *a)) {
+                    RelocateBytes(dest--, a--, 1);
+                    ++count_a;
+                    count_b = 0;
+                    if(--len_a == 0) {
+                        goto succeed;
+                    }
+                    if(count_a >= min_gallop) {
+                        break;
+                    }
+                } else {
+                    RelocateBytes(dest--, b--, 1);
+                    ++count_b;
+                    count_a = 0;
+                    if(--len_b == 1) {
+                        goto copy_a;
+                    }
+                    if(count_b >= min_gallop) {
+                        break;
+                    }
+                }
+            }
+
+            ++min_gallop;
+            do {
+                min_gallop -= min_gallop > 1;
+
+                count_a = len_a - GallopRight(*b, (T const*)base_a, len_a, len_a - 1, less);
+                if(count_a) {
+                    dest -= count_a;
+                    a -= count_a;
+                    RelocateBytes(dest + 1, a + 1, count_a);
+                    len_a -= count_a;
+                    if(len_a == 0) {
+                        goto succeed;
+                    }
+                }
+                RelocateBytes(dest--, b--, 1);
+                if(--len_b == 1) {
+                    goto copy_a;
+                }
+
+                count_b = len_b - GallopLeft(*a, (T const*)scratch, len_b, len_b - 1, less);
+                if(count_b) {
+                    dest -= count_b;
+                    b -= count_b;
+                    RelocateBytes(dest + 1, b + 1, count_b);
+                    len_b -= count_b;
+                    if(len_b == 1) {
+                        goto copy_a;
+                    }
+                    if(len_b == 0) {
+                        goto succeed;
+                    }
+                }
+                RelocateBytes(dest--, a--, 1);
+                if(--len_a == 0) {
+                    goto succeed;
+                }
+            } while(count_a >= stable_sort_min_gallop || count_b >= stable_sort_min_gallop);
+            ++min_gallop;
+        }
+
+    succeed:
+        state.min_gallop = min_gallop < 1 ? 1 : min_gallop;
+        if(len_b) {
+            RelocateBytes(dest - (len_b - 1), scratch, len_b);
+        }
+        return;
+
+    copy_a:
+        state.min_gallop = min_gallop < 1 ? 1 : min_gallop;
+        // The first item of B is smaller than all remaining items of A.
+        dest -= len_a;
+        a -= len_a;
+        RelocateBytes(dest + 1, a + 1, len_a);
+        RelocateBytes(dest, b, 1);
+    }
+
+    template<typename T, typename tLessProc>
+    void MergeAt(tMergeState<T, tLessProc>& state, ptrdiff_t index) {
+        T* base_a = state.runs[index].base;
+        ptrdiff_t len_a = state.runs[index].len;
+        T* base_b = state.runs[index + 1].base;
+        ptrdiff_t len_b = state.runs[index + 1].len;
+
+        state.runs[index].len = len_a + len_b;
+        if(index == state.run_count - 3) {
+            state.runs[index + 1] = state.runs[index + 2];
+        }
+        --state.run_count;
+
+        // Items at the start of A and the end of B are already in place.
+        ptrdiff_t skip = GallopRight(*base_b, (T const*)base_a, len_a, 0, *state.less);
+        base_a += skip;
+        len_a -= skip;
+        if(len_a == 0) {
+            return;
+        }
+        len_b = GallopLeft(base_a[len_a - 1], (T const*)base_b, len_b, len_b - 1, *state.less);
+        if(len_b == 0) {
+            return;
+        }
+
+        if(len_a <= len_b) {
+            MergeLow(state, base_a, len_a, base_b, len_b);
+        } else {
+            MergeHigh(state, base_a, len_a, base_b, len_b);
+        }
+    }
+
+    /// Merge runs until the lengths on the stack decrease faster than the Fibonacci numbers, which keeps merges
+    /// balanced.
+    template<typename T, typename tLessProc>
+    void MergeCollapse(tMergeState<T, tLessProc>& state) {
+        typename tMergeState<T, tLessProc>::tRun* runs = state.runs;
+        while(state.run_count > 1) {
+            ptrdiff_t n = state.run_count - 2;
+            if((n > 0 && runs[n - 1].len <= runs[n].len + runs[n + 1].len) || (n > 1 && runs[n - 2].len <= runs[n - 1].len + runs[n].len)) {
+                if(runs[n - 1].len < runs[n + 1].len) {
+                    --n;
+                }
+            } else if(runs[n].len > runs[n + 1].len) {
+                break;
+            }
+            MergeAt(state, n);
+        }
+    }
+
+    /// Sorts [begin, end) assuming [begin, sorted_end) is sorted already. Uses bitwise relocation.
+    template<typename T, typename tLessProc>
+    void BinaryInsertionSort(T* begin, T* sorted_end, T* end, tLessProc& less) {
+        alignas(T) uint8_t temp[sizeof(T)];
+        for(T* cursor = sorted_end; cursor < end; ++cursor) {
+            T* lower = begin;
+            T* upper = cursor;
+            while(lower < upper) {
+                T* half = lower + (upper - lower) / 2;
+                if(less(*cursor, *half)) {
+                    upper = half;
+                } else {
+                    lower = half + 1;
+                }
+            }
+            if(lower != cursor) {
+                RelocateBytes((T*)temp, cursor, 1);
+                RelocateBytes(lower + 1, lower, cursor - lower);
+                RelocateBytes(lower, (T*)temp, 1);
+            }
+        }
+    }
+
+    /// Length of the run at \a begin. Strictly descending runs are reversed.
+    template<typename T, typename tLessProc>
+    ptrdiff_t CountRunAndMakeAscending(T* begin, T* end, tLessProc& less) {
+        if(end - begin < 2) {
+            return end - begin;
+        }
+        T* cursor = begin + 1;
+        if(less(*cursor, *begin)) {
+            while(cursor + 1 < end && less(cursor[1], cursor[0])) {
+                ++cursor;
+            }
+            for(T* left = begin, *right = cursor; left < right; ++left, --right) {
+                SwapItems(left, right);
+            }
+        } else {
+            while(cursor + 1 < end && !less(cursor[1], cursor[0])) {
+                ++cursor;
+            }
+        }
+        return cursor + 1 - begin;
+    }
+
+    /// Runs shorter than this are extended with binary insertion sort. Chosen so that the number of runs is a power
+    /// of two or slightly less, which keeps the final merges balanced.
+    inline ptrdiff_t MinRunLength(ptrdiff_t len) {
+        ptrdiff_t r = 0;
+        while(len >= 64) {
+            r |= len & 1;
+            len >>= 1;
+        }
+        return len + r;
+    }
+
+    template<bool Relocatable>
+    struct tStableSortOps;
+
+    template<>
+    struct tStableSortOps<false> {
+        template<typename T, typename tLessProc>
+        static void Sort(tSlice<T> slice, tAllocator allocator, tLessProc& less) {
+            (void)allocator;
+            StableSortSliceInPlace(slice, less);
+        }
+    };
+
+    template<>
+    struct tStableSortOps<true> {
+        template<typename T, typename tLessProc>
+        static void Sort(tSlice<T> slice, tAllocator allocator, tLessProc& less) {
+            T* begin = slice.ptr;
+            T* end = slice.ptr + slice.len;
+            if(slice.len < 64) {
+                ptrdiff_t run_len = CountRunAndMakeAscending(begin, end, less);
+                BinaryInsertionSort(begin, begin + run_len, end, less);
+                return;
+            }
+
+            tSlice<T> scratch = allocator.template AllocArray<T>(slice.len / 2, kNoInit);
+            if(!scratch) {
+                StableSortSliceInPlace(slice, less);
+                return;
+            }
+
+            tMergeState<T, tLessProc> state;
+            state.less = &less;
+            state.scratch = scratch.ptr;
+            state.min_gallop = stable_sort_min_gallop;
+            state.run_count = 0;
+
+            ptrdiff_t min_run = MinRunLength(slice.len);
+            for(T* cursor = begin; cursor < end;) {
+                ptrdiff_t run_len = CountRunAndMakeAscending(cursor, end, less);
+                if(run_len < min_run) {
+                    ptrdiff_t forced_len = end - cursor < min_run ? end - cursor : min_run;
+                    BinaryInsertionSort(cursor, cursor + run_len, cursor + forced_len, less);
+                    run_len = forced_len;
+                }
+                MTB_ASSERT(state.run_count < (ptrdiff_t)MTB_ARRAY_COUNT(state.runs));
+                state.runs[state.run_count++] = {cursor, run_len};
+                MergeCollapse(state);
+                cursor += run_len;
+            }
+
+            while(state.run_count > 1) {
+                ptrdiff_t n = state.run_count - 2;
+                if(n > 0 && state.runs[n - 1].len < state.runs[n + 1].len) {
+                    --n;
+                }
+                MergeAt(state, n);
+            }
+
+            allocator.FreeArray(scratch);
+        }
+    };
+
+    constexpr ptrdiff_t sample_sort_max_bucket_count = 256;
+    constexpr ptrdiff_t sample_sort_oversampling = 16;
+
+    template<typename T, typename tLessProc>
+    struct tSampleSort {
+        tSlice<T> items;
+        T* scratch;
+        tLessProc* less;
+
+        /// Sorted, pointing into items. Items equal to a splitter go to the bucket after it.
+        T const** splitters;
+        ptrdiff_t bucket_count;
+
+        /// Bucket of every item.
+        uint8_t* bucket_ids;
+
+        ptrdiff_t block_count;
+        ptrdiff_t block_len;
+
+        /// Item count per block and bucket, turned into scratch offsets after counting.
+        ptrdiff_t* block_offsets;
+
+        /// Start of every bucket in scratch, plus the end of the last one.
+        ptrdiff_t* bucket_offsets;
+    };
+
+    template<typename T, typename tLessProc>
+    ptrdiff_t SampleSortClassify(tSampleSort<T, tLessProc>& sort, T const& item) {
+        ptrdiff_t lower = 0;
+        ptrdiff_t count = sort.bucket_count - 1;
+        while(count > 0) {
+            ptrdiff_t half = count / 2;
+            if(!(*sort.less)(item, *sort.splitters[lower + half])) {
+                lower += half + 1;
+                count -= half + 1;
+            } else {
+                count = half;
+            }
+        }
+        return lower;
+    }
+
+    template<typename T, typename tLessProc>
+    void SampleSortCountTask(void* task_context, ptrdiff_t block) {
+        tSampleSort<T, tLessProc>& sort = *(tSampleSort<T, tLessProc>*)task_context;
+        ptrdiff_t* counts = sort.block_offsets + block * sort.bucket_count;
+        ptrdiff_t begin = block * sort.block_len;
+        ptrdiff_t end = begin + sort.block_len < sort.items.len ? begin + sort.block_len : sort.items.len;
+        for(ptrdiff_t index = begin; index < end; ++index) {
+            ptrdiff_t bucket = SampleSortClassify(sort, sort.items.ptr[index]);
+            sort.bucket_ids[index] = (uint8_t)bucket;
+            ++counts[bucket];
+        }
+    }
+
+    template<typename T, typename tLessProc>
+    void SampleSortScatterTask(void* task_context, ptrdiff_t block) {
+        tSampleSort<T, tLessProc>& sort = *(tSampleSort<T, tLessProc>*)task_context;
+        ptrdiff_t* offsets = sort.block_offsets + block * sort.bucket_count;
+        ptrdiff_t begin = block * sort.block_len;
+        ptrdiff_t end = begin + sort.block_len < sort.items.len ? begin + sort.block_len : sort.items.len;
+        for(ptrdiff_t index = begin; index < end; ++index) {
+            ptrdiff_t target = offsets[sort.bucket_ids[index]]++;
+            MTB_memcpy((void*)(sort.scratch + target), (void const*)(sort.items.ptr + index), sizeof(T));
+        }
+    }
+
+    template<typename T, typename tLessProc>
+    void SampleSortBucketTask(void* task_context, ptrdiff_t bucket) {
+        tSampleSort<T, tLessProc>& sort = *(tSampleSort<T, tLessProc>*)task_context;
+        ptrdiff_t begin = sort.bucket_offsets[bucket];
+        ptrdiff_t len = sort.bucket_offsets[bucket + 1] - begin;
+        SortSlice(PtrSlice(sort.scratch + begin, len), *sort.less);
+        MTB_memcpy((void*)(sort.items.ptr + begin), (void const*)(sort.scratch + begin), len * sizeof(T));
+    }
+}  // namespace mtb::impl
+
+template<typename T, typename tLessProc>
+void mtb::StableSortSlice(tSlice<T> slice, tAllocator allocator, tLessProc less) {
+    impl::tStableSortOps<MTB_IS_TRIVIALLY_RELOCATABLE(T)>::Sort(slice, allocator, less);
+}
+
+template<typename T, typename tLessProc>
+void mtb::StableSortSliceInPlace(tSlice<T> slice, tLessProc less) {
+    T* begin = slice.ptr;
+    ptrdiff_t len = slice.len;
+    ptrdiff_t block_len = impl::stable_sort_in_place_block_len;
+
+    ptrdiff_t start = 0;
+    for(; start + block_len <= len; start += block_len) {
+        impl::InsertionSort(begin + start, begin + start + block_len, less);
+    }
+    impl::InsertionSort(begin + start, begin + len, less);
+
+    for(; block_len < len; block_len *= 2) {
+        for(start = 0; start + block_len < len; start += 2 * block_len) {
+            T* middle = begin + start + block_len;
+            T* last = start + 2 * block_len < len ? middle + block_len : begin + len;
+            if(less(*middle, *(middle - 1))) {
+                impl::SymMerge(begin + start, middle, last, less);
+            }
+        }
+    }
+}
+
+namespace mtb::impl {
+    template<typename tLessProc>
+    struct tReverseLess {
+        tLessProc* less;
+
+        template<typename T>
+        MTB_NODISCARD bool operator()(T const& a, T const& b) const {
+            return (*less)(b, a);
+        }
+    };
+
+    /// Move the \a count smallest items of [begin, end) to the front, with the greatest of them at the front.
+    template<typename T, typename tLessProc>
+    void HeapSelect(T* begin, T* end, ptrdiff_t count, tLessProc& less) {
+        for(ptrdiff_t index = count / 2; index > 0; --index) {
+            SiftDown(begin, index - 1, count, less);
+        }
+        for(T* cursor = begin + count; cursor < end; ++cursor) {
+            if(less(*cursor, *begin)) {
+                SwapItems(cursor, begin);
+                SiftDown(begin, 0, count, less);
+            }
+        }
+    }
+}  // namespace mtb::impl
+
+template<typename T, typename tLessProc>
+void mtb::SliceNthElement(tSlice<T> slice, ptrdiff_t nth, tLessProc less) {
+    MTB_ASSERT(IsValidIndex(slice, nth));
+    T* begin = slice.ptr;
+    T* end = slice.ptr + slice.len;
+    T* target = slice.ptr + nth;
+    int bad_allowed = 2 * Log2Floor((uint64_t)slice.len);
+
+    while(end - begin >= impl::sort_insertion_threshold) {
+        ptrdiff_t size = end - begin;
+        ptrdiff_t s2 = size / 2;
+        if(size > impl::sort_ninther_threshold) {
+            impl::Sort3(begin, begin + s2, end - 1, less);
+            impl::Sort3(begin + 1, begin + (s2 - 1), end - 2, less);
+            impl::Sort3(begin + 2, begin + (s2 + 1), end - 3, less);
+            impl::Sort3(begin + (s2 - 1), begin + s2, begin + (s2 + 1), less);
+            impl::SwapItems(begin, begin + s2);
+        } else {
+            impl::Sort3(begin + s2, begin, end - 1, less);
+        }
+
+        T* pivot = impl::PartitionRight<MTB_IS_POD(T)>(begin, end, less).pivot;
+        if(pivot == target) {
+            return;
+        }
+
+        ptrdiff_t l_size = pivot - begin;
+        ptrdiff_t r_size = end - (pivot + 1);
+        if((l_size < size / 8 || r_size < size / 8) && --bad_allowed == 0) {
+            // Select the target among the remaining items with a heap: put the (target - begin + 1) smallest items
+            // in front, the greatest of them first, and move that one into place.
+            ptrdiff_t count = target - begin + 1;
+            impl::HeapSelect(begin, end, count, less);
+            impl::SwapItems(begin, target);
+            return;
+        }
+
+        if(target < pivot) {
+            end = pivot;
+        } else {
+            begin = pivot + 1;
+        }
+    }
+
+    impl::InsertionSort(begin, end, less);
+}
+
+template<typename T, typename tLessProc>
+void mtb::SlicePartialSort(tSlice<T> slice, ptrdiff_t count, tLessProc less) {
+    if(count >= slice.len) {
+        SortSlice(slice, less);
+    } else if(count > 0) {
+        SliceNthElement(slice, count - 1, less);
+        SortSlice(SliceRange(slice, 0, count - 1), less);
+    }
+}
+
+namespace mtb {
+    /// Streaming accumulator for the \a capacity greatest items by tLessProc, e.g. the best scores. Items are kept in a
+    /// min-heap, so the worst of the kept items acts as a threshold that rejects most candidates with one comparison.
+    /// Accumulators filled on separate threads can be merged afterwards.
+    template<typename T, typename tLessProc = tLess>
+    struct tTopK {
+        /// May not be null.
+        tAllocator allocator;
+
+        tLessProc less;
+
+        /// The allocation. items[0] is the worst of the first len items.
+        tSlice<T> items;
+
+        /// Number of items currently kept.
+        ptrdiff_t len;
+
+        MTB_NODISCARD ptrdiff_t Capacity() const { return items.len; }
+
+        /// The worst item that is currently kept, or null while there is still room for more.
+        MTB_NODISCARD T const* Threshold() const { return len > 0 && len == items.len ? items.ptr : nullptr; }
+    };
+
+    template<typename T, typename tLessProc = tLess>
+    MTB_NODISCARD tTopK<T, tLessProc> CreateTopK(tAllocator allocator, ptrdiff_t capacity, tLessProc less = {}) {
+        tTopK<T, tLessProc> result{allocator, less};
+        result.items = allocator.template AllocArray<T>(capacity, kNoInit);
+        return result;
+    }
+
+    template<typename T, typename tLessProc>
+    void Clear(tTopK<T, tLessProc>& top) {
+        DestructItems(top.items.ptr, (size_t)top.len);
+        top.len = 0;
+    }
+
+    template<typename T, typename tLessProc>
+    void ClearAllocation(tTopK<T, tLessProc>& top) {
+        Clear(top);
+        top.allocator.FreeArray(top.items);
+        top.items = {};
+    }
+
+    /// Returns false if \a item was rejected because all kept items are better.
+    template<typename T, typename tLessProc>
+    bool Push(tTopK<T, tLessProc>& top, T const& item) {
+        impl::tReverseLess<tLessProc> greater{&top.less};
+        if(top.len < top.items.len) {
+            // Still filling up. Sift the new item up the min-heap.
+            ptrdiff_t index = top.len++;
+            new(top.items.ptr + index) T(item);
+            while(index > 0) {
+                ptrdiff_t parent = (index - 1) / 2;
+                if(!greater(top.items[parent], top.items[index])) {
+                    break;
+                }
+                impl::SwapItems(top.items.ptr + parent, top.items.ptr + index);
+                index = parent;
+            }
+            return true;
+        }
+
+        if(top.len == 0 || !top.less(top.items[0], item)) {
+            return false;
+        }
+        top.items[0] = item;
+        impl::SiftDown(top.items.ptr, 0, top.len, greater);
+        return true;
+    }
+
+    template<typename T, typename tLessProc, typename U>
+    void PushMany(tTopK<T, tLessProc>& top, tSlice<U> items) {
+        for(T const& item : items) {
+            Push(top, item);
+        }
+    }
+
+    /// Add all items kept by \a src to \a dest.
+    template<typename T, typename tLessProc>
+    void Merge(tTopK<T, tLessProc>& dest, tTopK<T, tLessProc> const& src) {
+        PushMany(dest, SliceRange(tSlice<T const>(src.items), 0, src.len));
+    }
+
+    /// Sort the kept items best first and return them. The items are still owned by \a top and stay valid until it is
+    /// cleared. The accumulator is no longer a heap afterwards, so Clear it before pushing again.
+    template<typename T, typename tLessProc>
+    tSlice<T> FinishTopK(tTopK<T, tLessProc>& top) {
+        // Heap sort on the min-heap moves the worst items to the back.
+        impl::tReverseLess<tLessProc> greater{&top.less};
+        for(ptrdiff_t last = top.len - 1; last > 0; --last) {
+            impl::SwapItems(top.items.ptr, top.items.ptr + last);
+            impl::SiftDown(top.items.ptr, 0, last, greater);
+        }
+        return SliceRange(top.items, 0, top.len);
+    }
+}  // namespace mtb
+
+namespace mtb::impl {
+    inline void PrefetchRead(void const* ptr) {
+#if MTB_COMPILER_MSVC && !MTB_COMPILER_CLANG
+        _mm_prefetch((char const*)ptr, _MM_HINT_T0);
+#else
+        __builtin_prefetch(ptr);
+#endif
+    }
+
+    template<typename T, typename tPredicate>
+    ptrdiff_t BranchlessPartitionPoint(tSlice<T> slice, tPredicate& predicate) {
+        if(slice.len == 0) {
+            return 0;
+        }
+        T* base = slice.ptr;
+        ptrdiff_t len = slice.len;
+        while(len > 1) {
+            ptrdiff_t half = len / 2;
+            PrefetchRead(base + half / 2);
+            PrefetchRead(base + half + half / 2);
+            base = predicate(base[half]) ? base + half : base;
+            len -= half;
+        }
+        return (base - slice.ptr) + predicate(*base);
+    }
+}  // namespace mtb::impl
+
+template<typename T, typename K, typename tLessProc>
+ptrdiff_t mtb::SliceLowerBound(tSlice<T> slice, K const& key, tLessProc less) {
+    auto predicate = [&](T const& item) { return less(item, key); };
+    return impl::BranchlessPartitionPoint(slice, predicate);
+}
+
+template<typename T, typename K, typename tLessProc>
+ptrdiff_t mtb::SliceUpperBound(tSlice<T> slice, K const& key, tLessProc less) {
+    auto predicate = [&](T const& item) { return !less(key, item); };
+    return impl::BranchlessPartitionPoint(slice, predicate);
+}
+
+template<typename T, typename K, typename tLessProc>
+mtb::tSlice<T> mtb::SliceEqualRange(tSlice<T> slice, K const& key, tLessProc less) {
+    ptrdiff_t begin = SliceLowerBound(slice, key, less);
+    ptrdiff_t end = begin + SliceUpperBound(SliceOffset(slice, begin), key, less);
+    return SliceBetween(slice, begin, end);
+}
+
+namespace mtb::impl {
+    /// Use galloping once one list is this many times longer than the other.
+    constexpr ptrdiff_t set_op_gallop_ratio = 32;
+
+    /// Position of the first item in [begin, end) that is not less than \a key. Exponential then binary search.
+    template<typename T, typename K, typename tLessProc>
+    ptrdiff_t GallopForward(T const* items, ptrdiff_t begin, ptrdiff_t end, K const& key, tLessProc& less) {
+        ptrdiff_t step = 1;
+        ptrdiff_t lower = begin;
+        while(lower + step < end && less(items[lower + step], key)) {
+            lower += step;
+            step *= 2;
+        }
+        ptrdiff_t upper = lower + step < end ? lower + step + 1 : end;
+        return lower + SliceLowerBound(PtrSlice(items + lower, upper - lower), key, less);
+    }
+
+    // Appends to reserved but unused capacity of an array.
+    template<typename T>
+    struct tSetOpWriter {
+        T* ptr;
+        ptrdiff_t len;
+
+        template<typename U>
+        void Put(U const& item) {
+            new(ptr + len++) T(item);
+        }
+    };
+
+    template<typename T>
+    tSetOpWriter<T> BeginSetOp(tArray<T>& out, ptrdiff_t max_count) {
+        if(!Reserve(out, out.len + max_count)) {
+            return {};
+        }
+        return {out.ptr + out.len, 0};
+    }
+
+    template<typename T>
+    tSlice<T> FinishSetOp(tArray<T>& out, tSetOpWriter<T> writer) {
+        tSlice<T> result = PtrSlice(writer.ptr, writer.len);
+        out.len += writer.len;
+        return result;
+    }
+
+    template<typename T, typename A, typename B, typename tLessProc>
+    void IntersectScalar(tSetOpWriter<T>& writer, A const* a, ptrdiff_t len_a, B const* b, ptrdiff_t len_b, tLessProc& less) {
+        if(len_a > len_b) {
+            IntersectScalar(writer, b, len_b, a, len_a, less);
+            return;
+        }
+        ptrdiff_t i = 0;
+        ptrdiff_t j = 0;
+        if(len_b / set_op_gallop_ratio > len_a) {
+            for(; i < len_a && j < len_b; ++i) {
+                j = GallopForward(b, j, len_b, a[i], less);
+                if(j < len_b && !less(a[i], b[j])) {
+                    writer.Put(a[i]);
+                    ++j;
+                }
+            }
+            return;
+        }
+        while(i < len_a && j < len_b) {
+            if(less(a[i], b[j])) {
+                ++i;
+            } else if(less(b[j], a[i])) {
+                ++j;
+            } else {
+                writer.Put(a[i]);
+                ++i;
+                ++j;
+            }
+        }
+    }
+
+    /// \a matched has a bit set for each of the first four items of \a a that is known to be in \a b.
+    template<typename T, typename A, typename B, typename tLessProc>
+    void DifferenceScalar(tSetOpWriter<T>& writer, A const* a, ptrdiff_t len_a, B const* b, ptrdiff_t len_b, int matched, tLessProc& less) {
+        bool gallop = len_b / set_op_gallop_ratio > len_a;
+        ptrdiff_t j = 0;
+        for(ptrdiff_t i = 0; i < len_a; ++i) {
+            if(i < 4 && ((matched >> i) & 1)) {
+                continue;
+            }
+            if(gallop) {
+                j = GallopForward(b, j, len_b, a[i], less);
+            } else {
+                while(j < len_b && less(b[j], a[i])) {
+                    ++j;
+                }
+            }
+            if(j == len_b || less(a[i], b[j])) {
+                writer.Put(a[i]);
+            }
+        }
+    }
+
+#if MTB_USE_SSSE3
+    /// Bit i is set if lane i of \a a equals any lane of \a b.
+    inline int MatchLanes(__m128i a, __m128i b) {
+        __m128i match = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(a, b), _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2))), _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3))))
+        );
+        return _mm_movemask_ps(_mm_castsi128_ps(match));
+    }
+
+    /// Store the lanes of \a a selected by \a mask. Writes 16 bytes, so there must be room for 3 more items.
+    template<typename T>
+    void PutLanes(tSetOpWriter<T>& writer, __m128i a, int mask) {
+        __m128i shuffle = _mm_loadu_si128((__m128i const*)compress_table.bytes[mask]);
+        _mm_storeu_si128((__m128i*)(writer.ptr + writer.len), _mm_shuffle_epi8(a, shuffle));
+        writer.len += CountSetBits((uint64_t)mask);
+    }
+
+    template<typename T>
+    void IntersectBlocks(tSetOpWriter<T>& writer, T const* a, ptrdiff_t len_a, T const* b, ptrdiff_t len_b) {
+        ptrdiff_t i = 0;
+        ptrdiff_t j = 0;
+        while(i + 4 <= len_a && j + 4 <= len_b) {
+            __m128i block_a = _mm_loadu_si128((__m128i const*)(a + i));
+            __m128i block_b = _mm_loadu_si128((__m128i const*)(b + j));
+            PutLanes(writer, block_a, MatchLanes(block_a, block_b));
+
+            T max_a = a[i + 3];
+            T max_b = b[j + 3];
+            i += (max_a <= max_b) * 4;
+            j += (max_b <= max_a) * 4;
+        }
+        tLess less;
+        IntersectScalar(writer, a + i, len_a - i, b + j, len_b - j, less);
+    }
+
+    template<typename T>
+    void DifferenceBlocks(tSetOpWriter<T>& writer, T const* a, ptrdiff_t len_a, T const* b, ptrdiff_t len_b) {
+        ptrdiff_t i = 0;
+        ptrdiff_t j = 0;
+        int matched = 0;
+        while(i + 4 <= len_a && j + 4 <= len_b) {
+            __m128i block_a = _mm_loadu_si128((__m128i const*)(a + i));
+            __m128i block_b = _mm_loadu_si128((__m128i const*)(b + j));
+            matched |= MatchLanes(block_a, block_b);
+
+            T max_a = a[i + 3];
+            T max_b = b[j + 3];
+            if(max_a <= max_b) {
+                // The block of a has met all blocks of b it could match.
+                PutLanes(writer, block_a, ~matched & 0xF);
+                matched = 0;
+                i += 4;
+            }
+            j += (max_b <= max_a) * 4;
+        }
+        tLess less;
+        DifferenceScalar(writer, a + i, len_a - i, b + j, len_b - j, matched, less);
+    }
+#endif
+
+    template<bool UseBlocks>
+    struct tSetOps {
+        template<typename T, typename A, typename B, typename tLessProc>
+        static void Intersect(tSetOpWriter<T>& writer, tSlice<A> a, tSlice<B> b, tLessProc& less) {
+            IntersectScalar(writer, a.ptr, a.len, b.ptr, b.len, less);
+        }
+
+        template<typename T, typename A, typename B, typename tLessProc>
+        static void Difference(tSetOpWriter<T>& writer, tSlice<A> a, tSlice<B> b, tLessProc& less) {
+            DifferenceScalar(writer, a.ptr, a.len, b.ptr, b.len, 0, less);
+        }
+    };
+
+#if MTB_USE_SSSE3
+    template<>
+    struct tSetOps<true> {
+        template<typename T, typename A, typename B, typename tLessProc>
+        static void Intersect(tSetOpWriter<T>& writer, tSlice<A> a, tSlice<B> b, tLessProc& less) {
+            if(a.len / set_op_gallop_ratio > b.len || b.len / set_op_gallop_ratio > a.len) {
+                IntersectScalar(writer, a.ptr, a.len, b.ptr, b.len, less);
+            } else {
+                IntersectBlocks(writer, (T const*)a.ptr, a.len, (T const*)b.ptr, b.len);
+            }
+        }
+
+        template<typename T, typename A, typename B, typename tLessProc>
+        static void Difference(tSetOpWriter<T>& writer, tSlice<A> a, tSlice<B> b, tLessProc& less) {
+            if(b.len / set_op_gallop_ratio > a.len) {
+                DifferenceScalar(writer, a.ptr, a.len, b.ptr, b.len, 0, less);
+            } else {
+                DifferenceBlocks(writer, (T const*)a.ptr, a.len, (T const*)b.ptr, b.len);
+            }
+        }
+    };
+
+    template<typename T, typename A, typename B, typename tLessProc>
+    struct tUseSetOpBlocks {
+        static constexpr bool value = (tIsSame<T, uint32_t>::value || tIsSame<T, int32_t>::value) && tIsSame<tRemoveConst<A>, T>::value &&
+                                      tIsSame<tRemoveConst<B>, T>::value && tIsSame<tLessProc, tLess>::value;
+    };
+#else
+    template<typename T, typename A, typename B, typename tLessProc>
+    struct tUseSetOpBlocks {
+        static constexpr bool value = false;
+    };
+#endif
+
+    /// Room needed for the SIMD kernels to store whole blocks.
+    constexpr ptrdiff_t set_op_slack = 4;
+}  // namespace mtb::impl
+
+template<typename T, typename A, typename B, typename tLessProc>
+mtb::tSlice<T> mtb::SliceIntersectSorted(tArray<T>& out, tSlice<A> a, tSlice<B> b, tLessProc less) {
+    impl::tSetOpWriter<T> writer = impl::BeginSetOp(out, (a.len < b.len ? a.len : b.len) + impl::set_op_slack);
+    if(writer.ptr) {
+        impl::tSetOps<impl::tUseSetOpBlocks<T, A, B, tLessProc>::value>::Intersect(writer, a, b, less);
+    }
+    return impl::FinishSetOp(out, writer);
+}
+
+template<typename T, typename A, typename B, typename tLessProc>
+mtb::tSlice<T> mtb::SliceDifferenceSorted(tArray<T>& out, tSlice<A> a, tSlice<B> b, tLessProc less) {
+    impl::tSetOpWriter<T> writer = impl::BeginSetOp(out, a.len + impl::set_op_slack);
+    if(writer.ptr) {
+        impl::tSetOps<impl::tUseSetOpBlocks<T, A, B, tLessProc>::value>::Difference(writer, a, b, less);
+    }
+    return impl::FinishSetOp(out, writer);
+}
+
+template<typename T, typename A, typename B, typename tLessProc>
+mtb::tSlice<T> mtb::SliceUnionSorted(tArray<T>& out, tSlice<A> a, tSlice<B> b, tLessProc less) {
+    impl::tSetOpWriter<T> writer = impl::BeginSetOp(out, a.len + b.len);
+    if(!writer.ptr) {
+        return {};
+    }
+
+    ptrdiff_t i = 0;
+    ptrdiff_t j = 0;
+    if(a.len / impl::set_op_gallop_ratio > b.len || b.len / impl::set_op_gallop_ratio > a.len) {
+        // Copy whole stretches of the long list between the items of the short one.
+        bool a_is_long = a.len > b.len;
+        while(i < a.len && j < b.len) {
+            if(a_is_long) {
+                ptrdiff_t next = impl::GallopForward(a.ptr, i, a.len, b[j], less);
+                for(; i < next; ++i) {
+                    writer.Put(a[i]);
+                }
+                if(i < a.len && !less(b[j], a[i])) {
+                    ++i;
+                }
+                writer.Put(b[j++]);
+            } else {
+                ptrdiff_t next = impl::GallopForward(b.ptr, j, b.len, a[i], less);
+                for(; j < next; ++j) {
+                    writer.Put(b[j]);
+                }
+                if(j < b.len && !less(a[i], b[j])) {
+                    ++j;
+                }
+                writer.Put(a[i++]);
+            }
+        }
+    } else {
+        while(i < a.len && j < b.len) {
+            if(less(a[i], b[j])) {
+                writer.Put(a[i++]);
+            } else if(less(b[j], a[i])) {
+                writer.Put(b[j++]);
+            } else {
+                writer.Put(a[i++]);
+                ++j;
+            }
+        }
+    }
+    for(; i < a.len; ++i) {
+        writer.Put(a[i]);
+    }
+    for(; j < b.len; ++j) {
+        writer.Put(b[j]);
+    }
+    return impl::FinishSetOp(out, writer);
+}
+
+template<typename T, typename L, typename tLessProc>
+mtb::tSlice<T> mtb::SliceIntersectSortedMany(tArray<T>& out, tSlice<L> lists, tLessProc less) {
+    if(lists.len == 0) {
+        return {};
+    }
+    if(lists.len == 1) {
+        impl::tSetOpWriter<T> writer = impl::BeginSetOp(out, lists[0].len);
+        if(writer.ptr) {
+            for(auto const& item : lists[0]) {
+                writer.Put(item);
+            }
+        }
+        return impl::FinishSetOp(out, writer);
+    }
+
+    // Order the lists by length. The shortest two are intersected first, the others only narrow the result down.
+    tSlice<ptrdiff_t> order = out.allocator.template AllocArray<ptrdiff_t>(lists.len, kNoInit);
+    if(!order) {
+        return {};
+    }
+    for(ptrdiff_t index = 0; index < lists.len; ++index) {
+        order[index] = index;
+    }
+    SortSlice(order, [&](ptrdiff_t x, ptrdiff_t y) { return lists[x].len < lists[y].len; });
+
+    ptrdiff_t begin = out.len;
+    SliceIntersectSorted(out, lists[order[0]], lists[order[1]], less);
+    for(ptrdiff_t index = 2; index < lists.len && out.len > begin; ++index) {
+        // Filter the result in place, it can only get shorter.
+        auto list = lists[order[index]];
+        ptrdiff_t write = begin;
+        ptrdiff_t cursor = 0;
+        for(ptrdiff_t read = begin; read < out.len && cursor < list.len; ++read) {
+            cursor = impl::GallopForward(list.ptr, cursor, list.len, out[read], less);
+            if(cursor < list.len && !less(out[read], list[cursor])) {
+                out[write++] = out[read];
+            }
+        }
+        DestructItems(out.ptr + write, (size_t)(out.len - write));
+        out.len = write;
+    }
+
+    out.allocator.FreeArray(order);
+    return SliceBetween(out.items, begin, out.len);
+}
+
+template<typename T, typename L, typename tLessProc>
+mtb::tSlice<T> mtb::SliceUnionSortedMany(tArray<T>& out, tSlice<L> lists, tLessProc less) {
+    struct tCursor {
+        ptrdiff_t list;
+        ptrdiff_t index;
+    };
+
+    ptrdiff_t total = 0;
+    for(ptrdiff_t index = 0; index < lists.len; ++index) {
+        total += lists[index].len;
+    }
+    tSlice<tCursor> heap = out.allocator.template AllocArray<tCursor>(lists.len, kNoInit);
+    impl::tSetOpWriter<T> writer = impl::BeginSetOp(out, total);
+    if(!heap || !writer.ptr) {
+        out.allocator.FreeArray(heap);
+        return {};
+    }
+
+    // Min-heap of cursors by their current item.
+    auto greater = [&](tCursor const& x, tCursor const& y) { return less(lists[y.list][y.index], lists[x.list][x.index]); };
+    ptrdiff_t heap_len = 0;
+    for(ptrdiff_t index = 0; index < lists.len; ++index) {
+        if(lists[index].len > 0) {
+            heap[heap_len++] = {index, 0};
+        }
+    }
+    for(ptrdiff_t index = heap_len / 2; index > 0; --index) {
+        impl::SiftDown(heap.ptr, index - 1, heap_len, greater);
+    }
+
+    while(heap_len > 0) {
+        tCursor& top = heap[0];
+        auto const& item = lists[top.list][top.index];
+        if(writer.len == 0 || less(writer.ptr[writer.len - 1], item)) {
+            writer.Put(item);
+        }
+        if(++top.index == lists[top.list].len) {
+            heap[0] = heap[--heap_len];
+        }
+        if(heap_len > 0) {
+            impl::SiftDown(heap.ptr, 0, heap_len, greater);
+        }
+    }
+
+    out.allocator.FreeArray(heap);
+    return impl::FinishSetOp(out, writer);
+}
+
+namespace mtb {
+    /// Read-only search structure over sorted items, stored in Eytzinger (BFS) order: the children of the item at
+    /// index k are at 2k and 2k + 1. The first levels of the tree share a few cache lines, and the grandchildren four
+    /// levels down are contiguous, so they can be prefetched while the search proceeds. Use this instead of
+    /// SliceLowerBound for large lookup tables that are searched often.
+    template<typename T>
+    struct tEytzingerIndex {
+        /// May not be null.
+        tAllocator allocator;
+
+        /// The allocation. The tree starts at index 1, items[0] is unused.
+        tSlice<T> items;
+
+        MTB_NODISCARD ptrdiff_t Count() const { return items.len > 0 ? items.len - 1 : 0; }
+    };
+
+    namespace impl {
+        template<typename T, typename U>
+        ptrdiff_t EytzingerFill(tSlice<T> tree, tSlice<U> sorted, ptrdiff_t sorted_index, ptrdiff_t tree_index) {
+            if(tree_index < tree.len) {
+                sorted_index = EytzingerFill(tree, sorted, sorted_index, 2 * tree_index);
+                new(tree.ptr + tree_index) T(sorted[sorted_index++]);
+                sorted_index = EytzingerFill(tree, sorted, sorted_index, 2 * tree_index + 1);
+            }
+            return sorted_index;
+        }
+
+        /// Tree index of the first item for which predicate(item) is false, or 0 if there is none.
+        template<typename T, typename tPredicate>
+        ptrdiff_t EytzingerPartitionPoint(tEytzingerIndex<T> const& index, tPredicate& predicate) {
+            // 16 descendants four levels down lie next to each other.
+            constexpr ptrdiff_t prefetch_stride = 16;
+            T const* items = index.items.ptr;
+            uintptr_t tree_len = (uintptr_t)index.items.len;
+            uintptr_t k = 1;
+            while(k < tree_len) {
+                PrefetchRead((uint8_t const*)items + (k * prefetch_stride) * sizeof(T));
+                k = 2 * k + (uintptr_t)predicate(items[k]);
+            }
+            // Going right means the item was less. Undo the right turns at the end of the path and the last left turn.
+            k >>= CountTrailingZeros(~(uint64_t)k) + 1;
+            return (ptrdiff_t)k;
+        }
+    }  // namespace impl
+
+    template<typename T, typename U>
+    MTB_NODISCARD tEytzingerIndex<T> CreateEytzingerIndex(tAllocator allocator, tSlice<U> sorted) {
+        tEytzingerIndex<T> result{allocator};
+        if(sorted.len > 0) {
+            result.items = allocator.template AllocArray<T>(sorted.len + 1, kClearToZero);
+            if(result.items) {
+                impl::EytzingerFill(result.items, sorted, 0, 1);
+            }
+        }
+        return result;
+    }
+
+    template<typename T>
+    void ClearAllocation(tEytzingerIndex<T>& index) {
+        if(index.items) {
+            DestructItems(index.items.ptr + 1, (size_t)index.items.len - 1);
+            index.allocator.FreeArray(index.items);
+            index.items = {};
+        }
+    }
+
+    /// First item that is not less than \a key, or null.
+    template<typename T, typename K, typename tLessProc = tLess>
+    MTB_NODISCARD T const* LowerBound(tEytzingerIndex<T> const& index, K const& key, tLessProc less = {}) {
+        auto predicate = [&](T const& item) { return less(item, key); };
+        ptrdiff_t k = impl::EytzingerPartitionPoint(index, predicate);
+        return k ? index.items.ptr + k : nullptr;
+    }
+
+    /// First item that is greater than \a key, or null.
+    template<typename T, typename K, typename tLessProc = tLess>
+    MTB_NODISCARD T const* UpperBound(tEytzingerIndex<T> const& index, K const& key, tLessProc less = {}) {
+        auto predicate = [&](T const& item) { return !less(key, item); };
+        ptrdiff_t k = impl::EytzingerPartitionPoint(index, predicate);
+        return k ? index.items.ptr + k : nullptr;
+    }
+
+    /// An item equal to \a key, or null.
+    template<typename T, typename K, typename tLessProc = tLess>
+    MTB_NODISCARD T const* Find(tEytzingerIndex<T> const& index, K const& key, tLessProc less = {}) {
+        T const* result = LowerBound(index, key, less);
+        return result && !less(key, *result) ? result : nullptr;
+    }
+}  // namespace mtb
+
+template<typename T, typename tLessProc>
+bool mtb::ParallelSortSlice(tSlice<T> slice, tTaskRunner runner, tAllocator allocator, tLessProc less) {
+    static_assert(MTB_IS_TRIVIALLY_RELOCATABLE(T), "Parallel sort moves items with memcpy.");
+
+    if(slice.len < MTB_PARALLEL_SORT_GRAIN_SIZE || !runner || runner.worker_count < 2) {
+        SortSlice(slice, less);
+        return true;
+    }
+
+    impl::tSampleSort<T, tLessProc> sort{};
+    sort.items = slice;
+    sort.less = &less;
+
+    // More buckets than workers even out differences in bucket size.
+    sort.bucket_count = runner.worker_count * 8;
+    if(sort.bucket_count > slice.len / MTB_PARALLEL_SORT_GRAIN_SIZE) {
+        sort.bucket_count = slice.len / MTB_PARALLEL_SORT_GRAIN_SIZE;
+    }
+    if(sort.bucket_count > impl::sample_sort_max_bucket_count) {
+        sort.bucket_count = impl::sample_sort_max_bucket_count;
+    }
+    if(sort.bucket_count < 2) {
+        sort.bucket_count = 2;
+    }
+    sort.block_count = runner.worker_count;
+    sort.block_len = (slice.len + sort.block_count - 1) / sort.block_count;
+
+    ptrdiff_t sample_count = sort.bucket_count * impl::sample_sort_oversampling;
+    tSlice<T> scratch = allocator.template AllocArray<T>(slice.len, kNoInit);
+    tSlice<uint8_t> bucket_ids = allocator.template AllocArray<uint8_t>(slice.len, kNoInit);
+    tSlice<ptrdiff_t> offsets = allocator.template AllocArray<ptrdiff_t>(sort.block_count * sort.bucket_count + sort.bucket_count + 1, kClearToZero);
+    tSlice<ptrdiff_t> samples = allocator.template AllocArray<ptrdiff_t>(sample_count, kNoInit);
+    tSlice<T const*> splitters = allocator.template AllocArray<T const*>(sort.bucket_count - 1, kNoInit);
+    bool result = scratch && bucket_ids && offsets && samples && splitters;
+
+    if(result) {
+        sort.scratch = scratch.ptr;
+        sort.bucket_ids = bucket_ids.ptr;
+        sort.block_offsets = offsets.ptr;
+        sort.bucket_offsets = offsets.ptr + sort.block_count * sort.bucket_count;
+        sort.splitters = splitters.ptr;
+
+        // Evenly spaced samples, sorted by index so the items themselves stay untouched.
+        for(ptrdiff_t index = 0; index < sample_count; ++index) {
+            samples[index] = index * (slice.len / sample_count) + (index * 7919) % (slice.len / sample_count);
+        }
+        SortSlice(samples, [&](ptrdiff_t a, ptrdiff_t b) { return less(slice.ptr[a], slice.ptr[b]); });
+        for(ptrdiff_t index = 1; index < sort.bucket_count; ++index) {
+            sort.splitters[index - 1] = slice.ptr + samples[index * impl::sample_sort_oversampling];
+        }
+
+        RunTasks(runner, sort.block_count, impl::SampleSortCountTask<T, tLessProc>, &sort);
+
+        // Bucket-major prefix sum, so every block scatters to its own range within each bucket.
+        ptrdiff_t offset = 0;
+        for(ptrdiff_t bucket = 0; bucket < sort.bucket_count; ++bucket) {
+            sort.bucket_offsets[bucket] = offset;
+            for(ptrdiff_t block = 0; block < sort.block_count; ++block) {
+                ptrdiff_t& block_offset = sort.block_offsets[block * sort.bucket_count + bucket];
+                ptrdiff_t count = block_offset;
+                block_offset = offset;
+                offset += count;
+            }
+        }
+        sort.bucket_offsets[sort.bucket_count] = offset;
+
+        RunTasks(runner, sort.block_count, impl::SampleSortScatterTask<T, tLessProc>, &sort);
+        RunTasks(runner, sort.bucket_count, impl::SampleSortBucketTask<T, tLessProc>, &sort);
+    }
+
+    allocator.FreeArray(splitters);
+    allocator.FreeArray(samples);
+    allocator.FreeArray(offsets);
+    allocator.FreeArray(bucket_ids);
+    allocator.FreeArray(scratch);
+    return result;
+}
+
+namespace mtb {
+    namespace impl {
+        /// Inputs with more items than this are radix-partitioned by hash before grouping.
+        constexpr ptrdiff_t group_by_partition_threshold = 1 << 16;
+
+        /// Target number of items per partition, so that the table and keys of one partition stay in L2.
+        constexpr ptrdiff_t group_by_partition_len = 1 << 13;
+
+        constexpr int group_by_max_partition_bits = 8;
+
+        /// Spread the entropy of a user hash function into the high bits, which pick partitions and table slots.
+        MTB_NODISCARD inline uint64_t MixHash(uint64_t hash) {
+            return (hash ^ (hash >> 32)) * 0x9E3779B97F4A7C15ULL;
+        }
+
+        struct tIndexSlot {
+            uint64_t hash;
+
+            /// -1 if the slot is free.
+            ptrdiff_t index;
+        };
+
+        inline void ClearIndexTable(tSlice<tIndexSlot> table) {
+            for(tIndexSlot& slot : table) {
+                slot.index = -1;
+            }
+        }
+
+        /// Look up \a key, starting at \a slot. Returns the index of an equal item in \a keys, or adds \a new_index to
+        /// the table and returns it. Keys are only compared if their hashes are equal.
+        template<typename K>
+        ptrdiff_t FindOrAddIndex(tSlice<tIndexSlot> table, size_t slot, uint64_t hash, K const* keys, K const& key, ptrdiff_t new_index, tMapCompareFunc compare_func) {
+            size_t mask = (size_t)table.len - 1;
+            while(true) {
+                tIndexSlot& entry = table.ptr[slot];
+                if(entry.index < 0) {
+                    entry.hash = hash;
+                    entry.index = new_index;
+                    return new_index;
+                }
+                if(entry.hash == hash && compare_func(keys + entry.index, &key, sizeof(K)) == 0) {
+                    return entry.index;
+                }
+                slot = (slot + 1) & mask;
+            }
+        }
+    }  // namespace impl
+
+    /// The result of GroupBy: the distinct keys in order of first appearance, and one row per key with the items that
+    /// have it, in input order. groups.items[g] are the items with key groups.keys[g].
+    template<typename K, typename T>
+    struct tGroups {
+        tArray<K> keys;
+        tJaggedArray<T> items;
+    };
+
+    template<typename K, typename T>
+    void ClearAllocation(tGroups<K, T>& groups) {
+        ClearAllocation(groups.keys);
+        ClearAllocation(groups.items);
+    }
+
+    /// Group copies of \a items by key_proc(item), with keys hashed and compared like tMap keys. Both the result and
+    /// scratch memory come from \a allocator. If an allocation fails, the result is empty.
+    ///
+    /// Large inputs are first partitioned by the high bits of the key hash, then grouped one partition at a time so
+    /// the lookup table of each partition fits in cache.
+    template<typename T, typename tKeyProc>
+    MTB_NODISCARD auto GroupBy(tSlice<T> items, tAllocator allocator, tKeyProc key_proc, tMapHashFunc hash_func, tMapCompareFunc compare_func)
+        -> tGroups<tDecay<decltype(key_proc(items[0]))>, tDecay<T>> {
+        using K = tDecay<decltype(key_proc(items[0]))>;
+        using V = tDecay<T>;
+        MTB_ASSERT(allocator && hash_func && compare_func);
+
+        tGroups<K, V> result{};
+        result.keys.allocator = allocator;
+        result.items.allocator = allocator;
+        if(items.len == 0) {
+            return result;
+        }
+
+        int partition_bits = 0;
+        if(items.len > impl::group_by_partition_threshold) {
+            partition_bits = Log2Ceil((uint64_t)(items.len / impl::group_by_partition_len));
+            if(partition_bits > impl::group_by_max_partition_bits) {
+                partition_bits = impl::group_by_max_partition_bits;
+            }
+        }
+        ptrdiff_t partition_count = (ptrdiff_t)1 << partition_bits;
+
+        tSlice<uint64_t> hashes = allocator.template AllocArray<uint64_t>(items.len, kNoInit);
+        tSlice<ptrdiff_t> group_ids = allocator.template AllocArray<ptrdiff_t>(items.len, kNoInit);
+        tSlice<ptrdiff_t> partition_offsets = allocator.template AllocArray<ptrdiff_t>(partition_count + 1, kClearToZero);
+        tSlice<ptrdiff_t> order{};
+        tSlice<impl::tIndexSlot> table{};
+        tArray<ptrdiff_t> counts{};
+        counts.allocator = allocator;
+        MTB_DEFER {
+            ClearAllocation(counts);
+            allocator.FreeArray(table);
+            allocator.FreeArray(order);
+            allocator.FreeArray(partition_offsets);
+            allocator.FreeArray(group_ids);
+            allocator.FreeArray(hashes);
+        };
+        if(partition_bits > 0) {
+            order = allocator.template AllocArray<ptrdiff_t>(items.len, kNoInit);
+        }
+        if(!hashes || !group_ids || !partition_offsets || (partition_bits > 0 && !order)) {
+            return result;
+        }
+
+        for(ptrdiff_t index = 0; index < items.len; ++index) {
+            K key = key_proc(items[index]);
+            hashes[index] = impl::MixHash(hash_func(&key, sizeof(K)));
+        }
+
+        if(partition_bits > 0) {
+            // Counting sort of item indices by the top bits of their hash.
+            int partition_shift = 64 - partition_bits;
+            for(ptrdiff_t index = 0; index < items.len; ++index) {
+                ++partition_offsets[(ptrdiff_t)(hashes[index] >> partition_shift) + 1];
+            }
+            for(ptrdiff_t partition = 0; partition < partition_count; ++partition) {
+                partition_offsets[partition + 1] += partition_offsets[partition];
+            }
+            // Use group_ids as write cursors for now.
+            SliceCopyBytes(SliceRange(group_ids, 0, partition_count), SliceRange(partition_offsets, 0, partition_count));
+            for(ptrdiff_t index = 0; index < items.len; ++index) {
+                order[group_ids[(ptrdiff_t)(hashes[index] >> partition_shift)]++] = index;
+            }
+        } else {
+            partition_offsets[1] = items.len;
+        }
+
+        ptrdiff_t max_partition_len = 0;
+        for(ptrdiff_t partition = 0; partition < partition_count; ++partition) {
+            ptrdiff_t partition_len = partition_offsets[partition + 1] - partition_offsets[partition];
+            max_partition_len = partition_len > max_partition_len ? partition_len : max_partition_len;
+        }
+        table = allocator.template AllocArray<impl::tIndexSlot>((ptrdiff_t)1 << Log2Ceil((uint64_t)(2 * max_partition_len)), kNoInit);
+        if(!table) {
+            return result;
+        }
+
+        for(ptrdiff_t partition = 0; partition < partition_count; ++partition) {
+            ptrdiff_t begin = partition_offsets[partition];
+            ptrdiff_t end = partition_offsets[partition + 1];
+            if(begin == end) {
+                continue;
+            }
+
+            // Size the table for this partition. The bits below the partition bits pick the slot.
+            int table_bits = Log2Ceil((uint64_t)(2 * (end - begin)));
+            table_bits = table_bits > 0 ? table_bits : 1;
+            tSlice<impl::tIndexSlot> partition_table = SliceRange(table, 0, (ptrdiff_t)1 << table_bits);
+            impl::ClearIndexTable(partition_table);
+
+            for(ptrdiff_t order_index = begin; order_index < end; ++order_index) {
+                ptrdiff_t index = order ? order[order_index] : order_index;
+                K key = key_proc(items[index]);
+                uint64_t hash = hashes[index];
+                size_t slot = (size_t)((hash << partition_bits) >> (64 - table_bits));
+                ptrdiff_t group = impl::FindOrAddIndex(partition_table, slot, hash, result.keys.ptr, key, result.keys.len, compare_func);
+                if(group == result.keys.len) {
+                    tSlice<ptrdiff_t> count = PushN(counts, 1, kClearToZero);
+                    tSlice<K> new_key = count ? PushN(result.keys, 1, kNoInit) : tSlice<K>{};
+                    if(!new_key) {
+                        ClearAllocation(result.keys);
+                        return result;
+                    }
+                    new(new_key.ptr) K(MoveCast(key));
+                }
+                group_ids[index] = group;
+                ++counts[group];
+            }
+        }
+
+        if(partition_bits > 0) {
+            // Renumber the groups in order of first appearance, like the unpartitioned path does.
+            ptrdiff_t group_count = result.keys.len;
+            tSlice<ptrdiff_t> renumbered = allocator.template AllocArray<ptrdiff_t>(group_count, kNoInit);
+            tSlice<K> keys = allocator.template AllocArray<K>(group_count, kNoInit);
+            if(!renumbered || !keys) {
+                allocator.FreeArray(keys);
+                allocator.FreeArray(renumbered);
+                ClearAllocation(result.keys);
+                return result;
+            }
+            for(ptrdiff_t& group : renumbered) {
+                group = -1;
+            }
+            ptrdiff_t next_group = 0;
+            for(ptrdiff_t& group : group_ids) {
+                if(renumbered[group] < 0) {
+                    renumbered[group] = next_group++;
+                }
+                group = renumbered[group];
+            }
+
+            // The partition order is not needed anymore, so it holds the renumbered counts.
+            for(ptrdiff_t group = 0; group < group_count; ++group) {
+                RelocateItems(keys.ptr + renumbered[group], 1, result.keys.ptr + group, 1);
+                order[renumbered[group]] = counts[group];
+            }
+            RelocateItems(result.keys.ptr, (size_t)group_count, keys.ptr, (size_t)group_count);
+            SliceCopyBytes(counts.items, SliceRange(order, 0, group_count));
+
+            allocator.FreeArray(keys);
+            allocator.FreeArray(renumbered);
+        }
+
+        // Fill the rows in input order. The row offsets double as write cursors and end up one row ahead.
+        result.items.offsets = allocator.template AllocArray<ptrdiff_t>(counts.len + 1, kNoInit);
+        result.items.values = allocator.template AllocArray<V>(items.len, kNoInit);
+        if(!result.items.offsets || !result.items.values) {
+            // No values were constructed yet, so only the keys need destroying.
+            allocator.FreeArray(result.items.values);
+            allocator.FreeArray(result.items.offsets);
+            result.items.values = {};
+            result.items.offsets = {};
+            ClearAllocation(result.keys);
+            return result;
+        }
+        ptrdiff_t offset = 0;
+        for(ptrdiff_t group = 0; group < counts.len; ++group) {
+            result.items.offsets[group + 1] = offset;
+            offset += counts[group];
+        }
+        for(ptrdiff_t index = 0; index < items.len; ++index) {
+            new(result.items.values.ptr + result.items.offsets[group_ids[index] + 1]++) V(items[index]);
+        }
+        result.items.offsets[0] = 0;
+        return result;
+    }
+}  // namespace mtb
+
+template<typename T>
+mtb::tSlice<T> mtb::SliceUnique(tSlice<T> slice, tAllocator scratch, tMapHashFunc hash_func, tMapCompareFunc compare_func) {
+    MTB_ASSERT(hash_func && compare_func);
+    if(slice.len < 2) {
+        return slice;
+    }
+
+    int table_bits = Log2Ceil((uint64_t)(2 * slice.len));
+    tSlice<impl::tIndexSlot> table = scratch.template AllocArray<impl::tIndexSlot>((ptrdiff_t)1 << table_bits, kNoInit);
+    if(!table) {
+        return slice;
+    }
+    impl::ClearIndexTable(table);
+
+    // Compact in place. Items before len are the unique ones, so the table can index into the slice itself.
+    ptrdiff_t len = 0;
+    for(ptrdiff_t index = 0; index < slice.len; ++index) {
+        uint64_t hash = impl::MixHash(hash_func(slice.ptr + index, sizeof(T)));
+        size_t slot = (size_t)(hash >> (64 - table_bits));
+        if(impl::FindOrAddIndex(table, slot, hash, slice.ptr, slice[index], len, compare_func) == len) {
+            if(index != len) {
+                slice[len] = MoveCast(slice[index]);
+            }
+            ++len;
+        }
+    }
+
+    scratch.FreeArray(table);
+    return SliceRange(slice, 0, len);
+}
+
+template<typename T, typename tLessProc>
+mtb::tSlice<T> mtb::SliceSortUnique(tSlice<T> slice, tLessProc less) {
+    SortSlice(slice, less);
+    ptrdiff_t len = slice.len > 0 ? 1 : 0;
+    for(ptrdiff_t index = 1; index < slice.len; ++index) {
+        if(less(slice[len - 1], slice[index])) {
+            if(index != len) {
+                slice[len] = MoveCast(slice[index]);
+            }
+            ++len;
+        }
+    }
+    return SliceRange(slice, 0, len);
+}
+
+// #Note I tried using tOption. In general, I would like something like that
+// very much. However, it's so hard to correctly implement in C++ that I don't
+// think it's worth the effort. one would have to verify on all compilers that
+// it actually behaves as expected with regards to implicit casting and move
+// semantics, and that it doesn't allow implicit casts from T to
+// tOption<T> etc. There's too much uncertainty on little details that could
+// go wrong. So I just disable this here. Maybe at some point in the future
+// (C++20 and beyond?) it might be easier to achieve this kind of thing.
+#if 1
+// --------------------------------------------------
+// -- #Section Option -------------------------------
+// --------------------------------------------------
+#define MTB_OPTION_MOVE_SEMANTICS 0
+
+namespace mtb {
+    template<typename T>
+    struct tOption {
+        bool has_value;
+
+        union {
+            T value;
+        };
+
+        // ReSharper disable once CppPossiblyUninitializedMember
+        tOption()
+            : has_value{false} {
+        }
+
+        tOption(T in_value)
+            : has_value{true} {
+            new(&value) T(MoveCast(in_value));
+        }
+
+#if MTB_OPTION_MOVE_SEMANTICS
+        tOption(T&& in_value)
+            : has_value{true} {
+            new(&value) T(MoveCast(in_value));
+        }
+#endif
+
+        tOption(tOption const& to_copy)
+            : has_value{to_copy.has_value} {
+            if(to_copy.has_value) {
+                new(&value) T(to_copy.value);
+            }
+        }
+
+#if MTB_OPTION_MOVE_SEMANTICS
+        tOption(tOption&& to_move)
+            : has_value{to_move.has_value} {
+            if(to_move.has_value) {
+                new(&value) T(MoveCast(to_move.value));
+            }
+        }
+#endif
+
+        ~tOption() {
+            if(has_value) {
+                value.~T();
+            }
+        }
+
+        tOption& operator=(tOption const& to_copy) {
+            if(&to_copy != this) {
+                if(!has_value && !to_copy.has_value) {
+                    // value stays untouched.
+                } else if(has_value && to_copy.has_value) {
+                    // we had a value, so copy directly.
+                    value = to_copy.value;
+                } else if(!has_value && to_copy.has_value) {
+                    // we didn't have a value before, so construct.
+                    new(&value) T(to_copy.value);
+                    has_value = true;
+                } else if(has_value && !to_copy.has_value) {
+                    // we had a value, so destroy.
+                    value.~T();
+                    has_value = false;
+                }
+            }
+
+            return *this;
+        }
+
+#if MTB_OPTION_MOVE_SEMANTICS
+        tOption& operator=(tOption&& to_move) {
+            if(&to_move != this) {
+                if(!has_value && !to_move.has_value) {
+                    // value stays untouched.
+                } else if(has_value && to_move.has_value) {
+                    // we had a value, so copy directly.
+                    value = (T &&) to_move.value;
+                } else if(!has_value && to_move.has_value) {
+                    // we didn't have a value before, so construct.
+                    new(&value) T((T &&) to_move.value);
+                    has_value = true;
+                } else if(has_value && !to_move.has_value) {
+                    // we had a value, so destroy.
+                    value.~T();
+                    has_value = false;
+                }
+            }
+
+            return *this;
+        }
+#endif
+
+        constexpr operator bool() const { return has_value; }
+
+        MTB_NODISCARD T& Unwrap() {
+            MTB_ASSERT(has_value);
+            return value;
+        }
+    };
+
+    template<typename T>
+    MTB_NODISCARD constexpr bool operator==(tOption<T> const& a, tOption<T> const& b) {
+        return (!a.has_value && !b.has_value) || (a.has_value && b.has_value && a.value == b.value);
+    }
+
+    template<typename T>
+    MTB_NODISCARD constexpr bool operator!=(tOption<T> const& a, tOption<T> const& b) {
+        return !(a == b);
+    }
+}  // namespace mtb
+#endif
+
+// --------------------------------------------------
+// -- #Section Arena --------------------------------
+// --------------------------------------------------
+
+// #Option
+#if !defined(MTB_ARENA_DEFAULT_BUCKET_SIZE)
+#define MTB_ARENA_DEFAULT_BUCKET_SIZE 4096
+#endif
+
+// #Option Number of cached buckets per size class in a tArenaBucketPool.
+#if !defined(MTB_ARENA_BUCKET_POOL_SLOTS)
+#define MTB_ARENA_BUCKET_POOL_SLOTS 16
+#endif
+
+namespace mtb {
+    struct tArenaBucket {
+        tArenaBucket* next;
+        tArenaBucket* prev;
+
+        /// Usually points right behind the bucket header. Buckets of a spilling arena have separately allocated data,
+        /// which is null while the bucket is spilled.
+        uint8_t* data;
+        size_t used_size;
+        size_t total_size;
+
+        /// Where this bucket lives in tArenaSpill::store, or kNoSpillOffset.
+        uint64_t spill_offset;
+    };
+
+    constexpr uint64_t kNoSpillOffset = ~(uint64_t)0;
+
+    /// Random-access backing storage, e.g. a temporary file. See mfs_FileBlockStore in mtb_filesystem.h.
+    struct tBlockStore {
+        void* user;
+        bool (*write_proc)(void* user, uint64_t offset, tSlice<void const> data);
+        bool (*read_proc)(void* user, uint64_t offset, tSlice<void> data);
+
+        MTB_NODISCARD constexpr explicit operator bool() const {
+            return write_proc && read_proc;
+        }
+    };
+
+    /// Lets a tArena exceed its memory budget by writing old buckets to a tBlockStore.
+    ///
+    /// Whenever the arena grows beyond resident_budget, the oldest buckets (all but the current one) are written to
+    /// the store and their data is freed. Bucket headers stay in memory, so markers remain valid. Spilled buckets are
+    /// paged back in by Linearize, ResetToMarker and PageIn. Pointers into a spilled bucket are invalid until the
+    /// bucket is paged in again, and may change when it is.
+    struct tArenaSpill {
+        tBlockStore store;
+
+        /// Bytes of bucket data allowed in memory before buckets are spilled.
+        size_t resident_budget;
+
+        // Stats.
+        size_t resident_size;
+        size_t spilled_size;
+
+        /// Bytes reserved in the store. Each bucket reserves its total_size the first time it is spilled.
+        uint64_t store_size;
+    };
+
+    /// Lock-free cache of arena buckets, bucketed by size class (log2 of the total size).
+    /// Only buckets with a power-of-two total_size are cached.
+    ///
+    /// Each size class is a fixed array of slots. Taking a bucket exchanges a slot with null, returning one
+    /// compare-exchanges null with the bucket. There are no links between cached buckets, so there is no ABA problem.
+    /// A full size class hands the bucket back to the arena's child_allocator instead.
+    ///
+    /// \remark All arenas sharing a pool must use interchangeable child allocators, e.g. all GetLibcAllocator().
+    struct tArenaBucketPool {
+        tArenaBucket* slots[64][MTB_ARENA_BUCKET_POOL_SLOTS];
+    };
+
+    /// The process-wide pool. Arenas opt in by setting tArena::bucket_pool = &GlobalArenaBucketPool().
+    MTB_NODISCARD tArenaBucketPool& GlobalArenaBucketPool();
+
+    /// Take a cached bucket with exactly \a total_size bytes of data. Returns null if there is none.
+    MTB_NODISCARD tArenaBucket* TakeBucket(tArenaBucketPool& pool, size_t total_size);
+
+    /// Returns false if the bucket could not be cached, in which case the caller still owns it.
+    bool ReturnBucket(tArenaBucketPool& pool, tArenaBucket* bucket);
+
+    /// Free all cached buckets with the given allocator.
+    void ReleaseBuckets(tArenaBucketPool& pool, tAllocator allocator);
+
+    struct tArenaMarker {
+        tArenaBucket* bucket;
+        size_t offset;
+
+        MTB_NODISCARD constexpr uint8_t* ptr() const {
+            return bucket ? bucket->data + offset : nullptr;
+        }
+    };
+
+    // #TODO struct tArenaStats { size_t largest_bucket_size; size_t NumBucketAllocations; size_t NumBucketFrees; };
+
+    struct tArena {
+        tAllocator child_allocator;
+        size_t min_bucket_size;
+        tArenaBucket* current_bucket;
+        tArenaBucket* first_free_bucket;
+
+        /// May be null. If set, Grow takes buckets from this pool before asking child_allocator and released buckets
+        /// are returned to it.
+        tArenaBucketPool* bucket_pool;
+
+        /// May be null. If set, buckets are spilled to disk when the arena exceeds the spill budget. Spilling buckets
+        /// bypass bucket_pool. Requires a child_allocator.
+        tArenaSpill* spill;
+
+        size_t largest_bucket_size;
+    };
+
+    MTB_NODISCARD size_t BucketTotalSize(tArenaBucket const* bucket);
+
+    MTB_NODISCARD size_t BucketUsedSize(tArenaBucket const* bucket);
+
+    void Reserve(tArena& arena, size_t total_size);
+
+    void Grow(tArena& arena, size_t required_size);
+
+    void Clear(tArena& arena, bool release_memory = true);
+
+    void* ReallocRaw(tArena& arena, void* old_ptr, size_t old_size, size_t old_alignment, size_t new_size, size_t new_alignment, eInit init);
+
+    MTB_NODISCARD void* PushRaw(tArena& arena, size_t size, size_t alignment, eInit init);
+
+    tSlice<void> ReallocRawArray(tArena& arena, tSlice<void> old_array, size_t old_alignment, size_t new_size, size_t new_alignment, eInit init);
+
+    MTB_NODISCARD tSlice<void> PushRawArray(tArena& arena, size_t size, size_t alignment, eInit init);
+
+    template<typename T>
+    tSlice<T> ReallocArray(tArena& arena, tSlice<T> old_array, size_t new_count, eInit init = kClearToZero) {
+        size_t new_size = MTB_sizeof(T) * new_count;
+        size_t alignment = MTB_alignof(T);
+        void* ptr = ReallocRaw(arena, old_array.ptr, SliceSize(old_array), alignment, new_size, alignment, init);
+        tSlice<T> result = PtrSlice((T*)ptr, new_count);
+        if(init == kClearToZero) {
+            SliceSetZero(SliceOffset(result, old_array.len));
+        }
+        return result;
+    }
+
+    template<typename T>
+    MTB_NODISCARD tSlice<T> PushArray(tArena& arena, size_t count, eInit init = kClearToZero) {
+        return ReallocArray<T>(arena, {}, count, init);
+    }
+
+    template<typename T, typename U = tRemoveConst<T>>
+    MTB_NODISCARD tSlice<U> PushCopyArray(tArena& arena, tSlice<T> to_copy) {
+        tSlice<U> Copy = PushArray<U>(arena, to_copy.len, kNoInit);
+        SliceCopyBytes(Copy, to_copy);
+        return Copy;
+    }
+
+    // The same as PushCopyArray with one additional zero-element at the end.
+    template<typename T, typename U = tRemoveConst<T>>
+    MTB_NODISCARD tSlice<U> PushCopyString(tArena& arena, tSlice<T> to_copy) {
+        tSlice<U> ZeroTerminatedCopy = PushArray<U>(arena, to_copy.len + 1, kNoInit);
+        tSlice<U> result = SliceRange(ZeroTerminatedCopy, 0, ZeroTerminatedCopy.len - 1);
+        SliceCopyBytes(result, to_copy);
+        // set terminator element.
+        new(PtrOffset(ZeroTerminatedCopy.ptr, ZeroTerminatedCopy.len - 1)) U{};
+        return result;
+    }
+
+    template<typename T>
+    MTB_NODISCARD T& PushOne(tArena& arena, eInit init = kClearToZero) {
+        T* result = PushArray<T>(arena, 1, init).ptr;
+        MTB_ASSERT(!!result);
+        return *result;
+    }
+
+    template<typename T>
+    MTB_NODISCARD T& PushCopy(tArena& arena, T const& item) {
+        T& result = PushOne<T>(arena, kNoInit);
+        SliceCopyBytes(PtrSlice(&result, 1), PtrSlice(&item, 1));
+        return result;
+    }
+
+    /* #TODO
+     - NumBuckets?
+     - accumulated total_size across all buckets?
+     - accumulated used_size across all buckets?
+    */
+
+    /// \remark Only valid before free was called.
+    MTB_NODISCARD tArenaMarker GetMarker(tArena const& arena);
+
+    void ResetToMarker(tArena& arena, tArenaMarker marker, bool release_memory = true);
+
+    /// Ensure the memory in the given range is contiguous.
+    /// Returns the marker to the beginning of the linearized section.
+    MTB_NODISCARD tSlice<void> Linearize(tArena& arena, tArenaMarker begin, tArenaMarker end);
+
+    MTB_NODISCARD tAllocator MakeAllocator(tArena& arena);
+
+    /// Spill buckets (oldest first, never the current one) until the arena fits into its spill budget.
+    /// Happens automatically when the arena grows. Returns false if the budget could not be met.
+    bool SpillBuckets(tArena& arena);
+
+    /// Make sure all buckets between the two markers are in memory. The empty marker \a begin means the oldest bucket.
+    void PageIn(tArena& arena, tArenaMarker begin, tArenaMarker end);
+
+    MTB_NODISCARD bool IsBucketResident(tArenaBucket const* bucket);
+
+    /// Self-relative pointer. Stores the distance from its own address to the target, so links between items in the
+    /// same block of memory stay valid when that block is moved as a whole, e.g. an arena snapshot that is mapped at a
+    /// different address on the next run. Copying a tRelPtr makes the copy point to the same absolute address.
+    ///
+    /// \remark A tRelPtr cannot point to itself. That offset is reserved for null.
+    template<typename T>
+    struct tRelPtr {
+        int64_t offset{};
+
+        tRelPtr() = default;
+
+        tRelPtr(T* target) { Set(target); }
+
+        tRelPtr(tRelPtr const& other) { Set(other.Get()); }
+
+        tRelPtr& operator=(tRelPtr const& other) {
+            Set(other.Get());
+            return *this;
+        }
+
+        tRelPtr& operator=(T* target) {
+            Set(target);
+            return *this;
+        }
+
+        void Set(T* target) { offset = target ? (int64_t)((intptr_t)target - (intptr_t)this) : 0; }
+
+        MTB_NODISCARD T* Get() const { return offset ? (T*)((intptr_t)this + (intptr_t)offset) : nullptr; }
+
+        MTB_NODISCARD T* operator->() const { return Get(); }
+
+        MTB_NODISCARD T& operator*() const { return *Get(); }
+
+        MTB_NODISCARD explicit operator bool() const { return offset != 0; }
+    };
+
+    // #Option Bump this whenever the layout of tArenaSnapshotHeader changes.
+#if !defined(MTB_ARENA_SNAPSHOT_FORMAT_VERSION)
+#define MTB_ARENA_SNAPSHOT_FORMAT_VERSION 1
+#endif
+
+    /// Stored at the beginning of an arena snapshot. Everything after it belongs to the snapshot's only bucket.
+    struct tArenaSnapshotHeader {
+        uint32_t magic;
+        uint32_t format_version;
+        uint64_t user_version;
+        uint64_t payload_offset;
+        uint64_t payload_size;
+        uint64_t payload_checksum;
+        uint64_t root_offset;
+    };
+
+    struct tArenaSnapshot {
+        bool is_valid;
+        tSlice<void const> payload;
+        void const* root;
+    };
+
+    /// Create an arena that allocates exclusively from \a memory, e.g. a writable memory-mapped file (see mfs_MapFile).
+    /// The arena has no child allocator, so it can not grow beyond \a memory. Store intra-arena links as tRelPtr.
+    MTB_NODISCARD tArena BeginArenaSnapshot(tSlice<void> memory);
+
+    /// Write the snapshot header for an arena created with BeginArenaSnapshot.
+    /// \a root must point into the arena. It is what OpenArenaSnapshot returns later.
+    /// \return The used prefix of the snapshot memory. Everything beyond that may be discarded.
+    tSlice<void> FinishArenaSnapshot(tArena& arena, void const* root, uint64_t user_version);
+
+    /// Validate a snapshot created with BeginArenaSnapshot/FinishArenaSnapshot, e.g. in a read-only memory-mapped file.
+    /// Nothing is copied, the result points into \a memory.
+    /// \param verify_checksum Hashes the entire payload. Skip it if the memory is trusted and startup time matters.
+    MTB_NODISCARD tArenaSnapshot OpenArenaSnapshot(tSlice<void const> memory, uint64_t user_version, bool verify_checksum = true);
+
+    template<typename T>
+    MTB_NODISCARD T const* SnapshotRoot(tArenaSnapshot const& snapshot) {
+        return snapshot.is_valid ? (T const*)snapshot.root : nullptr;
+    }
+
+#if MTB_USE_STB_SPRINTF
+    /// \brief Produce several fragments of formatted strings within the given arena. Use `*printf_Arena` or `Linearize` to produce an actual string.
+    void vprintf_ArenaRaw(tArena& arena, char const* format, va_list vargs);
+
+    // Append a string with the given format inside the given arena.
+    inline void printf_ArenaRaw(tArena& arena, char const* format, ...) {
+        va_list args;
+        va_start(args, format);
+        vprintf_ArenaRaw(arena, format, args);
+        va_end(args);
+    }
+
+    /// \brief Append a string with the given format inside the given arena. Produces a null-terminated string.
+    /// \return The formatted string EXCLUDING the null-terminator.
+    tSlice<char> vprintf_Arena(tArena& arena, char const* format, va_list vargs);
+
+    // Append a string with the given format inside the given arena.
+    inline tSlice<char> printf_Arena(tArena& arena, char const* format, ...) {
+        va_list args;
+        va_start(args, format);
+        tSlice<char> result = vprintf_Arena(arena, format, args);
+        va_end(args);
+
+        return result;
+    }
+
+#endif  // MTB_USE_STB_SPRINTF
+
+}  // namespace mtb
+
+// --------------------------------------------------
+// -- #Section External Sort ------------------------
+// --------------------------------------------------
+
+// #Option Smallest read buffer per run while merging. Limits how many runs are merged at once.
+#if !defined(MTB_EXTERNAL_SORT_MIN_BLOCK_SIZE)
+#define MTB_EXTERNAL_SORT_MIN_BLOCK_SIZE (64 * 1024)
+#endif
+
+namespace mtb {
+    /// Sorts more fixed-size records than fit in memory. Records are pushed one by one or in batches (e.g. straight
+    /// out of a mapped file). Whenever the buffer of memory_budget bytes is full, it is sorted with SortSlice and
+    /// written to \a runs as a sorted run. FinishExternalSort merges the runs into the output with a loser tree,
+    /// reading and writing in large sequential blocks.
+    ///
+    /// If there are more runs than the memory budget allows reading in blocks of MTB_EXTERNAL_SORT_MIN_BLOCK_SIZE,
+    /// groups of runs are first merged into longer runs, which are appended to \a runs. Back \a runs with a temporary
+    /// file, e.g. using mfs_FileBlockStore from mtb_filesystem.h.
+    template<typename T, typename tLessProc = tLess>
+    struct tExternalSort {
+        static_assert(MTB_IS_POD(T), "Records are written to and read from the block stores as bytes.");
+
+        struct tRun {
+            /// Offset into runs, in records.
+            uint64_t begin;
+            uint64_t len;
+        };
+
+        /// May not be null.
+        tAllocator allocator;
+
+        tBlockStore runs;
+        tLessProc less;
+
+        /// The memory budget.
+        tSlice<T> buffer;
+        ptrdiff_t buffer_len;
+
+        tArray<tRun> written_runs;
+
+        /// Total number of records pushed so far.
+        uint64_t count;
+
+        /// Set once writing to the store failed. Everything after that is a no-op.
+        bool failed;
+    };
+
+    template<typename T, typename tLessProc = tLess>
+    MTB_NODISCARD tExternalSort<T, tLessProc> CreateExternalSort(tAllocator allocator, tBlockStore runs, size_t memory_budget, tLessProc less = {});
+
+    template<typename T, typename tLessProc>
+    void ClearAllocation(tExternalSort<T, tLessProc>& sort);
+
+    /// Returns false if a sorted run could not be written.
+    template<typename T, typename tLessProc>
+    bool Push(tExternalSort<T, tLessProc>& sort, T const& item);
+
+    template<typename T, typename tLessProc, typename U>
+    bool PushMany(tExternalSort<T, tLessProc>& sort, tSlice<U> items);
+
+    /// Write all pushed records in sorted order to \a output, starting at offset 0. \a output may be the store the
+    /// records were originally read from. Afterwards, \a sort is empty and can be reused.
+    template<typename T, typename tLessProc>
+    bool FinishExternalSort(tExternalSort<T, tLessProc>& sort, tBlockStore output);
+
+    namespace impl {
+        /// Merges sorted runs read from a block store with a tree of losers: every inner node holds the run that lost
+        /// the match played there, and tree[0] holds the overall winner. Replacing the winner only replays the matches
+        /// on the path from its leaf to the root, with one comparison per level.
+        template<typename T, typename tLessProc>
+        struct tLoserTreeMerge {
+            struct tCursor {
+                tSlice<T> block;
+                ptrdiff_t pos;
+                ptrdiff_t len;
+
+                /// Next record to read from the store, and one past the last one of this run.
+                uint64_t next;
+                uint64_t end;
+            };
+
+            tBlockStore store;
+            tLessProc* less;
+            tSlice<tCursor> cursors;
+            tSlice<ptrdiff_t> tree;
+            bool failed;
+
+            /// Whether run \a a comes before run \a b. Exhausted runs lose against everything.
+            bool Beats(ptrdiff_t a, ptrdiff_t b) const {
+                tCursor const& x = cursors[a];
+                tCursor const& y = cursors[b];
+                if(x.pos == x.len || y.pos == y.len) {
+                    return y.pos == y.len && x.pos != x.len;
+                }
+                T const& u = x.block[x.pos];
+                T const& v = y.block[y.pos];
+                return (*less)(u, v) || (!(*less)(v, u) && a < b);
+            }
+
+            void Refill(tCursor& cursor) {
+                uint64_t remaining = cursor.end - cursor.next;
+                cursor.pos = 0;
+                cursor.len = remaining < (uint64_t)cursor.block.len ? (ptrdiff_t)remaining : cursor.block.len;
+                if(cursor.len > 0) {
+                    tSlice<void> bytes{cursor.block.ptr, cursor.len * (ptrdiff_t)sizeof(T)};
+                    if(!store.read_proc(store.user, cursor.next * sizeof(T), bytes)) {
+                        failed = true;
+                        cursor.len = 0;
+                    }
+                    cursor.next += (uint64_t)cursor.len;
+                }
+            }
+
+            void Replay(ptrdiff_t run) {
+                ptrdiff_t winner = run;
+                for(ptrdiff_t node = (run + cursors.len) / 2; node > 0; node /= 2) {
+                    if(tree[node] < 0) {
+                        // Only while building: the first run to arrive waits for its opponent.
+                        tree[node] = winner;
+                        return;
+                    }
+                    if(Beats(tree[node], winner)) {
+                        Swap(tree[node], winner);
+                    }
+                }
+                tree[0] = winner;
+            }
+        };
+
+        /// Merge \a runs from \a store into \a output at \a output_offset (in records), using \a memory for one read
+        /// block per run and one write block.
+        template<typename T, typename tLessProc>
+        bool MergeRuns(tExternalSort<T, tLessProc>& sort, tSlice<typename tExternalSort<T, tLessProc>::tRun> runs, tBlockStore output, uint64_t output_offset) {
+            using tMerge = tLoserTreeMerge<T, tLessProc>;
+            tMerge merge{};
+            merge.store = sort.runs;
+            merge.less = &sort.less;
+            merge.cursors = sort.allocator.template AllocArray<typename tMerge::tCursor>(runs.len, kClearToZero);
+            merge.tree = sort.allocator.template AllocArray<ptrdiff_t>(runs.len, kNoInit);
+            bool result = merge.cursors && merge.tree;
+
+            if(result) {
+                ptrdiff_t block_len = sort.buffer.len / (runs.len + 1);
+                for(ptrdiff_t run = 0; run < runs.len; ++run) {
+                    auto& cursor = merge.cursors[run];
+                    cursor.block = SliceRange(sort.buffer, run * block_len, block_len);
+                    cursor.next = runs[run].begin;
+                    cursor.end = runs[run].begin + runs[run].len;
+                    merge.Refill(cursor);
+                }
+                for(ptrdiff_t& node : merge.tree) {
+                    node = -1;
+                }
+                for(ptrdiff_t run = runs.len; run > 0; --run) {
+                    merge.Replay(run - 1);
+                }
+
+                tSlice<T> out = SliceBetween(sort.buffer, runs.len * block_len, sort.buffer.len);
+                ptrdiff_t out_len = 0;
+                while(!merge.failed) {
+                    auto& cursor = merge.cursors[merge.tree[0]];
+                    if(cursor.pos == cursor.len) {
+                        break;
+                    }
+                    out[out_len++] = cursor.block[cursor.pos++];
+                    if(cursor.pos == cursor.len) {
+                        merge.Refill(cursor);
+                    }
+                    merge.Replay(merge.tree[0]);
+
+                    if(out_len == out.len) {
+                        merge.failed |= !output.write_proc(output.user, output_offset * sizeof(T), SliceRange(out, 0, out_len));
+                        output_offset += (uint64_t)out_len;
+                        out_len = 0;
+                    }
+                }
+                if(out_len > 0 && !merge.failed) {
+                    merge.failed |= !output.write_proc(output.user, output_offset * sizeof(T), SliceRange(out, 0, out_len));
+                }
+                result = !merge.failed;
+            }
+
+            sort.allocator.FreeArray(merge.tree);
+            sort.allocator.FreeArray(merge.cursors);
+            return result;
+        }
+
+        template<typename T, typename tLessProc>
+        bool WriteSortedRun(tExternalSort<T, tLessProc>& sort) {
+            SortSlice(SliceRange(sort.buffer, 0, sort.buffer_len), sort.less);
+            uint64_t begin = 0;
+            if(sort.written_runs.len > 0) {
+                auto const& last = sort.written_runs[sort.written_runs.len - 1];
+                begin = last.begin + last.len;
+            }
+            if(!sort.runs.write_proc(sort.runs.user, begin * sizeof(T), SliceRange(sort.buffer, 0, sort.buffer_len))) {
+                return false;
+            }
+            Push(sort.written_runs, typename tExternalSort<T, tLessProc>::tRun{begin, (uint64_t)sort.buffer_len});
+            sort.buffer_len = 0;
+            return true;
+        }
+    }  // namespace impl
+}  // namespace mtb
+
+template<typename T, typename tLessProc>
+mtb::tExternalSort<T, tLessProc> mtb::CreateExternalSort(tAllocator allocator, tBlockStore runs, size_t memory_budget, tLessProc less) {
+    MTB_ASSERT(allocator && runs);
+    tExternalSort<T, tLessProc> result{allocator, runs, less};
+    result.written_runs.allocator = allocator;
+
+    // Room for at least a merge of two runs and the output.
+    ptrdiff_t buffer_len = (ptrdiff_t)(memory_budget / sizeof(T));
+    result.buffer = allocator.template AllocArray<T>(buffer_len >= 3 ? buffer_len : 3, kNoInit);
+    MTB_ASSERT(result.buffer);
+    return result;
+}
+
+template<typename T, typename tLessProc>
+void mtb::ClearAllocation(tExternalSort<T, tLessProc>& sort) {
+    sort.allocator.FreeArray(sort.buffer);
+    sort.buffer = {};
+    sort.buffer_len = 0;
+    ClearAllocation(sort.written_runs);
+    sort.count = 0;
+    sort.failed = false;
+}
+
+template<typename T, typename tLessProc>
+bool mtb::Push(tExternalSort<T, tLessProc>& sort, T const& item) {
+    if(sort.buffer_len == sort.buffer.len && !sort.failed) {
+        sort.failed = !impl::WriteSortedRun(sort);
+    }
+    if(sort.failed) {
+        return false;
+    }
+    sort.buffer[sort.buffer_len++] = item;
+    ++sort.count;
+    return true;
+}
+
+template<typename T, typename tLessProc, typename U>
+bool mtb::PushMany(tExternalSort<T, tLessProc>& sort, tSlice<U> items) {
+    while(items.len > 0) {
+        if(sort.buffer_len == sort.buffer.len && !sort.failed) {
+            sort.failed = !impl::WriteSortedRun(sort);
+        }
+        if(sort.failed) {
+            return false;
+        }
+        ptrdiff_t count = sort.buffer.len - sort.buffer_len;
+        count = count < items.len ? count : items.len;
+        CopyConstructItems(sort.buffer.ptr + sort.buffer_len, (size_t)count, items.ptr, (size_t)count);
+        sort.buffer_len += count;
+        sort.count += (uint64_t)count;
+        items = SliceBetween(items, count, items.len);
+    }
+    return true;
+}
+
+template<typename T, typename tLessProc>
+bool mtb::FinishExternalSort(tExternalSort<T, tLessProc>& sort, tBlockStore output) {
+    using tRun = typename tExternalSort<T, tLessProc>::tRun;
+    bool result = !sort.failed;
+
+    if(result && sort.written_runs.len == 0) {
+        // Everything fit in memory.
+        SortSlice(SliceRange(sort.buffer, 0, sort.buffer_len), sort.less);
+        result = sort.buffer_len == 0 || output.write_proc(output.user, 0, SliceRange(sort.buffer, 0, sort.buffer_len));
+    } else if(result) {
+        result = sort.buffer_len == 0 || impl::WriteSortedRun(sort);
+
+        ptrdiff_t max_fan_in = (ptrdiff_t)(sort.buffer.len * sizeof(T) / MTB_EXTERNAL_SORT_MIN_BLOCK_SIZE) - 1;
+        max_fan_in = max_fan_in >= 2 ? max_fan_in : 2;
+
+        // Merge groups of runs into longer runs appended to the store until one merge is enough.
+        ptrdiff_t first_run = 0;
+        while(result && sort.written_runs.len - first_run > max_fan_in) {
+            ptrdiff_t run_count = sort.written_runs.len - first_run;
+            ptrdiff_t group_len = max_fan_in < run_count - max_fan_in + 1 ? max_fan_in : run_count - max_fan_in + 1;
+            tRun const& last = sort.written_runs[sort.written_runs.len - 1];
+            tRun merged{last.begin + last.len, 0};
+
+            // The group is copied because pushing the merged run may reallocate written_runs.
+            tSlice<tRun> group = sort.allocator.template AllocArray<tRun>(group_len, kNoInit);
+            result = !!group;
+            if(result) {
+                SliceCopyBytes(group, SliceRange(sort.written_runs.items, first_run, group_len));
+                for(tRun const& run : group) {
+                    merged.len += run.len;
+                }
+                result = impl::MergeRuns(sort, group, sort.runs, merged.begin);
+                sort.allocator.FreeArray(group);
+            }
+            Push(sort.written_runs, merged);
+            first_run += group_len;
+        }
+
+        result = result && impl::MergeRuns(sort, SliceBetween(sort.written_runs.items, first_run, sort.written_runs.len), output, 0);
+    }
+
+    Clear(sort.written_runs);
+    sort.buffer_len = 0;
+    sort.count = 0;
+    sort.failed = false;
+    return result;
+}
+
+// --------------------------------------------------
+// -- #Section Strings ------------------------------
+// --------------------------------------------------
+namespace mtb {
+    namespace literals {
+        /// Create an mtb::tSlice<char const> from a string literal.
+        static tSlice<char const> operator""_s(char const* str, size_t len) {
+            return {.ptr = str, .len = (ptrdiff_t)len};
+        }
+    }  // namespace literals
+
+    //
+    // Types
+    //
+    enum eStringComparison {
+        kCaseSensitive,
+        kIgnoreCase,
+    };
+
+    using tTrimPredicate = bool (*)(char);
+    using tWTrimPredicate = bool (*)(wchar_t);
+
+    MTB_NODISCARD size_t StringLengthZ(char const* str_z);
+    MTB_NODISCARD size_t StringLengthZ(wchar_t const* str_z);
+
+    MTB_NODISCARD inline tSlice<char> WrapZ(char* str_z) { return PtrSlice(str_z, StringLengthZ(str_z)); }
+    MTB_NODISCARD inline tSlice<wchar_t> WrapZ(wchar_t* str_z) { return PtrSlice(str_z, StringLengthZ(str_z)); }
+
+    MTB_NODISCARD inline tSlice<char const> ConstZ(char const* str_z) { return PtrSlice(str_z, StringLengthZ(str_z)); }
+    MTB_NODISCARD inline tSlice<wchar_t const> ConstZ(wchar_t const* str_z) { return PtrSlice(str_z, StringLengthZ(str_z)); }
+
+    //
+    // Character conversion
+    //
+
+    MTB_NODISCARD char ToLowerChar(char c);
+    MTB_NODISCARD char ToUpperChar(char c);
+
+    MTB_NODISCARD wchar_t ToLowerChar(wchar_t c);
+    MTB_NODISCARD wchar_t ToUpperChar(wchar_t c);
+
+    //
+    // Character properties
+    //
+
+    MTB_NODISCARD bool IsDigitChar(char c);
+    MTB_NODISCARD bool IsWhiteChar(char c);
+
+    MTB_NODISCARD bool IsDigitChar(wchar_t c);
+    MTB_NODISCARD bool IsWhiteChar(wchar_t c);
+
+    // String comparison
+
+    MTB_NODISCARD int32_t StringCompare(tSlice<char const> str_a, tSlice<char const> str_b, eStringComparison cmp = kCaseSensitive);
+    MTB_NODISCARD int32_t StringCompare(tSlice<wchar_t const> str_a, tSlice<wchar_t const> str_b, eStringComparison cmp = kCaseSensitive);
+
+    MTB_NODISCARD bool StringsAreEqual(tSlice<char const> str_a, tSlice<char const> str_b, eStringComparison cmp = kCaseSensitive);
+    MTB_NODISCARD bool StringsAreEqual(tSlice<wchar_t const> str_a, tSlice<wchar_t const> str_b, eStringComparison cmp = kCaseSensitive);
+
+    /// Lexicographic order: characters are compared as unsigned values, and a string comes before every longer string
+    /// that starts with it. Note that StringCompare orders by length first.
+    MTB_NODISCARD int32_t StringCompareLexicographic(tSlice<char const> str_a, tSlice<char const> str_b);
+    MTB_NODISCARD int32_t StringCompareLexicographic(tSlice<wchar_t const> str_a, tSlice<wchar_t const> str_b);
+
+    //
+    // String sorting
+    //
+
+    /// Sort \a strings in lexicographic order (see StringCompareLexicographic) with multikey quicksort. Strings are
+    /// partitioned by one character at a time, so the common prefix of a group of strings is never looked at twice.
+    /// Small groups are finished with insertion sort comparing from the end of their common prefix.
+    ///
+    /// If \a lcp is given, it must be as long as \a strings. It receives the length of the longest common prefix of
+    /// each string and its predecessor in sorted order, and 0 for the first string.
+    void SortStrings(tSlice<tSlice<char const>> strings, tSlice<ptrdiff_t> lcp = {});
+    void SortStrings(tSlice<tSlice<wchar_t const>> strings, tSlice<ptrdiff_t> lcp = {});
+
+    MTB_NODISCARD bool StringStartsWith(tSlice<char const> str, tSlice<char const> prefix, eStringComparison cmp = kCaseSensitive);
+    MTB_NODISCARD bool StringStartsWith(tSlice<wchar_t const> str, tSlice<wchar_t const> prefix, eStringComparison cmp = kCaseSensitive);
+
+    MTB_NODISCARD bool StringEndsWith(tSlice<char const> str, tSlice<char const> prefix, eStringComparison cmp = kCaseSensitive);
+    MTB_NODISCARD bool StringEndsWith(tSlice<wchar_t const> str, tSlice<wchar_t const> prefix, eStringComparison cmp = kCaseSensitive);
+
+    //
+    // Trim Start
+    //
+
+    MTB_NODISCARD tSlice<char const> StringTrimStartPredicate(tSlice<char const> str, tTrimPredicate Predicate);
+    MTB_NODISCARD inline tSlice<char> StringTrimStartPredicate(tSlice<char> str, tTrimPredicate Predicate) { return SliceRemoveConst(StringTrimStartPredicate((tSlice<char const>)str, Predicate)); }
+    MTB_NODISCARD tSlice<wchar_t const> StringTrimStartPredicate(tSlice<wchar_t const> str, tWTrimPredicate Predicate);
+    MTB_NODISCARD inline tSlice<wchar_t> StringTrimStartPredicate(tSlice<wchar_t> str, tWTrimPredicate Predicate) { return SliceRemoveConst(StringTrimStartPredicate((tSlice<wchar_t const>)str, Predicate)); }
+
+    MTB_NODISCARD tSlice<char const> StringTrimStart(tSlice<char const> str);
+    MTB_NODISCARD inline tSlice<char> StringTrimStart(tSlice<char> str) { return SliceRemoveConst(StringTrimStart((tSlice<char const>)str)); }
+    MTB_NODISCARD tSlice<wchar_t const> StringTrimStart(tSlice<wchar_t const> str);
+    MTB_NODISCARD inline tSlice<wchar_t> StringTrimStart(tSlice<wchar_t> str) { return SliceRemoveConst(StringTrimStart((tSlice<wchar_t const>)str)); }
+
+    //
+    // Trim End
+    //
+
+    MTB_NODISCARD tSlice<char const> StringTrimEndPredicate(tSlice<char const> str, tTrimPredicate Predicate);
+    MTB_NODISCARD inline tSlice<char> StringTrimEndPredicate(tSlice<char> str, tTrimPredicate Predicate) { return SliceRemoveConst(StringTrimEndPredicate((tSlice<char const>)str, Predicate)); }
+    MTB_NODISCARD tSlice<wchar_t const> StringTrimEndPredicate(tSlice<wchar_t const> str, tWTrimPredicate Predicate);
+    MTB_NODISCARD inline tSlice<wchar_t> StringTrimEndPredicate(tSlice<wchar_t> str, tWTrimPredicate Predicate) { return SliceRemoveConst(StringTrimEndPredicate((tSlice<wchar_t const>)str, Predicate)); }
+
+    MTB_NODISCARD tSlice<char const> StringTrimEnd(tSlice<char const> str);
+    MTB_NODISCARD inline tSlice<char> StringTrimEnd(tSlice<char> str) { return SliceRemoveConst(StringTrimEnd((tSlice<char const>)str)); }
+    MTB_NODISCARD tSlice<wchar_t const> StringTrimEnd(tSlice<wchar_t const> str);
+    MTB_NODISCARD inline tSlice<wchar_t> StringTrimEnd(tSlice<wchar_t> str) { return SliceRemoveConst(StringTrimEnd((tSlice<wchar_t const>)str)); }
+
+    //
+    // Trim (both ends)
+    //
+
+    MTB_NODISCARD tSlice<char const> StringTrimPredicate(tSlice<char const> str, tTrimPredicate Predicate);
+    MTB_NODISCARD inline tSlice<char> StringTrimPredicate(tSlice<char> str, tTrimPredicate Predicate) { return SliceRemoveConst(StringTrimPredicate((tSlice<char const>)str, Predicate)); }
+    MTB_NODISCARD tSlice<wchar_t const> StringTrimPredicate(tSlice<wchar_t const> str, tWTrimPredicate Predicate);
+    MTB_NODISCARD inline tSlice<wchar_t> StringTrimPredicate(tSlice<wchar_t> str, tWTrimPredicate Predicate) { return SliceRemoveConst(StringTrimPredicate((tSlice<wchar_t const>)str, Predicate)); }
+
+    MTB_NODISCARD tSlice<char const> StringTrim(tSlice<char const> str);
+    MTB_NODISCARD inline tSlice<char> StringTrim(tSlice<char> str) { return SliceRemoveConst(StringTrim((tSlice<char const>)str)); }
+    MTB_NODISCARD tSlice<wchar_t const> StringTrim(tSlice<wchar_t const> str);
+    MTB_NODISCARD inline tSlice<wchar_t> StringTrim(tSlice<wchar_t> str) { return SliceRemoveConst(StringTrim((tSlice<wchar_t const>)str)); }
+
+    //
+    // String Allocation
+    //
+
+    MTB_NODISCARD tSlice<char> AllocString(tAllocator a, size_t char_count);
+    MTB_NODISCARD tSlice<wchar_t> AllocWString(tAllocator a, size_t char_count);
+
+    MTB_NODISCARD tSlice<char> DupeString(tAllocator a, tSlice<char const> str);
+    MTB_NODISCARD tSlice<wchar_t> DupeString(tAllocator a, tSlice<wchar_t const> str);
+
+    void FreeString(tAllocator a, tSlice<char> str);
+    void FreeString(tAllocator a, tSlice<wchar_t> str);
+}  // namespace mtb::string
+
+// --------------------------------------------------
+// -- #Section Units --------------------------------
+// --------------------------------------------------
+namespace mtb {
+    const uint64_t kibibytes_to_bytes = 1024ULL;
+    const uint64_t mebibytes_to_bytes = 1024ULL * kibibytes_to_bytes;
+    const uint64_t gibibytes_to_bytes = 1024ULL * mebibytes_to_bytes;
+    const uint64_t tebibytes_to_bytes = 1024ULL * gibibytes_to_bytes;
+    const uint64_t pebibytes_to_bytes = 1024ULL * tebibytes_to_bytes;
+    const uint64_t exbibytes_to_bytes = 1024ULL * pebibytes_to_bytes;
+
+    const uint64_t kilobytes_to_bytes = 1000ULL;
+    const uint64_t megabytes_to_bytes = 1000ULL * kilobytes_to_bytes;
+    const uint64_t gigabytes_to_bytes = 1000ULL * megabytes_to_bytes;
+    const uint64_t terabytes_to_bytes = 1000ULL * gigabytes_to_bytes;
+    const uint64_t petabytes_to_bytes = 1000ULL * terabytes_to_bytes;
+    const uint64_t exabytes_to_bytes = 1000ULL * petabytes_to_bytes;
+
+    // clang-format off
+    const uint64_t microseconds_to_nanoseconds = 1000ULL;
+    const uint64_t milliseconds_to_nanoseconds = 1000ULL * microseconds_to_nanoseconds;
+    const uint64_t seconds_to_nanoseconds      = 1000ULL * milliseconds_to_nanoseconds;
+    const uint64_t minutes_to_nanoseconds      =   60ULL * seconds_to_nanoseconds;
+    const uint64_t hours_to_nanoseconds        =   60ULL * minutes_to_nanoseconds;
+    const uint64_t days_to_nanoseconds         =   24ULL * hours_to_nanoseconds;
+    // clang-format on
+
+    /// Break a value into whole unit components.
+    /// \example
+    ///    uint64_t byte_value = (1337 * mebibytes_to_bytes) + (666 * kibibytes_to_bytes) + 42;
+    ///    uint64_t units[]{mebibytes_to_bytes, kibibytes_to_bytes, 1}; uint32_t results[3];
+    ///    BreakIntoUnits(byte_value, ArraySlice(units), ArraySlice(results));
+    ///    // results[0] == 1337; results[1] == 666; results[0] == 42;
+    void BreakIntoUnits(uint64_t value, tSlice<uint64_t const> units_table, tSlice<uint32_t> out_results);
+}  // namespace mtb
+
+// --------------------------------------------------
+// -- #Section Timespan ClockTime -------------------
+// --------------------------------------------------
+
+namespace mtb::time {
+    struct tTimespan {
+        int64_t nanoseconds;
+
+        constexpr operator bool() const { return (bool)nanoseconds; }
+
+        // clang-format off
+        MTB_NODISCARD constexpr int64_t Nanoseconds() const { return nanoseconds; }
+        MTB_NODISCARD constexpr double Microseconds() const { return (double)nanoseconds / (double)microseconds_to_nanoseconds; }
+        MTB_NODISCARD constexpr double Milliseconds() const { return (double)nanoseconds / (double)milliseconds_to_nanoseconds; }
+        MTB_NODISCARD constexpr double Seconds()      const { return (double)nanoseconds / (double)seconds_to_nanoseconds; }
+        MTB_NODISCARD constexpr double Minutes()      const { return (double)nanoseconds / (double)minutes_to_nanoseconds; }
+        MTB_NODISCARD constexpr double Hours()        const { return (double)nanoseconds / (double)hours_to_nanoseconds; }
+        MTB_NODISCARD constexpr double Days()         const { return (double)nanoseconds / (double)days_to_nanoseconds; }
+        // clang-format on
+
+        // clang-format off
+        MTB_NODISCARD static constexpr tTimespan FromNanoseconds(int64_t in_nanoseconds)  { return { in_nanoseconds }; }
+        MTB_NODISCARD static constexpr tTimespan FromMicroseconds(double in_microseconds) { return { (int64_t)(in_microseconds * (double)microseconds_to_nanoseconds) }; }
+        MTB_NODISCARD static constexpr tTimespan FromMilliseconds(double in_milliseconds) { return { (int64_t)(in_milliseconds * (double)milliseconds_to_nanoseconds) }; }
+        MTB_NODISCARD static constexpr tTimespan FromSeconds     (double in_seconds)      { return { (int64_t)(in_seconds      * (double)seconds_to_nanoseconds) }; }
+        MTB_NODISCARD static constexpr tTimespan FromMinutes     (double in_minutes)      { return { (int64_t)(in_minutes      * (double)minutes_to_nanoseconds) }; }
+        MTB_NODISCARD static constexpr tTimespan FromHours       (double in_hours)        { return { (int64_t)(in_hours        * (double)hours_to_nanoseconds) }; }
+        MTB_NODISCARD static constexpr tTimespan FromDays        (double in_days)         { return { (int64_t)(in_days         * (double)days_to_nanoseconds) }; }
+        // clang-format on
+    };
+
+    constexpr tTimespan timespan_zero{0};
+    constexpr tTimespan timespan_min{tIntProperties<int64_t>::min_value};
+    constexpr tTimespan timespan_max{tIntProperties<int64_t>::max_value};
+
+    //
+    // timespan + timespan
+    //
+    MTB_NODISCARD constexpr tTimespan operator+(tTimespan a, tTimespan b) {
+        return {a.nanoseconds + b.nanoseconds};
+    }
+
+    MTB_NODISCARD constexpr tTimespan& operator+=(tTimespan& a, tTimespan b) {
+        a.nanoseconds += b.nanoseconds;
+        return a;
+    }
+
+    //
+    // (timespan) - timespan
+    //
+    MTB_NODISCARD constexpr tTimespan operator-(tTimespan a) {
+        return {-a.nanoseconds};
+    }
+
+    MTB_NODISCARD constexpr tTimespan operator-(tTimespan a, tTimespan b) {
+        return {a.nanoseconds - b.nanoseconds};
+    }
+
+    MTB_NODISCARD constexpr tTimespan& operator-=(tTimespan& a, tTimespan b) {
+        a.nanoseconds -= b.nanoseconds;
+        return a;
+    }
+
+    //
+    // timespan comparison
+    //
+    MTB_NODISCARD constexpr bool operator==(tTimespan a, tTimespan b) {
+        return a.nanoseconds == b.nanoseconds;
+    }
+
+    MTB_NODISCARD constexpr bool operator!=(tTimespan a, tTimespan b) {
+        return a.nanoseconds != b.nanoseconds;
+    }
+
+    MTB_NODISCARD constexpr bool operator<(tTimespan a, tTimespan b) {
+        return a.nanoseconds < b.nanoseconds;
+    }
+
+    MTB_NODISCARD constexpr bool operator<=(tTimespan a, tTimespan b) {
+        return a.nanoseconds <= b.nanoseconds;
+    }
+
+    MTB_NODISCARD constexpr bool operator>(tTimespan a, tTimespan b) {
+        return a.nanoseconds > b.nanoseconds;
+    }
+
+    MTB_NODISCARD constexpr bool operator>=(tTimespan a, tTimespan b) {
+        return a.nanoseconds >= b.nanoseconds;
+    }
+
+    struct tClockTime {
+        bool negative;
+        uint32_t days;
+        uint32_t hours;
+        uint32_t minutes;
+        uint32_t seconds;
+        uint32_t milliseconds;
+        uint32_t microseconds;
+        uint32_t nanoseconds;
+    };
+
+    MTB_NODISCARD tClockTime ClockTimeFromTimespan(tTimespan span);
+}  // namespace mtb::time
+
+#endif  // !defined(MTB_INCLUDED)
+
+// --------------------------------------------------
+// -- #Section Implementation -----------------------
+// --------------------------------------------------
+#if defined(MTB_IMPLEMENTATION)
+
+void mtb::CopyBytes(void* dest, void const* src, size_t size) {
+#if MTB_USE_LIBC
+    ::memcpy(dest, src, size);
+#else
+    uint8_t* dst = (uint8_t*)dest;
+    uint8_t const* src = (uint8_t const*)src;
+    for(size_t index = 0; index < size; ++index) {
+        dst[index] = src[index];
+    }
+#endif  // MTB_USE_LIBC
+}
+
+void mtb::MoveBytes(void* dest, void const* src, size_t size) {
+#if MTB_USE_LIBC
+    ::memmove(dest, src, size);
+#else
+    uint8_t* dst = (uint8_t*)dest;
+    uint8_t const* src = (uint8_t const*)src;
+    if(dst < src) {
+        // copy forward
+        for(size_t index = 0; index < size; ++index) {
+            dst[index] = src[index];
+        }
+    } else {
+        // copy reverse
+        for(size_t rIndex = size; rIndex > 0; --rIndex) {
+            size_t index = rIndex - 1;
+            dst[index] = src[index];
+        }
+    }
+#endif  // MTB_USE_LIBC
+}
+
+void mtb::SetBytes(void* dest, int byte_value, size_t size) {
+#if MTB_USE_LIBC
+    ::memset(dest, byte_value, size);
+#else
+    uint8_t* dst = (uint8_t*)dest;
+    uint8_t byte_value_u8 = (uint8_t)byte_value;
+    for(size_t index = 0; index < size; index++) {
+        dst[index] = byte_value_u8;
+    }
+#endif
+}
+
+int mtb::CompareBytes(void const* a, void const* b, size_t size) {
+#if MTB_USE_LIBC
+    return ::memcmp(a, b, size);
+#else
+    uint8_t* byte_a = (uint8_t*)a;
+    uint8_t* byte_b = (uint8_t*)b;
+    for(size_t index = 0; index < size; ++index) {
+        if(byte_a[index] != byte_b[index]) {
+            return byte_a[index] - byte_b[index];
+        }
+    }
+    return 0;
+#endif
+}
+
+int mtb::SliceCompareBytes(tSlice<void const> a, tSlice<void const> b) {
+    int result = (int)(a.len - b.len);
+    if(result == 0) {
+        result = MTB_memcmp(a.ptr, b.ptr, a.len);
+    }
+    return result;
+}
+
+bool mtb::SliceBytesAreEqual(tSlice<void const> a, tSlice<void const> b) {
+    return SliceCompareBytes(a, b) == 0;
+}
+
+void mtb::AlignAllocation(void** inout_ptr, size_t* inout_size, size_t alignment) {
+    MTB_ASSERT(inout_ptr != nullptr);
+    MTB_ASSERT(*inout_ptr != nullptr);
+    MTB_ASSERT(alignment > 0);
+
+    auto unaligned = (uintptr_t)*inout_ptr;
+
+    /* Example
+        unaligned =      0b1010'1010 // input pointer
+        alignment = 16 = 0b0001'0000
+
+        a = 0b0000'1111
+        ~a = 0b1111'0000
+
+        unaligned + a = 0b1011'1001
+        (unaligned + a) & ~a = 0b1011'0000 // i.e. the last four bits are cleared.
+    */
+    size_t a = alignment - 1;
+    uintptr_t aligned = (unaligned + a) & ~a;
+    uintptr_t delta = aligned - unaligned;
+    *(uint8_t**)inout_ptr += delta;
+    if(inout_size) {
+        *inout_size += delta;
+    }
+}
+
+// IMPL
+namespace mtb::impl {
+    size_t ChooseAlignment(size_t alignment) {
+        return alignment ? alignment : MTB_ALLOCATOR_DEFAULT_ALIGNMENT;
+    }
+}  // namespace mtb::impl
+
+mtb::tSlice<void> mtb::tAllocator::AllocRaw(size_t size, size_t alignment, eInit init) const {
+    MTB_ASSERT(IsValid());
+    size_t chosen_alignment = impl::ChooseAlignment(alignment);
+    tSlice<void> result = realloc_proc(user, {}, chosen_alignment, size, chosen_alignment, init);
+    return result;
+}
+
+mtb::tSlice<void> mtb::tAllocator::ReallocRaw(tSlice<void> old_mem, size_t old_alignment, size_t new_size, size_t new_alignment, eInit init) const {
+    MTB_ASSERT(IsValid());
+    return realloc_proc(user, old_mem, impl::ChooseAlignment(old_alignment), new_size, impl::ChooseAlignment(new_alignment), init);
+}
+
+mtb::tSlice<void> mtb::tAllocator::DupeRaw(tSlice<void> mem, size_t alignment) const {
+    MTB_ASSERT(IsValid());
+    size_t chosen_alignment = impl::ChooseAlignment(alignment);
+    tSlice<void> result = realloc_proc(user, mem, chosen_alignment, mem.len, chosen_alignment, kNoInit);
+    MTB_ASSERT(result.len == mem.len);
+    MTB_memcpy(result.ptr, mem.ptr, mem.len);
+    return result;
+}
+
+void mtb::tAllocator::FreeRaw(tSlice<void> mem, size_t alignment) const {
+    MTB_ASSERT(IsValid());
+    size_t chosen_alignment = impl::ChooseAlignment(alignment);
+    realloc_proc(user, mem, chosen_alignment, 0, chosen_alignment, kNoInit);
+}
+
+#if MTB_USE_LIBC
+namespace mtb::impl {
+    // ReSharper disable once CppParameterMayBeConstPtrOrRef
+    tSlice<void> LibcReallocProc(void* user, tSlice<void> old_mem, size_t old_alignment, size_t new_size, size_t new_alignment, eInit init) {
+        (void)user;
+        MTB_ASSERT((!old_mem || old_alignment >= new_alignment) && "Changing alignment is not supported on realloc (yet?)");
+
+        tSlice<void> result{};
+        if(old_mem || new_size) {
+            void* new_ptr = ::realloc(old_mem.ptr, new_size);
+            if(new_ptr) {
+                result = PtrSlice(new_ptr, new_size);
+                void* AlignedPtr = result.ptr;
+                size_t AlignedSize = result.len;
+                AlignAllocation(&AlignedPtr, &AlignedSize, new_alignment);
+                MTB_ASSERT(AlignedSize == new_size && "Unsupported alignment");
+
+                if(init == kClearToZero && old_mem.len < result.len) {
+                    SliceSetZero(SliceOffset(result, old_mem.len));
+                }
+            } else {
+                MTB_ASSERT((old_mem.ptr == nullptr || new_size == 0) && "realloc failed to resize an existing allocation?!");
+            }
+        }
+
+        return result;
+    }
+}  // namespace mtb::impl
+
+mtb::tAllocator mtb::GetLibcAllocator() {
+    tAllocator result{};
+    result.realloc_proc = impl::LibcReallocProc;
+    return result;
+}
+#endif
+
+namespace mtb::impl {
+    tSlice<void> BufferAllocatorReallocProc(
+        void* user,
+        tSlice<void> old_mem,
+        size_t old_alignment,
+        size_t new_size,
+        size_t new_alignment,
+        eInit init
+    ) {
+        (void)old_alignment;
+        tSlice<void> result{};
+        if(old_mem || new_size) {
+            MTB_ASSERT(user);
+            tBufferAllocator& allocator = *(tBufferAllocator*)user;
+            if(old_mem && old_mem.ptr == PtrOffset(allocator.buf.ptr, allocator.fill - old_mem.len)) {
+                // Resize is requested and old_mem is the most recent allocation.
+                void* aligned_ptr = old_mem.ptr;
+                size_t required_usize = new_size;
+                AlignAllocation(&aligned_ptr, &required_usize, new_alignment);
+                auto required_size = IntCast<ptrdiff_t>(required_usize);
+                if(required_size > old_mem.len) {
+                    // Grow existing allocation if possible
+                    ptrdiff_t delta = required_size - old_mem.len;
+                    if(allocator.fill + delta <= allocator.buf.len) {
+                        result = PtrSlice(aligned_ptr, new_size);
+                        allocator.fill += delta;
+                        if(init == kClearToZero) {
+                            SliceSetZero(SliceOffset(result, old_mem.len));
+                        }
+                    }
+                } else {
+                    // Shrink existing allocation
+                    result = PtrSlice(aligned_ptr, new_size);
+                    allocator.fill -= old_mem.len - required_size;
+                }
+            } else {
+                // Try to allocate a new slice.
+                void* aligned_ptr = PtrOffset(allocator.buf.ptr, allocator.fill);
+                size_t required_usize = new_size;
+                AlignAllocation(&aligned_ptr, &required_usize, new_alignment);
+                auto required_size = IntCast<ptrdiff_t>(required_usize);
+                if(allocator.fill + required_size <= allocator.buf.len) {
+                    result = PtrSlice(aligned_ptr, new_size);
+                    allocator.fill += required_size;
+                    if(init == kClearToZero) {
+                        SliceSetZero(result);
+                    }
+                }
+            }
+        }
+        return result;
+    }
+}  // namespace mtb::impl
+
+mtb::tAllocator mtb::tBufferAllocator::Allocator() {
+    tAllocator result;
+    result.user = this;
+    result.realloc_proc = mtb::impl::BufferAllocatorReallocProc;
+    return result;
+}
+
+#if MTB_USE_STB_SPRINTF
+namespace mtb::impl {
+    char* InternalPrintfCallback(char const* buf, void* user, int len) {
+        PushMany(*(tArray<char>*)user, PtrSlice(buf, len));
+        return const_cast<char*>(buf);
+    }
+}  // namespace mtb::impl
+
+mtb::tSlice<char> mtb::vprintfAlloc(tAllocator a, char const* format, va_list vargs) {
+    tArray<char> buffer{
+        .allocator = a,
+    };
+    char temp_buffer[STB_SPRINTF_MIN];
+    stbsp_vsprintfcb(impl::InternalPrintfCallback, &buffer, temp_buffer, format, vargs);
+    PushOne<char>(buffer, kNoInit) = 0;
+    tSlice<char> result = ShrinkAllocation(buffer);
+    if(result.len > 0) {
+        result.len -= 1;
+    }
+    return result;
+}
+
+mtb::tSlice<char> mtb::PushFormat(tArray<char>& array, char const* format, ...) {
+    va_list vargs;
+    va_start(vargs, format);
+    tSlice<char> result = PushFormatV(array, format, vargs);
+    va_end(vargs);
+    return result;
+}
+
+mtb::tSlice<char> mtb::PushFormatV(tArray<char>& array, char const* format, va_list vargs) {
+    ptrdiff_t offset = array.len;
+    char temp_buffer[STB_SPRINTF_MIN];
+    stbsp_vsprintfcb(impl::InternalPrintfCallback, &array, temp_buffer, format, vargs);
+    return SliceOffset(array.items, offset);
+}
+#endif  // MTB_USE_STB_SPRINTF
+
+mtb::tSlice<char> mtb::ToString(tArray<char>& array, bool null_terminate /*= true*/) {
+    ptrdiff_t end_offset = 0;
+    if(null_terminate) {
+        Push(array, '\0');
+        end_offset = 1;
+    }
+    ShrinkAllocation(array);
+    return SliceRange(array.items, 0, array.len - end_offset);
+}
+
+void mtb::QuickSort(void* user_ptr, ptrdiff_t count, bool (*less_proc)(void*, ptrdiff_t, ptrdiff_t), void (*swap_proc)(void*, ptrdiff_t, ptrdiff_t), ptrdiff_t threshold) {
+    // Based on https://github.com/svpv/qsort
+    if(count <= 1) {
+        return;
+    }
+
+    ptrdiff_t left = 0;
+    ptrdiff_t right = count - 1;
+    ptrdiff_t stack_pointer = 0;  // the number of frames pushed to the stack
+
+    struct
+    {
+        ptrdiff_t left, right;
+    } stack[sizeof(count) > 4 ? 48 : 32];
+
+    while(true) {
+        if(right - left + 1 >= threshold) {
+            // Partition
+            ptrdiff_t Middle = left + ((right - left) >> 1);
+
+            // Sort 3 elements
+            if(less_proc(user_ptr, Middle, left + 1)) {
+                if(less_proc(user_ptr, right, Middle)) {
+                    swap_proc(user_ptr, left + 1, right);
+                } else {
+                    swap_proc(user_ptr, left + 1, Middle);
+                    if(less_proc(user_ptr, right, Middle)) {
+                        swap_proc(user_ptr, Middle, right);
+                    }
+                }
+            } else if(less_proc(user_ptr, right, Middle)) {
+                swap_proc(user_ptr, Middle, right);
+                if(less_proc(user_ptr, Middle, left + 1)) {
+                    swap_proc(user_ptr, left + 1, Middle);
+                }
+            }
+
+            // Place the median at the beginning
+            swap_proc(user_ptr, left, Middle);
+
+            ptrdiff_t I = left + 1;
+            ptrdiff_t J = right;
+            while(true) {
+                do {
+                    ++I;
+                } while(less_proc(user_ptr, I, left));
+                do {
+                    --J;
+                } while(less_proc(user_ptr, left, J));
+                if(I >= J) {
+                    break;
+                }
+
+                swap_proc(user_ptr, I, J);
+            }
+
+            // Compensate for the I==J case.
+            I = J + 1;
+            swap_proc(user_ptr, left, J);
+            // The median is not part of the left subfile.
+            --J;
+
+            ptrdiff_t L1, R1, L2, R2;
+            if(J - left >= right - I) {
+                L1 = left;
+                R1 = J;
+                L2 = I;
+                R2 = right;
+            } else {
+                L1 = I;
+                R1 = right;
+                L2 = left;
+                R2 = J;
+            }
+
+            if(L2 == R2) {
+                left = L1;
+                right = R1;
+            } else {
+                stack[stack_pointer].left = L1;
+                stack[stack_pointer].right = R1;
+                stack_pointer++;
+                // Process the smaller subfile on the next iteration.
+                left = L2;
+                right = R2;
+            }
+        } else {
+            // Insertion sort
+            for(ptrdiff_t I = left + 1; I <= right; ++I) {
+                for(ptrdiff_t J = I; J > left && less_proc(user_ptr, J, J - 1); --J) {
+                    swap_proc(user_ptr, J, J - 1);
+                }
+            }
+
+            if(stack_pointer == 0) {
+                break;
+            }
+
+            --stack_pointer;
+            left = stack[stack_pointer].left;
+            right = stack[stack_pointer].right;
+        }
+    }
+}
+
+void mtb::RunTasks(tTaskRunner runner, ptrdiff_t task_count, void (*task_proc)(void* task_context, ptrdiff_t index), void* task_context) {
+    if(runner) {
+        runner.run_proc(runner.user, task_count, task_proc, task_context);
+    } else {
+        for(ptrdiff_t index = 0; index < task_count; ++index) {
+            task_proc(task_context, index);
+        }
+    }
+}
+
+namespace mtb {
+    void InternalInsertNextBucket(tArenaBucket*& current_bucket, tArenaBucket* new_bucket) {
+        if(current_bucket) {
+            new_bucket->prev = current_bucket;
+            new_bucket->next = current_bucket->next;
+            new_bucket->next->prev = new_bucket->prev->next = new_bucket;
+        } else {
+            new_bucket->prev = new_bucket->next = new_bucket;
+        }
+        current_bucket = new_bucket;
+    }
+
+    tArenaBucket* InternalUnlinkBucket(tArenaBucket*& current_bucket) {
+        MTB_ASSERT(current_bucket != nullptr);
+
+        tArenaBucket* result = current_bucket;
+        if(current_bucket == current_bucket->prev) {
+            current_bucket = nullptr;
+        } else {
+            current_bucket->prev->next = current_bucket->next;
+            current_bucket->next->prev = current_bucket->prev;
+            current_bucket = current_bucket->prev;
+        }
+        result->prev = result->next = nullptr;
+        return result;
+    }
+
+    uint8_t* InternalBucketAlloc(tArenaBucket* bucket, size_t* inout_size, size_t alignment) {
+        uint8_t* result = nullptr;
+        if(bucket && inout_size) {
+            result = bucket->data + bucket->used_size;
+            size_t EffectiveSize = *inout_size;
+            AlignAllocation((void**)&result, &EffectiveSize, alignment);
+            if(BucketUsedSize(bucket) + EffectiveSize <= BucketTotalSize(bucket)) {
+                *inout_size = EffectiveSize;
+            } else {
+                result = nullptr;
+            }
+        }
+        return result;
+    }
+
+    void* InternalArenaAlloc(tArena& arena, size_t size, size_t alignment) {
+        size_t EffectiveSize = size;
+        uint8_t* result = InternalBucketAlloc(arena.current_bucket, &EffectiveSize, alignment);
+        if(!result) {
+            result = InternalBucketAlloc(arena.first_free_bucket, &EffectiveSize, alignment);
+            if(result) {
+                InternalInsertNextBucket(arena.current_bucket, InternalUnlinkBucket(arena.first_free_bucket));
+            } else {
+                Grow(arena, size + alignment);
+                MTB_ASSERT(arena.current_bucket);
+
+                result = arena.current_bucket->data;
+                AlignAllocation((void**)&result, &EffectiveSize, alignment);
+                MTB_ASSERT(BucketUsedSize(arena.current_bucket) + EffectiveSize <= BucketTotalSize(arena.current_bucket));
+            }
+        }
+
+        arena.current_bucket->used_size += EffectiveSize;
+
+        return result;
+    }
+
+    tSlice<void> InternalArenaAllocatorProc(void* user, tSlice<void> old_mem, size_t old_alignment, size_t new_size, size_t new_alignment, eInit init) {
+        auto* arena = (tArena*)user;
+        MTB_ASSERT(arena);
+        void* new_ptr = ReallocRaw(*arena, old_mem.ptr, old_mem.len, old_alignment, new_size, new_alignment, init);
+        tSlice<void> result = PtrSlice(new_ptr, new_size);
+        return result;
+    }
+
+    size_t InternalBucketAllocationSize(size_t total_size) {
+        return sizeof(tArenaBucket) + total_size;
+    }
+
+    uint8_t* InternalTrailingBucketData(tArenaBucket* bucket) {
+        return (uint8_t*)(bucket + 1);
+    }
+
+    bool InternalIsSpillBucket(tArenaBucket* bucket) {
+        return bucket->data != InternalTrailingBucketData(bucket);
+    }
+
+    void InternalFreeBucket(tArena& arena, tArenaBucket* bucket) {
+        if(InternalIsSpillBucket(bucket)) {
+            MTB_ASSERT(arena.spill);
+            tArenaSpill& spill = *arena.spill;
+            if(bucket->data) {
+                arena.child_allocator.FreeRaw(PtrSlice((void*)bucket->data, bucket->total_size), alignof(tArenaBucket));
+                spill.resident_size -= bucket->total_size;
+            } else {
+                spill.spilled_size -= bucket->total_size;
+            }
+
+            // Buckets are spilled oldest first and freed newest first, so this usually gives back the end of the store.
+            if(bucket->spill_offset != kNoSpillOffset && bucket->spill_offset + bucket->total_size == spill.store_size) {
+                spill.store_size = bucket->spill_offset;
+            }
+
+            arena.child_allocator.FreeRaw(PtrSlice((void*)bucket, sizeof(tArenaBucket)), alignof(tArenaBucket));
+            return;
+        }
+
+        if(arena.bucket_pool && ReturnBucket(*arena.bucket_pool, bucket)) {
+            return;
+        }
+        arena.child_allocator.FreeRaw(PtrSlice((void*)bucket, InternalBucketAllocationSize(bucket->total_size)), alignof(tArenaBucket));
+    }
+
+    bool InternalSpillBucket(tArena& arena, tArenaBucket* bucket) {
+        MTB_ASSERT(arena.spill && bucket->data);
+        tArenaSpill& spill = *arena.spill;
+
+        uint64_t offset = bucket->spill_offset;
+        if(offset == kNoSpillOffset) {
+            offset = spill.store_size;
+        }
+
+        tSlice<void const> data = PtrSlice((void const*)bucket->data, bucket->used_size);
+        if(!spill.store.write_proc(spill.store.user, offset, data)) {
+            return false;
+        }
+
+        if(bucket->spill_offset == kNoSpillOffset) {
+            bucket->spill_offset = offset;
+            spill.store_size += bucket->total_size;
+        }
+
+        arena.child_allocator.FreeRaw(PtrSlice((void*)bucket->data, bucket->total_size), alignof(tArenaBucket));
+        bucket->data = nullptr;
+        spill.resident_size -= bucket->total_size;
+        spill.spilled_size += bucket->total_size;
+        return true;
+    }
+
+    void InternalPageInBucket(tArena& arena, tArenaBucket* bucket) {
+        if(bucket->data) {
+            return;
+        }
+
+        MTB_ASSERT(arena.spill);
+        tArenaSpill& spill = *arena.spill;
+
+        bucket->data = (uint8_t*)arena.child_allocator.AllocRaw(bucket->total_size, alignof(tArenaBucket), kNoInit).ptr;
+        // #TODO Handle out-of-memory properly.
+        MTB_ASSERT(bucket->data != nullptr);
+
+        bool ok = spill.store.read_proc(spill.store.user, bucket->spill_offset, PtrSlice((void*)bucket->data, bucket->used_size));
+        // #TODO Report unreadable spill stores properly.
+        MTB_ASSERT(ok && "Unable to read spilled arena bucket.");
+        (void)ok;
+
+        spill.spilled_size -= bucket->total_size;
+        spill.resident_size += bucket->total_size;
+    }
+}  // namespace mtb
+
+namespace mtb::impl {
+    tArenaBucket* AtomicLoadPtr(tArenaBucket* const* ptr) {
+#if MTB_COMPILER_MSVC && !MTB_COMPILER_CLANG
+        return (tArenaBucket*)_InterlockedCompareExchangePointer((void* volatile*)ptr, nullptr, nullptr);
+#else
+        return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#endif
+    }
+
+    tArenaBucket* AtomicExchangePtr(tArenaBucket** ptr, tArenaBucket* value) {
+#if MTB_COMPILER_MSVC && !MTB_COMPILER_CLANG
+        return (tArenaBucket*)_InterlockedExchangePointer((void* volatile*)ptr, value);
+#else
+        return __atomic_exchange_n(ptr, value, __ATOMIC_ACQ_REL);
+#endif
+    }
+
+    bool AtomicCompareExchangePtr(tArenaBucket** ptr, tArenaBucket* expected, tArenaBucket* desired) {
+#if MTB_COMPILER_MSVC && !MTB_COMPILER_CLANG
+        return _InterlockedCompareExchangePointer((void* volatile*)ptr, desired, expected) == expected;
+#else
+        return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+    }
+
+    /// Returns -1 if buckets of this size are never cached.
+    int BucketPoolSizeClass(size_t total_size) {
+        return IsPowerOfTwo(total_size) ? Log2Floor(total_size) : -1;
+    }
+}  // namespace mtb::impl
+
+mtb::tArenaBucketPool& mtb::GlobalArenaBucketPool() {
+    static tArenaBucketPool global_pool{};
+    return global_pool;
+}
+
+mtb::tArenaBucket* mtb::TakeBucket(tArenaBucketPool& pool, size_t total_size) {
+    int size_class = impl::BucketPoolSizeClass(total_size);
+    if(size_class < 0) {
+        return nullptr;
+    }
+
+    for(tArenaBucket*& slot : pool.slots[size_class]) {
+        // Check first so empty slots don't cost an atomic read-modify-write.
+        if(impl::AtomicLoadPtr(&slot)) {
+            if(tArenaBucket* bucket = impl::AtomicExchangePtr(&slot, nullptr)) {
+                MTB_ASSERT(bucket->total_size == total_size);
+                return bucket;
+            }
+        }
+    }
+    return nullptr;
+}
+
+bool mtb::ReturnBucket(tArenaBucketPool& pool, tArenaBucket* bucket) {
+    MTB_ASSERT(bucket);
+    int size_class = impl::BucketPoolSizeClass(bucket->total_size);
+    if(size_class < 0) {
+        return false;
+    }
+
+    bucket->next = bucket->prev = nullptr;
+    bucket->used_size = 0;
+    for(tArenaBucket*& slot : pool.slots[size_class]) {
+        if(!impl::AtomicLoadPtr(&slot) && impl::AtomicCompareExchangePtr(&slot, nullptr, bucket)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void mtb::ReleaseBuckets(tArenaBucketPool& pool, tAllocator allocator) {
+    for(auto& size_class : pool.slots) {
+        for(tArenaBucket*& slot : size_class) {
+            if(tArenaBucket* bucket = impl::AtomicExchangePtr(&slot, nullptr)) {
+                allocator.FreeRaw(PtrSlice((void*)bucket, InternalBucketAllocationSize(bucket->total_size)), alignof(tArenaBucket));
+            }
+        }
+    }
+}
+
+size_t mtb::BucketTotalSize(tArenaBucket const* bucket) {
+    return bucket ? bucket->total_size : 0;
+}
+
+size_t mtb::BucketUsedSize(tArenaBucket const* bucket) {
+    return bucket ? bucket->used_size : 0;
+}
+
+void mtb::Grow(tArena& arena, size_t required_size) {
+    if(arena.min_bucket_size == 0) {
+        arena.min_bucket_size = MTB_ARENA_DEFAULT_BUCKET_SIZE;
+    }
+
+    size_t new_bucket_size = BucketTotalSize(arena.current_bucket);
+    if(new_bucket_size < arena.min_bucket_size) {
+        new_bucket_size = arena.min_bucket_size;
+    }
+    while(new_bucket_size < required_size) {
+        new_bucket_size *= 2;
+    }
+
+    tArenaBucket* new_bucket = nullptr;
+    tAllocator allocator = arena.child_allocator;
+    if(arena.spill) {
+        MTB_ASSERT(allocator && "Spilling arenas need a child_allocator.");
+        new_bucket = (tArenaBucket*)allocator.AllocRaw(sizeof(tArenaBucket), alignof(tArenaBucket), kNoInit).ptr;
+        MTB_ASSERT(new_bucket != nullptr);
+        new_bucket->data = (uint8_t*)allocator.AllocRaw(new_bucket_size, alignof(tArenaBucket), kNoInit).ptr;
+        // #TODO Handle out-of-memory properly.
+        MTB_ASSERT(new_bucket->data != nullptr);
+        arena.spill->resident_size += new_bucket_size;
+    } else {
+        if(arena.bucket_pool) {
+            new_bucket = TakeBucket(*arena.bucket_pool, new_bucket_size);
+        }
+
+        if(!new_bucket && allocator) {
+            new_bucket = (tArenaBucket*)allocator.AllocRaw(InternalBucketAllocationSize(new_bucket_size), alignof(tArenaBucket), kNoInit).ptr;
+            // #TODO Handle out-of-memory properly.
+            MTB_ASSERT(new_bucket != nullptr);
+        }
+
+        if(new_bucket) {
+            new_bucket->data = InternalTrailingBucketData(new_bucket);
+        }
+    }
+
+    if(new_bucket) {
+        new_bucket->used_size = 0;
+        new_bucket->total_size = new_bucket_size;
+        new_bucket->spill_offset = kNoSpillOffset;
+        InternalInsertNextBucket(arena.current_bucket, new_bucket);
+
+        if(arena.largest_bucket_size < new_bucket_size) {
+            arena.largest_bucket_size = new_bucket_size;
+        }
+
+        if(arena.spill && arena.spill->resident_size > arena.spill->resident_budget) {
+            SpillBuckets(arena);
+        }
+    }
+}
+
+void mtb::Reserve(tArena& arena, size_t total_size) {
+    if(total_size > BucketTotalSize(arena.current_bucket)) {
+        Grow(arena, total_size);
+    }
+}
+
+void mtb::Clear(tArena& arena, bool release_memory /*= true*/) {
+    ResetToMarker(arena, {}, release_memory);
+    if(arena.first_free_bucket && release_memory) {
+        if(arena.child_allocator) {
+            while(arena.first_free_bucket) {
+                InternalFreeBucket(arena, InternalUnlinkBucket(arena.first_free_bucket));
+            }
+        }
+    }
+}
+
+void* mtb::ReallocRaw(tArena& arena, void* old_ptr, size_t old_size, size_t old_alignment, size_t new_size, size_t new_alignment, eInit init) {
+    if(old_ptr || old_size) {
+        MTB_ASSERT(old_ptr && old_size);
+    }
+
+    ptrdiff_t DeltaSize = (ptrdiff_t)new_size - (ptrdiff_t)old_size;
+    if(DeltaSize < 0) {
+        DeltaSize = -DeltaSize;
+    }
+
+    void* result = nullptr;
+    if(!old_ptr) {
+        if(new_size) {
+            result = InternalArenaAlloc(arena, new_size, new_alignment);
+            if(init == kClearToZero) {
+                MTB_memset(result, 0, new_size);
+            }
+        }
+    } else {
+        MTB_ASSERT(old_alignment == new_alignment && "Old and new alignment must be the same for now.");
+
+        if(new_size < old_size) {
+            if((uintptr_t)old_ptr + (uintptr_t)old_size == (uintptr_t)GetMarker(arena).ptr()) {
+                // Shrink the existing allocation.
+                MTB_ASSERT(arena.current_bucket);
+                MTB_ASSERT(arena.current_bucket->used_size >= (size_t)DeltaSize);
+                arena.current_bucket->used_size -= DeltaSize;
+            }
+
+            if(new_size) {
+                result = old_ptr;
+            }
+        } else if(new_size > old_size) {
+            // Can we grow the existing allocation?
+            if((uintptr_t)old_ptr + (uintptr_t)old_size == (uintptr_t)GetMarker(arena).ptr() &&
+               BucketUsedSize(arena.current_bucket) + DeltaSize <= BucketTotalSize(arena.current_bucket)) {
+                void* new_ptr = InternalArenaAlloc(arena, DeltaSize, 1);
+                MTB_ASSERT((uintptr_t)new_ptr == (uintptr_t)old_ptr + (uintptr_t)old_size);
+                (void)new_ptr;
+                result = old_ptr;
+            } else {
+                result = InternalArenaAlloc(arena, new_size, new_alignment);
+                MTB_ASSERT(result != nullptr);
+                MTB_memcpy(result, old_ptr, old_size);
+            }
+
+            if(init == kClearToZero) {
+                MTB_memset(PtrOffset(result, old_size), 0, DeltaSize);
+            }
+        } else {
+            result = old_ptr;
+        }
+    }
+
+    return result;
+}
+
+void* mtb::PushRaw(tArena& arena, size_t size, size_t alignment, eInit init) {
+    return ReallocRaw(arena, nullptr, 0, 0, size, alignment, init);
+}
+
+mtb::tSlice<void> mtb::ReallocRawArray(tArena& arena, tSlice<void> old_array, size_t old_alignment, size_t new_size, size_t new_alignment, eInit init) {
+    void* ptr = ReallocRaw(arena, old_array.ptr, old_array.len, old_alignment, new_size, new_alignment, init);
+    return PtrSlice(ptr, new_size);
+}
+
+mtb::tSlice<void> mtb::PushRawArray(tArena& arena, size_t size, size_t alignment, eInit init) {
+    return ReallocRawArray(arena, {}, 0, size, alignment, init);
+}
+
+mtb::tArenaMarker mtb::GetMarker(tArena const& arena) {
+    tArenaMarker result{arena.current_bucket, BucketUsedSize(arena.current_bucket)};
+    return result;
+}
+
+void mtb::ResetToMarker(tArena& arena, tArenaMarker marker, bool release_memory /*= true*/) {
+    if(arena.current_bucket) {
+        if(!arena.child_allocator) {
+            release_memory = false;
+        }
+
+        if(!marker.bucket) {
+            // Treat the empty marker as a marker of the oldest bucket.
+            marker.bucket = arena.current_bucket->next;
+        }
+
+        // search backwards through all buckets, freeing them if they're not
+        // the one we're looking for.
+        bool looping = true;
+        while(looping) {
+            if(arena.current_bucket == marker.bucket) {
+                looping = false;
+                if(marker.offset > 0) {
+                    break;
+                }
+            }
+
+            tArenaBucket* free_bucket = InternalUnlinkBucket(arena.current_bucket);
+            // The contents of spilled buckets are gone anyway, so there is no point in keeping them around.
+            if(release_memory || !free_bucket->data) {
+                InternalFreeBucket(arena, free_bucket);
+            } else {
+                InternalInsertNextBucket(arena.first_free_bucket, free_bucket);
+            }
+        }
+
+        if(arena.current_bucket) {
+            InternalPageInBucket(arena, arena.current_bucket);
+            arena.current_bucket->used_size = marker.offset;
+        }
+    }
+}
+
+mtb::tSlice<void> mtb::Linearize(tArena& arena, tArenaMarker begin, tArenaMarker end) {
+    if(!end.bucket) {
+        MTB_ASSERT(!begin.bucket);
+    } else if(!begin.bucket) {
+        MTB_ASSERT(arena.current_bucket);
+        // If the begin marker has a null-bucket, use the first/oldest bucket.
+        begin.bucket = arena.current_bucket->next;
+    }
+
+    tSlice<void> result;
+    if(begin.bucket == end.bucket) {
+        MTB_ASSERT(begin.offset <= end.offset);
+        if(begin.bucket) {
+            InternalPageInBucket(arena, begin.bucket);
+        }
+        result = PtrSliceBetween(begin.ptr(), end.ptr());
+    } else {
+        MTB_ASSERT(end.bucket);
+
+        // determine the size
+        size_t required_size = begin.bucket->used_size - begin.offset;
+        for(tArenaBucket* bucket = begin.bucket->next; bucket != end.bucket; bucket = bucket->next) {
+            required_size += bucket->used_size;
+        }
+        required_size += end.offset;
+
+        // allocate data
+        result = PushArray<uint8_t>(arena, required_size, kNoInit);
+
+        // Allocating may have spilled some of the source buckets.
+        PageIn(arena, begin, end);
+
+        // copy the data
+        size_t cursor = 0;
+        MTB_memcpy(result + cursor, begin.bucket->data + begin.offset, begin.bucket->used_size - begin.offset);
+        cursor += begin.bucket->used_size - begin.offset;
+        for(tArenaBucket* bucket = begin.bucket->next; bucket != end.bucket; bucket = bucket->next) {
+            MTB_memcpy(result + cursor, bucket->data, bucket->used_size);
+            cursor += bucket->used_size;
+        }
+        MTB_memcpy(result + cursor, end.bucket->data, end.offset);
+    }
+
+    return result;
+}
+
+mtb::tAllocator mtb::MakeAllocator(tArena& arena) {
+    // ReSharper disable once CppInitializedValueIsAlwaysRewritten
+    tAllocator result{};
+    result.user = &arena;
+    result.realloc_proc = InternalArenaAllocatorProc;
+    return result;
+}
+
+bool mtb::SpillBuckets(tArena& arena) {
+    if(!arena.spill) {
+        return true;
+    }
+
+    tArenaSpill& spill = *arena.spill;
+    MTB_ASSERT(spill.store && "Spilling arenas need a block store.");
+    if(arena.current_bucket) {
+        for(tArenaBucket* bucket = arena.current_bucket->next; bucket != arena.current_bucket; bucket = bucket->next) {
+            if(spill.resident_size <= spill.resident_budget) {
+                break;
+            }
+            if(bucket->data && !InternalSpillBucket(arena, bucket)) {
+                return false;
+            }
+        }
+    }
+    return spill.resident_size <= spill.resident_budget;
+}
+
+void mtb::PageIn(tArena& arena, tArenaMarker begin, tArenaMarker end) {
+    if(!arena.current_bucket || !end.bucket) {
+        return;
+    }
+
+    tArenaBucket* bucket = begin.bucket ? begin.bucket : arena.current_bucket->next;
+    while(true) {
+        InternalPageInBucket(arena, bucket);
+        if(bucket == end.bucket) {
+            break;
+        }
+        bucket = bucket->next;
+    }
+}
+
+bool mtb::IsBucketResident(tArenaBucket const* bucket) {
+    return bucket && bucket->data;
+}
+
+namespace mtb::impl {
+    // "MTBS" in little endian.
+    constexpr uint32_t snapshot_magic = 0x5342544D;
+
+    size_t SnapshotBucketOffset() {
+        size_t a = alignof(tArenaBucket) - 1;
+        return (sizeof(tArenaSnapshotHeader) + a) & ~a;
+    }
+
+    uint64_t SnapshotLoad64(uint8_t const* ptr) {
+        uint64_t result;
+        MTB_memcpy(&result, ptr, sizeof(result));
+        return result;
+    }
+
+    // Four independent multiply-xorshift lanes so the hash isn't bound by the latency of a single multiplication.
+    uint64_t SnapshotChecksum(tSlice<void const> bytes) {
+        uint64_t const prime = 0x9E3779B97F4A7C15ULL;
+        uint64_t lanes[4]{prime, prime ^ 1, prime ^ 2, prime ^ 3};
+        auto const* ptr = (uint8_t const*)bytes.ptr;
+        size_t remaining = (size_t)bytes.len;
+        for(; remaining >= 32; remaining -= 32, ptr += 32) {
+            for(int lane = 0; lane < 4; ++lane) {
+                lanes[lane] = (lanes[lane] ^ SnapshotLoad64(ptr + 8 * lane)) * prime;
+                lanes[lane] ^= lanes[lane] >> 29;
+            }
+        }
+
+        uint64_t result = (uint64_t)bytes.len;
+        for(uint64_t lane : lanes) {
+            result = (result ^ lane) * prime;
+        }
+        for(; remaining > 0; --remaining, ++ptr) {
+            result = (result ^ *ptr) * prime;
+        }
+        return result ^ (result >> 32);
+    }
+}  // namespace mtb::impl
+
+mtb::tArena mtb::BeginArenaSnapshot(tSlice<void> memory) {
+    size_t bucket_offset = impl::SnapshotBucketOffset();
+    MTB_ASSERT(memory.ptr && (size_t)memory.len > bucket_offset + sizeof(tArenaBucket));
+
+    ItemSetZero(*(tArenaSnapshotHeader*)memory.ptr);
+
+    auto* bucket = (tArenaBucket*)PtrOffset(memory.ptr, bucket_offset);
+    bucket->data = InternalTrailingBucketData(bucket);
+    bucket->spill_offset = kNoSpillOffset;
+    size_t payload_offset = (size_t)PtrDistance(bucket->data, (uint8_t*)memory.ptr);
+    bucket->used_size = 0;
+    bucket->total_size = (size_t)memory.len - payload_offset;
+
+    tArena result{};
+    InternalInsertNextBucket(result.current_bucket, bucket);
+    result.min_bucket_size = bucket->total_size;
+    result.largest_bucket_size = bucket->total_size;
+    return result;
+}
+
+mtb::tSlice<void> mtb::FinishArenaSnapshot(tArena& arena, void const* root, uint64_t user_version) {
+    tArenaBucket* bucket = arena.current_bucket;
+    MTB_ASSERT(bucket && bucket->next == bucket && "Not an arena created by BeginArenaSnapshot.");
+    MTB_ASSERT(!arena.child_allocator && "Not an arena created by BeginArenaSnapshot.");
+    MTB_ASSERT((uint8_t const*)root >= bucket->data && (uint8_t const*)root < bucket->data + bucket->used_size);
+
+    void* memory = PtrOffset((void*)bucket, -(ptrdiff_t)impl::SnapshotBucketOffset());
+    auto* header = (tArenaSnapshotHeader*)memory;
+    header->magic = impl::snapshot_magic;
+    header->format_version = MTB_ARENA_SNAPSHOT_FORMAT_VERSION;
+    header->user_version = user_version;
+    header->payload_offset = (uint64_t)PtrDistance(bucket->data, (uint8_t*)memory);
+    header->payload_size = bucket->used_size;
+    header->payload_checksum = impl::SnapshotChecksum(PtrSlice((void const*)bucket->data, (ptrdiff_t)bucket->used_size));
+    header->root_offset = (uint64_t)PtrDistance((uint8_t const*)root, (uint8_t const*)bucket->data);
+
+    return PtrSlice(memory, (ptrdiff_t)(header->payload_offset + header->payload_size));
+}
+
+mtb::tArenaSnapshot mtb::OpenArenaSnapshot(tSlice<void const> memory, uint64_t user_version, bool verify_checksum /*= true*/) {
+    tArenaSnapshot result{};
+    if(!memory.ptr || (size_t)memory.len < sizeof(tArenaSnapshotHeader)) {
+        return result;
+    }
+
+    auto const* header = (tArenaSnapshotHeader const*)memory.ptr;
+    if(header->magic != impl::snapshot_magic || header->format_version != MTB_ARENA_SNAPSHOT_FORMAT_VERSION || header->user_version != user_version) {
+        return result;
+    }
+
+    if(header->payload_offset > (uint64_t)memory.len || header->payload_size > (uint64_t)memory.len - header->payload_offset || header->root_offset >= header->payload_size) {
+        return result;
+    }
+
+    tSlice<void const> payload = PtrSlice(PtrOffset(memory.ptr, (ptrdiff_t)header->payload_offset), (ptrdiff_t)header->payload_size);
+    if(verify_checksum && impl::SnapshotChecksum(payload) != header->payload_checksum) {
+        return result;
+    }
+
+    result.is_valid = true;
+    result.payload = payload;
+    result.root = PtrOffset(payload.ptr, (ptrdiff_t)header->root_offset);
+    return result;
+}
+
+#if MTB_USE_STB_SPRINTF
+namespace mtb {
+    static char* InternalArenaPrintCallback(char const* buf, void* user, int len) {
+        auto* arena = (tArena*)user;
+        tSlice<void> dest = PushRawArray(*arena, len, 1, kNoInit);
+        SliceCopyBytes(dest, PtrSlice(buf, len));
+        return const_cast<char*>(buf);
+    }
+}  // namespace mtb
+
+void mtb::vprintf_ArenaRaw(tArena& arena, char const* format, va_list vargs) {
+    char temp_buffer[STB_SPRINTF_MIN];
+    stbsp_vsprintfcb(InternalArenaPrintCallback, &arena, temp_buffer, format, vargs);
+}
+
+mtb::tSlice<char> mtb::vprintf_Arena(tArena& arena, char const* format, va_list vargs) {
+    // Remember where we were in this arena.
+    tArenaMarker begin_marker = GetMarker(arena);
+
+    // Produce formatted string fragments within the arena.
+    vprintf_ArenaRaw(arena, format, vargs);
+
+    // Append the null-terminator.
+    PushOne<char>(arena, kNoInit) = 0;
+
+    // Make sure all formatted string fragments we produced are actually linear in memory.
+    tSlice<char> result = SliceCast<char>(Linearize(arena, begin_marker, GetMarker(arena)));
+    MTB_ASSERT(result.len > 0);
+
+    // Remove the null-terminator from the result.
+    result.len--;
+
+    return result;
+}
+#endif  // MTB_USE_STB_SPRINTF
+
+namespace mtb::impl {
+    template<typename C>
+    C Impl_ToLowerChar(C c) {
+        switch(c) {
+            case (C)'a': return (C)'a';
+            case (C)'b': return (C)'b';
+            case (C)'C': return (C)'c';
+            case (C)'D': return (C)'d';
+            case (C)'E': return (C)'e';
+            case (C)'F': return (C)'f';
+            case (C)'G': return (C)'g';
+            case (C)'H': return (C)'h';
+            case (C)'I': return (C)'i';
+            case (C)'J': return (C)'j';
+            case (C)'K': return (C)'k';
+            case (C)'L': return (C)'l';
+            case (C)'M': return (C)'m';
+            case (C)'N': return (C)'n';
+            case (C)'O': return (C)'o';
+            case (C)'P': return (C)'p';
+            case (C)'Q': return (C)'q';
+            case (C)'R': return (C)'r';
+            case (C)'S': return (C)'s';
+            case (C)'T': return (C)'t';
+            case (C)'U': return (C)'u';
+            case (C)'V': return (C)'v';
+            case (C)'W': return (C)'w';
+            case (C)'X': return (C)'x';
+            case (C)'Y': return (C)'y';
+            case (C)'Z': return (C)'z';
+            default: return c;
+        }
+    }
+
+    template<typename C>
+    C Impl_ToUpperChar(C c) {
+        switch(c) {
+            case (C)'a': return (C)'a';
+            case (C)'b': return (C)'b';
+            case (C)'c': return (C)'C';
+            case (C)'d': return (C)'D';
+            case (C)'e': return (C)'E';
+            case (C)'f': return (C)'F';
+            case (C)'g': return (C)'G';
+            case (C)'h': return (C)'H';
+            case (C)'i': return (C)'I';
+            case (C)'j': return (C)'J';
+            case (C)'k': return (C)'K';
+            case (C)'l': return (C)'L';
+            case (C)'m': return (C)'M';
+            case (C)'n': return (C)'N';
+            case (C)'o': return (C)'O';
+            case (C)'p': return (C)'P';
+            case (C)'q': return (C)'Q';
+            case (C)'r': return (C)'R';
+            case (C)'s': return (C)'S';
+            case (C)'t': return (C)'T';
+            case (C)'u': return (C)'U';
+            case (C)'v': return (C)'V';
+            case (C)'w': return (C)'W';
+            case (C)'x': return (C)'X';
+            case (C)'y': return (C)'Y';
+            case (C)'z': return (C)'Z';
+            default: return c;
+        }
+    }
+
+    template<typename C>
+    bool Impl_IsDigitChar(C c) {
+        switch(c) {
+            case (C)'0':
+            case (C)'1':
+            case (C)'2':
+            case (C)'3':
+            case (C)'4':
+            case (C)'5':
+            case (C)'6':
+            case (C)'7':
+            case (C)'8':
+            case (C)'9':
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    template<typename C>
+    bool Impl_IsWhiteChar(C c) {
+        switch(c) {
+            case (C)' ':
+            case (C)'\n':
+            case (C)'\r':
+            case (C)'\t':
+            case (C)'\v':
+            case (C)'\b':
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    template<typename C>
+    int32_t Impl_StringCompare(tSlice<C const> str_a, tSlice<C const> str_b, eStringComparison cmp) {
+        int32_t result = 0;
+
+        if(str_a.len != str_b.len) {
+            result = IntCast<int32_t>(str_a.len - str_b.len);
+        } else {
+            size_t count = str_a.len;
+            switch(cmp) {
+                case kCaseSensitive: {
+                    for(size_t ByteIndex = 0; ByteIndex < count; ++ByteIndex) {
+                        if(str_a.ptr[ByteIndex] != str_b.ptr[ByteIndex]) {
+                            result = str_a.ptr[ByteIndex] < str_b.ptr[ByteIndex] ? -1 : 1;
+                            break;
+                        }
+                    }
+                } break;
+
+                case eStringComparison::kIgnoreCase: {
+                    for(size_t ByteIndex = 0; ByteIndex < count; ++ByteIndex) {
+                        C CharA = ToLowerChar(str_a.ptr[ByteIndex]);
+                        C CharB = ToLowerChar(str_b.ptr[ByteIndex]);
+                        if(CharA != CharB) {
+                            result = (int32_t)(CharA - CharB);
+                            break;
+                        }
+                    }
+                } break;
+            }
+        }
+
+        return result;
+    }
+
+    MTB_NODISCARD inline uint32_t StringSortKey(char c) { return (uint8_t)c; }
+    MTB_NODISCARD inline uint32_t StringSortKey(wchar_t c) { return (uint32_t)c; }
+
+    /// Compare two strings that are known to be equal up to \a depth. Stores the length of their common prefix in
+    /// \a lcp.
+    template<typename C>
+    int32_t Impl_StringCompareLexicographic(tSlice<C const> str_a, tSlice<C const> str_b, ptrdiff_t depth, ptrdiff_t* lcp) {
+        ptrdiff_t count = str_a.len < str_b.len ? str_a.len : str_b.len;
+        ptrdiff_t index = depth;
+        while(index < count && str_a.ptr[index] == str_b.ptr[index]) {
+            ++index;
+        }
+        *lcp = index;
+        if(index < count) {
+            return StringSortKey(str_a.ptr[index]) < StringSortKey(str_b.ptr[index]) ? -1 : 1;
+        }
+        return str_a.len < str_b.len ? -1 : (str_a.len > str_b.len ? 1 : 0);
+    }
+
+    constexpr ptrdiff_t string_sort_insertion_threshold = 16;
+
+    /// Key of the character at \a depth. The end of the string has key 0, before every character.
+    template<typename C>
+    MTB_NODISCARD uint64_t StringSortKeyAt(tSlice<C const> str, ptrdiff_t depth) {
+        return depth < str.len ? (uint64_t)StringSortKey(str.ptr[depth]) + 1 : 0;
+    }
+
+    /// Sort strings that share their first \a depth characters. Sets lcp[1..len) if \a lcp is not null.
+    template<typename C>
+    void MultikeyQuickSort(tSlice<C const>* strings, ptrdiff_t* lcp, ptrdiff_t len, ptrdiff_t depth) {
+        struct tPart {
+            tSlice<C const>* strings;
+            ptrdiff_t* lcp;
+            ptrdiff_t len;
+            ptrdiff_t depth;
+        };
+
+        while(len > string_sort_insertion_threshold) {
+            uint64_t a = StringSortKeyAt(strings[0], depth);
+            uint64_t b = StringSortKeyAt(strings[len / 2], depth);
+            uint64_t c = StringSortKeyAt(strings[len - 1], depth);
+            uint64_t pivot = a < b ? (b < c ? b : (a < c ? c : a)) : (a < c ? a : (b < c ? c : b));
+
+            // Three-way partition: [0, lt) < pivot, [lt, gt) == pivot, [gt, len) > pivot.
+            ptrdiff_t lt = 0;
+            ptrdiff_t gt = len;
+            ptrdiff_t index = 0;
+            while(index < gt) {
+                uint64_t key = StringSortKeyAt(strings[index], depth);
+                if(key < pivot) {
+                    Swap(strings[lt++], strings[index++]);
+                } else if(key > pivot) {
+                    Swap(strings[index], strings[--gt]);
+                } else {
+                    ++index;
+                }
+            }
+
+            // Neighbors from different parts share exactly the first depth characters.
+            if(lcp) {
+                if(lt > 0 && lt < len) {
+                    lcp[lt] = depth;
+                }
+                if(gt > 0 && gt < len) {
+                    lcp[gt] = depth;
+                }
+            }
+
+            tPart parts[3] = {
+                {strings, lcp, lt, depth},
+                {strings + lt, lcp ? lcp + lt : nullptr, gt - lt, depth + 1},
+                {strings + gt, lcp ? lcp + gt : nullptr, len - gt, depth},
+            };
+            if(pivot == 0) {
+                // These strings all end at depth, so they are equal.
+                if(lcp) {
+                    for(ptrdiff_t equal = lt + 1; equal < gt; ++equal) {
+                        lcp[equal] = depth;
+                    }
+                }
+                parts[1].len = 0;
+            }
+
+            // Recurse into the smaller parts and continue with the largest one, which bounds the stack depth.
+            ptrdiff_t largest = parts[0].len >= parts[1].len ? 0 : 1;
+            largest = parts[largest].len >= parts[2].len ? largest : 2;
+            for(ptrdiff_t part = 0; part < 3; ++part) {
+                if(part != largest && parts[part].len > 1) {
+                    MultikeyQuickSort(parts[part].strings, parts[part].lcp, parts[part].len, parts[part].depth);
+                }
+            }
+            strings = parts[largest].strings;
+            lcp = parts[largest].lcp;
+            len = parts[largest].len;
+            depth = parts[largest].depth;
+        }
+
+        // Insertion sort, comparing from depth on.
+        for(ptrdiff_t index = 1; index < len; ++index) {
+            tSlice<C const> str = strings[index];
+            ptrdiff_t dest = index;
+            ptrdiff_t prefix_len;
+            while(dest > 0 && Impl_StringCompareLexicographic(str, strings[dest - 1], depth, &prefix_len) < 0) {
+                strings[dest] = strings[dest - 1];
+                --dest;
+            }
+            strings[dest] = str;
+        }
+        if(lcp) {
+            for(ptrdiff_t index = 1; index < len; ++index) {
+                (void)Impl_StringCompareLexicographic(strings[index - 1], strings[index], depth, &lcp[index]);
+            }
+        }
+    }
+
+    template<typename C>
+    void Impl_SortStrings(tSlice<tSlice<C const>> strings, tSlice<ptrdiff_t> lcp) {
+        MTB_ASSERT(!lcp || lcp.len == strings.len);
+        if(strings.len > 0) {
+            if(lcp) {
+                lcp[0] = 0;
+            }
+            MultikeyQuickSort(strings.ptr, lcp.ptr, strings.len, 0);
+        }
+    }
+
+    template<typename C>
+    bool Impl_StringStartsWith(tSlice<C const> str, tSlice<C const> prefix, eStringComparison cmp) {
+        bool result = false;
+        if(str.len >= prefix.len) {
+            result = StringsAreEqual(SliceRange(str, 0, prefix.len), prefix, cmp);
+        }
+
+        return result;
+    }
+
+    template<typename C>
+    bool Impl_StringEndsWith(tSlice<C const> str, tSlice<C const> prefix, eStringComparison cmp) {
+        bool result = false;
+        if(str.len >= prefix.len) {
+            size_t offset = str.len - prefix.len;
+            result = StringsAreEqual(SliceBetween(str, offset, str.len), prefix, cmp);
+        }
+
+        return result;
+    }
+
+    template<typename C, typename P>
+    tSlice<C> Impl_StringTrimStartPredicate(tSlice<C> str, P Predicate) {
+        ptrdiff_t offset = 0;
+        if(Predicate) {
+            for(; offset < str.len; ++offset) {
+                C c = str.ptr[offset];
+                bool bIsValid = Predicate(c);
+                if(!bIsValid) {
+                    break;
+                }
+            }
+        }
+
+        return SliceBetween(str, offset, str.len);
+    }
+
+    template<typename C, typename P>
+    tSlice<C> Impl_StringTrimEndPredicate(tSlice<C> str, P Predicate) {
+        ptrdiff_t one_past_last_index = str.len;
+        if(Predicate) {
+            while(one_past_last_index > 0 && Predicate(str.ptr[one_past_last_index - 1])) {
+                --one_past_last_index;
+            }
+        }
+
+        return SliceBetween(str, 0, one_past_last_index);
+    }
+
+    template<typename C>
+    tSlice<C> Impl_AllocString(tAllocator a, size_t char_count) {
+        tSlice<C> result = a.AllocArray<C>(char_count + 1, kClearToZero);
+        return SliceRange(result, 0, result.len - 1);
+    }
+
+    template<typename CIn, typename COut = tRemoveConst<CIn>>
+    tSlice<COut> Impl_DupeString(tAllocator a, tSlice<CIn> str) {
+        tSlice<COut> result = a.AllocArray<COut>(str.len + 1, kNoInit);
+        SliceCopyBytes(result, str);
+        *SliceLast(result) = 0;
+        return SliceRange(result, 0, result.len - 1);
+    }
+
+    template<typename C>
+    size_t Impl_StringLengthZ(C const* str_z) {
+        size_t result = 0;
+        if(C const* s = str_z) {
+            while(*s++) {
+                ++result;
+            }
+        }
+
+        return result;
+    }
+}  // namespace mtb::impl
+
+size_t mtb::StringLengthZ(char const* str_z) {
+    return impl::Impl_StringLengthZ(str_z);
+}
+
+size_t mtb::StringLengthZ(wchar_t const* str_z) {
+    return impl::Impl_StringLengthZ(str_z);
+}
+
+char mtb::ToLowerChar(char c) {
+    return impl::Impl_ToLowerChar(c);
+}
+wchar_t mtb::ToLowerChar(wchar_t c) {
+    return impl::Impl_ToLowerChar(c);
+}
+
+char mtb::ToUpperChar(char c) {
+    return impl::Impl_ToUpperChar(c);
+}
+wchar_t mtb::ToUpperChar(wchar_t c) {
+    return impl::Impl_ToUpperChar(c);
+}
+
+bool mtb::IsDigitChar(char c) {
+    return impl::Impl_IsDigitChar(c);
+}
+bool mtb::IsDigitChar(wchar_t c) {
+    return impl::Impl_IsDigitChar(c);
+}
+
+bool mtb::IsWhiteChar(char c) {
+    return impl::Impl_IsWhiteChar(c);
+}
+
+bool mtb::IsWhiteChar(wchar_t c) {
+    return impl::Impl_IsWhiteChar(c);
+}
+
+int32_t mtb::StringCompare(tSlice<char const> str_a, tSlice<char const> str_b, eStringComparison cmp /*= kCaseSensitive*/) {
+    return impl::Impl_StringCompare(str_a, str_b, cmp);
+}
+int32_t mtb::StringCompare(tSlice<wchar_t const> str_a, tSlice<wchar_t const> str_b, eStringComparison cmp /*= kCaseSensitive*/) {
+    return impl::Impl_StringCompare(str_a, str_b, cmp);
+}
+
+bool mtb::StringsAreEqual(tSlice<char const> str_a, tSlice<char const> str_b, eStringComparison cmp) {
+    return impl::Impl_StringCompare(str_a, str_b, cmp) == 0;
+}
+
+bool mtb::StringsAreEqual(tSlice<wchar_t const> str_a, tSlice<wchar_t const> str_b, eStringComparison cmp) {
+    return impl::Impl_StringCompare(str_a, str_b, cmp) == 0;
+}
+
+int32_t mtb::StringCompareLexicographic(tSlice<char const> str_a, tSlice<char const> str_b) {
+    ptrdiff_t lcp;
+    return impl::Impl_StringCompareLexicographic(str_a, str_b, 0, &lcp);
+}
+int32_t mtb::StringCompareLexicographic(tSlice<wchar_t const> str_a, tSlice<wchar_t const> str_b) {
+    ptrdiff_t lcp;
+    return impl::Impl_StringCompareLexicographic(str_a, str_b, 0, &lcp);
+}
+
+void mtb::SortStrings(tSlice<tSlice<char const>> strings, tSlice<ptrdiff_t> lcp) {
+    impl::Impl_SortStrings(strings, lcp);
+}
+void mtb::SortStrings(tSlice<tSlice<wchar_t const>> strings, tSlice<ptrdiff_t> lcp) {
+    impl::Impl_SortStrings(strings, lcp);
+}
+
+bool mtb::StringStartsWith(tSlice<char const> str, tSlice<char const> prefix, eStringComparison cmp) {
+    return impl::Impl_StringStartsWith(str, prefix, cmp);
+}
+bool mtb::StringStartsWith(tSlice<wchar_t const> str, tSlice<wchar_t const> prefix, eStringComparison cmp) {
+    return impl::Impl_StringStartsWith(str, prefix, cmp);
+}
+
+bool mtb::StringEndsWith(tSlice<char const> str, tSlice<char const> prefix, eStringComparison cmp) {
+    return impl::Impl_StringEndsWith(str, prefix, cmp);
+}
+
+bool mtb::StringEndsWith(tSlice<wchar_t const> str, tSlice<wchar_t const> prefix, eStringComparison cmp) {
+    return impl::Impl_StringEndsWith(str, prefix, cmp);
+}
+
+mtb::tSlice<char const> mtb::StringTrimStartPredicate(tSlice<char const> str, tTrimPredicate Predicate) {
+    return impl::Impl_StringTrimStartPredicate<char const>(str, Predicate);
+}
+
+mtb::tSlice<wchar_t const> mtb::StringTrimStartPredicate(tSlice<wchar_t const> str, tWTrimPredicate Predicate) {
+    return impl::Impl_StringTrimStartPredicate(str, Predicate);
+}
+
+mtb::tSlice<char const> mtb::StringTrimEndPredicate(tSlice<char const> str, tTrimPredicate Predicate) {
+    return impl::Impl_StringTrimEndPredicate(str, Predicate);
+}
+
+mtb::tSlice<wchar_t const> mtb::StringTrimEndPredicate(tSlice<wchar_t const> str, tWTrimPredicate Predicate) {
+    return impl::Impl_StringTrimEndPredicate(str, Predicate);
+}
+mtb::tSlice<char const> mtb::StringTrimPredicate(tSlice<char const> str, tTrimPredicate Predicate) {
+    return StringTrimStartPredicate(StringTrimEndPredicate(str, Predicate), Predicate);
+}
+
+mtb::tSlice<wchar_t const> mtb::StringTrimPredicate(tSlice<wchar_t const> str, tWTrimPredicate Predicate) {
+    return StringTrimStartPredicate(StringTrimEndPredicate(str, Predicate), Predicate);
+}
+
+mtb::tSlice<char const> mtb::StringTrimStart(tSlice<char const> str) {
+    return StringTrimStartPredicate(str, IsWhiteChar);
+}
+
+mtb::tSlice<wchar_t const> mtb::StringTrimStart(tSlice<wchar_t const> str) {
+    return StringTrimStartPredicate(str, IsWhiteChar);
+}
+
+mtb::tSlice<char const> mtb::StringTrimEnd(tSlice<char const> str) {
+    return StringTrimEndPredicate(str, IsWhiteChar);
+}
+
+mtb::tSlice<wchar_t const> mtb::StringTrimEnd(tSlice<wchar_t const> str) {
+    return StringTrimEndPredicate(str, IsWhiteChar);
+}
+
+mtb::tSlice<char const> mtb::StringTrim(tSlice<char const> str) {
+    return StringTrimPredicate(str, IsWhiteChar);
+}
+
+mtb::tSlice<wchar_t const> mtb::StringTrim(tSlice<wchar_t const> str) {
+    return StringTrimPredicate(str, IsWhiteChar);
+}
+
+mtb::tSlice<char> mtb::AllocString(tAllocator a, size_t char_count) {
+    return impl::Impl_AllocString<char>(a, char_count);
+}
+
+mtb::tSlice<wchar_t> mtb::AllocWString(tAllocator a, size_t char_count) {
+    return impl::Impl_AllocString<wchar_t>(a, char_count);
+}
+
+mtb::tSlice<char> mtb::DupeString(tAllocator a, tSlice<char const> str) {
+    return impl::Impl_DupeString(a, str);
+}
+
+mtb::tSlice<wchar_t> mtb::DupeString(tAllocator a, tSlice<wchar_t const> str) {
+    return impl::Impl_DupeString(a, str);
+}
+
+void mtb::FreeString(tAllocator a, tSlice<char> str) {
+    ++str.len;
+    a.FreeArray(str);
+}
+void mtb::FreeString(tAllocator a, tSlice<wchar_t> str) {
+    ++str.len;
+    a.FreeArray(str);
+}
+
+void mtb::BreakIntoUnits(uint64_t value, tSlice<uint64_t const> units_table, tSlice<uint32_t> out_results) {
+    uint64_t remaining = value;
+    for(ptrdiff_t index = 0; index < units_table.len; ++index) {
+        uint64_t unit = units_table.ptr[index];
+        MTB_ASSERT(unit > 0);
+        auto result = (uint32_t)(remaining / unit);
+        remaining -= result * unit;
+
+        out_results[index] = result;
+    }
+}
+
+mtb::time::tClockTime mtb::time::ClockTimeFromTimespan(tTimespan timespan) {
+    tClockTime result{};
+    uint64_t Total;
+    if(timespan.nanoseconds < 0) {
+        Total = IntCast<uint64_t>(-timespan.nanoseconds);
+        result.negative = true;
+    } else {
+        Total = IntCast<uint64_t>(timespan.nanoseconds);
+    }
+
+    uint64_t units[7]{
+        days_to_nanoseconds,
+        hours_to_nanoseconds,
+        minutes_to_nanoseconds,
+        seconds_to_nanoseconds,
+        milliseconds_to_nanoseconds,
+        microseconds_to_nanoseconds,
+        1,
+    };
+    BreakIntoUnits(Total, ArraySlice(units), PtrSlice(&result.days, 7));
+
+    return result;
+}
+
+// --------------------------------------------------
+// -- #Section Tests --------------------------------
+// --------------------------------------------------
+#if MTB_TESTS
+#include <atomic>  // std::atomic
+#include <thread>  // std::thread
+
+DOCTEST_TEST_SUITE("mtb::tArena_SKIP") {
+    using namespace mtb;
+
+    ptrdiff_t BucketCount(tArena& arena) {
+        ptrdiff_t result = 0;
+        if(arena.current_bucket) {
+            result = 1;
+            for(tBucket* bucket = arena.current_bucket->next; bucket != arena.current_bucket; bucket = bucket->next) {
+                ++result;
+            }
+        }
+        return result;
+    }
+
+    DOCTEST_TEST_CASE("General") {
+        tArena arena{};
+        arena.min_bucket_size = 1024;
+        DOCTEST_CHECK(BucketCount(arena) == 0);
+        uint8_t* p0 = (uint8_t*)PushRaw(arena, 1023, 1, kNoInit);
+        DOCTEST_CHECK(BucketCount(arena) == 1);
+        memset(p0, 2, 1023);
+        uint8_t* p1 = (uint8_t*)PushRaw(arena, 1, 1024, kNoInit);
+        DOCTEST_CHECK(BucketCount(arena) == 2);
+        DOCTEST_CHECK((uintptr_t)p1 % 1024 == 0);
+        *p1 = 3;
+        uint8_t* p2 = (uint8_t*)PushRaw(arena, 1, 1024, kNoInit);
+        DOCTEST_CHECK(BucketCount(arena) == 2);
+        DOCTEST_CHECK((uintptr_t)p2 % 1024 == 0);
+        *p2 = 4;
+
+        for(int index = 0; index < 1023; ++index) {
+            DOCTEST_CHECK(p0[index] == 2);
+        }
+        DOCTEST_CHECK(*p1 == 3);
+        DOCTEST_CHECK(*p2 == 4);
+
+        Clear(arena, true);
+        DOCTEST_CHECK(BucketCount(arena) == 0);
+    }
+
+    DOCTEST_TEST_CASE("marker") {
+        tArena arena{};
+        arena.min_bucket_size = 1024;
+        DOCTEST_CHECK(BucketUsedSize(arena.current_bucket) == 0);
+
+        tArenaMarker zero_marker{};
+
+        PushRaw(arena, 512, 1, kNoInit);
+        DOCTEST_CHECK(BucketUsedSize(arena.current_bucket) == 512);
+
+        DOCTEST_SUBCASE("force bucket overflow") {
+            tArenaMarker marker = GetMarker(arena);
+
+            PushRaw(arena, 1024, 1, kNoInit);
+            DOCTEST_CHECK(arena.current_bucket != marker.bucket);
+
+            ResetToMarker(arena, marker, false);
+            DOCTEST_CHECK(arena.current_bucket == marker.bucket);
+        }
+
+        DOCTEST_SUBCASE("free entire arena via marker") {
+            ResetToMarker(arena, zero_marker, false);
+            DOCTEST_CHECK(arena.current_bucket == nullptr);
+            DOCTEST_CHECK(BucketUsedSize(arena.current_bucket) == 0);
+        }
+
+        DOCTEST_SUBCASE("linearize") {
+            tArenaMarker marker0 = GetMarker(arena);
+
+            void* p0 = PushRaw(arena, 1024, 1, kNoInit);
+            void* p1 = PushRaw(arena, 1024, 1, kNoInit);
+            DOCTEST_CHECK(p0 != p1);
+
+            tSlice<void> Linear = Linearize(arena, marker0, GetMarker(arena));
+            tArenaMarker Marker1 = GetMarker(arena);
+            DOCTEST_CHECK(Linear.ptr != p0);
+            DOCTEST_CHECK(Linear.ptr != p1);
+            DOCTEST_CHECK(BucketUsedSize(arena.current_bucket) >= 2 * 1024);
+            DOCTEST_CHECK(Marker1.bucket != nullptr);
+            DOCTEST_CHECK(BucketTotalSize(Marker1.bucket) >= 2 * 1024);
+        }
+
+        Clear(arena, true);
+    }
+
+    DOCTEST_TEST_CASE("Linearize") {
+        tArena arena{};
+        arena.min_bucket_size = 1;
+        MTB_DEFER { Clear(arena, true); };
+
+        PushOne<int>(arena) = 1;
+        PushOne<int>(arena) = 2;
+        PushOne<int>(arena) = 3;
+        tArenaMarker MidMarker = GetMarker(arena);
+        PushOne<int>(arena) = 4;
+        PushOne<int>(arena) = 5;
+        PushOne<int>(arena) = 6;
+        PushOne<int>(arena) = 7;
+        tArenaMarker end_marker = GetMarker(arena);
+
+        tSlice<int> left = SliceCast<int>(Linearize(arena, {}, MidMarker));
+        DOCTEST_CHECK(left.len == 3);
+        DOCTEST_CHECK(left[0] == 1);
+        DOCTEST_CHECK(left[1] == 2);
+        DOCTEST_CHECK(left[2] == 3);
+
+        tSlice<int> right = SliceCast<int>(Linearize(arena, MidMarker, end_marker));
+        DOCTEST_CHECK(right.len == 4);
+        DOCTEST_CHECK(right[0] == 4);
+        DOCTEST_CHECK(right[1] == 5);
+        DOCTEST_CHECK(right[2] == 6);
+        DOCTEST_CHECK(right[3] == 7);
+
+        tSlice<int> All = SliceCast<int>(Linearize(arena, {}, end_marker));
+        DOCTEST_CHECK(All.len == 7);
+        DOCTEST_CHECK(All[0] == 1);
+        DOCTEST_CHECK(All[1] == 2);
+        DOCTEST_CHECK(All[2] == 3);
+        DOCTEST_CHECK(All[3] == 4);
+        DOCTEST_CHECK(All[4] == 5);
+        DOCTEST_CHECK(All[5] == 6);
+        DOCTEST_CHECK(All[6] == 7);
+    }
+
+#if MTB_USE_STB_SPRINTF
+    DOCTEST_TEST_CASE("printf") {
+        tArena arena{};
+        MTB_DEFER { Clear(arena, true); };
+
+        tSlice<char> str = printf_Arena(arena, "Hello world!");
+        DOCTEST_CHECK(toString(str) == "Hello world!");
+
+        Clear(arena, false);
+
+        DOCTEST_SUBCASE("manual linearization") {
+            // This produces a formatted non-null-terminated string.
+            arena.min_bucket_size = 1;
+            tArenaMarker begin_marker = GetMarker(arena);
+            printf_ArenaRaw(arena, "%c", 'a');
+            printf_ArenaRaw(arena, "%c", 'b');
+            printf_ArenaRaw(arena, "%c", 'c');
+            printf_ArenaRaw(arena, "%c", 'd');
+            printf_ArenaRaw(arena, "%c", 'e');
+            printf_ArenaRaw(arena, "%c", 'f');
+            tArenaMarker end_marker = GetMarker(arena);
+            tSlice<char> linearized = SliceCast<char>(Linearize(arena, begin_marker, end_marker));
+            DOCTEST_CHECK(toString(linearized) == "abcdef");
+        }
+
+        DOCTEST_SUBCASE("force linearization over multiple buckets") {
+            arena.min_bucket_size = 8;
+
+            char const* lipsum =
+                "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Sed cursus "
+                "hendrerit pharetra. Cras sit amet blandit arcu."
+                "Mauris tristique dapibus vulputate. Maecenas ipsum dui, porta id "
+                "felis quis, gravida dictum neque. Suspendisse id"
+                "fringilla justo. Duis volutpat lobortis magna et imperdiet. Etiam "
+                "vulputate nisl eu lacus pulvinar sodales. Mauris eu"
+                "diam nulla. Pellentesque commodo, ligula in varius eleifend, velit "
+                "metus fermentum sapien, a accumsan nisl metus vel"
+                "lorem. Aliquam ultricies nisl sed ex tincidunt semper. Ut ut turpis "
+                "eleifend, sagittis velit eu, lobortis elit. Mauris"
+                "pellentesque dignissim elit, quis suscipit ante iaculis vitae. "
+                "Aenean non gravida ex. Mauris lobortis mi massa, id"
+                "bibendum eros laoreet lobortis. Fusce nisi libero, dictum et dui "
+                "iaculis, pellentesque aliquet erat. Cras pharetra metus"
+                "nec sapien consectetur, vitae viverra sem sollicitudin. Fusce id "
+                "condimentum leo. Ut gravida sed nisi eu convallis."
+                "Nulla volutpat metus id nisi ultricies, nec gravida libero laoreet. "
+                "Vestibulum bibendum leo lorem, vitae maximus leo"
+                "luctus non. Pellentesque nec pretium risus. Integer libero neque, "
+                "molestie vel erat sit amet, euismod rutrum enim."
+                "Maecenas tincidunt magna sapien, vel iaculis est vehicula a. "
+                "Suspendisse sollicitudin purus quis magna interdum, id"
+                "bibendum tortor sollicitudin. Phasellus eget lectus feugiat, luctus "
+                "diam et, venenatis felis. Cras sit amet tellus non"
+                "est aliquam posuere. Curabitur eu aliquet arcu. Suspendisse a "
+                "sollicitudin eros. Donec ac egestas ante. Pellentesque id"
+                "pellentesque turpis. Pellentesque lobortis vel elit fringilla "
+                "scelerisque. Donec eu posuere lacus, vitae iaculis metus."
+                "Aliquam eleifend facilisis quam, et fringilla nisl ornare "
+                "facilisis. Phasellus in massa ac risus posuere maximus."
+                "Vestibulum id velit id quam eleifend fermentum. Interdum et "
+                "malesuada fames ac ante ipsum primis in faucibus. Integer eu"
+                "rutrum est. Curabitur non risus non felis dictum scelerisque. "
+                "Maecenas id rutrum dolor, in sagittis mauris. Donec id"
+                "nunc vel nisl volutpat vulputate nec sed leo. Suspendisse potenti. "
+                "Integer cursus, ante eu ullamcorper imperdiet, orci"
+                "metus porta ligula, at mollis est urna quis massa. Mauris faucibus "
+                "placerat purus in volutpat. Etiam lacinia non tellus"
+                "at iaculis. Maecenas bibendum odio volutpat varius fermentum. Sed "
+                "libero massa, semper eget scelerisque a, sodales vel"
+                "felis. Integer sodales augue eu felis hendrerit, ac malesuada felis "
+                "auctor. In hac habitasse platea dictumst. Phasellus"
+                "maximus eu magna id pellentesque. Fusce quis tempus lacus. "
+                "Suspendisse luctus suscipit lacus euismod viverra. Morbi"
+                "consequat nec felis id blandit. Morbi nec felis turpis. Cras ornare "
+                "enim leo, sed convallis lectus elementum vel. Cras"
+                "luctus augue finibus nibh varius consectetur. Quisque elementum, "
+                "velit quis egestas tempus, sapien magna faucibus odio,"
+                "ac tincidunt odio mauris in erat.";
 
-            // Place the median at the beginning
-            swap_proc(user_ptr, left, Middle);
+            tSlice<char> result = printf_Arena(arena, "%s", lipsum);
+            DOCTEST_CHECK(toString(result) == lipsum);
+        }
+    }
+#endif  // MTB_USE_STB_SPRINTF
+}
 
-            ptrdiff_t I = left + 1;
-            ptrdiff_t J = right;
-            while(true) {
-                do {
-                    ++I;
-                } while(less_proc(user_ptr, I, left));
-                do {
-                    --J;
-                } while(less_proc(user_ptr, left, J));
-                if(I >= J) {
-                    break;
-                }
+DOCTEST_TEST_SUITE("mtb::tArenaBucketPool") {
+    using namespace mtb;
 
-                swap_proc(user_ptr, I, J);
-            }
+    DOCTEST_TEST_CASE("Buckets are recycled across arenas") {
+        tArenaBucketPool pool{};
+        MTB_DEFER { ReleaseBuckets(pool, GetLibcAllocator()); };
+
+        tArena first{};
+        first.child_allocator = GetLibcAllocator();
+        first.min_bucket_size = 1024;
+        first.bucket_pool = &pool;
+        (void)PushRaw(first, 16, 1, kNoInit);
+        tArenaBucket* first_bucket = first.current_bucket;
+        Clear(first);
+        DOCTEST_CHECK(first.current_bucket == nullptr);
+
+        tArena second{};
+        second.child_allocator = GetLibcAllocator();
+        second.min_bucket_size = 1024;
+        second.bucket_pool = &pool;
+        (void)PushRaw(second, 16, 1, kNoInit);
+        DOCTEST_CHECK(second.current_bucket == first_bucket);
+        DOCTEST_CHECK(BucketUsedSize(second.current_bucket) == 16);
+        Clear(second);
+
+        DOCTEST_CHECK(TakeBucket(pool, 2048) == nullptr);
+        tArenaBucket* cached = TakeBucket(pool, 1024);
+        DOCTEST_CHECK(cached == first_bucket);
+        DOCTEST_CHECK(ReturnBucket(pool, cached));
+    }
+}
 
-            // Compensate for the I==J case.
-            I = J + 1;
-            swap_proc(user_ptr, left, J);
-            // The median is not part of the left subfile.
-            --J;
+DOCTEST_TEST_SUITE("mtb::tInlineArray") {
+    using namespace mtb;
 
-            ptrdiff_t L1, R1, L2, R2;
-            if(J - left >= right - I) {
-                L1 = left;
-                R1 = J;
-                L2 = I;
-                R2 = right;
-            } else {
-                L1 = I;
-                R1 = right;
-                L2 = left;
-                R2 = J;
-            }
+    DOCTEST_TEST_CASE("Inline until full") {
+        tInlineArray<int, 4> array{};
+        array.allocator = GetLibcAllocator();
+        MTB_DEFER { ClearAllocation(array); };
 
-            if(L2 == R2) {
-                left = L1;
-                right = R1;
-            } else {
-                stack[stack_pointer].left = L1;
-                stack[stack_pointer].right = R1;
-                stack_pointer++;
-                // Process the smaller subfile on the next iteration.
-                left = L2;
-                right = R2;
-            }
-        } else {
-            // Insertion sort
-            for(ptrdiff_t I = left + 1; I <= right; ++I) {
-                for(ptrdiff_t J = I; J > left && less_proc(user_ptr, J, J - 1); --J) {
-                    swap_proc(user_ptr, J, J - 1);
-                }
-            }
+        for(int index = 0; index < 4; ++index) {
+            Push(array, index);
+        }
+        DOCTEST_CHECK(array.IsInline());
+        DOCTEST_CHECK(array.len == 4);
+
+        Insert(array, 0, -1);
+        DOCTEST_CHECK_FALSE(array.IsInline());
+        DOCTEST_REQUIRE(array.len == 5);
+        int expected[]{-1, 0, 1, 2, 3};
+        for(int index = 0; index < 5; ++index) {
+            DOCTEST_CHECK(array[index] == expected[index]);
+        }
 
-            if(stack_pointer == 0) {
-                break;
-            }
+        RemoveAt(array, 1, 2);
+        DOCTEST_REQUIRE(array.len == 3);
+        DOCTEST_CHECK(array[0] == -1);
+        DOCTEST_CHECK(array[1] == 2);
+        DOCTEST_CHECK(array[2] == 3);
 
-            --stack_pointer;
-            left = stack[stack_pointer].left;
-            right = stack[stack_pointer].right;
-        }
+        ShrinkAllocation(array);
+        DOCTEST_CHECK(array.IsInline());
+        DOCTEST_CHECK(array[2] == 3);
+    }
+
+    DOCTEST_TEST_CASE("No allocator needed within capacity") {
+        tInlineArray<int, 8> array{};
+        PushRepeat(array, 7, 8);
+        RemoveAt(array, 0, 1, true);
+        DOCTEST_CHECK(array.len == 7);
+        DOCTEST_CHECK(*GetLast(array) == 7);
+        DOCTEST_CHECK(GetSlack(array).len == 1);
     }
 }
 
-namespace mtb {
-    void InternalInsertNextBucket(tArenaBucket*& current_bucket, tArenaBucket* new_bucket) {
-        if(current_bucket) {
-            new_bucket->prev = current_bucket;
-            new_bucket->next = current_bucket->next;
-            new_bucket->next->prev = new_bucket->prev->next = new_bucket;
-        } else {
-            new_bucket->prev = new_bucket->next = new_bucket;
+DOCTEST_TEST_SUITE("mtb::tBucketArray") {
+    using namespace mtb;
+
+    DOCTEST_TEST_CASE("Locate") {
+        DOCTEST_CHECK(BucketArrayLocate(4, 0).bucket == 0);
+        DOCTEST_CHECK(BucketArrayLocate(4, 3).bucket == 0);
+        DOCTEST_CHECK(BucketArrayLocate(4, 3).offset == 3);
+        DOCTEST_CHECK(BucketArrayLocate(4, 4).bucket == 1);
+        DOCTEST_CHECK(BucketArrayLocate(4, 4).offset == 0);
+        DOCTEST_CHECK(BucketArrayLocate(4, 11).bucket == 1);
+        DOCTEST_CHECK(BucketArrayLocate(4, 11).offset == 7);
+        DOCTEST_CHECK(BucketArrayLocate(4, 12).bucket == 2);
+    }
+
+    DOCTEST_TEST_CASE("Pointer stability") {
+        tBucketArray<int> array{};
+        array.allocator = GetLibcAllocator();
+        array.first_bucket_len = 4;
+        MTB_DEFER { ClearAllocation(array); };
+
+        int* first = &Push(array, 0);
+        for(int index = 1; index < 100; ++index) {
+            Push(array, index);
         }
-        current_bucket = new_bucket;
-    }
+        int more[]{100, 101, 102};
+        PushMany(array, ArraySlice(more));
 
-    tArenaBucket* InternalUnlinkBucket(tArenaBucket*& current_bucket) {
-        MTB_ASSERT(current_bucket != nullptr);
+        DOCTEST_CHECK(first == &array[0]);
+        DOCTEST_REQUIRE(array.len == 103);
 
-        tArenaBucket* result = current_bucket;
-        if(current_bucket == current_bucket->prev) {
-            current_bucket = nullptr;
-        } else {
-            current_bucket->prev->next = current_bucket->next;
-            current_bucket->next->prev = current_bucket->prev;
-            current_bucket = current_bucket->prev;
+        ptrdiff_t count = 0;
+        for(ptrdiff_t bucket_index = 0; bucket_index < UsedBucketCount(array); ++bucket_index) {
+            for(int item : GetBucketItems(array, bucket_index)) {
+                DOCTEST_CHECK(item == count);
+                ++count;
+            }
         }
-        result->prev = result->next = nullptr;
-        return result;
+        DOCTEST_CHECK(count == 103);
     }
+}
 
-    uint8_t* InternalBucketAlloc(tArenaBucket* bucket, size_t* inout_size, size_t alignment) {
-        uint8_t* result = nullptr;
-        if(bucket && inout_size) {
-            result = bucket->data + bucket->used_size;
-            size_t EffectiveSize = *inout_size;
-            AlignAllocation((void**)&result, &EffectiveSize, alignment);
-            if(BucketUsedSize(bucket) + EffectiveSize <= BucketTotalSize(bucket)) {
-                *inout_size = EffectiveSize;
-            } else {
-                result = nullptr;
-            }
+DOCTEST_TEST_SUITE("mtb::tArray") {
+    using namespace mtb;
+
+    tArray<int> MakeIota(int count) {
+        tArray<int> result{};
+        result.allocator = GetLibcAllocator();
+        for(int index = 0; index < count; ++index) {
+            Push(result, index);
         }
         return result;
     }
 
-    void* InternalArenaAlloc(tArena& arena, size_t size, size_t alignment) {
-        size_t EffectiveSize = size;
-        uint8_t* result = InternalBucketAlloc(arena.current_bucket, &EffectiveSize, alignment);
-        if(!result) {
-            result = InternalBucketAlloc(arena.first_free_bucket, &EffectiveSize, alignment);
-            if(result) {
-                InternalInsertNextBucket(arena.current_bucket, InternalUnlinkBucket(arena.first_free_bucket));
-            } else {
-                Grow(arena, size + alignment);
-                MTB_ASSERT(arena.current_bucket);
+    DOCTEST_TEST_CASE("RemoveAll") {
+        tArray<int> array = MakeIota(10);
+        MTB_DEFER { ClearAllocation(array); };
 
-                result = arena.current_bucket->data;
-                AlignAllocation((void**)&result, &EffectiveSize, alignment);
-                MTB_ASSERT(BucketUsedSize(arena.current_bucket) + EffectiveSize <= BucketTotalSize(arena.current_bucket));
+        DOCTEST_SUBCASE("stable") {
+            DOCTEST_CHECK(RemoveAll(array, [](int item) { return item % 3 == 0; }) == 4);
+            int expected[]{1, 2, 4, 5, 7, 8};
+            DOCTEST_REQUIRE(array.len == MTB_ARRAY_COUNT(expected));
+            for(int index = 0; index < array.len; ++index) {
+                DOCTEST_CHECK(array[index] == expected[index]);
             }
         }
 
-        arena.current_bucket->used_size += EffectiveSize;
+        DOCTEST_SUBCASE("stable, every keep mask") {
+            // 16 blocks of 4 items cover every keep mask of the 32-bit kernel, followed by a tail of 3.
+            tArray<int> items{};
+            items.allocator = GetLibcAllocator();
+            MTB_DEFER { ClearAllocation(items); };
+            for(int index = 0; index < 16 * 4 + 3; ++index) {
+                int block = index / 4;
+                int removed = index < 16 * 4 ? !((block >> (index % 4)) & 1) : index % 2;
+                Push(items, index * 2 + removed);
+            }
+            DOCTEST_CHECK(RemoveAll(items, [](int item) { return item % 2 == 1; }) == 16 * 2 + 1);
+            bool ok = items.len == 16 * 2 + 2;
+            for(int index = 1; ok && index < items.len; ++index) {
+                ok = items[index - 1] < items[index] && items[index] % 2 == 0;
+            }
+            DOCTEST_CHECK(ok);
 
-        return result;
+            float floats[]{1.0f, -2.0f, 3.0f, -4.0f, -5.0f, 6.0f};
+            tSlice<float> slice = ArraySlice(floats);
+            auto negative = [](float item) { return item < 0.0f; };
+            DOCTEST_CHECK(impl::SliceRemoveAll(slice, negative) == 3);
+            DOCTEST_CHECK((floats[0] == 1.0f && floats[1] == 3.0f && floats[2] == 6.0f));
+        }
+
+        DOCTEST_SUBCASE("swap") {
+            DOCTEST_CHECK(RemoveAll(array, [](int item) { return item < 5; }, true) == 5);
+            DOCTEST_REQUIRE(array.len == 5);
+            for(int item : array) {
+                DOCTEST_CHECK(item >= 5);
+            }
+        }
     }
 
-    tSlice<void> InternalArenaAllocatorProc(void* user, tSlice<void> old_mem, size_t old_alignment, size_t new_size, size_t new_alignment, eInit init) {
-        auto* arena = (tArena*)user;
-        MTB_ASSERT(arena);
-        void* new_ptr = ReallocRaw(*arena, old_mem.ptr, old_mem.len, old_alignment, new_size, new_alignment, init);
-        tSlice<void> result = PtrSlice(new_ptr, new_size);
-        return result;
+    DOCTEST_TEST_CASE("RemoveFirst and RemoveLast") {
+        tArray<int> array = MakeIota(6);
+        MTB_DEFER { ClearAllocation(array); };
+
+        DOCTEST_CHECK(RemoveFirst(array, [](int item) { return item % 2 == 1; }));
+        DOCTEST_CHECK(RemoveLast(array, [](int item) { return item % 2 == 1; }));
+        DOCTEST_CHECK_FALSE(RemoveLast(array, [](int item) { return item > 100; }));
+        int expected[]{0, 2, 3, 4};
+        DOCTEST_REQUIRE(array.len == MTB_ARRAY_COUNT(expected));
+        for(int index = 0; index < array.len; ++index) {
+            DOCTEST_CHECK(array[index] == expected[index]);
+        }
     }
-}  // namespace mtb
 
-size_t mtb::BucketTotalSize(tArenaBucket const* bucket) {
-    return bucket ? bucket->total_size : 0;
-}
+    DOCTEST_TEST_CASE("RemoveIndices") {
+        tArray<int> array = MakeIota(10);
+        MTB_DEFER { ClearAllocation(array); };
 
-size_t mtb::BucketUsedSize(tArenaBucket const* bucket) {
-    return bucket ? bucket->used_size : 0;
+        ptrdiff_t indices[]{0, 3, 4, 9};
+        RemoveIndices(array, ArraySlice(indices));
+        int expected[]{1, 2, 5, 6, 7, 8};
+        DOCTEST_REQUIRE(array.len == MTB_ARRAY_COUNT(expected));
+        for(int index = 0; index < array.len; ++index) {
+            DOCTEST_CHECK(array[index] == expected[index]);
+        }
+    }
 }
 
-void mtb::Grow(tArena& arena, size_t required_size) {
-    if(arena.min_bucket_size == 0) {
-        arena.min_bucket_size = MTB_ARENA_DEFAULT_BUCKET_SIZE;
-    }
+DOCTEST_TEST_SUITE("mtb::tJaggedArray") {
+    using namespace mtb;
 
-    size_t new_bucket_size = BucketTotalSize(arena.current_bucket);
-    if(new_bucket_size < arena.min_bucket_size) {
-        new_bucket_size = arena.min_bucket_size;
-    }
-    while(new_bucket_size < required_size) {
-        new_bucket_size *= 2;
+    DOCTEST_TEST_CASE("Count then fill") {
+        ptrdiff_t row_lengths[]{2, 0, 3};
+        tJaggedArray<int> jagged = CreateJaggedArray<int>(GetLibcAllocator(), ArraySlice(row_lengths));
+        MTB_DEFER { ClearAllocation(jagged); };
+
+        DOCTEST_REQUIRE(jagged.RowCount() == 3);
+        DOCTEST_CHECK(jagged[0].len == 2);
+        DOCTEST_CHECK(jagged[1].len == 0);
+        DOCTEST_CHECK(jagged[2].len == 3);
+        jagged[2][2] = 42;
+        DOCTEST_CHECK(jagged.values[4] == 42);
+    }
+
+    DOCTEST_TEST_CASE("Builder") {
+        tJaggedArrayBuilder<int> builder = CreateJaggedArrayBuilder<int>(GetLibcAllocator());
+        MTB_DEFER { ClearAllocation(builder.entries); };
+
+        AddItem(builder, 2, 20);
+        AddItem(builder, 0, 0);
+        AddItem(builder, 2, 21);
+        int row_one[]{10, 11, 12};
+        AddRow(builder, 1, ArraySlice(row_one));
+
+        tJaggedArray<int> jagged = FinishJaggedArray(builder, GetLibcAllocator(), 4);
+        MTB_DEFER { ClearAllocation(jagged); };
+
+        DOCTEST_REQUIRE(jagged.RowCount() == 4);
+        DOCTEST_CHECK(jagged[0].len == 1);
+        DOCTEST_CHECK(jagged[1].len == 3);
+        DOCTEST_CHECK(jagged[3].len == 0);
+        DOCTEST_CHECK(jagged[1][2] == 12);
+        DOCTEST_CHECK(jagged[2][0] == 20);
+        DOCTEST_CHECK(jagged[2][1] == 21);
+        DOCTEST_CHECK(builder.entries.len == 0);
     }
+}
 
-    tAllocator allocator = arena.child_allocator;
-    if(allocator) {
-        tArenaBucket* new_bucket = (tArenaBucket*)allocator.AllocRaw(sizeof(tArenaBucket) - sizeof(uint8_t) + new_bucket_size, alignof(tArenaBucket), kNoInit).ptr;
-        // #TODO Handle out-of-memory properly.
-        MTB_ASSERT(new_bucket != nullptr);
-        new_bucket->used_size = 0;
-        new_bucket->total_size = new_bucket_size;
-        InternalInsertNextBucket(arena.current_bucket, new_bucket);
+DOCTEST_TEST_SUITE("mtb::tSoA") {
+    using namespace mtb;
 
-        if(arena.largest_bucket_size < new_bucket_size) {
-            arena.largest_bucket_size = new_bucket_size;
+    struct tParticle {
+        float position;
+        uint8_t flags;
+        double mass;
+    };
+
+    DOCTEST_TEST_CASE("Columns") {
+        tSoA<float, uint8_t, double> soa{};
+        soa.allocator = GetLibcAllocator();
+        MTB_DEFER { ClearAllocation(soa); };
+
+        for(int index = 0; index < 40; ++index) {
+            Push(soa, (float)index, (uint8_t)index, index * 2.0);
         }
+        DOCTEST_REQUIRE(soa.len == 40);
+        for(size_t column = 0; column < soa.column_count; ++column) {
+            DOCTEST_CHECK((uintptr_t)soa.columns[column] % MTB_SOA_COLUMN_ALIGNMENT == 0);
+        }
+        DOCTEST_CHECK(Column<1>(soa)[39] == 39);
+        DOCTEST_CHECK(Column<2>(soa)[39] == 78.0);
+
+        RemoveAt(soa, 0, 1, true);
+        DOCTEST_CHECK(soa.len == 39);
+        DOCTEST_CHECK(Column<0>(soa)[0] == 39.0f);
+        DOCTEST_CHECK(Column<2>(soa)[0] == 78.0);
+
+        RemoveAt(soa, 1);
+        DOCTEST_CHECK(Column<1>(soa)[1] == 2);
     }
-}
 
-void mtb::Reserve(tArena& arena, size_t total_size) {
-    if(total_size > BucketTotalSize(arena.current_bucket)) {
-        Grow(arena, total_size);
+    DOCTEST_TEST_CASE("Transpose") {
+        tSoA<float, uint8_t, double> soa{};
+        soa.allocator = GetLibcAllocator();
+        MTB_DEFER { ClearAllocation(soa); };
+
+        tParticle particles[]{{1.0f, 1, 10.0}, {2.0f, 2, 20.0}, {3.0f, 3, 30.0}};
+        PushFromStructs(soa, ArraySlice(particles), &tParticle::position, &tParticle::flags, &tParticle::mass);
+        DOCTEST_REQUIRE(soa.len == 3);
+        DOCTEST_CHECK(Column<2>(soa)[1] == 20.0);
+
+        tParticle out[2]{};
+        CopyToStructs(soa, 1, ArraySlice(out), &tParticle::position, &tParticle::flags, &tParticle::mass);
+        DOCTEST_CHECK(out[0].position == 2.0f);
+        DOCTEST_CHECK(out[1].flags == 3);
+        DOCTEST_CHECK(out[1].mass == 30.0);
     }
 }
 
-void mtb::Clear(tArena& arena, bool release_memory /*= true*/) {
-    ResetToMarker(arena, {}, release_memory);
-    if(arena.first_free_bucket && release_memory) {
-        tAllocator allocator = arena.child_allocator;
-        if(allocator) {
-            while(arena.first_free_bucket) {
-                tArenaBucket* bucket = InternalUnlinkBucket(arena.first_free_bucket);
-                allocator.FreeOne(bucket);
+DOCTEST_TEST_SUITE("mtb::SortSlice") {
+    using namespace mtb;
+
+    template<typename T, typename tLessProc = tLess>
+    bool IsSorted(tSlice<T> slice, tLessProc less = {}) {
+        for(ptrdiff_t index = 1; index < slice.len; ++index) {
+            if(less(slice[index], slice[index - 1])) {
+                return false;
             }
         }
-    }
-}
-
-void* mtb::ReallocRaw(tArena& arena, void* old_ptr, size_t old_size, size_t old_alignment, size_t new_size, size_t new_alignment, eInit init) {
-    if(old_ptr || old_size) {
-        MTB_ASSERT(old_ptr && old_size);
+        return true;
     }
 
-    ptrdiff_t DeltaSize = (ptrdiff_t)new_size - (ptrdiff_t)old_size;
-    if(DeltaSize < 0) {
-        DeltaSize = -DeltaSize;
-    }
+    DOCTEST_TEST_CASE("Patterns") {
+        static int items[5000];
+        uint64_t state = 1;
+        tSlice<int> slice = ArraySlice(items);
 
-    void* result = nullptr;
-    if(!old_ptr) {
-        if(new_size) {
-            result = InternalArenaAlloc(arena, new_size, new_alignment);
-            if(init == kClearToZero) {
-                MTB_memset(result, 0, new_size);
+        DOCTEST_SUBCASE("random") {
+            for(int& item : items) {
+                item = (int)mtb_test::NextRandom(state);
             }
         }
-    } else {
-        MTB_ASSERT(old_alignment == new_alignment && "Old and new alignment must be the same for now.");
-
-        if(new_size < old_size) {
-            if((uintptr_t)old_ptr + (uintptr_t)old_size == (uintptr_t)GetMarker(arena).ptr()) {
-                // Shrink the existing allocation.
-                MTB_ASSERT(arena.current_bucket);
-                MTB_ASSERT(arena.current_bucket->used_size >= (size_t)DeltaSize);
-                arena.current_bucket->used_size -= DeltaSize;
+        DOCTEST_SUBCASE("few unique") {
+            for(int& item : items) {
+                item = (int)(mtb_test::NextRandom(state) % 4);
             }
-
-            if(new_size) {
-                result = old_ptr;
+        }
+        DOCTEST_SUBCASE("sorted") {
+            for(int index = 0; index < 5000; ++index) {
+                items[index] = index;
             }
-        } else if(new_size > old_size) {
-            // Can we grow the existing allocation?
-            if((uintptr_t)old_ptr + (uintptr_t)old_size == (uintptr_t)GetMarker(arena).ptr() &&
-               BucketUsedSize(arena.current_bucket) + DeltaSize <= BucketTotalSize(arena.current_bucket)) {
-                void* new_ptr = InternalArenaAlloc(arena, DeltaSize, 1);
-                MTB_ASSERT((uintptr_t)new_ptr == (uintptr_t)old_ptr + (uintptr_t)old_size);
-                (void)new_ptr;
-                result = old_ptr;
-            } else {
-                result = InternalArenaAlloc(arena, new_size, new_alignment);
-                MTB_ASSERT(result != nullptr);
-                MTB_memcpy(result, old_ptr, old_size);
+        }
+        DOCTEST_SUBCASE("reversed") {
+            for(int index = 0; index < 5000; ++index) {
+                items[index] = -index;
             }
-
-            if(init == kClearToZero) {
-                MTB_memset(PtrOffset(result, old_size), 0, DeltaSize);
+        }
+        DOCTEST_SUBCASE("sawtooth") {
+            for(int index = 0; index < 5000; ++index) {
+                items[index] = index % 100;
+            }
+        }
+        DOCTEST_SUBCASE("organ pipe") {
+            for(int index = 0; index < 5000; ++index) {
+                items[index] = index < 2500 ? index : 5000 - index;
             }
-        } else {
-            result = old_ptr;
         }
-    }
 
-    return result;
-}
+        int64_t sum_before = 0;
+        for(int item : items) {
+            sum_before += item;
+        }
+
+        SortSlice(slice);
+        DOCTEST_CHECK(IsSorted(slice));
+
+        int64_t sum_after = 0;
+        for(int item : items) {
+            sum_after += item;
+        }
+        DOCTEST_CHECK(sum_before == sum_after);
+    }
 
-void* mtb::PushRaw(tArena& arena, size_t size, size_t alignment, eInit init) {
-    return ReallocRaw(arena, nullptr, 0, 0, size, alignment, init);
-}
+    DOCTEST_TEST_CASE("Custom comparison and non-POD items") {
+        struct tItem {
+            int key;
+            tArray<int> payload;
+        };
 
-mtb::tSlice<void> mtb::ReallocRawArray(tArena& arena, tSlice<void> old_array, size_t old_alignment, size_t new_size, size_t new_alignment, eInit init) {
-    void* ptr = ReallocRaw(arena, old_array.ptr, old_array.len, old_alignment, new_size, new_alignment, init);
-    return PtrSlice(ptr, new_size);
-}
+        static tItem items[300];
+        uint64_t state = 7;
+        for(tItem& item : items) {
+            item.key = (int)(mtb_test::NextRandom(state) % 1000);
+        }
 
-mtb::tSlice<void> mtb::PushRawArray(tArena& arena, size_t size, size_t alignment, eInit init) {
-    return ReallocRawArray(arena, {}, 0, size, alignment, init);
+        auto greater = [](tItem const& a, tItem const& b) { return a.key > b.key; };
+        SortSlice(ArraySlice(items), greater);
+        DOCTEST_CHECK(IsSorted(ArraySlice(items), greater));
+    }
 }
 
-mtb::tArenaMarker mtb::GetMarker(tArena const& arena) {
-    tArenaMarker result{arena.current_bucket, BucketUsedSize(arena.current_bucket)};
-    return result;
-}
+DOCTEST_TEST_SUITE("mtb::SortSmall") {
+    using namespace mtb;
 
-void mtb::ResetToMarker(tArena& arena, tArenaMarker marker, bool release_memory /*= true*/) {
-    if(arena.current_bucket) {
-        tAllocator allocator = arena.child_allocator;
-        if(!allocator) {
-            release_memory = false;
-        }
+    template<typename K>
+    void CheckSortSmall(uint64_t seed) {
+        K keys[64];
+        K expected[64];
+        for(ptrdiff_t len = 0; len <= 64; ++len) {
+            for(ptrdiff_t index = 0; index < len; ++index) {
+                uint64_t bits = (uint64_t)mtb_test::NextRandom(seed) << 33;
+                bits ^= (uint64_t)mtb_test::NextRandom(seed) << 2;
+                bits ^= mtb_test::NextRandom(seed);
+                keys[index] = (K)(int64_t)bits;
+                if(index % 5 == 0) {
+                    keys[index] = (K)0;
+                }
+                expected[index] = keys[index];
+            }
+            tLess less;
+            impl::InsertionSort(expected, expected + len, less);
+            SortSmall(PtrSlice(keys, len));
 
-        if(!marker.bucket) {
-            // Treat the empty marker as a marker of the oldest bucket.
-            marker.bucket = arena.current_bucket->next;
+            bool same = true;
+            for(ptrdiff_t index = 0; index < len; ++index) {
+                same &= keys[index] == expected[index];
+            }
+            DOCTEST_CHECK_MESSAGE(same, "len ", len);
         }
+    }
 
-        // search backwards through all buckets, freeing them if they're not
-        // the one we're looking for.
-        bool looping = true;
-        while(looping) {
-            if(arena.current_bucket == marker.bucket) {
-                looping = false;
-                if(marker.offset > 0) {
-                    break;
+    DOCTEST_TEST_CASE("Key types") {
+        CheckSortSmall<int32_t>(1);
+        CheckSortSmall<uint32_t>(2);
+        CheckSortSmall<int64_t>(3);
+        CheckSortSmall<uint64_t>(4);
+        CheckSortSmall<float>(5);
+        CheckSortSmall<double>(6);
+        CheckSortSmall<int16_t>(7);
+    }
+
+    template<typename K>
+    void CheckSortSmallSpecialValues(uint64_t seed) {
+        K const inf = (K)HUGE_VAL;
+        K const nan = inf - inf;
+        K keys[64];
+        for(ptrdiff_t len = 0; len <= 64; ++len) {
+            ptrdiff_t nan_count = 0;
+            for(ptrdiff_t index = 0; index < len; ++index) {
+                uint32_t bits = mtb_test::NextRandom(seed);
+                switch(bits % 8) {
+                    case 0: keys[index] = inf; break;
+                    case 1: keys[index] = -inf; break;
+                    case 2: keys[index] = nan; ++nan_count; break;
+                    case 3: keys[index] = (K)-0.0; break;
+                    default: keys[index] = (K)(int32_t)bits; break;
+                }
+            }
+            K expected[64];
+            ptrdiff_t expected_len = 0;
+            for(ptrdiff_t index = 0; index < len; ++index) {
+                if(keys[index] == keys[index]) {
+                    expected[expected_len++] = keys[index];
                 }
             }
+            tLess less;
+            impl::InsertionSort(expected, expected + expected_len, less);
+            SortSmall(PtrSlice(keys, len));
 
-            tArenaBucket* free_bucket = InternalUnlinkBucket(arena.current_bucket);
-            if(release_memory) {
-                allocator.FreeRaw(PtrSlice((void*)free_bucket, sizeof(tArenaBucket) - sizeof(uint8_t) + free_bucket->total_size), alignof(tArenaBucket));
-            } else {
-                InternalInsertNextBucket(arena.first_free_bucket, free_bucket);
+            bool same = true;
+            for(ptrdiff_t index = 0; index < expected_len; ++index) {
+                same &= keys[index] == expected[index];
+            }
+            for(ptrdiff_t index = expected_len; index < len; ++index) {
+                same &= keys[index] != keys[index];
             }
+            DOCTEST_CHECK_MESSAGE(same, "len ", len);
+            DOCTEST_CHECK(len - expected_len == nan_count);
         }
+    }
 
-        if(arena.current_bucket) {
-            arena.current_bucket->used_size = marker.offset;
-        }
+    DOCTEST_TEST_CASE("Infinity and NaN") {
+        CheckSortSmallSpecialValues<float>(8);
+        CheckSortSmallSpecialValues<double>(9);
     }
 }
 
-mtb::tSlice<void> mtb::Linearize(tArena& arena, tArenaMarker begin, tArenaMarker end) {
-    if(!end.bucket) {
-        MTB_ASSERT(!begin.bucket);
-    } else if(!begin.bucket) {
-        MTB_ASSERT(arena.current_bucket);
-        // If the begin marker has a null-bucket, use the first/oldest bucket.
-        begin.bucket = arena.current_bucket->next;
-    }
+DOCTEST_TEST_SUITE("mtb::RadixSort") {
+    using namespace mtb;
 
-    tSlice<void> result;
-    if(begin.bucket == end.bucket) {
-        MTB_ASSERT(begin.offset <= end.offset);
-        result = PtrSliceBetween(begin.ptr(), end.ptr());
-    } else {
-        MTB_ASSERT(end.bucket);
+    DOCTEST_TEST_CASE("Keys") {
+        tAllocator a = GetLibcAllocator();
+        uint64_t state = 3;
 
-        // determine the size
-        size_t required_size = begin.bucket->used_size - begin.offset;
-        for(tArenaBucket* bucket = begin.bucket->next; bucket != end.bucket; bucket = bucket->next) {
-            required_size += bucket->used_size;
+        DOCTEST_SUBCASE("unsigned") {
+            static uint64_t keys[1000];
+            for(uint64_t& key : keys) {
+                key = ((uint64_t)mtb_test::NextRandom(state) << 32) | mtb_test::NextRandom(state);
+            }
+            DOCTEST_REQUIRE(RadixSort(ArraySlice(keys), a));
+            for(ptrdiff_t index = 1; index < 1000; ++index) {
+                DOCTEST_CHECK(keys[index - 1] <= keys[index]);
+            }
         }
-        required_size += end.offset;
 
-        // allocate data
-        result = PushArray<uint8_t>(arena, required_size, kNoInit);
+        DOCTEST_SUBCASE("signed") {
+            static int32_t keys[1000];
+            for(int32_t& key : keys) {
+                key = (int32_t)(mtb_test::NextRandom(state) % 2000) - 1000;
+            }
+            DOCTEST_REQUIRE(RadixSort(ArraySlice(keys), a));
+            for(ptrdiff_t index = 1; index < 1000; ++index) {
+                DOCTEST_CHECK(keys[index - 1] <= keys[index]);
+            }
+        }
 
-        // copy the data
-        size_t cursor = 0;
-        MTB_memcpy(result + cursor, begin.bucket->data + begin.offset, begin.bucket->used_size - begin.offset);
-        cursor += begin.bucket->used_size - begin.offset;
-        for(tArenaBucket* bucket = begin.bucket->next; bucket != end.bucket; bucket = bucket->next) {
-            MTB_memcpy(result + cursor, bucket->data, bucket->used_size);
-            cursor += bucket->used_size;
+        DOCTEST_SUBCASE("float") {
+            static float keys[1000];
+            for(float& key : keys) {
+                key = ((float)mtb_test::NextRandom(state) / 1000.0f) - 2000000.0f;
+            }
+            keys[10] = 0.0f;
+            keys[20] = -1.5f;
+            DOCTEST_REQUIRE(RadixSort(ArraySlice(keys), a));
+            for(ptrdiff_t index = 1; index < 1000; ++index) {
+                DOCTEST_CHECK(keys[index - 1] <= keys[index]);
+            }
         }
-        MTB_memcpy(result + cursor, end.bucket->data, end.offset);
     }
 
-    return result;
-}
-
-mtb::tAllocator mtb::MakeAllocator(tArena& arena) {
-    // ReSharper disable once CppInitializedValueIsAlwaysRewritten
-    tAllocator result{};
-    result.user = &arena;
-    result.realloc_proc = InternalArenaAllocatorProc;
-    return result;
-}
+    DOCTEST_TEST_CASE("Pairs") {
+        int64_t keys[]{5, -3, 9, 0, -3, 2};
+        char values[]{'a', 'b', 'c', 'd', 'e', 'f'};
+        DOCTEST_REQUIRE(RadixSortPairs(ArraySlice(keys), ArraySlice(values), GetLibcAllocator()));
 
-#if MTB_USE_STB_SPRINTF
-namespace mtb {
-    static char* InternalArenaPrintCallback(char const* buf, void* user, int len) {
-        auto* arena = (tArena*)user;
-        tSlice<void> dest = PushRawArray(*arena, len, 1, kNoInit);
-        SliceCopyBytes(dest, PtrSlice(buf, len));
-        return const_cast<char*>(buf);
+        int64_t expected_keys[]{-3, -3, 0, 2, 5, 9};
+        char expected_values[]{'b', 'e', 'd', 'f', 'a', 'c'};
+        for(ptrdiff_t index = 0; index < 6; ++index) {
+            DOCTEST_CHECK(keys[index] == expected_keys[index]);
+            DOCTEST_CHECK(values[index] == expected_values[index]);
+        }
     }
-}  // namespace mtb
 
-void mtb::vprintf_ArenaRaw(tArena& arena, char const* format, va_list vargs) {
-    char temp_buffer[STB_SPRINTF_MIN];
-    stbsp_vsprintfcb(InternalArenaPrintCallback, &arena, temp_buffer, format, vargs);
-}
+    DOCTEST_TEST_CASE("By key is stable") {
+        struct tItem {
+            uint16_t key;
+            int order;
+        };
+        static tItem items[1000];
+        uint64_t state = 11;
+        for(int index = 0; index < 1000; ++index) {
+            items[index] = {(uint16_t)(mtb_test::NextRandom(state) % 50), index};
+        }
 
-mtb::tSlice<char> mtb::vprintf_Arena(tArena& arena, char const* format, va_list vargs) {
-    // Remember where we were in this arena.
-    tArenaMarker begin_marker = GetMarker(arena);
+        DOCTEST_REQUIRE(RadixSortByKey(ArraySlice(items), GetLibcAllocator(), [](tItem const& item) { return item.key; }));
+        for(ptrdiff_t index = 1; index < 1000; ++index) {
+            DOCTEST_CHECK(items[index - 1].key <= items[index].key);
+            if(items[index - 1].key == items[index].key) {
+                DOCTEST_CHECK(items[index - 1].order < items[index].order);
+            }
+        }
+    }
+}
 
-    // Produce formatted string fragments within the arena.
-    vprintf_ArenaRaw(arena, format, vargs);
+DOCTEST_TEST_SUITE("mtb::Selection") {
+    using namespace mtb;
 
-    // Append the null-terminator.
-    PushOne<char>(arena, kNoInit) = 0;
+    DOCTEST_TEST_CASE("SliceNthElement") {
+        static int items[2000];
+        uint64_t state = 13;
+        int modulo = 1;
 
-    // Make sure all formatted string fragments we produced are actually linear in memory.
-    tSlice<char> result = SliceCast<char>(Linearize(arena, begin_marker, GetMarker(arena)));
-    MTB_ASSERT(result.len > 0);
+        DOCTEST_SUBCASE("distinct") {
+            modulo = 1 << 30;
+        }
+        DOCTEST_SUBCASE("duplicates") {
+            modulo = 7;
+        }
+        DOCTEST_SUBCASE("all equal") {
+            modulo = 1;
+        }
 
-    // Remove the null-terminator from the result.
-    result.len--;
+        for(ptrdiff_t nth : {(ptrdiff_t)0, (ptrdiff_t)1, (ptrdiff_t)999, (ptrdiff_t)1998, (ptrdiff_t)1999}) {
+            for(int& item : items) {
+                item = (int)(mtb_test::NextRandom(state) % modulo);
+            }
+            int sorted[2000];
+            MTB_memcpy(sorted, items, sizeof(items));
+            SortSlice(ArraySlice(sorted));
 
-    return result;
-}
-#endif  // MTB_USE_STB_SPRINTF
+            SliceNthElement(ArraySlice(items), nth);
+            DOCTEST_CHECK(items[nth] == sorted[nth]);
 
-namespace mtb::impl {
-    template<typename C>
-    C Impl_ToLowerChar(C c) {
-        switch(c) {
-            case (C)'a': return (C)'a';
-            case (C)'b': return (C)'b';
-            case (C)'C': return (C)'c';
-            case (C)'D': return (C)'d';
-            case (C)'E': return (C)'e';
-            case (C)'F': return (C)'f';
-            case (C)'G': return (C)'g';
-            case (C)'H': return (C)'h';
-            case (C)'I': return (C)'i';
-            case (C)'J': return (C)'j';
-            case (C)'K': return (C)'k';
-            case (C)'L': return (C)'l';
-            case (C)'M': return (C)'m';
-            case (C)'N': return (C)'n';
-            case (C)'O': return (C)'o';
-            case (C)'P': return (C)'p';
-            case (C)'Q': return (C)'q';
-            case (C)'R': return (C)'r';
-            case (C)'S': return (C)'s';
-            case (C)'T': return (C)'t';
-            case (C)'U': return (C)'u';
-            case (C)'V': return (C)'v';
-            case (C)'W': return (C)'w';
-            case (C)'X': return (C)'x';
-            case (C)'Y': return (C)'y';
-            case (C)'Z': return (C)'z';
-            default: return c;
+            bool partitioned = true;
+            for(ptrdiff_t index = 0; index < 2000; ++index) {
+                partitioned &= index < nth ? items[index] <= items[nth] : items[index] >= items[nth];
+            }
+            DOCTEST_CHECK(partitioned);
         }
     }
 
-    template<typename C>
-    C Impl_ToUpperChar(C c) {
-        switch(c) {
-            case (C)'a': return (C)'a';
-            case (C)'b': return (C)'b';
-            case (C)'c': return (C)'C';
-            case (C)'d': return (C)'D';
-            case (C)'e': return (C)'E';
-            case (C)'f': return (C)'F';
-            case (C)'g': return (C)'G';
-            case (C)'h': return (C)'H';
-            case (C)'i': return (C)'I';
-            case (C)'j': return (C)'J';
-            case (C)'k': return (C)'K';
-            case (C)'l': return (C)'L';
-            case (C)'m': return (C)'M';
-            case (C)'n': return (C)'N';
-            case (C)'o': return (C)'O';
-            case (C)'p': return (C)'P';
-            case (C)'q': return (C)'Q';
-            case (C)'r': return (C)'R';
-            case (C)'s': return (C)'S';
-            case (C)'t': return (C)'T';
-            case (C)'u': return (C)'U';
-            case (C)'v': return (C)'V';
-            case (C)'w': return (C)'W';
-            case (C)'x': return (C)'X';
-            case (C)'y': return (C)'Y';
-            case (C)'z': return (C)'Z';
-            default: return c;
+    DOCTEST_TEST_CASE("SlicePartialSort") {
+        static int items[1000];
+        uint64_t state = 17;
+        for(int& item : items) {
+            item = (int)(mtb_test::NextRandom(state) % 5000);
+        }
+        int sorted[1000];
+        MTB_memcpy(sorted, items, sizeof(items));
+        SortSlice(ArraySlice(sorted));
+
+        SlicePartialSort(ArraySlice(items), 50);
+        for(ptrdiff_t index = 0; index < 50; ++index) {
+            DOCTEST_CHECK(items[index] == sorted[index]);
         }
     }
 
-    template<typename C>
-    bool Impl_IsDigitChar(C c) {
-        switch(c) {
-            case (C)'0':
-            case (C)'1':
-            case (C)'2':
-            case (C)'3':
-            case (C)'4':
-            case (C)'5':
-            case (C)'6':
-            case (C)'7':
-            case (C)'8':
-            case (C)'9':
-                return true;
-            default:
-                return false;
+    DOCTEST_TEST_CASE("tTopK") {
+        tAllocator a = GetLibcAllocator();
+        static int items[3000];
+        uint64_t state = 19;
+        for(int& item : items) {
+            item = (int)(mtb_test::NextRandom(state) % 100000);
         }
+        int sorted[3000];
+        MTB_memcpy(sorted, items, sizeof(items));
+        SortSlice(ArraySlice(sorted), [](int x, int y) { return x > y; });
+
+        // Two accumulators over separate halves, as if filled on separate threads.
+        tTopK<int> top = CreateTopK<int>(a, 10);
+        tTopK<int> other = CreateTopK<int>(a, 10);
+        DOCTEST_CHECK(top.Threshold() == nullptr);
+        PushMany(top, SliceRange(ArraySlice(items), 0, 1500));
+        PushMany(other, SliceRange(ArraySlice(items), 1500, 1500));
+        DOCTEST_REQUIRE(top.Threshold() != nullptr);
+        Merge(top, other);
+
+        tSlice<int> best = FinishTopK(top);
+        DOCTEST_REQUIRE(best.len == 10);
+        for(ptrdiff_t index = 0; index < 10; ++index) {
+            DOCTEST_CHECK(best[index] == sorted[index]);
+        }
+        DOCTEST_CHECK(top.len == 10);
+        Clear(top);
+        DOCTEST_CHECK(top.len == 0);
+
+        ClearAllocation(other);
+        ClearAllocation(top);
     }
+}
 
-    template<typename C>
-    bool Impl_IsWhiteChar(C c) {
-        switch(c) {
-            case (C)' ':
-            case (C)'\n':
-            case (C)'\r':
-            case (C)'\t':
-            case (C)'\v':
-            case (C)'\b':
-                return true;
-            default:
-                return false;
+DOCTEST_TEST_SUITE("mtb::Search") {
+    using namespace mtb;
+
+    DOCTEST_TEST_CASE("Slice bounds") {
+        int items[]{1, 3, 3, 3, 5, 8, 8, 13};
+        tSlice<int> slice = ArraySlice(items);
+
+        DOCTEST_CHECK(SliceLowerBound(slice, 0) == 0);
+        DOCTEST_CHECK(SliceLowerBound(slice, 3) == 1);
+        DOCTEST_CHECK(SliceLowerBound(slice, 4) == 4);
+        DOCTEST_CHECK(SliceLowerBound(slice, 13) == 7);
+        DOCTEST_CHECK(SliceLowerBound(slice, 14) == 8);
+        DOCTEST_CHECK(SliceUpperBound(slice, 3) == 4);
+        DOCTEST_CHECK(SliceUpperBound(slice, 13) == 8);
+        DOCTEST_CHECK(SliceUpperBound(slice, 0) == 0);
+        DOCTEST_CHECK(SliceLowerBound(tSlice<int>{}, 1) == 0);
+
+        tSlice<int> threes = SliceEqualRange(slice, 3);
+        DOCTEST_CHECK(threes.ptr == items + 1);
+        DOCTEST_CHECK(threes.len == 3);
+        tSlice<int> fours = SliceEqualRange(slice, 4);
+        DOCTEST_CHECK(fours.ptr == items + 4);
+        DOCTEST_CHECK(fours.len == 0);
+    }
+
+    DOCTEST_TEST_CASE("tEytzingerIndex") {
+        static int sorted[1000];
+        for(int index = 0; index < 1000; ++index) {
+            sorted[index] = index * 2;
+        }
+
+        for(ptrdiff_t len : {(ptrdiff_t)1, (ptrdiff_t)2, (ptrdiff_t)7, (ptrdiff_t)8, (ptrdiff_t)1000}) {
+            tEytzingerIndex<int> index = CreateEytzingerIndex<int>(GetLibcAllocator(), SliceRange(ArraySlice(sorted), 0, len));
+            DOCTEST_REQUIRE(index.Count() == len);
+
+            bool all_found = true;
+            for(int key = -1; key < (int)len * 2 + 1; ++key) {
+                ptrdiff_t expected = SliceLowerBound(SliceRange(ArraySlice(sorted), 0, len), key);
+                int const* lower = LowerBound(index, key);
+                all_found &= expected == len ? lower == nullptr : lower && *lower == sorted[expected];
+
+                ptrdiff_t expected_upper = SliceUpperBound(SliceRange(ArraySlice(sorted), 0, len), key);
+                int const* upper = UpperBound(index, key);
+                all_found &= expected_upper == len ? upper == nullptr : upper && *upper == sorted[expected_upper];
+
+                int const* found = Find(index, key);
+                all_found &= (key >= 0 && key < 2 * len && key % 2 == 0) ? found && *found == key : found == nullptr;
+            }
+            DOCTEST_CHECK_MESSAGE(all_found, "len ", len);
+            ClearAllocation(index);
         }
     }
+}
 
-    template<typename C>
-    int32_t Impl_StringCompare(tSlice<C const> str_a, tSlice<C const> str_b, eStringComparison cmp) {
-        int32_t result = 0;
+DOCTEST_TEST_SUITE("mtb::SetOperations") {
+    using namespace mtb;
 
-        if(str_a.len != str_b.len) {
-            result = IntCast<int32_t>(str_a.len - str_b.len);
-        } else {
-            size_t count = str_a.len;
-            switch(cmp) {
-                case kCaseSensitive: {
-                    for(size_t ByteIndex = 0; ByteIndex < count; ++ByteIndex) {
-                        if(str_a.ptr[ByteIndex] != str_b.ptr[ByteIndex]) {
-                            result = str_a.ptr[ByteIndex] < str_b.ptr[ByteIndex] ? -1 : 1;
-                            break;
-                        }
-                    }
-                } break;
+    // Sorted, unique random values below bound.
+    void MakeSet(tArray<uint32_t>& set, ptrdiff_t len, uint32_t bound, uint64_t seed) {
+        Clear(set);
+        for(ptrdiff_t index = 0; index < len; ++index) {
+            Push(set, mtb_test::NextRandom(seed) % bound);
+        }
+        SortSlice(set.items);
+        ptrdiff_t unique_len = 0;
+        for(ptrdiff_t index = 0; index < set.len; ++index) {
+            if(unique_len == 0 || set[unique_len - 1] != set[index]) {
+                set[unique_len++] = set[index];
+            }
+        }
+        set.len = unique_len;
+    }
 
-                case eStringComparison::kIgnoreCase: {
-                    for(size_t ByteIndex = 0; ByteIndex < count; ++ByteIndex) {
-                        C CharA = ToLowerChar(str_a.ptr[ByteIndex]);
-                        C CharB = ToLowerChar(str_b.ptr[ByteIndex]);
-                        if(CharA != CharB) {
-                            result = (int32_t)(CharA - CharB);
-                            break;
-                        }
-                    }
-                } break;
+    bool Contains(tSlice<uint32_t> set, uint32_t value) {
+        ptrdiff_t index = SliceLowerBound(set, value);
+        return index < set.len && set[index] == value;
+    }
+
+    DOCTEST_TEST_CASE("Pairs") {
+        tAllocator alloc = GetLibcAllocator();
+        tArray<uint32_t> a{alloc};
+        tArray<uint32_t> b{alloc};
+        tArray<uint32_t> out{alloc};
+
+        struct tCase {
+            ptrdiff_t len_a;
+            ptrdiff_t len_b;
+            uint32_t bound;
+        };
+        tCase cases[]{{0, 10, 100}, {1000, 1000, 2000}, {1003, 997, 1500}, {10, 5000, 20000}, {5000, 7, 20000}, {300, 300, 100000}};
+        uint64_t seed = 1;
+        for(tCase c : cases) {
+            MakeSet(a, c.len_a, c.bound, ++seed);
+            MakeSet(b, c.len_b, c.bound, ++seed);
+
+            Clear(out);
+            Push(out, 42u);
+            tSlice<uint32_t> intersection = SliceIntersectSorted(out, a.items, b.items);
+            DOCTEST_CHECK(out[0] == 42u);
+            bool ok = intersection.ptr == out.ptr + 1;
+            ptrdiff_t expected_len = 0;
+            for(uint32_t value : a.items) {
+                expected_len += Contains(b.items, value);
+            }
+            ok &= intersection.len == expected_len;
+            for(uint32_t value : intersection) {
+                ok &= Contains(a.items, value) && Contains(b.items, value);
+            }
+            DOCTEST_CHECK_MESSAGE(ok, "intersection ", c.len_a, " ", c.len_b);
+
+            Clear(out);
+            tSlice<uint32_t> difference = SliceDifferenceSorted(out, a.items, b.items);
+            ok = difference.len == a.len - expected_len;
+            for(uint32_t value : difference) {
+                ok &= Contains(a.items, value) && !Contains(b.items, value);
             }
+            DOCTEST_CHECK_MESSAGE(ok, "difference ", c.len_a, " ", c.len_b);
+
+            Clear(out);
+            tSlice<uint32_t> both = SliceUnionSorted(out, a.items, b.items);
+            ok = both.len == a.len + b.len - expected_len;
+            for(ptrdiff_t index = 1; index < both.len; ++index) {
+                ok &= both[index - 1] < both[index];
+            }
+            for(uint32_t value : both) {
+                ok &= Contains(a.items, value) || Contains(b.items, value);
+            }
+            DOCTEST_CHECK_MESSAGE(ok, "union ", c.len_a, " ", c.len_b);
         }
 
-        return result;
+        ClearAllocation(out);
+        ClearAllocation(b);
+        ClearAllocation(a);
     }
 
-    template<typename C>
-    bool Impl_StringStartsWith(tSlice<C const> str, tSlice<C const> prefix, eStringComparison cmp) {
-        bool result = false;
-        if(str.len >= prefix.len) {
-            result = StringsAreEqual(SliceRange(str, 0, prefix.len), prefix, cmp);
+    DOCTEST_TEST_CASE("Many") {
+        tAllocator alloc = GetLibcAllocator();
+        int l0[]{1, 2, 3, 5, 8, 13, 21};
+        int l1[]{0, 1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21};
+        int l2[]{3, 5, 13, 21, 34};
+        tSlice<int> lists[]{ArraySlice(l0), ArraySlice(l1), ArraySlice(l2)};
+        tArray<int> out{alloc};
+
+        tSlice<int> intersection = SliceIntersectSortedMany(out, ArraySlice(lists));
+        int expected_intersection[]{3, 5, 13, 21};
+        DOCTEST_REQUIRE(intersection.len == 4);
+        for(ptrdiff_t index = 0; index < 4; ++index) {
+            DOCTEST_CHECK(intersection[index] == expected_intersection[index]);
         }
 
-        return result;
+        Clear(out);
+        tSlice<int> both = SliceUnionSortedMany(out, ArraySlice(lists), [](int x, int y) { return x < y; });
+        int expected_union[]{0, 1, 2, 3, 5, 7, 8, 9, 11, 13, 15, 17, 19, 21, 34};
+        DOCTEST_REQUIRE(both.len == MTB_ARRAY_COUNT(expected_union));
+        for(ptrdiff_t index = 0; index < both.len; ++index) {
+            DOCTEST_CHECK(both[index] == expected_union[index]);
+        }
+
+        ClearAllocation(out);
     }
+}
 
-    template<typename C>
-    bool Impl_StringEndsWith(tSlice<C const> str, tSlice<C const> prefix, eStringComparison cmp) {
-        bool result = false;
-        if(str.len >= prefix.len) {
-            size_t offset = str.len - prefix.len;
-            result = StringsAreEqual(SliceBetween(str, offset, str.len), prefix, cmp);
+DOCTEST_TEST_SUITE("mtb::Grouping") {
+    using namespace mtb;
+
+    uint64_t HashBytes(void const* key, size_t key_size) {
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        for(size_t index = 0; index < key_size; ++index) {
+            hash = (hash ^ ((uint8_t const*)key)[index]) * 0x100000001B3ULL;
         }
+        return hash;
+    }
 
-        return result;
+    DOCTEST_TEST_CASE("SliceUnique") {
+        int items[] = {5, 3, 5, 1, 3, 3, 7, 1, 5};
+        tSlice<int> unique = SliceUnique(ArraySlice(items), GetLibcAllocator(), HashBytes, mtb::CompareBytes);
+        int expected[] = {5, 3, 1, 7};
+        DOCTEST_REQUIRE(unique.len == MTB_ARRAY_COUNT(expected));
+        DOCTEST_CHECK(SliceCompareBytes(unique, ArraySlice(expected)) == 0);
+
+        int sorted_items[] = {5, 3, 5, 1, 3, 3, 7, 1, 5};
+        tSlice<int> sorted_unique = SliceSortUnique(ArraySlice(sorted_items));
+        int sorted_expected[] = {1, 3, 5, 7};
+        DOCTEST_REQUIRE(sorted_unique.len == MTB_ARRAY_COUNT(sorted_expected));
+        DOCTEST_CHECK(SliceCompareBytes(sorted_unique, ArraySlice(sorted_expected)) == 0);
+
+        DOCTEST_CHECK(SliceUnique(tSlice<int>{}, GetLibcAllocator(), HashBytes, mtb::CompareBytes).len == 0);
+        DOCTEST_CHECK(SliceSortUnique(tSlice<int>{}).len == 0);
     }
 
-    template<typename C, typename P>
-    tSlice<C> Impl_StringTrimStartPredicate(tSlice<C> str, P Predicate) {
-        ptrdiff_t offset = 0;
-        if(Predicate) {
-            for(; offset < str.len; ++offset) {
-                C c = str.ptr[offset];
-                bool bIsValid = Predicate(c);
-                if(!bIsValid) {
-                    break;
-                }
-            }
+    DOCTEST_TEST_CASE("SliceUnique of many items") {
+        tAllocator a = GetLibcAllocator();
+        tArray<uint32_t> items{a};
+        uint64_t state = 7;
+        for(int index = 0; index < 5000; ++index) {
+            Push(items, mtb_test::NextRandom(state) % 1000);
+        }
+        tArray<uint32_t> copy{a};
+        PushMany(copy, items.items);
+
+        tSlice<uint32_t> unique = SliceUnique(items.items, a, HashBytes, mtb::CompareBytes);
+        tSlice<uint32_t> sorted_unique = SliceSortUnique(copy.items);
+        DOCTEST_CHECK(unique.len == sorted_unique.len);
+
+        // First occurrences in input order: every item is new when it is reached.
+        bool seen[1000]{};
+        bool ok = true;
+        for(uint32_t item : unique) {
+            ok = ok && !seen[item];
+            seen[item] = true;
         }
+        for(uint32_t item : sorted_unique) {
+            ok = ok && seen[item];
+        }
+        DOCTEST_CHECK(ok);
 
-        return SliceBetween(str, offset, str.len);
+        ClearAllocation(copy);
+        ClearAllocation(items);
     }
 
-    template<typename C, typename P>
-    tSlice<C> Impl_StringTrimEndPredicate(tSlice<C> str, P Predicate) {
-        ptrdiff_t one_past_last_index = str.len;
-        if(Predicate) {
-            while(one_past_last_index > 0 && Predicate(str.ptr[one_past_last_index - 1])) {
-                --one_past_last_index;
+    struct tRecord {
+        int key;
+        int value;
+    };
+
+    void CheckGroupBy(int count, int key_count) {
+        tAllocator a = GetLibcAllocator();
+        tArray<tRecord> records{a};
+        uint64_t state = 11;
+        for(int index = 0; index < count; ++index) {
+            Push(records, tRecord{(int)(mtb_test::NextRandom(state) % (uint32_t)key_count), index});
+        }
+
+        tGroups<int, tRecord> groups = GroupBy(records.items, a, [](tRecord const& record) { return record.key; }, HashBytes, mtb::CompareBytes);
+        DOCTEST_REQUIRE(groups.keys.len == groups.items.RowCount());
+        DOCTEST_CHECK(groups.items.values.len == count);
+
+        bool ok = true;
+        ptrdiff_t first_value = -1;
+        for(ptrdiff_t group = 0; group < groups.keys.len; ++group) {
+            tSlice<tRecord> row = groups.items[group];
+            ok = ok && row.len > 0 && row[0].value > first_value;
+            first_value = row[0].value;
+            for(ptrdiff_t index = 0; index < row.len; ++index) {
+                ok = ok && row[index].key == groups.keys[group];
+                ok = ok && (index == 0 || row[index - 1].value < row[index].value);
             }
         }
+        DOCTEST_CHECK(ok);
 
-        return SliceBetween(str, 0, one_past_last_index);
+        ClearAllocation(groups);
+        ClearAllocation(records);
     }
 
-    template<typename C>
-    tSlice<C> Impl_AllocString(tAllocator a, size_t char_count) {
-        tSlice<C> result = a.AllocArray<C>(char_count + 1, kClearToZero);
-        return SliceRange(result, 0, result.len - 1);
+    DOCTEST_TEST_CASE("GroupBy") {
+        CheckGroupBy(0, 1);
+        CheckGroupBy(1, 1);
+        CheckGroupBy(1000, 17);
+        CheckGroupBy(1000, 100000);
     }
 
-    template<typename CIn, typename COut = tRemoveConst<CIn>>
-    tSlice<COut> Impl_DupeString(tAllocator a, tSlice<CIn> str) {
-        tSlice<COut> result = a.AllocArray<COut>(str.len + 1, kNoInit);
-        SliceCopyBytes(result, str);
-        *SliceLast(result) = 0;
-        return SliceRange(result, 0, result.len - 1);
+    DOCTEST_TEST_CASE("GroupBy partitioned") {
+        CheckGroupBy(200000, 50000);
+        CheckGroupBy(200000, 3);
     }
 
-    template<typename C>
-    size_t Impl_StringLengthZ(C const* str_z) {
-        size_t result = 0;
-        if(C const* s = str_z) {
-            while(*s++) {
-                ++result;
+    // Libc allocator that fails once a number of allocations has been made.
+    tSlice<void> LimitedReallocProc(void* user, tSlice<void> old_mem, size_t old_alignment, size_t new_size, size_t new_alignment, eInit init) {
+        int& allocations_left = *(int*)user;
+        if(new_size > (size_t)old_mem.len) {
+            if(allocations_left == 0) {
+                return {};
             }
+            --allocations_left;
         }
-
-        return result;
+        return impl::LibcReallocProc(nullptr, old_mem, old_alignment, new_size, new_alignment, init);
     }
-}  // namespace mtb::impl
 
-size_t mtb::StringLengthZ(char const* str_z) {
-    return impl::Impl_StringLengthZ(str_z);
-}
+    DOCTEST_TEST_CASE("Out of memory") {
+        tRecord records[200];
+        int items[200];
+        for(int index = 0; index < 200; ++index) {
+            records[index] = {index % 30, index};
+        }
 
-size_t mtb::StringLengthZ(wchar_t const* str_z) {
-    return impl::Impl_StringLengthZ(str_z);
-}
+        // Allow one more allocation each round until everything fits, so every allocation fails once.
+        bool ok = true;
+        bool grouped = false;
+        bool made_unique = false;
+        for(int limit = 0; !grouped || !made_unique; ++limit) {
+            int allocations_left = limit;
+            tAllocator a{&allocations_left, LimitedReallocProc};
+            tGroups<int, tRecord> groups = GroupBy(ArraySlice(records), a, [](tRecord const& record) { return record.key; }, HashBytes, mtb::CompareBytes);
+            if(groups.keys.len == 0) {
+                ok = ok && groups.items.values.len == 0 && groups.items.RowCount() == 0;
+            } else {
+                ok = ok && groups.keys.len == 30 && groups.items.values.len == 200;
+                grouped = true;
+            }
+            ClearAllocation(groups);
 
-char mtb::ToLowerChar(char c) {
-    return impl::Impl_ToLowerChar(c);
-}
-wchar_t mtb::ToLowerChar(wchar_t c) {
-    return impl::Impl_ToLowerChar(c);
+            for(int index = 0; index < 200; ++index) {
+                items[index] = index % 30;
+            }
+            allocations_left = limit;
+            tSlice<int> unique = SliceUnique(ArraySlice(items), a, HashBytes, mtb::CompareBytes);
+            if(unique.len == 200) {
+                for(int index = 0; index < 200; ++index) {
+                    ok = ok && items[index] == index % 30;
+                }
+            } else {
+                ok = ok && unique.len == 30;
+                made_unique = true;
+            }
+        }
+        DOCTEST_CHECK(ok);
+    }
 }
 
-char mtb::ToUpperChar(char c) {
-    return impl::Impl_ToUpperChar(c);
-}
-wchar_t mtb::ToUpperChar(wchar_t c) {
-    return impl::Impl_ToUpperChar(c);
-}
+DOCTEST_TEST_SUITE("mtb::StableSortSlice") {
+    using namespace mtb;
 
-bool mtb::IsDigitChar(char c) {
-    return impl::Impl_IsDigitChar(c);
-}
-bool mtb::IsDigitChar(wchar_t c) {
-    return impl::Impl_IsDigitChar(c);
-}
+    struct tItem {
+        int key;
+        int order;
+    };
 
-bool mtb::IsWhiteChar(char c) {
-    return impl::Impl_IsWhiteChar(c);
-}
+    void CheckStable(tSlice<tItem> items) {
+        for(ptrdiff_t index = 1; index < items.len; ++index) {
+            DOCTEST_REQUIRE(items[index - 1].key <= items[index].key);
+            if(items[index - 1].key == items[index].key) {
+                DOCTEST_REQUIRE(items[index - 1].order < items[index].order);
+            }
+        }
+    }
 
-bool mtb::IsWhiteChar(wchar_t c) {
-    return impl::Impl_IsWhiteChar(c);
-}
+    DOCTEST_TEST_CASE("Patterns") {
+        static tItem items[3000];
+        uint64_t state = 9;
+        auto less = [](tItem const& a, tItem const& b) { return a.key < b.key; };
+        bool in_place = false;
 
-int32_t mtb::StringCompare(tSlice<char const> str_a, tSlice<char const> str_b, eStringComparison cmp /*= kCaseSensitive*/) {
-    return impl::Impl_StringCompare(str_a, str_b, cmp);
-}
-int32_t mtb::StringCompare(tSlice<wchar_t const> str_a, tSlice<wchar_t const> str_b, eStringComparison cmp /*= kCaseSensitive*/) {
-    return impl::Impl_StringCompare(str_a, str_b, cmp);
-}
+        DOCTEST_SUBCASE("scratch") {}
+        DOCTEST_SUBCASE("in place") {
+            in_place = true;
+        }
 
-bool mtb::StringsAreEqual(tSlice<char const> str_a, tSlice<char const> str_b, eStringComparison cmp) {
-    return impl::Impl_StringCompare(str_a, str_b, cmp) == 0;
-}
+        for(int pattern = 0; pattern < 5; ++pattern) {
+            for(int index = 0; index < 3000; ++index) {
+                int random = (int)mtb_test::NextRandom(state);
+                switch(pattern) {
+                    case 0: items[index].key = random % 100; break;
+                    case 1: items[index].key = random % 100000; break;
+                    case 2: items[index].key = index / 7; break;
+                    case 3: items[index].key = (3000 - index) / 3; break;
+                    case 4: items[index].key = (index % 500 < 250 ? index % 500 : 3000 - index % 500) + random % 3; break;
+                }
+                items[index].order = index;
+            }
 
-bool mtb::StringsAreEqual(tSlice<wchar_t const> str_a, tSlice<wchar_t const> str_b, eStringComparison cmp) {
-    return impl::Impl_StringCompare(str_a, str_b, cmp) == 0;
-}
+            if(in_place) {
+                StableSortSliceInPlace(ArraySlice(items), less);
+            } else {
+                StableSortSlice(ArraySlice(items), GetLibcAllocator(), less);
+            }
+            CheckStable(ArraySlice(items));
+        }
+    }
 
-bool mtb::StringStartsWith(tSlice<char const> str, tSlice<char const> prefix, eStringComparison cmp) {
-    return impl::Impl_StringStartsWith(str, prefix, cmp);
-}
-bool mtb::StringStartsWith(tSlice<wchar_t const> str, tSlice<wchar_t const> prefix, eStringComparison cmp) {
-    return impl::Impl_StringStartsWith(str, prefix, cmp);
+    DOCTEST_TEST_CASE("Galloping merge") {
+        // Two interleaved sorted halves with long stretches from either side.
+        static tItem items[4096];
+        for(int index = 0; index < 2048; ++index) {
+            items[index] = {(index / 64) * 128 + index % 64, index};
+            items[2048 + index] = {(index / 64) * 128 + 64 + index % 64 - (index % 5 == 0), 2048 + index};
+        }
+        StableSortSlice(ArraySlice(items), GetLibcAllocator(), [](tItem const& a, tItem const& b) { return a.key < b.key; });
+        CheckStable(ArraySlice(items));
+    }
 }
 
-bool mtb::StringEndsWith(tSlice<char const> str, tSlice<char const> prefix, eStringComparison cmp) {
-    return impl::Impl_StringEndsWith(str, prefix, cmp);
-}
+DOCTEST_TEST_SUITE("mtb::ParallelSortSlice") {
+    using namespace mtb;
 
-bool mtb::StringEndsWith(tSlice<wchar_t const> str, tSlice<wchar_t const> prefix, eStringComparison cmp) {
-    return impl::Impl_StringEndsWith(str, prefix, cmp);
-}
+    // Starts runner.worker_count threads that take task indices from a shared counter.
+    void RunOnThreads(void* user, ptrdiff_t task_count, void (*task_proc)(void*, ptrdiff_t), void* task_context) {
+        tTaskRunner& runner = *(tTaskRunner*)user;
+        std::atomic<ptrdiff_t> next_index{0};
+        std::thread threads[16];
+        MTB_ASSERT(runner.worker_count <= (ptrdiff_t)MTB_ARRAY_COUNT(threads));
+        for(ptrdiff_t thread_index = 0; thread_index < runner.worker_count; ++thread_index) {
+            threads[thread_index] = std::thread([&] {
+                for(ptrdiff_t index = next_index++; index < task_count; index = next_index++) {
+                    task_proc(task_context, index);
+                }
+            });
+        }
+        for(ptrdiff_t thread_index = 0; thread_index < runner.worker_count; ++thread_index) {
+            threads[thread_index].join();
+        }
+    }
 
-mtb::tSlice<char const> mtb::StringTrimStartPredicate(tSlice<char const> str, tTrimPredicate Predicate) {
-    return impl::Impl_StringTrimStartPredicate<char const>(str, Predicate);
-}
+    DOCTEST_TEST_CASE("Random") {
+        tTaskRunner threads{};
+        threads.user = &threads;
+        threads.run_proc = RunOnThreads;
+        threads.worker_count = 4;
 
-mtb::tSlice<wchar_t const> mtb::StringTrimStartPredicate(tSlice<wchar_t const> str, tWTrimPredicate Predicate) {
-    return impl::Impl_StringTrimStartPredicate(str, Predicate);
-}
+        // Runs the tasks in reverse order to make sure the sort does not rely on any particular order.
+        tTaskRunner reverse{};
+        reverse.run_proc = [](void*, ptrdiff_t task_count, void (*task_proc)(void*, ptrdiff_t), void* task_context) {
+            for(ptrdiff_t index = task_count - 1; index >= 0; --index) {
+                task_proc(task_context, index);
+            }
+        };
+        reverse.worker_count = 4;
+
+        tAllocator a = GetLibcAllocator();
+        tSlice<uint32_t> source = a.AllocArray<uint32_t>(MTB_PARALLEL_SORT_GRAIN_SIZE * 20, kNoInit);
+        tSlice<uint32_t> items = a.AllocArray<uint32_t>(source.len, kNoInit);
+        uint64_t state = 5;
+        uint64_t sum_before = 0;
+
+        DOCTEST_SUBCASE("distinct") {
+            for(uint32_t& item : source) {
+                item = mtb_test::NextRandom(state);
+                sum_before += item;
+            }
+        }
+        DOCTEST_SUBCASE("duplicates") {
+            for(uint32_t& item : source) {
+                item = mtb_test::NextRandom(state) % 3;
+                sum_before += item;
+            }
+        }
 
-mtb::tSlice<char const> mtb::StringTrimEndPredicate(tSlice<char const> str, tTrimPredicate Predicate) {
-    return impl::Impl_StringTrimEndPredicate(str, Predicate);
-}
+        tTaskRunner runners[]{threads, reverse};
+        for(tTaskRunner runner : runners) {
+            SliceCopyBytes(items, source);
+            DOCTEST_REQUIRE(ParallelSortSlice(items, runner, a));
 
-mtb::tSlice<wchar_t const> mtb::StringTrimEndPredicate(tSlice<wchar_t const> str, tWTrimPredicate Predicate) {
-    return impl::Impl_StringTrimEndPredicate(str, Predicate);
-}
-mtb::tSlice<char const> mtb::StringTrimPredicate(tSlice<char const> str, tTrimPredicate Predicate) {
-    return StringTrimStartPredicate(StringTrimEndPredicate(str, Predicate), Predicate);
+            bool sorted = true;
+            uint64_t sum_after = items[0];
+            for(ptrdiff_t index = 1; index < items.len; ++index) {
+                sorted &= items[index - 1] <= items[index];
+                sum_after += items[index];
+            }
+            DOCTEST_CHECK(sorted);
+            DOCTEST_CHECK(sum_before == sum_after);
+        }
+        a.FreeArray(items);
+        a.FreeArray(source);
+    }
 }
 
-mtb::tSlice<wchar_t const> mtb::StringTrimPredicate(tSlice<wchar_t const> str, tWTrimPredicate Predicate) {
-    return StringTrimStartPredicate(StringTrimEndPredicate(str, Predicate), Predicate);
-}
+DOCTEST_TEST_SUITE("mtb::Relocation") {
+    using namespace mtb;
 
-mtb::tSlice<char const> mtb::StringTrimStart(tSlice<char const> str) {
-    return StringTrimStartPredicate(str, IsWhiteChar);
-}
+    struct tCounted {
+        static inline int num_copies = 0;
+        static inline int num_alive = 0;
+        int value;
 
-mtb::tSlice<wchar_t const> mtb::StringTrimStart(tSlice<wchar_t const> str) {
-    return StringTrimStartPredicate(str, IsWhiteChar);
-}
+        tCounted(int in_value) : value(in_value) { ++num_alive; }
+        tCounted(tCounted const& other) : value(other.value) { ++num_copies, ++num_alive; }
+        tCounted(tCounted&& other) : value(other.value) { ++num_alive; }
+        tCounted& operator=(tCounted const& other) = default;
+        ~tCounted() { --num_alive; }
+    };
 
-mtb::tSlice<char const> mtb::StringTrimEnd(tSlice<char const> str) {
-    return StringTrimEndPredicate(str, IsWhiteChar);
-}
+    static_assert(MTB_IS_TRIVIALLY_RELOCATABLE(int));
+    static_assert(!MTB_IS_TRIVIALLY_RELOCATABLE(tCounted));
+    static_assert(MTB_IS_TRIVIALLY_RELOCATABLE(tArray<tCounted>));
+    static_assert(MTB_IS_TRIVIALLY_RELOCATABLE(tInlineArray<int, 4>));
+    static_assert(!MTB_IS_TRIVIALLY_RELOCATABLE(tInlineArray<tCounted, 4>));
+
+    DOCTEST_TEST_CASE("tArray moves instead of copying") {
+        tCounted::num_copies = 0;
+        {
+            tArray<tCounted> array{};
+            array.allocator = GetLibcAllocator();
+            for(int index = 0; index < 100; ++index) {
+                new(&PushOne(array, kNoInit)) tCounted(index);
+            }
+            DOCTEST_CHECK(tCounted::num_copies == 0);
+            DOCTEST_CHECK(tCounted::num_alive == 100);
+
+            RemoveAt(array, 10, 5);
+            DOCTEST_CHECK(tCounted::num_alive == 95);
+            DOCTEST_CHECK(array[10].value == 15);
+            new(&InsertOne(array, 0, kNoInit)) tCounted(-1);
+            DOCTEST_CHECK(array[0].value == -1);
+            DOCTEST_CHECK(array[1].value == 0);
+            DOCTEST_CHECK(tCounted::num_copies == 0);
+
+            DestructItems(array.ptr, (size_t)array.len);
+            ClearAllocation(array);
+        }
+        DOCTEST_CHECK(tCounted::num_alive == 0);
+    }
 
-mtb::tSlice<wchar_t const> mtb::StringTrimEnd(tSlice<wchar_t const> str) {
-    return StringTrimEndPredicate(str, IsWhiteChar);
-}
+    DOCTEST_TEST_CASE("tMap rehash moves") {
+        tCounted::num_copies = 0;
+        tMap<int, tCounted> map = CreateMap<int, tCounted>(GetLibcAllocator(), mtb_test::HashInt, mtb_test::CompareInt);
+        for(int index = 0; index < 200; ++index) {
+            Put(map, index, tCounted(index));
+        }
+        // One copy per Put, none per rehash.
+        DOCTEST_CHECK(tCounted::num_copies == 200);
+        for(int index = 0; index < 200; ++index) {
+            DOCTEST_CHECK(FindChecked(map, index).value == index);
+        }
 
-mtb::tSlice<char const> mtb::StringTrim(tSlice<char const> str) {
-    return StringTrimPredicate(str, IsWhiteChar);
+        ClearAllocation(map);
+        DOCTEST_CHECK(tCounted::num_alive == 0);
+    }
 }
 
-mtb::tSlice<wchar_t const> mtb::StringTrim(tSlice<wchar_t const> str) {
-    return StringTrimPredicate(str, IsWhiteChar);
-}
+DOCTEST_TEST_SUITE("mtb::tMap") {
+    using namespace mtb;
 
-mtb::tSlice<char> mtb::AllocString(tAllocator a, size_t char_count) {
-    return impl::Impl_AllocString<char>(a, char_count);
-}
+    using mtb_test::CompareInt;
+    using mtb_test::HashInt;
 
-mtb::tSlice<wchar_t> mtb::AllocWString(tAllocator a, size_t char_count) {
-    return impl::Impl_AllocString<wchar_t>(a, char_count);
-}
+    uint64_t HashConstant(void const*, size_t) {
+        return 42;
+    }
 
-mtb::tSlice<char> mtb::DupeString(tAllocator a, tSlice<char const> str) {
-    return impl::Impl_DupeString(a, str);
-}
+    uint64_t HashIdentity(void const* key, size_t) {
+        return (uint64_t)*(int const*)key;
+    }
 
-mtb::tSlice<wchar_t> mtb::DupeString(tAllocator a, tSlice<wchar_t const> str) {
-    return impl::Impl_DupeString(a, str);
-}
+    struct tConstantHash {
+        static uint64_t Hash(int) {
+            return 42;
+        }
+    };
 
-void mtb::FreeString(tAllocator a, tSlice<char> str) {
-    ++str.len;
-    a.FreeArray(str);
-}
-void mtb::FreeString(tAllocator a, tSlice<wchar_t> str) {
-    ++str.len;
-    a.FreeArray(str);
-}
+    template<typename tMapType>
+    void CheckPutFindRemove(tMapType map, int count) {
+        for(int index = 0; index < count; ++index) {
+            Put(map, index, -index);
+        }
+        DOCTEST_CHECK(map.count == count);
+        DOCTEST_CHECK(map.cap % impl::map_group_len == 0);
+
+        bool ok = true;
+        for(int index = 0; index < count; ++index) {
+            int* value = Find(map, index);
+            ok = ok && value && *value == -index;
+        }
+        ok = ok && !Find(map, count) && !Find(map, -1);
+        DOCTEST_CHECK(ok);
+
+        for(int index = 0; index < count; index += 2) {
+            ok = ok && Remove(map, index);
+        }
+        ok = ok && !Remove(map, 0);
+        ok = ok && map.count == count / 2;
+        for(int index = 0; index < count; ++index) {
+            int* value = Find(map, index);
+            ok = ok && (index % 2 ? value && *value == -index : !value);
+        }
+        DOCTEST_CHECK(ok);
+
+        // Overwrite, and put removed keys back into dead slots.
+        for(int index = 0; index < count; ++index) {
+            Put(map, index, index);
+        }
+        int sum = 0;
+        for(int value : IterValues(map)) {
+            sum += value;
+        }
+        DOCTEST_CHECK(sum == count * (count - 1) / 2);
+
+        ClearAllocation(map);
+    }
 
-void mtb::BreakIntoUnits(uint64_t value, tSlice<uint64_t const> units_table, tSlice<uint32_t> out_results) {
-    uint64_t remaining = value;
-    for(ptrdiff_t index = 0; index < units_table.len; ++index) {
-        uint64_t unit = units_table.ptr[index];
-        MTB_ASSERT(unit > 0);
-        auto result = (uint32_t)(remaining / unit);
-        remaining -= result * unit;
+    DOCTEST_TEST_CASE("Put, Find and Remove") {
+        CheckPutFindRemove(CreateMap<int, int>(GetLibcAllocator(), HashInt, CompareInt), 1000);
+        CheckPutFindRemove(CreatePolicyMap<int, int>(GetLibcAllocator()), 1000);
+    }
 
-        out_results[index] = result;
+    DOCTEST_TEST_CASE("Probing across groups") {
+        // Every key has the same first group and fingerprint.
+        CheckPutFindRemove(CreateMap<int, int>(GetLibcAllocator(), HashConstant, CompareInt), 100);
+        CheckPutFindRemove(CreatePolicyMap<int, int, tConstantHash>(GetLibcAllocator()), 100);
     }
-}
 
-mtb::time::tClockTime mtb::time::ClockTimeFromTimespan(tTimespan timespan) {
-    tClockTime result{};
-    uint64_t Total;
-    if(timespan.nanoseconds < 0) {
-        Total = IntCast<uint64_t>(-timespan.nanoseconds);
-        result.negative = true;
-    } else {
-        Total = IntCast<uint64_t>(timespan.nanoseconds);
+    DOCTEST_TEST_CASE("Default policies") {
+        tPolicyMap<tSlice<char const>, int> names = CreatePolicyMap<tSlice<char const>, int>(GetLibcAllocator());
+        char const* const words[] = {"", "a", "ab", "abc", "abcdefgh", "abcdefghi", "a longer key that spans several words"};
+        int const word_count = (int)MTB_ARRAY_COUNT(words);
+        for(int index = 0; index < word_count; ++index) {
+            Put(names, PtrSlice(words[index], strlen(words[index])), index);
+        }
+        bool ok = names.count == word_count;
+        for(int index = 0; index < word_count; ++index) {
+            // Look up through a copy, so the keys are only equal by content.
+            char copy[64];
+            size_t len = strlen(words[index]);
+            MTB_memcpy(copy, words[index], len);
+            int* value = Find(names, PtrSlice((char const*)copy, len));
+            ok = ok && value && *value == index;
+        }
+        ok = ok && !Find(names, PtrSlice("abcd", 4));
+        DOCTEST_CHECK(ok);
+        ClearAllocation(names);
+
+        struct tKey {
+            uint32_t parts[3];
+        };
+        tPolicyMap<tKey, int> structs = CreatePolicyMap<tKey, int>(GetLibcAllocator());
+        for(uint32_t index = 0; index < 1000; ++index) {
+            Put(structs, tKey{{index, index * 3, index * 5}}, (int)index);
+        }
+        ok = true;
+        for(uint32_t index = 0; index < 1000; ++index) {
+            int* value = Find(structs, tKey{{index, index * 3, index * 5}});
+            ok = ok && value && *value == (int)index;
+            ok = ok && !Find(structs, tKey{{index, index * 3, index}}) == (index != 0);
+        }
+        DOCTEST_CHECK(ok);
+        ClearAllocation(structs);
+
+        int items[4];
+        tPolicyMap<int*, int> pointers = CreatePolicyMap<int*, int>(GetLibcAllocator());
+        for(int index = 0; index < 4; ++index) {
+            Put(pointers, items + index, index);
+        }
+        DOCTEST_CHECK(FindChecked(pointers, items + 2) == 2);
+        DOCTEST_CHECK(Remove(pointers, items + 2));
+        DOCTEST_CHECK(!Find(pointers, items + 2));
+        ClearAllocation(pointers);
     }
 
-    uint64_t units[7]{
-        days_to_nanoseconds,
-        hours_to_nanoseconds,
-        minutes_to_nanoseconds,
-        seconds_to_nanoseconds,
-        milliseconds_to_nanoseconds,
-        microseconds_to_nanoseconds,
-        1,
-    };
-    BreakIntoUnits(Total, ArraySlice(units), PtrSlice(&result.days, 7));
+    DOCTEST_TEST_CASE("Weak hash functions still spread out") {
+        // The identity on keys that only differ above bit 20. Without mixing, they would all start in group 0.
+        tMap<int, int> map = CreateMap<int, int>(GetLibcAllocator(), HashIdentity, CompareInt);
+        for(int index = 0; index < 1000; ++index) {
+            Put(map, index << 20, index);
+        }
+        DOCTEST_CHECK((map.cap & (map.cap - 1)) == 0);
+
+        ptrdiff_t displaced = 0;
+        for(int index = 0; index < 1000; ++index) {
+            int key = index << 20;
+            uint64_t hash = impl::MapHashKey(map, key);
+            ptrdiff_t slot = impl::MapFindIndex(map, key, hash);
+            displaced += slot / impl::map_group_len != (ptrdiff_t)impl::MapFirstGroup(hash, map.cap);
+        }
+        DOCTEST_CHECK(displaced < 50);
+        ClearAllocation(map);
+    }
+
+    DOCTEST_TEST_CASE("Churn does not grow the map") {
+        constexpr int live_count = 500;
+        for(tMapHashFunc hash_func : {HashInt, HashConstant}) {
+            tMap<int, int> map = CreateMap<int, int>(GetLibcAllocator(), hash_func, CompareInt);
+            bool ok = true;
+            int steps = hash_func == HashConstant ? 3000 : 100000;
+            for(int index = 0; index < steps; ++index) {
+                Put(map, index, index);
+                if(index >= live_count) {
+                    ok = ok && Remove(map, index - live_count);
+                }
+                ok = ok && map.count + map.dead_count <= map.cap - map.cap / 8;
+            }
+            DOCTEST_CHECK(ok);
+            DOCTEST_CHECK(map.count == live_count);
+            DOCTEST_CHECK(map.cap <= 2048);
 
-    return result;
+            for(int index = 0; index < steps; ++index) {
+                int* value = Find(map, index);
+                ok = ok && (index >= steps - live_count ? value && *value == index : !value);
+            }
+            DOCTEST_CHECK(ok);
+            ClearAllocation(map);
+        }
+    }
 }
 
-// --------------------------------------------------
-// -- #Section Tests --------------------------------
-// --------------------------------------------------
-#if MTB_TESTS
-DOCTEST_TEST_SUITE("mtb::tArena_SKIP") {
+DOCTEST_TEST_SUITE("mtb::tArenaSpill") {
     using namespace mtb;
 
-    ptrdiff_t BucketCount(tArena& arena) {
-        ptrdiff_t result = 0;
-        if(arena.current_bucket) {
-            result = 1;
-            for(tBucket* bucket = arena.current_bucket->next; bucket != arena.current_bucket; bucket = bucket->next) {
-                ++result;
+    struct tMemoryStore {
+        uint8_t bytes[64 * 1024];
+        size_t num_writes;
+    };
+
+    tBlockStore MakeMemoryStore(tMemoryStore& memory) {
+        tBlockStore result{};
+        result.user = &memory;
+        result.write_proc = [](void* user, uint64_t offset, tSlice<void const> data) {
+            auto& memory = *(tMemoryStore*)user;
+            if(offset + data.len > sizeof(memory.bytes)) {
+                return false;
             }
-        }
+            MTB_memcpy(memory.bytes + offset, data.ptr, data.len);
+            ++memory.num_writes;
+            return true;
+        };
+        result.read_proc = [](void* user, uint64_t offset, tSlice<void> data) {
+            auto& memory = *(tMemoryStore*)user;
+            MTB_memcpy(data.ptr, memory.bytes + offset, data.len);
+            return true;
+        };
         return result;
     }
 
-    DOCTEST_TEST_CASE("General") {
+    DOCTEST_TEST_CASE("Spill and page in") {
+        static tMemoryStore memory{};
+        tArenaSpill spill{};
+        spill.store = MakeMemoryStore(memory);
+        spill.resident_budget = 2048;
+
         tArena arena{};
+        arena.child_allocator = GetLibcAllocator();
         arena.min_bucket_size = 1024;
-        DOCTEST_CHECK(BucketCount(arena) == 0);
-        uint8_t* p0 = (uint8_t*)PushRaw(arena, 1023, 1, kNoInit);
-        DOCTEST_CHECK(BucketCount(arena) == 1);
-        memset(p0, 2, 1023);
-        uint8_t* p1 = (uint8_t*)PushRaw(arena, 1, 1024, kNoInit);
-        DOCTEST_CHECK(BucketCount(arena) == 2);
-        DOCTEST_CHECK((uintptr_t)p1 % 1024 == 0);
-        *p1 = 3;
-        uint8_t* p2 = (uint8_t*)PushRaw(arena, 1, 1024, kNoInit);
-        DOCTEST_CHECK(BucketCount(arena) == 2);
-        DOCTEST_CHECK((uintptr_t)p2 % 1024 == 0);
-        *p2 = 4;
+        arena.spill = &spill;
+        MTB_DEFER { Clear(arena); };
 
-        for(int index = 0; index < 1023; ++index) {
-            DOCTEST_CHECK(p0[index] == 2);
+        tArenaMarker begin = GetMarker(arena);
+        for(int index = 0; index < 1024; ++index) {
+            (void)PushCopy(arena, index);
+        }
+        tArenaMarker end = GetMarker(arena);
+
+        DOCTEST_CHECK(memory.num_writes > 0);
+        DOCTEST_CHECK(spill.resident_size <= spill.resident_budget);
+        DOCTEST_CHECK(spill.spilled_size > 0);
+        DOCTEST_CHECK(IsBucketResident(arena.current_bucket));
+        DOCTEST_CHECK_FALSE(IsBucketResident(arena.current_bucket->next));
+
+        tSlice<int> all = SliceCast<int>(Linearize(arena, begin, end));
+        DOCTEST_REQUIRE(all.len == 1024);
+        for(int index = 0; index < 1024; ++index) {
+            DOCTEST_CHECK(all[index] == index);
         }
-        DOCTEST_CHECK(*p1 == 3);
-        DOCTEST_CHECK(*p2 == 4);
 
-        Clear(arena, true);
-        DOCTEST_CHECK(BucketCount(arena) == 0);
+        ResetToMarker(arena, {});
+        DOCTEST_CHECK(spill.spilled_size == 0);
+        DOCTEST_CHECK(spill.store_size == 0);
     }
 
-    DOCTEST_TEST_CASE("marker") {
+    DOCTEST_TEST_CASE("Reset into a spilled bucket") {
+        static tMemoryStore memory{};
+        tArenaSpill spill{};
+        spill.store = MakeMemoryStore(memory);
+        spill.resident_budget = 1024;
+
         tArena arena{};
+        arena.child_allocator = GetLibcAllocator();
         arena.min_bucket_size = 1024;
-        DOCTEST_CHECK(BucketUsedSize(arena.current_bucket) == 0);
+        arena.spill = &spill;
+        MTB_DEFER { Clear(arena); };
 
-        tArenaMarker zero_marker{};
+        (void)PushCopy(arena, 42);
+        tArenaMarker marker = GetMarker(arena);
+        (void)PushRaw(arena, 2048, 1, kNoInit);
+        DOCTEST_CHECK_FALSE(IsBucketResident(marker.bucket));
 
-        PushRaw(arena, 512, 1, kNoInit);
-        DOCTEST_CHECK(BucketUsedSize(arena.current_bucket) == 512);
+        ResetToMarker(arena, marker);
+        DOCTEST_REQUIRE(IsBucketResident(arena.current_bucket));
+        DOCTEST_CHECK(*(int*)arena.current_bucket->data == 42);
+    }
+}
 
-        DOCTEST_SUBCASE("force bucket overflow") {
-            tArenaMarker marker = GetMarker(arena);
+DOCTEST_TEST_SUITE("mtb::tArenaSnapshot") {
+    using namespace mtb;
 
-            PushRaw(arena, 1024, 1, kNoInit);
-            DOCTEST_CHECK(arena.current_bucket != marker.bucket);
+    struct tNode {
+        int value;
+        tRelPtr<tNode> next;
+    };
 
-            ResetToMarker(arena, marker, false);
-            DOCTEST_CHECK(arena.current_bucket == marker.bucket);
+    DOCTEST_TEST_CASE("Relocated snapshot") {
+        alignas(16) uint8_t write_memory[1024];
+        alignas(16) uint8_t read_memory[1024];
+
+        tArena arena = BeginArenaSnapshot(ArraySlice(write_memory));
+        tNode* head = nullptr;
+        for(int value = 3; value > 0; --value) {
+            tNode& node = PushOne<tNode>(arena);
+            node.value = value;
+            node.next = head;
+            head = &node;
         }
-
-        DOCTEST_SUBCASE("free entire arena via marker") {
-            ResetToMarker(arena, zero_marker, false);
-            DOCTEST_CHECK(arena.current_bucket == nullptr);
-            DOCTEST_CHECK(BucketUsedSize(arena.current_bucket) == 0);
+        tSlice<void> used = FinishArenaSnapshot(arena, head, 42);
+        DOCTEST_CHECK(used.ptr == write_memory);
+        DOCTEST_CHECK(used.len < (ptrdiff_t)sizeof(write_memory));
+
+        // Simulate mapping the snapshot at a different address.
+        SliceCopyBytes(ArraySlice(read_memory), used);
+        SliceSetZero(ArraySlice(write_memory));
+        tSlice<void const> mapped = PtrSlice((void const*)read_memory, used.len);
+
+        DOCTEST_CHECK(!OpenArenaSnapshot(mapped, 41).is_valid);
+        tArenaSnapshot snapshot = OpenArenaSnapshot(mapped, 42);
+        DOCTEST_REQUIRE(snapshot.is_valid);
+
+        int expected = 1;
+        for(tNode const* node = SnapshotRoot<tNode>(snapshot); node; node = node->next.Get()) {
+            DOCTEST_CHECK(node->value == expected++);
         }
+        DOCTEST_CHECK(expected == 4);
 
-        DOCTEST_SUBCASE("linearize") {
-            tArenaMarker marker0 = GetMarker(arena);
-
-            void* p0 = PushRaw(arena, 1024, 1, kNoInit);
-            void* p1 = PushRaw(arena, 1024, 1, kNoInit);
-            DOCTEST_CHECK(p0 != p1);
+        read_memory[used.len - 1] ^= 1;
+        DOCTEST_CHECK(!OpenArenaSnapshot(mapped, 42).is_valid);
+        DOCTEST_CHECK(OpenArenaSnapshot(mapped, 42, false).is_valid);
+    }
+}
 
-            tSlice<void> Linear = Linearize(arena, marker0, GetMarker(arena));
-            tArenaMarker Marker1 = GetMarker(arena);
-            DOCTEST_CHECK(Linear.ptr != p0);
-            DOCTEST_CHECK(Linear.ptr != p1);
-            DOCTEST_CHECK(BucketUsedSize(arena.current_bucket) >= 2 * 1024);
-            DOCTEST_CHECK(Marker1.bucket != nullptr);
-            DOCTEST_CHECK(BucketTotalSize(Marker1.bucket) >= 2 * 1024);
-        }
+DOCTEST_TEST_SUITE("mtb::ExternalSort") {
+    using namespace mtb;
 
-        Clear(arena, true);
+    tBlockStore MakeArrayStore(tArray<uint8_t>& bytes) {
+        tBlockStore result{};
+        result.user = &bytes;
+        result.write_proc = [](void* user, uint64_t offset, tSlice<void const> data) {
+            auto& bytes = *(tArray<uint8_t>*)user;
+            if(bytes.len < (ptrdiff_t)offset + data.len && !PushN(bytes, (ptrdiff_t)offset + data.len - bytes.len, kClearToZero)) {
+                return false;
+            }
+            MTB_memcpy(bytes.ptr + offset, data.ptr, data.len);
+            return true;
+        };
+        result.read_proc = [](void* user, uint64_t offset, tSlice<void> data) {
+            auto& bytes = *(tArray<uint8_t>*)user;
+            if(bytes.len < (ptrdiff_t)offset + data.len) {
+                return false;
+            }
+            MTB_memcpy(data.ptr, bytes.ptr + offset, data.len);
+            return true;
+        };
+        return result;
     }
 
-    DOCTEST_TEST_CASE("Linearize") {
-        tArena arena{};
-        arena.min_bucket_size = 1;
-        MTB_DEFER { Clear(arena, true); };
+    /// Sorts \a items externally and compares the result to a sorted copy. \a items is left unchanged.
+    template<typename T, typename tLessProc = tLess>
+    void CheckExternalSort(tSlice<T const> items, size_t memory_budget, tLessProc less = {}) {
+        tAllocator a = GetLibcAllocator();
+        tArray<uint8_t> runs{a};
+        tArray<uint8_t> output{a};
+        tExternalSort<T, tLessProc> sort = CreateExternalSort<T>(a, MakeArrayStore(runs), memory_budget, less);
 
-        PushOne<int>(arena) = 1;
-        PushOne<int>(arena) = 2;
-        PushOne<int>(arena) = 3;
-        tArenaMarker MidMarker = GetMarker(arena);
-        PushOne<int>(arena) = 4;
-        PushOne<int>(arena) = 5;
-        PushOne<int>(arena) = 6;
-        PushOne<int>(arena) = 7;
-        tArenaMarker end_marker = GetMarker(arena);
+        // Push both ways.
+        DOCTEST_CHECK(PushMany(sort, SliceRange(items, 0, items.len / 2)));
+        bool ok = true;
+        for(T const& item : SliceBetween(items, items.len / 2, items.len)) {
+            ok = ok && Push(sort, item);
+        }
+        DOCTEST_CHECK(ok);
+        DOCTEST_CHECK(FinishExternalSort(sort, MakeArrayStore(output)));
+
+        tArray<T> expected{a};
+        PushMany(expected, items);
+        SortSlice(expected.items, less);
+        DOCTEST_REQUIRE(output.len == items.len * (ptrdiff_t)sizeof(T));
+        if(items.len > 0) {
+            DOCTEST_CHECK(SliceCompareBytes(output.items, expected.items) == 0);
+        }
 
-        tSlice<int> left = SliceCast<int>(Linearize(arena, {}, MidMarker));
-        DOCTEST_CHECK(left.len == 3);
-        DOCTEST_CHECK(left[0] == 1);
-        DOCTEST_CHECK(left[1] == 2);
-        DOCTEST_CHECK(left[2] == 3);
+        ClearAllocation(expected);
+        ClearAllocation(sort);
+        ClearAllocation(output);
+        ClearAllocation(runs);
+    }
 
-        tSlice<int> right = SliceCast<int>(Linearize(arena, MidMarker, end_marker));
-        DOCTEST_CHECK(right.len == 4);
-        DOCTEST_CHECK(right[0] == 4);
-        DOCTEST_CHECK(right[1] == 5);
-        DOCTEST_CHECK(right[2] == 6);
-        DOCTEST_CHECK(right[3] == 7);
+    DOCTEST_TEST_CASE("Sort") {
+        tAllocator a = GetLibcAllocator();
+        tArray<uint32_t> items{a};
+        uint64_t state = 5;
+        for(int index = 0; index < 100000; ++index) {
+            Push(items, mtb_test::NextRandom(state));
+        }
 
-        tSlice<int> All = SliceCast<int>(Linearize(arena, {}, end_marker));
-        DOCTEST_CHECK(All.len == 7);
-        DOCTEST_CHECK(All[0] == 1);
-        DOCTEST_CHECK(All[1] == 2);
-        DOCTEST_CHECK(All[2] == 3);
-        DOCTEST_CHECK(All[3] == 4);
-        DOCTEST_CHECK(All[4] == 5);
-        DOCTEST_CHECK(All[5] == 6);
-        DOCTEST_CHECK(All[6] == 7);
+        // In memory, one merge, and a few merge passes.
+        tSlice<uint32_t const> input = items.items;
+        CheckExternalSort(input, 1024 * 1024);
+        CheckExternalSort(input, 128 * 1024);
+        CheckExternalSort(input, 4096);
+        CheckExternalSort(SliceRange(input, 0, 0), 4096);
+        ClearAllocation(items);
     }
 
-#if MTB_USE_STB_SPRINTF
-    DOCTEST_TEST_CASE("printf") {
-        tArena arena{};
-        MTB_DEFER { Clear(arena, true); };
-
-        tSlice<char> str = printf_Arena(arena, "Hello world!");
-        DOCTEST_CHECK(toString(str) == "Hello world!");
+    struct tRecord {
+        uint64_t key;
+        uint32_t payload[2];
+    };
 
-        Clear(arena, false);
+    DOCTEST_TEST_CASE("Records") {
+        tAllocator a = GetLibcAllocator();
+        tArray<tRecord> items{a};
+        uint64_t state = 9;
+        for(uint32_t index = 0; index < 20000; ++index) {
+            Push(items, tRecord{mtb_test::NextRandom(state) >> 7, {index, index}});
+        }
+        auto less = [](tRecord const& x, tRecord const& y) { return x.key < y.key || (x.key == y.key && x.payload[0] < y.payload[0]); };
+        CheckExternalSort(tSlice<tRecord const>(items.items), 16 * 1024, less);
+        ClearAllocation(items);
+    }
+}
 
-        DOCTEST_SUBCASE("manual linearization") {
-            // This produces a formatted non-null-terminated string.
-            arena.min_bucket_size = 1;
-            tArenaMarker begin_marker = GetMarker(arena);
-            printf_ArenaRaw(arena, "%c", 'a');
-            printf_ArenaRaw(arena, "%c", 'b');
-            printf_ArenaRaw(arena, "%c", 'c');
-            printf_ArenaRaw(arena, "%c", 'd');
-            printf_ArenaRaw(arena, "%c", 'e');
-            printf_ArenaRaw(arena, "%c", 'f');
-            tArenaMarker end_marker = GetMarker(arena);
-            tSlice<char> linearized = SliceCast<char>(Linearize(arena, begin_marker, end_marker));
-            DOCTEST_CHECK(toString(linearized) == "abcdef");
+DOCTEST_TEST_SUITE("mtb::SortStrings") {
+    using namespace mtb;
+    using namespace mtb::literals;
+
+    DOCTEST_TEST_CASE("StringCompareLexicographic") {
+        DOCTEST_CHECK(StringCompareLexicographic("b"_s, "ab"_s) > 0);
+        DOCTEST_CHECK(StringCompare("b"_s, "ab"_s) < 0);
+        DOCTEST_CHECK(StringCompareLexicographic("ab"_s, "abc"_s) < 0);
+        DOCTEST_CHECK(StringCompareLexicographic("abc"_s, "abc"_s) == 0);
+        DOCTEST_CHECK(StringCompareLexicographic("\xE0"_s, "z"_s) > 0);
+        DOCTEST_CHECK(StringCompareLexicographic(""_s, "\0"_s) < 0);
+    }
+
+    DOCTEST_TEST_CASE("Sort with LCP") {
+        tAllocator a = GetLibcAllocator();
+        constexpr int count = 3000;
+        constexpr int max_len = 12;
+        tSlice<char> chars = a.AllocArray<char>(count * max_len, kNoInit);
+        tSlice<tSlice<char const>> strings = a.AllocArray<tSlice<char const>>(count);
+        tSlice<ptrdiff_t> lcp = a.AllocArray<ptrdiff_t>(count);
+
+        // Few distinct characters, so there are lots of shared prefixes and duplicates.
+        char const alphabet[] = {'a', 'b', 'c', '\xE0'};
+        uint64_t state = 13;
+        for(int index = 0; index < count; ++index) {
+            int len = (int)(mtb_test::NextRandom(state) % max_len);
+            for(int char_index = 0; char_index < len; ++char_index) {
+                chars[index * max_len + char_index] = alphabet[mtb_test::NextRandom(state) % (index % 2 ? 2 : 4)];
+            }
+            strings[index] = {chars.ptr + index * max_len, len};
         }
 
-        DOCTEST_SUBCASE("force linearization over multiple buckets") {
-            arena.min_bucket_size = 8;
+        SortStrings(strings, lcp);
+
+        bool sorted = true;
+        bool lcp_ok = lcp[0] == 0;
+        for(int index = 1; index < count; ++index) {
+            tSlice<char const> prev = strings[index - 1];
+            tSlice<char const> str = strings[index];
+            sorted = sorted && StringCompareLexicographic(prev, str) <= 0;
+            ptrdiff_t prefix_len = 0;
+            while(prefix_len < prev.len && prefix_len < str.len && prev[prefix_len] == str[prefix_len]) {
+                ++prefix_len;
+            }
+            lcp_ok = lcp_ok && lcp[index] == prefix_len;
+        }
+        DOCTEST_CHECK(sorted);
+        DOCTEST_CHECK(lcp_ok);
 
-            char const* lipsum =
-                "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Sed cursus "
-                "hendrerit pharetra. Cras sit amet blandit arcu."
-                "Mauris tristique dapibus vulputate. Maecenas ipsum dui, porta id "
-                "felis quis, gravida dictum neque. Suspendisse id"
-                "fringilla justo. Duis volutpat lobortis magna et imperdiet. Etiam "
-                "vulputate nisl eu lacus pulvinar sodales. Mauris eu"
-                "diam nulla. Pellentesque commodo, ligula in varius eleifend, velit "
-                "metus fermentum sapien, a accumsan nisl metus vel"
-                "lorem. Aliquam ultricies nisl sed ex tincidunt semper. Ut ut turpis "
-                "eleifend, sagittis velit eu, lobortis elit. Mauris"
-                "pellentesque dignissim elit, quis suscipit ante iaculis vitae. "
-                "Aenean non gravida ex. Mauris lobortis mi massa, id"
-                "bibendum eros laoreet lobortis. Fusce nisi libero, dictum et dui "
-                "iaculis, pellentesque aliquet erat. Cras pharetra metus"
-                "nec sapien consectetur, vitae viverra sem sollicitudin. Fusce id "
-                "condimentum leo. Ut gravida sed nisi eu convallis."
-                "Nulla volutpat metus id nisi ultricies, nec gravida libero laoreet. "
-                "Vestibulum bibendum leo lorem, vitae maximus leo"
-                "luctus non. Pellentesque nec pretium risus. Integer libero neque, "
-                "molestie vel erat sit amet, euismod rutrum enim."
-                "Maecenas tincidunt magna sapien, vel iaculis est vehicula a. "
-                "Suspendisse sollicitudin purus quis magna interdum, id"
-                "bibendum tortor sollicitudin. Phasellus eget lectus feugiat, luctus "
-                "diam et, venenatis felis. Cras sit amet tellus non"
-                "est aliquam posuere. Curabitur eu aliquet arcu. Suspendisse a "
-                "sollicitudin eros. Donec ac egestas ante. Pellentesque id"
-                "pellentesque turpis. Pellentesque lobortis vel elit fringilla "
-                "scelerisque. Donec eu posuere lacus, vitae iaculis metus."
-                "Aliquam eleifend facilisis quam, et fringilla nisl ornare "
-                "facilisis. Phasellus in massa ac risus posuere maximus."
-                "Vestibulum id velit id quam eleifend fermentum. Interdum et "
-                "malesuada fames ac ante ipsum primis in faucibus. Integer eu"
-                "rutrum est. Curabitur non risus non felis dictum scelerisque. "
-                "Maecenas id rutrum dolor, in sagittis mauris. Donec id"
-                "nunc vel nisl volutpat vulputate nec sed leo. Suspendisse potenti. "
-                "Integer cursus, ante eu ullamcorper imperdiet, orci"
-                "metus porta ligula, at mollis est urna quis massa. Mauris faucibus "
-                "placerat purus in volutpat. Etiam lacinia non tellus"
-                "at iaculis. Maecenas bibendum odio volutpat varius fermentum. Sed "
-                "libero massa, semper eget scelerisque a, sodales vel"
-                "felis. Integer sodales augue eu felis hendrerit, ac malesuada felis "
-                "auctor. In hac habitasse platea dictumst. Phasellus"
-                "maximus eu magna id pellentesque. Fusce quis tempus lacus. "
-                "Suspendisse luctus suscipit lacus euismod viverra. Morbi"
-                "consequat nec felis id blandit. Morbi nec felis turpis. Cras ornare "
-                "enim leo, sed convallis lectus elementum vel. Cras"
-                "luctus augue finibus nibh varius consectetur. Quisque elementum, "
-                "velit quis egestas tempus, sapien magna faucibus odio,"
-                "ac tincidunt odio mauris in erat.";
+        a.FreeArray(lcp);
+        a.FreeArray(strings);
+        a.FreeArray(chars);
+    }
 
-            tSlice<char> result = printf_Arena(arena, "%s", lipsum);
-            DOCTEST_CHECK(toString(result) == lipsum);
-        }
+    DOCTEST_TEST_CASE("Wide strings") {
+        tSlice<wchar_t const> strings[] = {ConstZ(L"pear"), ConstZ(L"peach"), ConstZ(L"apple"), ConstZ(L"pea"), ConstZ(L""), ConstZ(L"peach")};
+        SortStrings(ArraySlice(strings));
+        DOCTEST_CHECK(StringsAreEqual(strings[0], ConstZ(L"")));
+        DOCTEST_CHECK(StringsAreEqual(strings[1], ConstZ(L"apple")));
+        DOCTEST_CHECK(StringsAreEqual(strings[2], ConstZ(L"pea")));
+        DOCTEST_CHECK(StringsAreEqual(strings[3], ConstZ(L"peach")));
+        DOCTEST_CHECK(StringsAreEqual(strings[4], ConstZ(L"peach")));
+        DOCTEST_CHECK(StringsAreEqual(strings[5], ConstZ(L"pear")));
     }
-#endif  // MTB_USE_STB_SPRINTF
 }
 
 #endif  // MTB_TESTS
@@ -3928,6 +10817,7 @@ DOCTEST_TEST_SUITE("mtb::tArena_SKIP") {
     </Type>
 
     <Type Name="::mtb::tMap &lt; * &gt;">
+        <AlternativeType Name="::mtb::tPolicyMap &lt; * &gt;"/>
         <DisplayString>count={count}</DisplayString>
         <Expand>
             <item Name="cap">cap</item>
@@ -3961,7 +10851,7 @@ DOCTEST_TEST_SUITE("mtb::tArena_SKIP") {
             <CustomListItems MaxItemsPerView="512">
                 <Variable Name="index" InitialValue="0"/>
                 <Loop Condition="index &lt; cap">
-                    <If Condition="Slots[index].State == 1">
+                    <If Condition="(Slots[index].State &amp; 0x80) != 0">
                         <item Name="{Keys[index]}">Values[index]</item>
                     </If>
                     <Exec>++index</Exec>
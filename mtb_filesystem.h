@@ -148,6 +148,38 @@ typedef struct mfs_FileIterator {
     void* internals;
 } mfs_FileIterator;
 
+typedef enum mfs_MapMode {
+    /* Map an existing file. The mapping may not be written to. */
+    mfs_MapMode_Read,
+    /* Create or overwrite a file of the requested size and map it for reading and writing. */
+    mfs_MapMode_CreateReadWrite,
+} mfs_MapMode;
+
+typedef struct mfs_MappedFile {
+    mfs_Error error;
+    uint8_t* data;
+    size_t size;
+    mfs_MapMode mode;
+
+    /* Backend-specific handles. */
+    uintptr_t os_handles[2];
+} mfs_MappedFile;
+
+typedef enum mfs_OpenMode {
+    /* Open an existing file for reading. */
+    mfs_OpenMode_Read,
+    /* Create or truncate a file and open it for reading and writing. */
+    mfs_OpenMode_CreateReadWrite,
+} mfs_OpenMode;
+
+typedef struct mfs_File {
+    mfs_Error error;
+    mfs_OpenMode mode;
+
+    /* Backend-specific handle. */
+    uintptr_t os_handle;
+} mfs_File;
+
 typedef struct mfs_Allocator {
     void* (*realloc_cb)(void* user_data, void* old_ptr, size_t old_size, size_t new_size);
     void* user_data;
@@ -303,6 +335,61 @@ MFS_FN mfs_CreateDirectoriesResult mfs_CreateDirectoriesZ(char const* path_utf8)
 MFS_FN mfs_FileIterator mfs_OpenFileIterator(mfs_String path_utf8);
 MFS_FN mfs_FileIterator mfs_OpenFileIteratorZ(char const* path_utf8);
 
+/*
+    Map a file into memory. With mfs_MapMode_Read, `size` is ignored and the
+    entire file is mapped. With mfs_MapMode_CreateReadWrite, the file is
+    created (or truncated) with `size` bytes before it is mapped.
+
+    Unlike other results, the mapping stays valid until mfs_UnmapFile, even
+    across mfs_Reset().
+*/
+MFS_FN mfs_MappedFile mfs_MapFile(mfs_String path_utf8, mfs_MapMode mode, size_t size);
+MFS_FN mfs_MappedFile mfs_MapFileZ(char const* path_utf8, mfs_MapMode mode, size_t size);
+
+/*
+    Unmap a file mapped with mfs_MapFile. Writable mappings are flushed first
+    and, if `keep_size` is non-zero, the file is truncated to `keep_size`
+    bytes afterwards.
+*/
+MFS_FN mfs_Error mfs_UnmapFile(mfs_MappedFile* mapped_file, size_t keep_size);
+
+/*
+    Open a file for positional reads and writes. Check `error` on the result.
+    The file stays open until mfs_CloseFile, even across mfs_Reset().
+*/
+MFS_FN mfs_File mfs_OpenFile(mfs_String path_utf8, mfs_OpenMode mode);
+MFS_FN mfs_File mfs_OpenFileZ(char const* path_utf8, mfs_OpenMode mode);
+
+/*
+    Read exactly `size` bytes starting at `offset`. Reading past the end of the file is an error.
+*/
+MFS_FN mfs_Error mfs_ReadFileAt(mfs_File* file, uint64_t offset, void* ptr, size_t size);
+
+/*
+    Write exactly `size` bytes starting at `offset`, growing the file if needed.
+*/
+MFS_FN mfs_Error mfs_WriteFileAt(mfs_File* file, uint64_t offset, void const* ptr, size_t size);
+
+MFS_FN void mfs_CloseFile(mfs_File* file);
+
+#if defined(MTB_INCLUDED)
+/*
+    Adapt an open file to mtb::tBlockStore, e.g. to back a spilling mtb::tArena.
+    The file must outlive the block store.
+*/
+inline ::mtb::tBlockStore mfs_FileBlockStore(mfs_File* file) {
+    ::mtb::tBlockStore result{};
+    result.user = file;
+    result.write_proc = [](void* user, uint64_t offset, ::mtb::tSlice<void const> data) {
+        return mfs_WriteFileAt((mfs_File*)user, offset, data.ptr, (size_t)data.len).code == mfs_ErrorCode_None;
+    };
+    result.read_proc = [](void* user, uint64_t offset, ::mtb::tSlice<void> data) {
+        return mfs_ReadFileAt((mfs_File*)user, offset, data.ptr, (size_t)data.len).code == mfs_ErrorCode_None;
+    };
+    return result;
+}
+#endif
+
 /*
     Close the given file iterator.
  */
@@ -405,7 +492,7 @@ static mfs_Error mfs_NoError() {
 }
 
 // ReSharper disable once CppDefaultInitializationWithNoUserConstructor
-static const mfs_Allocator mfs__no_allocator;
+static const mfs_Allocator mfs__no_allocator = MFS_ZERO_INIT();
 
 static void* mfs__LibcReallocProc(void* user_data, void* old_ptr, size_t old_size, size_t new_size) {
     (void)user_data;
@@ -422,7 +509,7 @@ typedef struct mfs__Arena {
 
 static const size_t arena_header_size = sizeof(mfs__Arena);
 
-static mfs__Arena* mfs__EmbedArena(void* ptr, size_t size, size_t fill) {
+static inline mfs__Arena* mfs__EmbedArena(void* ptr, size_t size, size_t fill) {
     MFS_ASSERT(size >= arena_header_size);
     mfs__Arena* arena = (mfs__Arena*)ptr;
     arena->ptr = (uint8_t*)ptr + arena_header_size;
@@ -604,6 +691,20 @@ static ptrdiff_t mfs__TrimTrailingDirSeparators(char const* ptr, ptrdiff_t len)
 #if MFS__POSIX
 #include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>     // errno
+#include <fcntl.h>     // open
+#include <sys/mman.h>  // mmap, munmap, msync
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // close, ftruncate, pread, pwrite
+
+/* Strict C modes (e.g. -std=c99) only declare these if a feature test macro was defined before the first system header
+   of the translation unit, which this file can't control. Repeating a declaration is harmless in C, and C++ compilers
+   declare them anyway. */
+#if !defined(__cplusplus)
+int ftruncate(int fd, off_t length);
+ssize_t pread(int fd, void* buf, size_t count, off_t offset);
+ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset);
+#endif
 
 static mfs_EntireFile mfs__posix_ReadEntireFile(mfs_String path_utf8) {
     mfs_EntireFile result = MFS_ZERO_INIT();
@@ -622,9 +723,8 @@ static mfs_EntireFile mfs__posix_ReadEntireFile(mfs_String path_utf8) {
     mfs__state.buf[path_utf8.len] = 0;
     char const* file_name_z = (char const*)&mfs__state.buf[0];
 
-    FILE* file;
-    errno_t file_error = fopen_s(&file, file_name_z, "rb");
-    if(file_error != 0) {
+    FILE* file = fopen(file_name_z, "rb");
+    if(!file) {
         result.error = MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "ReadEntireFile: Unable to open file.");
         return result;
     }
@@ -664,6 +764,156 @@ static mfs_EntireFile mfs__posix_ReadEntireFile(mfs_String path_utf8) {
     return result;
 }
 
+/*
+    Copy the given path into the internal buffer so it can be passed to APIs that expect null-terminated strings.
+    Returns NULL and sets `out_error` if the path is not usable.
+*/
+static char const* mfs__posix_PathZ(mfs_String path_utf8, mfs_Error* out_error) {
+    if(!path_utf8.len) {
+        *out_error = MFS_MAKE_ERROR(mfs_ErrorCode_InvalidFileName, "The given file name is empty.");
+        return NULL;
+    }
+
+    if(path_utf8.len > MFS__FILE_NAME_LIMIT) {
+        *out_error = MFS_MAKE_ERROR(mfs_ErrorCode_InvalidFileName, "The given file name is too large (must be <= " MFS__STRINGIFY(MFS__FILE_NAME_LIMIT) ").");
+        return NULL;
+    }
+
+    memcpy(&mfs__state.buf[0], path_utf8.ptr, path_utf8.len);
+    mfs__state.buf[path_utf8.len] = 0;
+    return (char const*)&mfs__state.buf[0];
+}
+
+static mfs_MappedFile mfs__posix_MapFile(mfs_String path_utf8, mfs_MapMode mode, size_t size) {
+    mfs_MappedFile result = MFS_ZERO_INIT();
+    result.mode = mode;
+
+    char const* file_name_z = mfs__posix_PathZ(path_utf8, &result.error);
+    if(!file_name_z) {
+        return result;
+    }
+
+    bool writable = mode == mfs_MapMode_CreateReadWrite;
+    int fd = open(file_name_z, writable ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDONLY, 0644);
+    if(fd < 0) {
+        mfs_ErrorCode code = errno == ENOENT ? mfs_ErrorCode_NotFound : errno == EACCES ? mfs_ErrorCode_PermissionDenied : mfs_ErrorCode_Unkown;
+        result.error = MFS_MAKE_ERROR(code, "MapFile: Unable to open file.");
+        return result;
+    }
+
+    if(writable) {
+        if(ftruncate(fd, (off_t)size) != 0) {
+            result.error = MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "MapFile: Unable to set the file size.");
+            close(fd);
+            return result;
+        }
+    } else {
+        struct stat file_stat;
+        if(fstat(fd, &file_stat) != 0) {
+            result.error = MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "MapFile: Unable to determine file size.");
+            close(fd);
+            return result;
+        }
+        size = (size_t)file_stat.st_size;
+    }
+
+    /* Empty files can not be mapped. The result is a valid mapping of size zero. */
+    if(size) {
+        void* ptr = mmap(NULL, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+        if(ptr == MAP_FAILED) {
+            result.error = MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "MapFile: Unable to map file.");
+            close(fd);
+            return result;
+        }
+        result.data = (uint8_t*)ptr;
+    }
+
+    result.size = size;
+    result.os_handles[0] = (uintptr_t)fd;
+    return result;
+}
+
+static mfs_Error mfs__posix_UnmapFile(mfs_MappedFile* mapped_file, size_t keep_size) {
+    mfs_Error result = mfs_NoError();
+    bool writable = mapped_file->mode == mfs_MapMode_CreateReadWrite;
+    int fd = (int)mapped_file->os_handles[0];
+
+    if(mapped_file->data) {
+        if(writable && msync(mapped_file->data, mapped_file->size, MS_SYNC) != 0) {
+            result = MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "UnmapFile: Unable to flush mapped memory.");
+        }
+        munmap(mapped_file->data, mapped_file->size);
+    }
+
+    if(writable && keep_size && ftruncate(fd, (off_t)keep_size) != 0 && !result.code) {
+        result = MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "UnmapFile: Unable to truncate file.");
+    }
+
+    close(fd);
+    return result;
+}
+
+static mfs_File mfs__posix_OpenFile(mfs_String path_utf8, mfs_OpenMode mode) {
+    mfs_File result = MFS_ZERO_INIT();
+    result.mode = mode;
+
+    char const* file_name_z = mfs__posix_PathZ(path_utf8, &result.error);
+    if(!file_name_z) {
+        return result;
+    }
+
+    bool writable = mode == mfs_OpenMode_CreateReadWrite;
+    int fd = open(file_name_z, writable ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDONLY, 0644);
+    if(fd < 0) {
+        mfs_ErrorCode code = errno == ENOENT ? mfs_ErrorCode_NotFound : errno == EACCES ? mfs_ErrorCode_PermissionDenied : mfs_ErrorCode_Unkown;
+        result.error = MFS_MAKE_ERROR(code, "OpenFile: Unable to open file.");
+        return result;
+    }
+
+    result.os_handle = (uintptr_t)fd;
+    return result;
+}
+
+static mfs_Error mfs__posix_ReadFileAt(mfs_File* file, uint64_t offset, void* ptr, size_t size) {
+    int fd = (int)file->os_handle;
+    uint8_t* cursor = (uint8_t*)ptr;
+    while(size) {
+        ssize_t num_read = pread(fd, cursor, size, (off_t)offset);
+        if(num_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if(num_read <= 0) {
+            return MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "ReadFileAt: Unable to read file.");
+        }
+        cursor += num_read;
+        offset += (uint64_t)num_read;
+        size -= (size_t)num_read;
+    }
+    return mfs_NoError();
+}
+
+static mfs_Error mfs__posix_WriteFileAt(mfs_File* file, uint64_t offset, void const* ptr, size_t size) {
+    int fd = (int)file->os_handle;
+    uint8_t const* cursor = (uint8_t const*)ptr;
+    while(size) {
+        ssize_t num_written = pwrite(fd, cursor, size, (off_t)offset);
+        if(num_written < 0 && errno == EINTR) {
+            continue;
+        }
+        if(num_written <= 0) {
+            return MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "WriteFileAt: Unable to write file.");
+        }
+        cursor += num_written;
+        offset += (uint64_t)num_written;
+        size -= (size_t)num_written;
+    }
+    return mfs_NoError();
+}
+
+static void mfs__posix_CloseFile(mfs_File* file) {
+    close((int)file->os_handle);
+}
+
 static mfs_CreateDirectoriesResult mfs__posix_CreateDirectories(mfs_String path_utf8) {
     mfs_CreateDirectoriesResult result = MFS_ZERO_INIT();
     result.error = MFS_MAKE_ERROR(mfs_ErrorCode_InvalidOperation, "NOT IMPLEMENTED");
@@ -676,6 +926,19 @@ static mfs_FileIterator mfs__posix_OpenFileIterator(mfs_String path_utf8) {
     return result;
 }
 
+static void mfs__posix_CloseFileIterator(mfs_FileIterator* iter) {
+}
+
+static bool mfs__posix_AdvanceFileIterator(mfs_FileIterator* iter) {
+    return false;
+}
+
+static mfs_ResolvedPath mfs__posix_ResolvePath(mfs_String path_utf8) {
+    mfs_ResolvedPath result = MFS_ZERO_INIT();
+    result.error = MFS_MAKE_ERROR(mfs_ErrorCode_InvalidOperation, "NOT IMPLEMENTED");
+    return result;
+}
+
 #endif  // MFS__POSIX
 
 /*
@@ -896,6 +1159,179 @@ static mfs_EntireFile mfs__win32_ReadEntireFile(mfs_String path_utf8) {
     return result;
 }
 
+static mfs_MappedFile mfs__win32_MapFile(mfs_String path_utf8, mfs_MapMode mode, size_t size) {
+    mfs_MappedFile result = MFS_ZERO_INIT();
+    result.mode = mode;
+
+    if(!mfs__state.ready) {
+        result.error = MFS_MAKE_ERROR(mfs_ErrorCode_InvalidOperation, "Not initialized. Did you forget to call mfs_Setup?");
+        return result;
+    }
+
+    mfs__Arena* temp_arena = mfs__EmbedArena(mfs__state.buf, sizeof(mfs__state.buf), 0);
+    mfs__win32_WideStringResult path_win32 = mfs__win32_ConvertToWideString(&temp_arena, mfs__no_allocator, path_utf8.ptr, path_utf8.len);
+    if(path_win32.error.code) {
+        result.error = path_win32.error;
+        return result;
+    }
+
+    bool writable = mode == mfs_MapMode_CreateReadWrite;
+    HANDLE file = CreateFileW(
+        path_win32.ptr,                                          // [in]           LPCWSTR               lpFileName,
+        writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,  // [in]           DWORD                 dwDesiredAccess,
+        FILE_SHARE_READ,                                         // [in]           DWORD                 dwShareMode,
+        NULL,                                                    // [in, optional] LPSECURITY_ATTRIBUTES lpSecurityAttributes,
+        writable ? CREATE_ALWAYS : OPEN_EXISTING,                // [in]           DWORD                 dwCreationDisposition,
+        0,                                                       // [in]           DWORD                 dwFlagsAndAttributes,
+        NULL                                                     // [in, optional] HANDLE                hTemplateFile
+    );
+    if(file == INVALID_HANDLE_VALUE) {
+        result.error = MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "MapFile: Unable to open file.");
+        return result;
+    }
+
+    if(!writable) {
+        LARGE_INTEGER file_size;
+        if(!GetFileSizeEx(file, &file_size)) {
+            result.error = MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "MapFile: Unable to determine file size.");
+            CloseHandle(file);
+            return result;
+        }
+        size = (size_t)file_size.QuadPart;
+    }
+
+    /* Empty files can not be mapped. The result is a valid mapping of size zero. */
+    HANDLE mapping = NULL;
+    if(size) {
+        LARGE_INTEGER mapping_size;
+        mapping_size.QuadPart = (LONGLONG)size;
+        mapping = CreateFileMappingW(file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, (DWORD)mapping_size.HighPart, mapping_size.LowPart, NULL);
+        if(!mapping) {
+            result.error = MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "MapFile: Unable to create file mapping.");
+            CloseHandle(file);
+            return result;
+        }
+
+        void* ptr = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+        if(!ptr) {
+            result.error = MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "MapFile: Unable to map view of file.");
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return result;
+        }
+        result.data = (uint8_t*)ptr;
+    }
+
+    result.size = size;
+    result.os_handles[0] = (uintptr_t)file;
+    result.os_handles[1] = (uintptr_t)mapping;
+    return result;
+}
+
+static mfs_Error mfs__win32_UnmapFile(mfs_MappedFile* mapped_file, size_t keep_size) {
+    mfs_Error result = mfs_NoError();
+    bool writable = mapped_file->mode == mfs_MapMode_CreateReadWrite;
+    HANDLE file = (HANDLE)mapped_file->os_handles[0];
+    HANDLE mapping = (HANDLE)mapped_file->os_handles[1];
+
+    if(mapped_file->data) {
+        if(writable && !FlushViewOfFile(mapped_file->data, 0)) {
+            result = MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "UnmapFile: Unable to flush mapped memory.");
+        }
+        UnmapViewOfFile(mapped_file->data);
+    }
+
+    if(mapping) {
+        CloseHandle(mapping);
+    }
+
+    if(writable && keep_size) {
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)keep_size;
+        if((!SetFilePointerEx(file, end, NULL, FILE_BEGIN) || !SetEndOfFile(file)) && !result.code) {
+            result = MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "UnmapFile: Unable to truncate file.");
+        }
+    }
+
+    CloseHandle(file);
+    return result;
+}
+
+static mfs_File mfs__win32_OpenFile(mfs_String path_utf8, mfs_OpenMode mode) {
+    mfs_File result = MFS_ZERO_INIT();
+    result.mode = mode;
+
+    if(!mfs__state.ready) {
+        result.error = MFS_MAKE_ERROR(mfs_ErrorCode_InvalidOperation, "Not initialized. Did you forget to call mfs_Setup?");
+        return result;
+    }
+
+    mfs__Arena* temp_arena = mfs__EmbedArena(mfs__state.buf, sizeof(mfs__state.buf), 0);
+    mfs__win32_WideStringResult path_win32 = mfs__win32_ConvertToWideString(&temp_arena, mfs__no_allocator, path_utf8.ptr, path_utf8.len);
+    if(path_win32.error.code) {
+        result.error = path_win32.error;
+        return result;
+    }
+
+    bool writable = mode == mfs_OpenMode_CreateReadWrite;
+    HANDLE file = CreateFileW(
+        path_win32.ptr,                                          // [in]           LPCWSTR               lpFileName,
+        writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,  // [in]           DWORD                 dwDesiredAccess,
+        FILE_SHARE_READ,                                         // [in]           DWORD                 dwShareMode,
+        NULL,                                                    // [in, optional] LPSECURITY_ATTRIBUTES lpSecurityAttributes,
+        writable ? CREATE_ALWAYS : OPEN_EXISTING,                // [in]           DWORD                 dwCreationDisposition,
+        FILE_ATTRIBUTE_NORMAL,                                   // [in]           DWORD                 dwFlagsAndAttributes,
+        NULL                                                     // [in, optional] HANDLE                hTemplateFile
+    );
+    if(file == INVALID_HANDLE_VALUE) {
+        result.error = MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "OpenFile: Unable to open file.");
+        return result;
+    }
+
+    result.os_handle = (uintptr_t)file;
+    return result;
+}
+
+static mfs_Error mfs__win32_ReadFileAt(mfs_File* file, uint64_t offset, void* ptr, size_t size) {
+    uint8_t* cursor = (uint8_t*)ptr;
+    while(size) {
+        DWORD chunk_size = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+        OVERLAPPED overlapped = MFS_ZERO_INIT();
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD num_read = 0;
+        if(!ReadFile((HANDLE)file->os_handle, cursor, chunk_size, &num_read, &overlapped) || num_read == 0) {
+            return MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "ReadFileAt: Unable to read file.");
+        }
+        cursor += num_read;
+        offset += num_read;
+        size -= num_read;
+    }
+    return mfs_NoError();
+}
+
+static mfs_Error mfs__win32_WriteFileAt(mfs_File* file, uint64_t offset, void const* ptr, size_t size) {
+    uint8_t const* cursor = (uint8_t const*)ptr;
+    while(size) {
+        DWORD chunk_size = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+        OVERLAPPED overlapped = MFS_ZERO_INIT();
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD num_written = 0;
+        if(!WriteFile((HANDLE)file->os_handle, cursor, chunk_size, &num_written, &overlapped) || num_written == 0) {
+            return MFS_MAKE_ERROR(mfs_ErrorCode_Unkown, "WriteFileAt: Unable to write file.");
+        }
+        cursor += num_written;
+        offset += num_written;
+        size -= num_written;
+    }
+    return mfs_NoError();
+}
+
+static void mfs__win32_CloseFile(mfs_File* file) {
+    CloseHandle((HANDLE)file->os_handle);
+}
+
 static mfs_CreateDirectoriesResult mfs__win32_CreateDirectories(mfs_String path_utf8) {
     mfs_CreateDirectoriesResult result = MFS_ZERO_INIT();
 
@@ -1212,7 +1648,7 @@ MFS_FN mfs_String mfs_Drive(mfs_String path) {
 }
 
 MFS_FN mfs_String mfs_DriveZ(char const* path_cstr) {
-    return mfs_Drive(mfs_String(path_cstr));
+    return mfs_Drive(mfs_StringZ(path_cstr));
 }
 
 MFS_FN mfs_String mfs_Root(mfs_String path) {
@@ -1227,7 +1663,7 @@ MFS_FN mfs_String mfs_Root(mfs_String path) {
 }
 
 MFS_FN mfs_String mfs_RootZ(char const* path_cstr) {
-    return mfs_Root(mfs_String(path_cstr));
+    return mfs_Root(mfs_StringZ(path_cstr));
 }
 
 MFS_FN mfs_String mfs_Anchor(mfs_String path) {
@@ -1240,7 +1676,7 @@ MFS_FN mfs_String mfs_Anchor(mfs_String path) {
 }
 
 MFS_FN mfs_String mfs_AnchorZ(char const* path_cstr) {
-    return mfs_Anchor(mfs_String(path_cstr));
+    return mfs_Anchor(mfs_StringZ(path_cstr));
 }
 
 MFS_FN mfs_String mfs_DirName(mfs_String path) {
@@ -1258,7 +1694,7 @@ MFS_FN mfs_String mfs_DirName(mfs_String path) {
 }
 
 MFS_FN mfs_String mfs_DirNameZ(char const* path_cstr) {
-    return mfs_DirName(mfs_String(path_cstr));
+    return mfs_DirName(mfs_StringZ(path_cstr));
 }
 
 MFS_FN mfs_String mfs_BaseName(mfs_String path) {
@@ -1277,7 +1713,7 @@ MFS_FN mfs_String mfs_BaseName(mfs_String path) {
 }
 
 MFS_FN mfs_String mfs_BaseNameZ(char const* path_cstr) {
-    return mfs_BaseName(mfs_String(path_cstr));
+    return mfs_BaseName(mfs_StringZ(path_cstr));
 }
 
 MFS_FN mfs_String mfs_Suffix(mfs_String path) {
@@ -1303,7 +1739,7 @@ MFS_FN mfs_String mfs_Suffix(mfs_String path) {
 }
 
 MFS_FN mfs_String mfs_SuffixZ(char const* path_cstr) {
-    return mfs_Suffix(mfs_String(path_cstr));
+    return mfs_Suffix(mfs_StringZ(path_cstr));
 }
 
 MFS_FN mfs_String mfs_BaseNameWithoutSuffix(mfs_String path) {
@@ -1315,7 +1751,7 @@ MFS_FN mfs_String mfs_BaseNameWithoutSuffix(mfs_String path) {
 }
 
 MFS_FN mfs_String mfs_BaseNameWithoutSuffixZ(char const* path_cstr) {
-    return mfs_BaseNameWithoutSuffix(mfs_String(path_cstr));
+    return mfs_BaseNameWithoutSuffix(mfs_StringZ(path_cstr));
 }
 
 MFS_FN mfs_String mfs_WithoutSuffix(mfs_String path) {
@@ -1326,7 +1762,7 @@ MFS_FN mfs_String mfs_WithoutSuffix(mfs_String path) {
 }
 
 MFS_FN mfs_String mfs_WithoutSuffixZ(char const* path_cstr) {
-    return mfs_WithoutSuffix(mfs_String(path_cstr));
+    return mfs_WithoutSuffix(mfs_StringZ(path_cstr));
 }
 
 mfs_ResolvedPath mfs_ResolvePath(mfs_String path_utf8) {
@@ -1377,6 +1813,82 @@ mfs_FileIterator mfs_OpenFileIteratorZ(char const* path_utf8) {
     return mfs_OpenFileIterator(mfs_StringZ(path_utf8));
 }
 
+mfs_MappedFile mfs_MapFile(mfs_String path_utf8, mfs_MapMode mode, size_t size) {
+#if MFS__POSIX
+    return mfs__posix_MapFile(path_utf8, mode, size);
+#elif MFS__WIN32
+    return mfs__win32_MapFile(path_utf8, mode, size);
+#endif
+}
+
+mfs_MappedFile mfs_MapFileZ(char const* path_utf8, mfs_MapMode mode, size_t size) {
+    return mfs_MapFile(mfs_StringZ(path_utf8), mode, size);
+}
+
+mfs_Error mfs_UnmapFile(mfs_MappedFile* mapped_file, size_t keep_size) {
+    MFS_ASSERT(mapped_file);
+    if(!mapped_file || mapped_file->error.code) {
+        return MFS_MAKE_ERROR(mfs_ErrorCode_InvalidOperation, "UnmapFile: Not a valid mapping.");
+    }
+#if MFS__POSIX
+    mfs_Error result = mfs__posix_UnmapFile(mapped_file, keep_size);
+#elif MFS__WIN32
+    mfs_Error result = mfs__win32_UnmapFile(mapped_file, keep_size);
+#endif
+    mfs_MappedFile empty = MFS_ZERO_INIT();
+    *mapped_file = empty;
+    return result;
+}
+
+mfs_File mfs_OpenFile(mfs_String path_utf8, mfs_OpenMode mode) {
+#if MFS__POSIX
+    return mfs__posix_OpenFile(path_utf8, mode);
+#elif MFS__WIN32
+    return mfs__win32_OpenFile(path_utf8, mode);
+#endif
+}
+
+mfs_File mfs_OpenFileZ(char const* path_utf8, mfs_OpenMode mode) {
+    return mfs_OpenFile(mfs_StringZ(path_utf8), mode);
+}
+
+mfs_Error mfs_ReadFileAt(mfs_File* file, uint64_t offset, void* ptr, size_t size) {
+    MFS_ASSERT(file);
+    if(file->error.code) {
+        return MFS_MAKE_ERROR(mfs_ErrorCode_InvalidOperation, "ReadFileAt: Not a valid file.");
+    }
+#if MFS__POSIX
+    return mfs__posix_ReadFileAt(file, offset, ptr, size);
+#elif MFS__WIN32
+    return mfs__win32_ReadFileAt(file, offset, ptr, size);
+#endif
+}
+
+mfs_Error mfs_WriteFileAt(mfs_File* file, uint64_t offset, void const* ptr, size_t size) {
+    MFS_ASSERT(file);
+    if(file->error.code || file->mode != mfs_OpenMode_CreateReadWrite) {
+        return MFS_MAKE_ERROR(mfs_ErrorCode_InvalidOperation, "WriteFileAt: Not a writable file.");
+    }
+#if MFS__POSIX
+    return mfs__posix_WriteFileAt(file, offset, ptr, size);
+#elif MFS__WIN32
+    return mfs__win32_WriteFileAt(file, offset, ptr, size);
+#endif
+}
+
+void mfs_CloseFile(mfs_File* file) {
+    MFS_ASSERT(file);
+    if(!file->error.code) {
+#if MFS__POSIX
+        mfs__posix_CloseFile(file);
+#elif MFS__WIN32
+        mfs__win32_CloseFile(file);
+#endif
+    }
+    mfs_File empty = MFS_ZERO_INIT();
+    *file = empty;
+}
+
 void mfs_CloseFileIterator(mfs_FileIterator* iter) {
 #if MFS__POSIX
     return mfs__posix_CloseFileIterator(iter);
@@ -1397,4 +1909,170 @@ bool mfs_AdvanceFileIterator(mfs_FileIterator* iter) {
 #endif
 }
 
+#if defined(MTB_INCLUDED) && MTB_TESTS
+DOCTEST_TEST_SUITE("mfs") {
+    using namespace mtb;
+
+    /// mfs_Reset keeps the setup, and mfs_Setup may only be called once.
+    void SetupOnce() {
+        if(!mfs__state.ready) {
+            mfs_SetupDesc setup_desc = MFS_ZERO_INIT();
+            mfs_Setup(&setup_desc);
+        }
+    }
+
+    struct tNode {
+        int value;
+        tRelPtr<tNode> next;
+    };
+
+    DOCTEST_TEST_CASE("Arena snapshot through a mapped file") {
+        char const* path = "mfs_test_snapshot.tmp";
+        SetupOnce();
+
+        mfs_MappedFile write_file = mfs_MapFileZ(path, mfs_MapMode_CreateReadWrite, 4096);
+        DOCTEST_REQUIRE(write_file.error.code == mfs_ErrorCode_None);
+        DOCTEST_REQUIRE(write_file.size == 4096);
+
+        tArena arena = BeginArenaSnapshot(PtrSlice((void*)write_file.data, (ptrdiff_t)write_file.size));
+        tNode* head = nullptr;
+        for(int value = 100; value > 0; --value) {
+            tNode& node = PushOne<tNode>(arena);
+            node.value = value;
+            node.next = head;
+            head = &node;
+        }
+        tSlice<void> used = FinishArenaSnapshot(arena, head, 7);
+        DOCTEST_REQUIRE(used.len > 0);
+        DOCTEST_CHECK(mfs_UnmapFile(&write_file, (size_t)used.len).code == mfs_ErrorCode_None);
+
+        mfs_MappedFile read_file = mfs_MapFileZ(path, mfs_MapMode_Read, 0);
+        DOCTEST_REQUIRE(read_file.error.code == mfs_ErrorCode_None);
+        DOCTEST_CHECK(read_file.size == (size_t)used.len);
+        tArenaSnapshot snapshot = OpenArenaSnapshot(PtrSlice((void const*)read_file.data, (ptrdiff_t)read_file.size), 7);
+        DOCTEST_REQUIRE(snapshot.is_valid);
+        int expected = 1;
+        for(tNode const* node = SnapshotRoot<tNode>(snapshot); node; node = node->next.Get()) {
+            expected += node->value == expected;
+        }
+        DOCTEST_CHECK(expected == 101);
+        DOCTEST_CHECK(mfs_UnmapFile(&read_file, 0).code == mfs_ErrorCode_None);
+
+        DOCTEST_CHECK(mfs_MapFileZ("mfs_test_does_not_exist.tmp", mfs_MapMode_Read, 0).error.code != mfs_ErrorCode_None);
+        remove(path);
+        mfs_Reset();
+    }
+
+    DOCTEST_TEST_CASE("Positional reads and writes") {
+        char const* path = "mfs_test_file.tmp";
+        SetupOnce();
+
+        mfs_File file = mfs_OpenFileZ(path, mfs_OpenMode_CreateReadWrite);
+        DOCTEST_REQUIRE(file.error.code == mfs_ErrorCode_None);
+        char const tail[] = "tail";
+        char const head[] = "head";
+        DOCTEST_CHECK(mfs_WriteFileAt(&file, 100, tail, 4).code == mfs_ErrorCode_None);
+        DOCTEST_CHECK(mfs_WriteFileAt(&file, 0, head, 4).code == mfs_ErrorCode_None);
+
+        char buffer[4];
+        DOCTEST_CHECK(mfs_ReadFileAt(&file, 100, buffer, 4).code == mfs_ErrorCode_None);
+        DOCTEST_CHECK(memcmp(buffer, tail, 4) == 0);
+        DOCTEST_CHECK(mfs_ReadFileAt(&file, 0, buffer, 4).code == mfs_ErrorCode_None);
+        DOCTEST_CHECK(memcmp(buffer, head, 4) == 0);
+        DOCTEST_CHECK(mfs_ReadFileAt(&file, 102, buffer, 4).code != mfs_ErrorCode_None);
+        mfs_CloseFile(&file);
+
+        mfs_File reopened = mfs_OpenFileZ(path, mfs_OpenMode_Read);
+        DOCTEST_REQUIRE(reopened.error.code == mfs_ErrorCode_None);
+        DOCTEST_CHECK(mfs_ReadFileAt(&reopened, 100, buffer, 4).code == mfs_ErrorCode_None);
+        DOCTEST_CHECK(memcmp(buffer, tail, 4) == 0);
+        mfs_CloseFile(&reopened);
+
+        remove(path);
+        mfs_Reset();
+    }
+
+    DOCTEST_TEST_CASE("Spilling arena backed by a file") {
+        char const* path = "mfs_test_spill.tmp";
+        SetupOnce();
+
+        mfs_File file = mfs_OpenFileZ(path, mfs_OpenMode_CreateReadWrite);
+        DOCTEST_REQUIRE(file.error.code == mfs_ErrorCode_None);
+
+        tArenaSpill spill{};
+        spill.store = mfs_FileBlockStore(&file);
+        spill.resident_budget = 2048;
+
+        tArena arena{};
+        arena.child_allocator = GetLibcAllocator();
+        arena.min_bucket_size = 1024;
+        arena.spill = &spill;
+
+        tArenaMarker begin = GetMarker(arena);
+        for(int index = 0; index < 4096; ++index) {
+            (void)PushCopy(arena, index);
+        }
+        tArenaMarker end = GetMarker(arena);
+        DOCTEST_CHECK(spill.spilled_size > 0);
+
+        tSlice<int> all = SliceCast<int>(Linearize(arena, begin, end));
+        DOCTEST_REQUIRE(all.len == 4096);
+        bool ok = true;
+        for(int index = 0; index < 4096; ++index) {
+            ok = ok && all[index] == index;
+        }
+        DOCTEST_CHECK(ok);
+
+        Clear(arena);
+        mfs_CloseFile(&file);
+        remove(path);
+        mfs_Reset();
+    }
+
+    DOCTEST_TEST_CASE("External sort with file-backed runs") {
+        char const* runs_path = "mfs_test_runs.tmp";
+        char const* output_path = "mfs_test_sorted.tmp";
+        SetupOnce();
+
+        mfs_File runs = mfs_OpenFileZ(runs_path, mfs_OpenMode_CreateReadWrite);
+        mfs_File output = mfs_OpenFileZ(output_path, mfs_OpenMode_CreateReadWrite);
+        DOCTEST_REQUIRE(runs.error.code == mfs_ErrorCode_None);
+        DOCTEST_REQUIRE(output.error.code == mfs_ErrorCode_None);
+
+        // The small budget makes for many runs and more than one merge pass.
+        tExternalSort<uint32_t> sort = CreateExternalSort<uint32_t>(GetLibcAllocator(), mfs_FileBlockStore(&runs), 16 * 1024);
+        uint64_t state = 3;
+        uint64_t sum_before = 0;
+        bool ok = true;
+        for(int index = 0; index < 50000; ++index) {
+            uint32_t item = mtb_test::NextRandom(state);
+            sum_before += item;
+            ok = ok && Push(sort, item);
+        }
+        DOCTEST_CHECK(ok);
+        DOCTEST_CHECK(FinishExternalSort(sort, mfs_FileBlockStore(&output)));
+        ClearAllocation(sort);
+        mfs_CloseFile(&output);
+        mfs_CloseFile(&runs);
+
+        mfs_MappedFile sorted_file = mfs_MapFileZ(output_path, mfs_MapMode_Read, 0);
+        DOCTEST_REQUIRE(sorted_file.error.code == mfs_ErrorCode_None);
+        DOCTEST_REQUIRE(sorted_file.size == 50000 * sizeof(uint32_t));
+        uint32_t const* sorted = (uint32_t const*)sorted_file.data;
+        uint64_t sum_after = sorted[0];
+        for(int index = 1; index < 50000; ++index) {
+            ok = ok && sorted[index - 1] <= sorted[index];
+            sum_after += sorted[index];
+        }
+        DOCTEST_CHECK(ok);
+        DOCTEST_CHECK(sum_before == sum_after);
+        DOCTEST_CHECK(mfs_UnmapFile(&sorted_file, sorted_file.size).code == mfs_ErrorCode_None);
+
+        remove(runs_path);
+        remove(output_path);
+        mfs_Reset();
+    }
+}
+#endif  // defined(MTB_INCLUDED) && MTB_TESTS
+
 #endif /* MFS_IMPLEMENTATION */
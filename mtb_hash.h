@@ -0,0 +1,532 @@
+/*
+ * Define MTB_HASH_IMPLEMENTATION in exactly one of your translation units that includes this header.
+ */
+
+/*
+ * Fast non-cryptographic hashing.
+ *
+ * Hash64 handles short inputs like wyhash by Wang Yi (public domain).
+ * Hosted at: https://github.com/wangyi-fudan/wyhash
+ * Long inputs are accumulated in 64-byte stripes like XXH3 by Yann Collet (BSD 2-Clause).
+ * Hosted at: https://github.com/Cyan4973/xxHash
+ * The results match neither of them.
+ *
+ * Crc32C is the Castagnoli CRC used by iSCSI, ext4, etc., computed with the crc32 instructions of SSE4.2 or ARMv8
+ * where available.
+ *
+ * Include this after mtb.h to get tMap hash functions and a CreateMap overload that picks them by key type.
+ */
+
+#if !defined(MTB__HASH_INCLUDED)
+#define MTB__HASH_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+// #Option Use SSE2 to accumulate long inputs.
+#if !defined(MTB_HASH_USE_SSE2)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MTB_HASH_USE_SSE2 1
+#else
+#define MTB_HASH_USE_SSE2 0
+#endif
+#endif
+
+// #Option Use AVX2 to accumulate long inputs.
+#if !defined(MTB_HASH_USE_AVX2)
+#if defined(__AVX2__)
+#define MTB_HASH_USE_AVX2 1
+#else
+#define MTB_HASH_USE_AVX2 0
+#endif
+#endif
+
+// #Option Use the SSE4.2 crc32 instruction for Crc32C.
+#if !defined(MTB_HASH_USE_SSE42)
+#if(defined(__SSE4_2__) || defined(__AVX__)) && (defined(__x86_64__) || defined(_M_X64))
+#define MTB_HASH_USE_SSE42 1
+#else
+#define MTB_HASH_USE_SSE42 0
+#endif
+#endif
+
+// #Option Use the ARMv8 crc32c instructions for Crc32C.
+#if !defined(MTB_HASH_USE_ARM_CRC32)
+#if defined(__ARM_FEATURE_CRC32) && defined(__aarch64__)
+#define MTB_HASH_USE_ARM_CRC32 1
+#else
+#define MTB_HASH_USE_ARM_CRC32 0
+#endif
+#endif
+
+namespace mtb {
+    /// State for hashing data that arrives in pieces. Passing the same bytes to HashUpdate, split up in any way, gives
+    /// the same result as Hash64 with the same seed.
+    struct tHashState {
+        uint64_t key[12];
+        uint64_t acc[8];
+        uint64_t seed;
+        uint64_t total_len;
+        uint64_t stripe_count;
+        size_t buffer_len;
+
+        /// The last 64 bytes that were accumulated, followed by up to 128 bytes that were not.
+        uint8_t buffer[64 + 128];
+    };
+
+    /// 64-bit hash of \a size bytes.
+    uint64_t Hash64(void const* data, size_t size, uint64_t seed = 0);
+
+    tHashState HashInit(uint64_t seed = 0);
+    void HashUpdate(tHashState& state, void const* data, size_t size);
+    uint64_t HashFinal(tHashState const& state);
+
+    /// CRC-32C of \a size bytes. Pass the result of the previous call as \a crc to continue a checksum, i.e.
+    /// Crc32C(b, nb, Crc32C(a, na)) is the checksum of a followed by b.
+    uint32_t Crc32C(void const* data, size_t size, uint32_t crc = 0);
+
+    /// Bijective mixer for 32-bit integers (lowbias32 by Chris Wellons).
+    inline uint32_t HashU32(uint32_t value) {
+        value ^= value >> 16;
+        value *= 0x7FEB352DU;
+        value ^= value >> 15;
+        value *= 0x846CA68BU;
+        value ^= value >> 16;
+        return value;
+    }
+
+    /// Bijective mixer for 64-bit integers (the SplitMix64 finalizer).
+    inline uint64_t HashU64(uint64_t value) {
+        value ^= value >> 30;
+        value *= 0xBF58476D1CE4E5B9ULL;
+        value ^= value >> 27;
+        value *= 0x94D049BB133111EBULL;
+        value ^= value >> 31;
+        return value;
+    }
+}  // namespace mtb
+
+#if defined(MTB_INCLUDED)
+namespace mtb {
+    /// tMapHashFunc for keys without padding bytes, using Hash64.
+    uint64_t MapHashBytes(void const* key, size_t key_size);
+
+    /// tMapHashFunc for integer and pointer keys of 1, 2, 4 or 8 bytes.
+    uint64_t MapHashInteger(void const* key, size_t key_size);
+
+    /// The hash function CreateMap uses for keys of type K if none is given.
+    template<typename K>
+    MTB_NODISCARD tMapHashFunc DefaultMapHashFunc() {
+        return tMapKeyIsInteger<K>::value ? MapHashInteger : MapHashBytes;
+    }
+
+    /// Create a map that hashes keys with DefaultMapHashFunc<K>() and compares them byte-wise. Keys with padding bytes
+    /// or with pointers to their actual data need their own functions.
+    template<typename K, typename V>
+    MTB_NODISCARD tMap<K, V> CreateMap(tAllocator allocator) {
+        return CreateMap<K, V>(allocator, DefaultMapHashFunc<K>(), CompareBytes);
+    }
+}  // namespace mtb
+#endif  // defined(MTB_INCLUDED)
+
+#endif  // !defined(MTB__HASH_INCLUDED)
+
+
+// ==============
+// Implementation
+// ==============
+
+#if defined(MTB_HASH_IMPLEMENTATION)
+#if !defined(MTB__HASH_IMPLEMENTED)
+#define MTB__HASH_IMPLEMENTED
+
+#include <string.h>  // memcpy
+
+#if MTB_HASH_USE_SSE2 || MTB_HASH_USE_AVX2 || MTB_HASH_USE_SSE42
+#include <immintrin.h>
+#endif
+
+#if MTB_HASH_USE_ARM_CRC32
+#include <arm_acle.h>
+#endif
+
+#if defined(_MSC_VER) && defined(_M_X64) && !defined(__SIZEOF_INT128__)
+#include <intrin.h>  // _umul128
+#endif
+
+namespace mtb {
+    namespace impl {
+        constexpr uint64_t hash_secret[12] = {
+            0x5457DA22336DA9D9ULL, 0x1053383AC7EC2C93ULL, 0x7513BDA5DD0FC8A1ULL, 0xF3CB002680986DE3ULL,
+            0xCA8B43828B863917ULL, 0xD53C68DB1D969E0FULL, 0xE042D32C3886B777ULL, 0x9E1165C60E56ECF9ULL,
+            0x41902D7745CBF51FULL, 0xECB1488CD9CF7D3DULL, 0xBB4E152C2F89A2ADULL, 0x0C91C843EC327E9DULL,
+        };
+
+        /// Inputs longer than this are accumulated in stripes.
+        constexpr size_t hash_short_max = 128;
+
+        constexpr size_t hash_stripe_len = 64;
+
+        /// The accumulators are scrambled after this many stripes, so high bits keep flowing into the low ones.
+        constexpr uint64_t hash_stripes_per_block = 16;
+
+        inline uint64_t HashRead64(uint8_t const* ptr) {
+            uint64_t result;
+            memcpy(&result, ptr, sizeof(result));
+            return result;
+        }
+
+        inline uint64_t HashRead32(uint8_t const* ptr) {
+            uint32_t result;
+            memcpy(&result, ptr, sizeof(result));
+            return result;
+        }
+
+        /// Full 64x64 -> 128 bit multiplication. \a a receives the low half, \a b the high half.
+        inline void HashMultiply(uint64_t& a, uint64_t& b) {
+#if defined(__SIZEOF_INT128__)
+            __uint128_t product = (__uint128_t)a * b;
+            a = (uint64_t)product;
+            b = (uint64_t)(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+            a = _umul128(a, b, &b);
+#else
+            uint64_t a_hi = a >> 32, a_lo = (uint32_t)a;
+            uint64_t b_hi = b >> 32, b_lo = (uint32_t)b;
+            uint64_t hi_hi = a_hi * b_hi, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, lo_lo = a_lo * b_lo;
+            uint64_t middle = hi_lo + (lo_lo >> 32) + (uint32_t)lo_hi;
+            a = (middle << 32) | (uint32_t)lo_lo;
+            b = hi_hi + (middle >> 32) + (lo_hi >> 32);
+#endif
+        }
+
+        inline uint64_t HashMix(uint64_t a, uint64_t b) {
+            HashMultiply(a, b);
+            return a ^ b;
+        }
+
+        uint64_t HashShort(uint8_t const* ptr, size_t len, uint64_t seed) {
+            uint64_t a = 0;
+            uint64_t b = 0;
+            seed ^= HashMix(seed ^ hash_secret[0], hash_secret[1]);
+            if(len <= 16) {
+                if(len >= 4) {
+                    size_t offset = (len >> 3) << 2;
+                    a = (HashRead32(ptr) << 32) | HashRead32(ptr + offset);
+                    b = (HashRead32(ptr + len - 4) << 32) | HashRead32(ptr + len - 4 - offset);
+                } else if(len > 0) {
+                    a = ((uint64_t)ptr[0] << 16) | ((uint64_t)ptr[len >> 1] << 8) | ptr[len - 1];
+                }
+            } else {
+                size_t remaining = len;
+                while(remaining > 16) {
+                    seed = HashMix(HashRead64(ptr) ^ hash_secret[1], HashRead64(ptr + 8) ^ seed);
+                    ptr += 16;
+                    remaining -= 16;
+                }
+                // The last 16 bytes, which may overlap with ones that were already mixed in.
+                a = HashRead64(ptr + remaining - 16);
+                b = HashRead64(ptr + remaining - 8);
+            }
+            a ^= hash_secret[1];
+            b ^= seed;
+            HashMultiply(a, b);
+            return HashMix(a ^ hash_secret[0] ^ len, b ^ hash_secret[1]);
+        }
+
+        /// For each 64-bit lane i: acc[i ^ 1] += data[i]; acc[i] += lo32(data[i] ^ key[i]) * hi32(data[i] ^ key[i]).
+        inline void HashAccumulateStripe(uint64_t* acc, uint8_t const* stripe, uint64_t const* key) {
+#if MTB_HASH_USE_AVX2
+            for(int lane = 0; lane < 8; lane += 4) {
+                __m256i data = _mm256_loadu_si256((__m256i const*)(stripe + lane * 8));
+                __m256i keyed = _mm256_xor_si256(data, _mm256_loadu_si256((__m256i const*)(key + lane)));
+                __m256i product = _mm256_mul_epu32(keyed, _mm256_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+                __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                __m256i sum = _mm256_add_epi64(_mm256_loadu_si256((__m256i const*)(acc + lane)), _mm256_add_epi64(product, swapped));
+                _mm256_storeu_si256((__m256i*)(acc + lane), sum);
+            }
+#elif MTB_HASH_USE_SSE2
+            for(int lane = 0; lane < 8; lane += 2) {
+                __m128i data = _mm_loadu_si128((__m128i const*)(stripe + lane * 8));
+                __m128i keyed = _mm_xor_si128(data, _mm_loadu_si128((__m128i const*)(key + lane)));
+                __m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+                __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                __m128i sum = _mm_add_epi64(_mm_loadu_si128((__m128i const*)(acc + lane)), _mm_add_epi64(product, swapped));
+                _mm_storeu_si128((__m128i*)(acc + lane), sum);
+            }
+#else
+            for(int lane = 0; lane < 8; ++lane) {
+                uint64_t data = HashRead64(stripe + lane * 8);
+                uint64_t keyed = data ^ key[lane];
+                acc[lane ^ 1] += data;
+                acc[lane] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+            }
+#endif
+        }
+
+        inline void HashScramble(uint64_t* acc, uint64_t const* key) {
+            for(int lane = 0; lane < 8; ++lane) {
+                acc[lane] = ((acc[lane] ^ (acc[lane] >> 47)) ^ key[lane]) * 0x9E3779B1U;
+            }
+        }
+
+        /// Accumulate a stripe that is followed by more input.
+        inline void HashStripe(tHashState& state, uint8_t const* stripe) {
+            HashAccumulateStripe(state.acc, stripe, state.key + (state.stripe_count & 3));
+            if(++state.stripe_count % hash_stripes_per_block == 0) {
+                HashScramble(state.acc, state.key + 4);
+            }
+        }
+
+        /// Accumulate the last 64 bytes of the input, which end at \a end, and produce the result.
+        uint64_t HashFinishLong(tHashState& state, uint8_t const* end) {
+            HashAccumulateStripe(state.acc, end - hash_stripe_len, state.key + 4);
+
+            uint64_t result = state.total_len * 0x9E3779B185EBCA87ULL;
+            for(int lane = 0; lane < 8; lane += 2) {
+                result += HashMix(state.acc[lane] ^ state.key[lane + 1], state.acc[lane + 1] ^ state.key[lane + 2]);
+            }
+            result ^= result >> 37;
+            result *= 0x165667919E3779F9ULL;
+            result ^= result >> 32;
+            return result;
+        }
+
+        struct tCrc32CTable {
+            uint32_t entries[256];
+        };
+
+        constexpr tCrc32CTable MakeCrc32CTable() {
+            tCrc32CTable result{};
+            for(uint32_t index = 0; index < 256; ++index) {
+                uint32_t crc = index;
+                for(int bit = 0; bit < 8; ++bit) {
+                    crc = crc & 1 ? (crc >> 1) ^ 0x82F63B78U : crc >> 1;
+                }
+                result.entries[index] = crc;
+            }
+            return result;
+        }
+
+        constexpr tCrc32CTable crc32c_table = MakeCrc32CTable();
+    }  // namespace impl
+}  // namespace mtb
+
+mtb::tHashState mtb::HashInit(uint64_t seed) {
+    tHashState result{};
+    result.seed = seed;
+    for(int index = 0; index < 12; ++index) {
+        result.key[index] = index & 1 ? impl::hash_secret[index] - seed : impl::hash_secret[index] + seed;
+    }
+    uint64_t const acc_init[8] = {
+        0x00000000C2B2AE3DULL, 0x9E3779B185EBCA87ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL,
+        0x85EBCA77C2B2AE63ULL, 0x0000000085EBCA77ULL, 0x27D4EB2F165667C5ULL, 0x000000009E3779B1ULL,
+    };
+    memcpy(result.acc, acc_init, sizeof(acc_init));
+    return result;
+}
+
+void mtb::HashUpdate(tHashState& state, void const* data, size_t size) {
+    uint8_t const* ptr = (uint8_t const*)data;
+    uint8_t* history = state.buffer;
+    uint8_t* pending = state.buffer + impl::hash_stripe_len;
+    state.total_len += size;
+
+    if(state.buffer_len + size <= impl::hash_short_max) {
+        memcpy(pending + state.buffer_len, ptr, size);
+        state.buffer_len += size;
+        return;
+    }
+
+    // This is a long input. Stripes are only accumulated when more input follows, because the last one is special.
+    // Top up the pending bytes to whole stripes. There is still input left after that.
+    size_t top_up = (impl::hash_stripe_len - state.buffer_len % impl::hash_stripe_len) % impl::hash_stripe_len;
+    memcpy(pending + state.buffer_len, ptr, top_up);
+    state.buffer_len += top_up;
+    ptr += top_up;
+    size -= top_up;
+    for(size_t offset = 0; offset < state.buffer_len; offset += impl::hash_stripe_len) {
+        impl::HashStripe(state, pending + offset);
+    }
+    if(state.buffer_len > 0) {
+        memcpy(history, pending + state.buffer_len - impl::hash_stripe_len, impl::hash_stripe_len);
+    }
+
+    uint8_t const* first = ptr;
+    while(size > impl::hash_stripe_len) {
+        impl::HashStripe(state, ptr);
+        ptr += impl::hash_stripe_len;
+        size -= impl::hash_stripe_len;
+    }
+    if(ptr != first) {
+        memcpy(history, ptr - impl::hash_stripe_len, impl::hash_stripe_len);
+    }
+
+    memcpy(pending, ptr, size);
+    state.buffer_len = size;
+}
+
+uint64_t mtb::HashFinal(tHashState const& state) {
+    uint8_t const* pending = state.buffer + impl::hash_stripe_len;
+    if(state.total_len <= impl::hash_short_max) {
+        return impl::HashShort(pending, (size_t)state.total_len, state.seed);
+    }
+
+    // The last stripe may reach back into the history in front of the pending bytes.
+    tHashState copy = state;
+    pending = copy.buffer + impl::hash_stripe_len;
+    size_t offset = 0;
+    while(copy.buffer_len - offset > impl::hash_stripe_len) {
+        impl::HashStripe(copy, pending + offset);
+        offset += impl::hash_stripe_len;
+    }
+    return impl::HashFinishLong(copy, pending + copy.buffer_len);
+}
+
+uint64_t mtb::Hash64(void const* data, size_t size, uint64_t seed) {
+    uint8_t const* ptr = (uint8_t const*)data;
+    if(size <= impl::hash_short_max) {
+        return impl::HashShort(ptr, size, seed);
+    }
+
+    tHashState state = HashInit(seed);
+    state.total_len = size;
+    size_t stripe_count = (size - 1) / impl::hash_stripe_len;
+    for(size_t stripe = 0; stripe < stripe_count; ++stripe) {
+        impl::HashStripe(state, ptr + stripe * impl::hash_stripe_len);
+    }
+    return impl::HashFinishLong(state, ptr + size);
+}
+
+uint32_t mtb::Crc32C(void const* data, size_t size, uint32_t crc) {
+    uint8_t const* ptr = (uint8_t const*)data;
+    crc = ~crc;
+#if MTB_HASH_USE_SSE42
+    uint64_t crc64 = crc;
+    for(; size >= 8; size -= 8, ptr += 8) {
+        crc64 = _mm_crc32_u64(crc64, impl::HashRead64(ptr));
+    }
+    crc = (uint32_t)crc64;
+    for(; size > 0; --size, ++ptr) {
+        crc = _mm_crc32_u8(crc, *ptr);
+    }
+#elif MTB_HASH_USE_ARM_CRC32
+    for(; size >= 8; size -= 8, ptr += 8) {
+        crc = __crc32cd(crc, impl::HashRead64(ptr));
+    }
+    for(; size > 0; --size, ++ptr) {
+        crc = __crc32cb(crc, *ptr);
+    }
+#else
+    for(; size > 0; --size, ++ptr) {
+        crc = impl::crc32c_table.entries[(crc ^ *ptr) & 0xFF] ^ (crc >> 8);
+    }
+#endif
+    return ~crc;
+}
+
+#if defined(MTB_INCLUDED)
+uint64_t mtb::MapHashBytes(void const* key, size_t key_size) {
+    return Hash64(key, key_size);
+}
+
+uint64_t mtb::MapHashInteger(void const* key, size_t key_size) {
+    switch(key_size) {
+        case 1: return HashU32(*(uint8_t const*)key);
+        case 2: return HashU32(*(uint16_t const*)key);
+        case 4: return HashU32(*(uint32_t const*)key);
+        case 8: return HashU64(*(uint64_t const*)key);
+        default: return Hash64(key, key_size);
+    }
+}
+#endif  // defined(MTB_INCLUDED)
+
+#if defined(MTB_INCLUDED) && MTB_TESTS
+DOCTEST_TEST_SUITE("mtb::Hash") {
+    using namespace mtb;
+
+    DOCTEST_TEST_CASE("Crc32C") {
+        DOCTEST_CHECK(Crc32C("123456789", 9) == 0xE3069283U);
+        DOCTEST_CHECK(Crc32C("56789", 5, Crc32C("1234", 4)) == 0xE3069283U);
+        DOCTEST_CHECK(Crc32C(nullptr, 0) == 0);
+    }
+
+    DOCTEST_TEST_CASE("Streaming matches one-shot") {
+        uint8_t bytes[3000];
+        uint64_t rng_state = 17;
+        for(uint8_t& byte : bytes) {
+            byte = (uint8_t)(mtb_test::NextRandom(rng_state) >> 23);
+        }
+
+        bool ok = true;
+        size_t const lens[] = {0, 1, 3, 4, 8, 15, 16, 17, 33, 64, 100, 127, 128, 129, 191, 192, 193, 256, 1023, 1024, 1025, 3000};
+        size_t const piece_lens[] = {1, 7, 63, 64, 65, 200};
+        for(size_t len : lens) {
+            uint64_t expected = Hash64(bytes, len, 99);
+            for(size_t piece_len : piece_lens) {
+                tHashState state = HashInit(99);
+                for(size_t offset = 0; offset < len; offset += piece_len) {
+                    HashUpdate(state, bytes + offset, len - offset < piece_len ? len - offset : piece_len);
+                }
+                ok = ok && HashFinal(state) == expected;
+            }
+            ok = ok && Hash64(bytes, len, 100) != expected;
+        }
+        DOCTEST_CHECK(ok);
+    }
+
+    DOCTEST_TEST_CASE("Same result on all code paths") {
+        uint8_t bytes[1000];
+        for(int index = 0; index < 1000; ++index) {
+            bytes[index] = (uint8_t)(index * 7);
+        }
+        DOCTEST_CHECK(Hash64(bytes, 0) == 0x5627673EBCBA409DULL);
+        DOCTEST_CHECK(Hash64(bytes, 5) == 0xDA911305EF724892ULL);
+        DOCTEST_CHECK(Hash64(bytes, 100) == 0x0ED91CC6E57EACCFULL);
+        DOCTEST_CHECK(Hash64(bytes, 1000) == 0xA0FF64A8613A42BFULL);
+    }
+
+    DOCTEST_TEST_CASE("Single bit changes") {
+        // Flipping any input bit should flip about half of the output bits.
+        uint8_t bytes[300]{};
+        size_t const lens[] = {8, 24, 300};
+        bool ok = true;
+        for(size_t len : lens) {
+            uint64_t base = Hash64(bytes, len);
+            int total_flipped = 0;
+            for(size_t bit = 0; bit < len * 8; ++bit) {
+                bytes[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+                total_flipped += CountSetBits(base ^ Hash64(bytes, len));
+                bytes[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+            }
+            double average = (double)total_flipped / (double)(len * 8);
+            ok = ok && average > 28 && average < 36;
+        }
+        DOCTEST_CHECK(ok);
+    }
+
+    DOCTEST_TEST_CASE("Map defaults") {
+        tMap<uint64_t, int> map = CreateMap<uint64_t, int>(GetLibcAllocator());
+        DOCTEST_CHECK((map.HashFunc == MapHashInteger));
+        for(int index = 0; index < 1000; ++index) {
+            Put(map, (uint64_t)index << 32, index);
+        }
+        bool ok = true;
+        for(int index = 0; index < 1000; ++index) {
+            int* value = Find(map, (uint64_t)index << 32);
+            ok = ok && value && *value == index;
+        }
+        DOCTEST_CHECK(ok);
+        ClearAllocation(map);
+
+        struct tKey {
+            uint32_t parts[3];
+        };
+        DOCTEST_CHECK((DefaultMapHashFunc<tKey>() == MapHashBytes));
+        DOCTEST_CHECK((DefaultMapHashFunc<char const*>() == MapHashInteger));
+    }
+}
+#endif  // defined(MTB_INCLUDED) && MTB_TESTS
+
+#endif  // !defined(MTB__HASH_IMPLEMENTED)
+#endif  // defined(MTB_HASH_IMPLEMENTATION)
@@ -0,0 +1,116 @@
+// Lookup and insertion timings for tMap. Not part of the test build.
+//
+//     g++ -std=c++17 -O2 tests/mtb_map_bench.cpp -o mtb_map_bench
+//
+// To compare against another revision, compile a second binary with MTB_BENCH_HEADER pointing at its mtb.h:
+//
+//     git show <revision>:mtb.h > /tmp/mtb_other.h
+//     g++ -std=c++17 -O2 -DMTB_BENCH_HEADER='"/tmp/mtb_other.h"' tests/mtb_map_bench.cpp -o mtb_map_bench_other
+//
+// Define MTB_BENCH_POLICY_MAP=1 to also time tPolicyMap with its default policies, for revisions that have it.
+//
+// Keys are uint64_t multiples of 7 with a multiplicative hash. Lookups go through a fixed table of random keys, half
+// of which are in the map. Every timing is the best of several rounds.
+
+// mtb.h relies on these being included already.
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MTB_IMPLEMENTATION
+#define MTB_RNG_IMPLEMENTATION
+#if defined(MTB_BENCH_HEADER)
+#include MTB_BENCH_HEADER
+#else
+#include "../mtb.h"
+#endif
+#include "../mtb_rng.h"
+
+#if !defined(MTB_BENCH_POLICY_MAP)
+#define MTB_BENCH_POLICY_MAP 0
+#endif
+
+#include <chrono>
+#include <stdio.h>
+
+using namespace mtb;
+
+namespace {
+    constexpr int lookup_count = 20000000;
+    constexpr int round_count = 3;
+
+    uint64_t HashKey(void const* key, size_t) {
+        return *(uint64_t const*)key * 0x9E3779B97F4A7C15ULL;
+    }
+
+    int CompareKey(void const* a, void const* b, size_t) {
+        return *(uint64_t const*)a != *(uint64_t const*)b;
+    }
+
+    double Seconds() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    struct tTimings {
+        double put_ns;
+        double find_ns;
+        uint64_t checksum;
+    };
+
+    template<typename tMapType>
+    tTimings Measure(tMapType (*create_proc)(), int key_count, tSlice<uint64_t const> lookup_keys) {
+        tTimings result{1e9, 1e9, 0};
+        for(int round = 0; round < round_count; ++round) {
+            tMapType map = create_proc();
+            double start = Seconds();
+            for(int index = 0; index < key_count; ++index) {
+                Put(map, (uint64_t)index * 7, (uint64_t)index);
+            }
+            double put_ns = (Seconds() - start) * 1e9 / key_count;
+
+            uint64_t checksum = 0;
+            start = Seconds();
+            for(int index = 0; index < lookup_count; ++index) {
+                uint64_t* value = Find(map, lookup_keys[index & (lookup_keys.len - 1)]);
+                checksum += value ? *value : 1;
+            }
+            double find_ns = (Seconds() - start) * 1e9 / lookup_count;
+
+            result.put_ns = put_ns < result.put_ns ? put_ns : result.put_ns;
+            result.find_ns = find_ns < result.find_ns ? find_ns : result.find_ns;
+            result.checksum = checksum;
+            ClearAllocation(map);
+        }
+        return result;
+    }
+
+    tMap<uint64_t, uint64_t> CreateFuncMap() {
+        return CreateMap<uint64_t, uint64_t>(GetLibcAllocator(), HashKey, CompareKey);
+    }
+
+#if MTB_BENCH_POLICY_MAP
+    tPolicyMap<uint64_t, uint64_t> CreateDefaultPolicyMap() {
+        return CreatePolicyMap<uint64_t, uint64_t>(GetLibcAllocator());
+    }
+#endif
+}  // namespace
+
+int main() {
+    static uint64_t lookup_keys[1 << 16];
+    int const key_counts[] = {1000, 100000, 4000000};
+
+    printf("%-12s %10s %12s %12s\n", "map", "keys", "Put ns", "Find ns");
+    for(int key_count : key_counts) {
+        tRNG rng = tRNG::Seed(1);
+        for(uint64_t& key : lookup_keys) {
+            key = (uint64_t)rng.RandomBelow_u32((uint32_t)(2 * key_count)) * 7;
+        }
+
+        tTimings timings = Measure(CreateFuncMap, key_count, ArraySlice(lookup_keys));
+        printf("%-12s %10d %12.1f %12.1f  (checksum %llu)\n", "tMap", key_count, timings.put_ns, timings.find_ns, (unsigned long long)timings.checksum);
+#if MTB_BENCH_POLICY_MAP
+        timings = Measure(CreateDefaultPolicyMap, key_count, ArraySlice(lookup_keys));
+        printf("%-12s %10d %12.1f %12.1f  (checksum %llu)\n", "tPolicyMap", key_count, timings.put_ns, timings.find_ns, (unsigned long long)timings.checksum);
+#endif
+    }
+}
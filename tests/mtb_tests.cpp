@@ -2,5 +2,12 @@
 #include "doctest.h"
 
 #define MTB_IMPLEMENTATION
+#define MTB_HASH_IMPLEMENTATION
+#define MFS_IMPLEMENTATION
+#if !defined(_WIN32)
+#define MFS_BACKEND_POSIX
+#endif
 #include "..\mtb.h"
 #include "..\mtb_rng.h"
+#include "..\mtb_hash.h"
+#include "..\mtb_filesystem.h"